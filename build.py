@@ -758,12 +758,13 @@ class Builder(object):
                           '-DCMAKE_INSTALL_PREFIX=' + self._install_dir,
                           '-DCMAKE_PREFIX_PATH=' + self._install_dir,
                           '-DCMAKE_BUILD_TYPE=' + self._build_config,
+                          self.track_allocations_definition(),
                           '-G', cmake_generator, '..']
             self.run_cmd(cmake_args)
             self.set_startup_vs_prj('ppp_test')
         else:
             targets = ['install'] if self._arch_name != 'wasm' else []
-            self.build_cmake_lib('..', [], targets, False)
+            self.build_cmake_lib('..', [self.track_allocations_definition()], targets, False)
             # Run unit tests for C++ code
             if self._arch_name in ['x64', 'x86'] and self._run_tests:
                 os.chdir(self._install_dir)
@@ -856,6 +857,8 @@ class Builder(object):
         parser.add_argument('--skip_install', help='Skips installation', action="store_true")
         parser.add_argument('--gen_vs_sln', help='Generates Visual Studio solution and projects',
                             action="store_true")
+        parser.add_argument('--track_allocations', help='Counts heap allocations per stage and request (slower)',
+                            action="store_true")
         parser.add_argument('--no_npm', help='Skips installing npm packages. Use only on developer workflow',
                             action="store_true")
 
@@ -873,8 +876,13 @@ class Builder(object):
         self._run_tests = args.test
         self._run_install = not args.skip_install
         self._no_npm = args.no_npm
+        self._track_allocations = args.track_allocations
         self._emsdk_backend = 'upstream' if 'upstream' in self.emsdk_version_number else 'fastcomp'
 
+    def track_allocations_definition(self):
+        # Always passed, the option would otherwise stick in the CMake cache of the build directory
+        return '-DPPP_TRACK_ALLOCATIONS=' + ('ON' if self._track_allocations else 'OFF')
+
     def clean_all_if_needed(self):
         if 'all' in self._clean_targets:
             if os.path.isdir(self._third_party_install_dir):
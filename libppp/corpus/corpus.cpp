@@ -0,0 +1,591 @@
+/*
+ * Generates a deterministic corpus of face pictures for the benchmarks and soak tests: augmented copies of the
+ * bundled sample pictures (or drawn face-like pictures when there are none) at every requested resolution, rotation,
+ * JPEG quality and EXIF variant. The same seed and options give the same files for a given OpenCV build, so runs on
+ * different boxes are comparable without shipping datasets. A corpus.json manifest describes every file.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+#include <tclap/CmdLine.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace
+{
+enum class ExifVariant
+{
+    NONE, ///<- No EXIF segment
+    CAMERA, ///<- Camera make, model and dates, upright pixels
+    ORIENTED, ///<- Pixels stored sideways or upside down with the orientation tag that makes them upright
+};
+
+const vector<pair<ExifVariant, string>> EXIF_VARIANT_NAMES = {
+    { ExifVariant::NONE, "none" },
+    { ExifVariant::CAMERA, "camera" },
+    { ExifVariant::ORIENTED, "oriented" },
+};
+
+struct SourcePicture
+{
+    string name;
+    cv::Mat image;
+};
+
+struct CorpusEntry
+{
+    string fileName;
+    string source;
+    cv::Size size;
+    double rotation;
+    int quality;
+    ExifVariant exifVariant;
+    int orientation; ///<- EXIF orientation tag, 0 when there is none
+};
+
+template <typename T>
+vector<T> parseList(const string & list, const string & name)
+{
+    vector<T> values;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        istringstream is(item);
+        T value;
+        if (!(is >> value) || !is.eof())
+        {
+            throw runtime_error("Invalid value '" + item + "' in --" + name);
+        }
+        values.push_back(value);
+    }
+    if (values.empty())
+    {
+        throw runtime_error("Empty list in --" + name);
+    }
+    return values;
+}
+
+vector<ExifVariant> parseExifVariants(const string & list)
+{
+    vector<ExifVariant> variants;
+    for (const auto & name : parseList<string>(list, "exif"))
+    {
+        const auto it = find_if(EXIF_VARIANT_NAMES.begin(), EXIF_VARIANT_NAMES.end(), [&name](const auto & p) {
+            return p.second == name;
+        });
+        if (it == EXIF_VARIANT_NAMES.end())
+        {
+            throw runtime_error("Unknown EXIF variant '" + name + "'");
+        }
+        variants.push_back(it->first);
+    }
+    return variants;
+}
+
+const string & exifVariantName(const ExifVariant variant)
+{
+    return find_if(EXIF_VARIANT_NAMES.begin(), EXIF_VARIANT_NAMES.end(), [variant](const auto & p) {
+               return p.first == variant;
+           })->second;
+}
+
+vector<SourcePicture> readSourcePictures(const string & sourcesDir)
+{
+    vector<fs::path> files;
+    if (fs::is_directory(sourcesDir))
+    {
+        for (const auto & entry : fs::directory_iterator(sourcesDir))
+        {
+            const auto ext = entry.path().extension().string();
+            if (ext == ".jpg" || ext == ".png")
+            {
+                files.push_back(entry.path());
+            }
+        }
+    }
+    // Directory iteration order is up to the file system
+    sort(files.begin(), files.end());
+
+    vector<SourcePicture> pictures;
+    for (const auto & file : files)
+    {
+        auto image = cv::imread(file.string(), cv::IMREAD_COLOR);
+        if (!image.empty())
+        {
+            pictures.push_back({ file.filename().string(), image });
+        }
+    }
+    return pictures;
+}
+
+// Random values only come from cv::RNG, whose sequence is defined by OpenCV, unlike the distributions of <random>
+cv::Mat drawFacePicture(cv::RNG & rng)
+{
+    const cv::Size size(1200, 1600);
+    cv::Mat image(size, CV_8UC3);
+    const cv::Scalar top(rng.uniform(150, 255), rng.uniform(150, 255), rng.uniform(150, 255));
+    const cv::Scalar bottom = top * 0.7;
+    for (auto row = 0; row < size.height; ++row)
+    {
+        const auto t = static_cast<double>(row) / size.height;
+        image.row(row).setTo(top * (1 - t) + bottom * t);
+    }
+
+    const auto skin = cv::Scalar(rng.uniform(60, 140), rng.uniform(100, 170), rng.uniform(150, 230));
+    const auto hair = cv::Scalar(rng.uniform(10, 80), rng.uniform(10, 70), rng.uniform(10, 70));
+    const cv::Point center(size.width / 2 + rng.uniform(-60, 60), size.height / 2 + rng.uniform(-40, 40));
+    const cv::Size head(rng.uniform(260, 320), rng.uniform(350, 410));
+    const auto eyeY = center.y - head.height / 6;
+    const auto eyeDx = head.width * 2 / 5;
+
+    cv::rectangle(image,
+                  cv::Point(center.x - head.width * 3 / 5, center.y + head.height * 4 / 5),
+                  cv::Point(center.x + head.width * 3 / 5, size.height),
+                  skin * 0.8,
+                  cv::FILLED,
+                  cv::LINE_AA);
+    cv::ellipse(image, center - cv::Point(0, head.height / 8), head + cv::Size(30, 30), 0, 180, 360, hair, -1);
+    cv::ellipse(image, center, head, 0, 0, 360, skin, cv::FILLED, cv::LINE_AA);
+    for (const auto side : { -1, 1 })
+    {
+        const cv::Point eye(center.x + side * eyeDx, eyeY);
+        cv::ellipse(image, eye, cv::Size(42, 20), 0, 0, 360, cv::Scalar(235, 235, 235), cv::FILLED, cv::LINE_AA);
+        cv::circle(image, eye, 16, cv::Scalar(rng.uniform(30, 120), rng.uniform(30, 90), 40), -1, cv::LINE_AA);
+        cv::circle(image, eye, 7, cv::Scalar(15, 15, 15), cv::FILLED, cv::LINE_AA);
+        cv::ellipse(image, eye - cv::Point(0, 40), cv::Size(50, 12), 0, 200, 340, hair, 10, cv::LINE_AA);
+    }
+    cv::line(image, cv::Point(center.x, eyeY + 20), cv::Point(center.x - 12, center.y + 70), skin * 0.7, 6);
+    cv::ellipse(image,
+                cv::Point(center.x, center.y + head.height / 2),
+                cv::Size(head.width / 3, 22),
+                0,
+                0,
+                180,
+                cv::Scalar(70, 70, 170),
+                10,
+                cv::LINE_AA);
+    return image;
+}
+
+cv::Mat rotatePicture(const cv::Mat & image, const double degrees)
+{
+    const auto quarterTurns = static_cast<int>(std::lround(degrees / 90.0));
+    if (std::abs(degrees - 90.0 * quarterTurns) < 1e-9)
+    {
+        cv::Mat rotated;
+        switch (((quarterTurns % 4) + 4) % 4)
+        {
+            case 1:
+                cv::rotate(image, rotated, cv::ROTATE_90_COUNTERCLOCKWISE);
+                return rotated;
+            case 2:
+                cv::rotate(image, rotated, cv::ROTATE_180);
+                return rotated;
+            case 3:
+                cv::rotate(image, rotated, cv::ROTATE_90_CLOCKWISE);
+                return rotated;
+            default:
+                return image.clone();
+        }
+    }
+    // Tilted heads keep the size of the picture, corners are filled from the border
+    const cv::Point2f center(image.cols / 2.0f, image.rows / 2.0f);
+    cv::Mat rotated;
+    cv::warpAffine(image,
+                   rotated,
+                   cv::getRotationMatrix2D(center, degrees, 1.0),
+                   image.size(),
+                   cv::INTER_LINEAR,
+                   cv::BORDER_REPLICATE);
+    return rotated;
+}
+
+// Crop, flip and exposure changes, so that copies of the same picture are different pictures
+cv::Mat augmentPicture(const cv::Mat & image, cv::RNG & rng)
+{
+    const auto maxDx = image.cols / 20;
+    const auto maxDy = image.rows / 20;
+    const auto left = rng.uniform(0, maxDx + 1);
+    const auto top = rng.uniform(0, maxDy + 1);
+    const auto right = rng.uniform(0, maxDx + 1);
+    const auto bottom = rng.uniform(0, maxDy + 1);
+    cv::Mat augmented = image(cv::Rect(left, top, image.cols - left - right, image.rows - top - bottom)).clone();
+    if (rng.uniform(0, 2) == 1)
+    {
+        cv::flip(augmented, augmented, 1);
+    }
+    augmented.convertTo(augmented, -1, rng.uniform(0.85, 1.15), rng.uniform(-20.0, 20.0));
+    return augmented;
+}
+
+// Upscaled pictures are too smooth to compress like camera pictures, sensor like noise gives them a realistic size
+cv::Mat resizePicture(const cv::Mat & image, const double megapixels, cv::RNG & rng)
+{
+    const auto aspectRatio = static_cast<double>(image.cols) / image.rows;
+    const auto height = std::max(1, static_cast<int>(std::lround(std::sqrt(megapixels * 1e6 / aspectRatio))));
+    const auto width = std::max(1, static_cast<int>(std::lround(height * aspectRatio)));
+    cv::Mat resized;
+    const auto interpolation = width < image.cols ? cv::INTER_AREA : cv::INTER_CUBIC;
+    cv::resize(image, resized, cv::Size(width, height), 0, 0, interpolation);
+
+    cv::Mat noise(resized.size(), CV_16SC3);
+    rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(rng.uniform(1.0, 4.0)));
+    cv::Mat noisy;
+    resized.convertTo(noisy, CV_16SC3);
+    noisy += noise;
+    noisy.convertTo(resized, CV_8UC3);
+    return resized;
+}
+
+/*!@brief Little endian TIFF structure of an EXIF APP1 segment. Values that do not fit in an IFD entry are written
+ * after the IFDs, offsets are relative to the TIFF header !*/
+class ExifSegmentWriter
+{
+public:
+    void addAscii(const uint16_t tag, const string & value)
+    {
+        m_entries.push_back({ tag, 2, static_cast<uint32_t>(value.size() + 1), 0, value + '\0' });
+    }
+
+    void addShort(const uint16_t tag, const uint16_t value)
+    {
+        m_entries.push_back({ tag, 3, 1, value, "" });
+    }
+
+    void addLong(const uint16_t tag, const uint32_t value)
+    {
+        m_entries.push_back({ tag, 4, 1, value, "" });
+    }
+
+    /*!@brief Segment with the entries in one IFD, plus an EXIF sub-IFD for DateTimeOriginal if given !*/
+    vector<uint8_t> build(const string & dateTimeOriginal)
+    {
+        vector<uint8_t> tiff { 'I', 'I', 42, 0, 8, 0, 0, 0 };
+        if (!dateTimeOriginal.empty())
+        {
+            addLong(EXIF_IFD_POINTER, 0);
+        }
+        sort(m_entries.begin(), m_entries.end(), [](const Entry & a, const Entry & b) { return a.tag < b.tag; });
+        const auto exifIfdOffset = writeIfd(tiff, m_entries);
+        if (!dateTimeOriginal.empty())
+        {
+            const auto pointer = find_if(m_entries.begin(), m_entries.end(), [](const Entry & e) {
+                return e.tag == EXIF_IFD_POINTER;
+            });
+            patchLong(tiff, pointer->valueOffsetPosition, exifIfdOffset);
+            vector<Entry> exifEntries { { DATE_TIME_ORIGINAL, 2, 20, 0, dateTimeOriginal + '\0' } };
+            writeIfd(tiff, exifEntries);
+        }
+
+        vector<uint8_t> segment { 0xFF, 0xE1, 0, 0, 'E', 'x', 'i', 'f', 0, 0 };
+        segment.insert(segment.end(), tiff.begin(), tiff.end());
+        const auto length = segment.size() - 2;
+        segment[2] = static_cast<uint8_t>(length >> 8);
+        segment[3] = static_cast<uint8_t>(length & 0xFF);
+        return segment;
+    }
+
+private:
+    static constexpr uint16_t EXIF_IFD_POINTER = 0x8769;
+    static constexpr uint16_t DATE_TIME_ORIGINAL = 0x9003;
+
+    struct Entry
+    {
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+        uint32_t value; ///<- Value of SHORT and LONG entries
+        string data; ///<- Value of ASCII entries
+        size_t valueOffsetPosition = 0;
+    };
+
+    static void putShort(vector<uint8_t> & out, const uint16_t v)
+    {
+        out.push_back(static_cast<uint8_t>(v & 0xFF));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    static void putLong(vector<uint8_t> & out, const uint32_t v)
+    {
+        for (auto shift = 0; shift < 32; shift += 8)
+        {
+            out.push_back(static_cast<uint8_t>((v >> shift) & 0xFF));
+        }
+    }
+
+    static void patchLong(vector<uint8_t> & out, const size_t position, const uint32_t v)
+    {
+        for (auto i = 0; i < 4; ++i)
+        {
+            out[position + i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+        }
+    }
+
+    // Writes the IFD and the values stored outside of it, returns the offset following them
+    static uint32_t writeIfd(vector<uint8_t> & out, vector<Entry> & entries)
+    {
+        putShort(out, static_cast<uint16_t>(entries.size()));
+        for (auto & entry : entries)
+        {
+            putShort(out, entry.tag);
+            putShort(out, entry.type);
+            putLong(out, entry.count);
+            entry.valueOffsetPosition = out.size();
+            putLong(out, entry.type == 2 && entry.data.size() <= 4 ? 0 : entry.value);
+            if (entry.type == 2 && entry.data.size() <= 4)
+            {
+                copy(entry.data.begin(), entry.data.end(), out.begin() + entry.valueOffsetPosition);
+            }
+        }
+        putLong(out, 0); // No next IFD
+        for (auto & entry : entries)
+        {
+            if (entry.type == 2 && entry.data.size() > 4)
+            {
+                patchLong(out, entry.valueOffsetPosition, static_cast<uint32_t>(out.size()));
+                out.insert(out.end(), entry.data.begin(), entry.data.end());
+                if (out.size() % 2 == 1)
+                {
+                    out.push_back(0); // Values start on a word boundary
+                }
+            }
+        }
+        return static_cast<uint32_t>(out.size());
+    }
+
+    vector<Entry> m_entries;
+};
+
+// EXIF orientation tag of upright pixels stored rotated by the given number of counterclockwise quarter turns
+int orientationOfQuarterTurns(const int quarterTurns)
+{
+    static const int ORIENTATIONS[] = { 1, 6, 3, 8 };
+    return ORIENTATIONS[quarterTurns % 4];
+}
+
+vector<uint8_t> encodeJpeg(const cv::Mat & image,
+                           const int quality,
+                           const ExifVariant exifVariant,
+                           const size_t index,
+                           int & orientation,
+                           cv::RNG & rng)
+{
+    orientation = 0;
+    auto stored = image;
+    if (exifVariant == ExifVariant::ORIENTED)
+    {
+        const auto quarterTurns = rng.uniform(1, 4);
+        orientation = orientationOfQuarterTurns(quarterTurns);
+        stored = rotatePicture(image, 90.0 * quarterTurns);
+    }
+
+    vector<uint8_t> jpeg;
+    cv::imencode(".jpg", stored, jpeg, { cv::IMWRITE_JPEG_QUALITY, quality });
+    if (exifVariant == ExifVariant::NONE)
+    {
+        return jpeg;
+    }
+
+    // Dates are derived from the index, not the clock, so that files are the same on every run
+    ostringstream dateTime;
+    dateTime << "2020:" << setfill('0') << setw(2) << 1 + index % 12 << ":" << setw(2) << 1 + index % 28 << " "
+             << setw(2) << index % 24 << ":" << setw(2) << index % 60 << ":" << setw(2) << (index * 7) % 60;
+    ExifSegmentWriter exif;
+    exif.addAscii(0x010F, "PPP Corpus");
+    exif.addAscii(0x0110, "Synthetic Camera " + to_string(1 + index % 3));
+    exif.addShort(0x0112, static_cast<uint16_t>(orientation == 0 ? 1 : orientation));
+    exif.addAscii(0x0132, dateTime.str());
+    if (orientation == 0)
+    {
+        orientation = 1;
+    }
+    const auto segment = exif.build(dateTime.str());
+
+    // After the JFIF APP0 segment written by the encoder, if any
+    size_t position = 2;
+    if (jpeg.size() > 5 && jpeg[2] == 0xFF && jpeg[3] == 0xE0)
+    {
+        position += 2 + (static_cast<size_t>(jpeg[4]) << 8 | jpeg[5]);
+    }
+    jpeg.insert(jpeg.begin() + static_cast<ptrdiff_t>(position), segment.begin(), segment.end());
+    return jpeg;
+}
+
+string formatNumber(const double value)
+{
+    ostringstream oss;
+    oss << value;
+    auto str = oss.str();
+    replace(str.begin(), str.end(), '.', 'p');
+    replace(str.begin(), str.end(), '-', 'm');
+    return str;
+}
+
+void writeManifest(const string & path, const vector<CorpusEntry> & entries, const unsigned seed)
+{
+    ofstream ofs(path);
+    rapidjson::OStreamWrapper osw(ofs);
+    rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(osw);
+    writer.StartObject();
+    writer.Key("seed");
+    writer.Uint(seed);
+    writer.Key("pictures");
+    writer.StartArray();
+    for (const auto & entry : entries)
+    {
+        writer.StartObject();
+        writer.Key("file");
+        writer.String(entry.fileName);
+        writer.Key("source");
+        writer.String(entry.source);
+        writer.Key("width");
+        writer.Int(entry.size.width);
+        writer.Key("height");
+        writer.Int(entry.size.height);
+        writer.Key("rotation");
+        writer.Double(entry.rotation);
+        writer.Key("quality");
+        writer.Int(entry.quality);
+        writer.Key("exif");
+        writer.String(exifVariantName(entry.exifVariant));
+        writer.Key("orientation");
+        writer.Int(entry.orientation);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    TCLAP::CmdLine cmd("Generates a deterministic corpus of face pictures for benchmarks", ' ', "1.0");
+    TCLAP::ValueArg<string> outputDir("o", "output", "Directory receiving the corpus", false, "corpus", "directory");
+    TCLAP::ValueArg<string> sourcesDir("",
+                                       "sources",
+                                       "Directory with the pictures to augment, faces are drawn when it has none",
+                                       false,
+                                       "research/sample_test_images",
+                                       "directory path");
+    TCLAP::SwitchArg synthetic("", "synthetic", "Draw face-like pictures instead of augmenting the sources", false);
+    TCLAP::ValueArg<string> megapixels("",
+                                       "megapixels",
+                                       "Comma separated resolutions of the pictures, in megapixels",
+                                       false,
+                                       "0.3,2,8,12,24,48",
+                                       "list");
+    TCLAP::ValueArg<string> rotations("",
+                                      "rotations",
+                                      "Comma separated rotations of the picture content, in degrees counterclockwise",
+                                      false,
+                                      "0",
+                                      "list");
+    TCLAP::ValueArg<string> qualities("", "qualities", "Comma separated JPEG qualities", false, "85", "list");
+    TCLAP::ValueArg<string> exifVariants("",
+                                         "exif",
+                                         "Comma separated EXIF variants among none, camera and oriented",
+                                         false,
+                                         "none,camera,oriented",
+                                         "list");
+    TCLAP::ValueArg<size_t> copies("c", "copies", "Pictures generated per combination of options", false, 1, "count");
+    TCLAP::ValueArg<unsigned> seed("", "seed", "Seed of the augmentations", false, 42, "integer");
+    cmd.add(outputDir);
+    cmd.add(sourcesDir);
+    cmd.add(synthetic);
+    cmd.add(megapixels);
+    cmd.add(rotations);
+    cmd.add(qualities);
+    cmd.add(exifVariants);
+    cmd.add(copies);
+    cmd.add(seed);
+    cmd.parse(argc, argv);
+
+    vector<double> resolutions;
+    vector<double> angles;
+    vector<int> jpegQualities;
+    vector<ExifVariant> variants;
+    try
+    {
+        resolutions = parseList<double>(megapixels.getValue(), "megapixels");
+        angles = parseList<double>(rotations.getValue(), "rotations");
+        jpegQualities = parseList<int>(qualities.getValue(), "qualities");
+        variants = parseExifVariants(exifVariants.getValue());
+    }
+    catch (const exception & ex)
+    {
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    cv::RNG rng(seed.getValue());
+    vector<SourcePicture> sources;
+    if (!synthetic.getValue())
+    {
+        sources = readSourcePictures(sourcesDir.getValue());
+    }
+    if (sources.empty())
+    {
+        cout << "Drawing face-like pictures" << endl;
+        for (auto i = 0; i < 8; ++i)
+        {
+            sources.push_back({ "synthetic_" + to_string(i), drawFacePicture(rng) });
+        }
+    }
+
+    fs::create_directories(outputDir.getValue());
+    vector<CorpusEntry> entries;
+    size_t index = 0;
+    for (const auto mp : resolutions)
+    {
+        for (const auto angle : angles)
+        {
+            for (const auto quality : jpegQualities)
+            {
+                for (const auto variant : variants)
+                {
+                    for (size_t copy = 0; copy < copies.getValue(); ++copy, ++index)
+                    {
+                        const auto & source = sources[index % sources.size()];
+                        auto image = augmentPicture(source.image, rng);
+                        image = resizePicture(rotatePicture(image, angle), mp, rng);
+
+                        CorpusEntry entry { "", source.name, image.size(), angle, quality, variant, 0 };
+                        const auto jpeg = encodeJpeg(image, quality, variant, index, entry.orientation, rng);
+                        ostringstream fileName;
+                        fileName << setfill('0') << setw(4) << index << "_" << formatNumber(mp) << "mp_r"
+                                 << formatNumber(angle) << "_q" << quality << "_" << exifVariantName(variant) << ".jpg";
+                        entry.fileName = fileName.str();
+
+                        ofstream ofs((fs::path(outputDir.getValue()) / entry.fileName).string(), ios::binary);
+                        ofs.write(reinterpret_cast<const char *>(jpeg.data()), static_cast<streamsize>(jpeg.size()));
+                        if (!ofs)
+                        {
+                            cerr << "Unable to write " << entry.fileName << endl;
+                            return 1;
+                        }
+                        cout << entry.fileName << " " << image.cols << "x" << image.rows << " from " << source.name
+                             << " (" << jpeg.size() / 1024 << " KiB)" << endl;
+                        entries.push_back(entry);
+                    }
+                }
+            }
+        }
+    }
+    writeManifest((fs::path(outputDir.getValue()) / "corpus.json").string(), entries, seed.getValue());
+    cout << "Generated " << entries.size() << " pictures in " << outputDir.getValue() << endl;
+    return 0;
+}
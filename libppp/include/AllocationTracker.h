@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ppp
+{
+/*!@brief Number of heap allocations and bytes requested !*/
+struct AllocationCounts final
+{
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    AllocationCounts operator-(const AllocationCounts & other) const;
+    AllocationCounts & operator+=(const AllocationCounts & other);
+};
+
+/*!@brief Counts the heap allocations made by each thread. Only active when the library is built with the
+ * PPP_TRACK_ALLOCATIONS CMake option, which replaces the global operator new and the default cv::Mat allocator.
+ * Allocations are attributed to stages and requests by the StageScope instances that enclose them on the same
+ * thread. Threads started by the library (gang sheet rendering, PNG encoding) measure what they allocate and the
+ * thread waiting for them adds it to its own totals with attributeToCurrentThread. Allocations made in the worker
+ * threads of OpenCV (cv::parallel_for_) are not attributed to any scope !*/
+class AllocationTracker final
+{
+public:
+    static constexpr bool isEnabled()
+    {
+#ifdef PPP_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /*!@brief Running totals of the calling thread !*/
+    static AllocationCounts currentThreadCounts();
+
+    /*!@brief Adds an allocation to the totals of the calling thread, must not allocate !*/
+    static void recordAllocation(size_t bytes) noexcept;
+
+    /*!@brief Adds the allocations that another thread made on behalf of the calling one to its totals, so that the
+     * scopes enclosing the call include them !*/
+    static void attributeToCurrentThread(const AllocationCounts & counts) noexcept;
+};
+} // namespace ppp
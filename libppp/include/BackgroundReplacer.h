@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CommonHelpers.h"
+#include "IConfigurable.h"
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+FWD_DECL(BackgroundReplacer)
+
+/*!@brief Replaces the background of a portrait with a plain colour.
+ * The foreground matte is segmented (GrabCut) on a small proxy of the picture, seeded with the head and shoulders
+ * expected around the crown and chin points, then upsampled to full resolution with a fast guided filter that snaps
+ * the matte to the edges of the picture. Compositing onto the colour is a single pass over the full resolution
+ * pixels, so the cost barely depends on the size of the picture !*/
+class BackgroundReplacer final : public IConfigurable
+{
+public:
+    bool isEnabled() const;
+
+    /*!@brief Replaces the background of a BGR picture in place
+     * param[in,out] image Picture to process, typically a crop around the face
+     * param[in] crownPoint Crown point in picture coordinates
+     * param[in] chinPoint Chin point in picture coordinates
+     * param[in] backgroundColor Colour composited behind the foreground
+     !*/
+    void replace(cv::Mat & image,
+                 const cv::Point2d & crownPoint,
+                 const cv::Point2d & chinPoint,
+                 const cv::Scalar & backgroundColor) const;
+
+    /*!@brief Foreground matte (CV_32F in [0, 1]) at the resolution of the proxy the segmentation runs on !*/
+    cv::Mat estimateProxyMatte(const cv::Mat & proxyImage,
+                               const cv::Point2d & crownPoint,
+                               const cv::Point2d & chinPoint) const;
+
+private:
+    void configureInternal(const ConfigLoaderSPtr & config) override;
+
+    bool m_enabled = false;
+    int m_proxySize = 128; ///<- Largest side of the proxy the matte is estimated on
+    int m_iterations = 2; ///<- GrabCut iterations
+    int m_guidedFilterRadius = 4; ///<- Window radius of the guided filter, in proxy pixels
+    double m_guidedFilterEps = 1e-3; ///<- Regularization of the guided filter, higher values blur the matte edges
+};
+} // namespace ppp
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include <dlib/image_processing/shape_predictor.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PPP_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PPP_PREFETCH(address)
+#endif
+
+namespace ppp
+{
+FWD_DECL(BatchShapePredictor)
+
+/*!@brief Evaluates a dlib shape predictor on many faces at once, with results identical bit for bit to dlib's.
+ * dlib processes one face at a time, walking each regression tree with a data dependent branch per level and
+ * reading feature pixels scattered across the image. Here a block of faces goes through each cascade level together:
+ * the feature pixels of all the faces are located and prefetched before any of them is read, then each tree is
+ * walked by all the faces in lockstep with branchless steps, so that the independent walks overlap in the pipeline
+ * and every tree is brought into the cache once per block instead of once per face.
+ * Only the tree walks and the pixel gathering are reimplemented: the shape alignment calls the same dlib functions,
+ * so the floating point operations and their order are unchanged.
+ * Optionally a face leaves the cascade once it has converged, i.e. once a level moves its shape points by less than
+ * a threshold on average. Shapes are then no longer identical to dlib's, see setConvergenceThreshold !*/
+class BatchShapePredictor final
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 8; ///<- Faces processed together
+
+    /*!@brief Copies the model, throws if its trees are not all complete trees of the same depth !*/
+    explicit BatchShapePredictor(const dlib::shape_predictor & shapePredictor);
+
+    /*!@brief Predicts the shape of every face, faces[i] being in images[i]
+     *  @param[out] numCascades If not null, receives the number of cascade levels evaluated for each face !*/
+    template <typename image_type>
+    std::vector<dlib::full_object_detection> operator()(const std::vector<const image_type *> & images,
+                                                        const std::vector<dlib::rectangle> & faces,
+                                                        std::vector<size_t> * numCascades = nullptr) const;
+
+    size_t numParts() const;
+
+    size_t numCascades() const;
+
+    /*!@brief Sets the mean displacement of the shape points by a cascade level, relative to the size of the face,
+     * under which the remaining levels are skipped. 0 (the default) evaluates all the levels !*/
+    void setConvergenceThreshold(float threshold);
+
+private:
+    struct Split
+    {
+        uint32_t idx1;
+        uint32_t idx2;
+        float threshold;
+    };
+
+    /*!@brief Level of the cascade, trees are stored in the breadth first layout of dlib !*/
+    struct Cascade
+    {
+        std::vector<Split> splits; ///<- m_numSplits per tree
+        std::vector<float> leafValues; ///<- m_numLeaves shape displacements per tree
+        std::vector<unsigned long> anchorIdx; ///<- Shape point each feature pixel is relative to
+        std::vector<dlib::vector<float, 2>> deltas; ///<- Offset of each feature pixel from its anchor
+    };
+
+    template <typename image_type>
+    void predictBlock(const std::vector<const image_type *> & images,
+                      const std::vector<dlib::rectangle> & faces,
+                      size_t first,
+                      size_t count,
+                      std::vector<dlib::full_object_detection> & shapes,
+                      std::vector<size_t> * numCascades) const;
+
+    /*!@brief Walks every tree of the cascade for the given faces of the block and adds the leaves to their shapes !*/
+    void applyCascade(const Cascade & cascade,
+                      const float * featurePixelValues,
+                      const std::vector<size_t> & activeFaces,
+                      std::vector<dlib::matrix<float, 0, 1>> & shapes) const;
+
+    /*!@brief Removes the faces whose shapes moved less than the convergence threshold since the previous level !*/
+    void removeConvergedFaces(const std::vector<dlib::matrix<float, 0, 1>> & previousShapes,
+                              const std::vector<dlib::matrix<float, 0, 1>> & shapes,
+                              std::vector<size_t> & activeFaces) const;
+
+    dlib::matrix<float, 0, 1> m_initialShape;
+    std::vector<Cascade> m_cascades;
+    size_t m_numTrees = 0; ///<- Per cascade level
+    size_t m_numFeatures = 0; ///<- Per cascade level
+    size_t m_depth = 0;
+    size_t m_numSplits = 0;
+    size_t m_numLeaves = 0;
+    float m_convergenceThreshold = 0.0f;
+};
+
+template <typename image_type>
+std::vector<dlib::full_object_detection> BatchShapePredictor::operator()(
+    const std::vector<const image_type *> & images,
+    const std::vector<dlib::rectangle> & faces,
+    std::vector<size_t> * numCascades) const
+{
+    if (images.size() != faces.size())
+    {
+        throw std::runtime_error("Each face needs the image it is in");
+    }
+    std::vector<dlib::full_object_detection> shapes(faces.size());
+    if (numCascades != nullptr)
+    {
+        numCascades->assign(faces.size(), 0);
+    }
+    for (size_t first = 0; first < faces.size(); first += BLOCK_SIZE)
+    {
+        predictBlock(images, faces, first, std::min(BLOCK_SIZE, faces.size() - first), shapes, numCascades);
+    }
+    return shapes;
+}
+
+template <typename image_type>
+void BatchShapePredictor::predictBlock(const std::vector<const image_type *> & images,
+                                       const std::vector<dlib::rectangle> & faces,
+                                       const size_t first,
+                                       const size_t count,
+                                       std::vector<dlib::full_object_detection> & shapes,
+                                       std::vector<size_t> * numCascades) const
+{
+    using namespace dlib;
+    using pixel_type = typename image_traits<image_type>::pixel_type;
+
+    std::vector<matrix<float, 0, 1>> currentShapes(count, m_initialShape);
+    std::vector<matrix<float, 0, 1>> previousShapes;
+    std::vector<const pixel_type *> featurePixels(count * m_numFeatures);
+    std::vector<float> featurePixelValues(count * m_numFeatures);
+    std::vector<size_t> activeFaces(count);
+    std::iota(activeFaces.begin(), activeFaces.end(), 0);
+
+    for (size_t level = 0; level < m_cascades.size() && !activeFaces.empty(); ++level)
+    {
+        const auto & cascade = m_cascades[level];
+        // Same computation as dlib's extract_feature_pixel_values, except that all the pixels of the block are
+        // prefetched before the first one is read
+        for (size_t a = 0; a < activeFaces.size(); ++a)
+        {
+            const auto f = activeFaces[a];
+            const auto & image = *images[first + f];
+            const const_image_view<image_type> imageView(image);
+            const auto area = get_rect(image);
+            const point_transform_affine tformToImage = impl::unnormalizing_tform(faces[first + f]);
+            const matrix<float, 2, 2> tform
+                = matrix_cast<float>(impl::find_tform_between_shapes(m_initialShape, currentShapes[f]).get_m());
+            for (size_t i = 0; i < m_numFeatures; ++i)
+            {
+                const point p
+                    = tformToImage(tform * cascade.deltas[i] + impl::location(currentShapes[f], cascade.anchorIdx[i]));
+                const auto pixel = area.contains(p) ? &imageView[p.y()][p.x()] : nullptr;
+                PPP_PREFETCH(pixel);
+                featurePixels[a * m_numFeatures + i] = pixel;
+            }
+        }
+        for (size_t i = 0; i < activeFaces.size() * m_numFeatures; ++i)
+        {
+            featurePixelValues[i] = featurePixels[i] != nullptr ? get_pixel_intensity(*featurePixels[i]) : 0;
+        }
+
+        if (m_convergenceThreshold > 0)
+        {
+            previousShapes = currentShapes;
+        }
+        applyCascade(cascade, featurePixelValues.data(), activeFaces, currentShapes);
+        if (numCascades != nullptr)
+        {
+            for (const auto f : activeFaces)
+            {
+                (*numCascades)[first + f] = level + 1;
+            }
+        }
+        if (m_convergenceThreshold > 0)
+        {
+            removeConvergedFaces(previousShapes, currentShapes, activeFaces);
+        }
+    }
+
+    for (size_t f = 0; f < count; ++f)
+    {
+        const auto & face = faces[first + f];
+        const point_transform_affine tformToImage = impl::unnormalizing_tform(face);
+        std::vector<point> parts(currentShapes[f].size() / 2);
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            parts[i] = tformToImage(impl::location(currentShapes[f], i));
+        }
+        shapes[first + f] = full_object_detection(face, parts);
+    }
+}
+} // namespace ppp
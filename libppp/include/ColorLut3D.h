@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+FWD_DECL(ColorLut3D)
+
+/*!@brief Colour transform sampled on a regular BGR grid and applied with trilinear interpolation.
+ * Any chain of per pixel colour corrections (exposure, white balance, contrast ...) collapses into one table, so
+ * applying all of them costs a single pass over the image !*/
+class ColorLut3D final
+{
+public:
+    using ColorTransform = std::function<cv::Vec3f(const cv::Vec3f & bgr)>;
+
+    /*!@brief Samples the transform on gridSize^3 nodes, colours being in [0, 1] !*/
+    static ColorLut3D fromTransform(const ColorTransform & transform, int gridSize = 17);
+
+    /*!@brief Builds the exposure, white balance and contrast correction of a portrait from its statistics.
+     * Levels and white balance come from the whole picture, the exposure brings the face to a mid skin tone
+     * param[in] image BGR picture, typically the crop, only a small proxy of it is analyzed
+     * param[in] faceRegion Region of the face within the picture
+     !*/
+    static ColorLut3D autoCorrection(const cv::Mat & image, const cv::Rect & faceRegion);
+
+    /*!@brief Single LUT doing first then second, so that both cost one pass !*/
+    static ColorLut3D compose(const ColorLut3D & first, const ColorLut3D & second);
+
+    /*!@brief Applies the transform in place to a BGR image !*/
+    void apply(cv::Mat & image) const;
+
+    /*!@brief Applies the transform to a BGR image, dst can be a region of a larger image of the same size.
+     * Transforms acting on each channel on its own (gains, levels, curves) go through cv::LUT, which is vectorized,
+     * the other ones are interpolated with the rows split across the OpenCV threads !*/
+    void apply(const cv::Mat & src, cv::Mat & dst) const;
+
+    /*!@brief Transformed colour of a BGR colour in [0, 1] !*/
+    cv::Vec3f map(const cv::Vec3f & bgr) const;
+
+    int gridSize() const;
+
+private:
+    explicit ColorLut3D(int gridSize);
+
+    const cv::Vec3f & node(int b, int g, int r) const;
+
+    /*!@brief Fills m_channelTable if each output channel only depends on the same input channel !*/
+    void buildChannelTable();
+
+    int m_gridSize;
+    std::vector<cv::Vec3f> m_nodes; ///<- Output colours in [0, 255], b major then g then r
+    std::array<int, 256> m_lowerNode; ///<- Grid node at or below each 8 bit input level
+    std::array<float, 256> m_weight; ///<- Interpolation weight of the node above each 8 bit input level
+    cv::Mat m_channelTable; ///<- Per channel 8 bit table for cv::LUT, empty when channels are mixed
+};
+} // namespace ppp
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CommonHelpers.h"
+#include "IConfigurable.h"
+#include "InstrumentedMutex.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace ppp
+{
+FWD_DECL(IccProfile)
+FWD_DECL(ColorLut3D)
+FWD_DECL(ColorProfileStore)
+
+/*!@brief Output colour profiles prints can be rendered to, referenced by id.
+ * The transform from sRGB to a profile is sampled into a 3D LUT the first time it is needed and cached by the profile
+ * data, so repeated prints to the same printer only cost the LUT application. The most recently used LUTs are kept,
+ * up to MAX_CACHED_LUTS, profiles with the same data sharing theirs. Profiles are loaded
+ * from the optional "colorProfiles" node of the configuration, each entry being a resource:
+ .{
+ .    "colorProfiles": { "lab_glossy": { "file": "profiles/lab_glossy.icc" } }
+ .}
+ !*/
+class ColorProfileStore final : public IConfigurable
+{
+public:
+    /*!@brief Parses and registers a profile, throws if it is not a supported one !*/
+    void registerProfile(const std::string & id, const std::string & iccData);
+
+    bool hasProfile(const std::string & id) const;
+
+    /*!@brief LUT converting sRGB pixels to the given profile, throws if the profile is unknown !*/
+    ColorLut3DSPtr printTransform(const std::string & id);
+
+private:
+    void configureInternal(const ConfigLoaderSPtr & config) override;
+
+    struct Entry
+    {
+        uint32_t hash; ///<- CRC32 of the profile data, compared before the data itself
+        std::shared_ptr<const std::string> data;
+        IccProfileSPtr profile;
+    };
+
+    struct CachedLut
+    {
+        uint32_t hash;
+        std::shared_ptr<const std::string> data; ///<- Profile data the LUT was built from
+        ColorLut3DSPtr lut;
+    };
+
+    static constexpr size_t MAX_CACHED_LUTS = 16; ///<- About 430 KB each with the default grid
+
+    /*!@brief Cached LUT of the profile data, moved to the front, or nullptr. Must be called with the lock held !*/
+    ColorLut3DSPtr findLut(const Entry & entry);
+
+    mutable InstrumentedMutex m_mutex { "colorProfiles" };
+    std::unordered_map<std::string, Entry> m_profiles;
+    std::list<CachedLut> m_luts; ///<- Most recently used first
+};
+} // namespace ppp
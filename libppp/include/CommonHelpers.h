@@ -74,6 +74,17 @@ DEFINE_STR(CROWN_POINT, crownPoint)
 DEFINE_STR(CHIN_POINT, chinPoint)
 DEFINE_STR(EXIF_INFO, EXIFInfo)
 DEFINE_STR(AS_BASE64, asBase64)
+DEFINE_STR(AUTO_CORRECT, autoCorrect)
+DEFINE_STR(PRINT_PROFILE, printProfile)
+DEFINE_STR(OUTPUT_FORMAT, format)
+
+// Gang sheet fields
+DEFINE_STR(GANG_SHEET_JOBS, jobs)
+DEFINE_STR(GANG_SHEET_COPIES, copies)
+
+// Preview fields
+DEFINE_STR(PREVIEW_FORMAT, format)
+DEFINE_STR(PREVIEW_MAX_HEIGHT, maxHeight)
 
 DEFINE_STR(UNITS, units)
 
@@ -98,6 +109,11 @@ DEFINE_STR(COMPLIANCE_RESULT_SUCCESS, success)
 DEFINE_STR(COMPLIANCE_RESULT_MESSAGE, message)
 DEFINE_STR(COMPLIANCE_RESULT_CHECK_NAME, checkName)
 
+// Parameter overrides, named after the configuration entries they replace
+DEFINE_STR(PARAMETER_OVERRIDES, overrides)
+DEFINE_STR(PHOTO_PRINT_MAKER, photoPrintMaker)
+DEFINE_STR(BACKGROUND_COLOR, background)
+
 DEFINE_STR(CROWN_CHIN_ESTIMATOR, crownChinEstimator)
 DEFINE_STR(CHIN_CROWN_COEFF, chinCrownCoeff)
 DEFINE_STR(CHIN_FROWN_COEFF, chinFrownCoeff)
@@ -11,7 +11,7 @@ class CrownChinEstimator final : public ICrownChinEstimator
 public:
     void configure(const ConfigLoaderSPtr & config) override;
 
-    bool estimateCrownChin(LandMarks & landMarks) override;
+    bool estimateCrownChin(LandMarks & landMarks, const ParameterOverrides * overrides = nullptr) override;
 
 private:
     double m_chinCrownCoeff { 1.7699 };
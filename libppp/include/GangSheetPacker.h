@@ -0,0 +1,58 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace ppp
+{
+FWD_DECL(GangSheetPacker)
+
+/*!@brief Location of one copy of a photo in a gang sheet !*/
+struct GangSheetTile final
+{
+    size_t jobIndex; ///<- Index of the print job the photo belongs to
+    cv::Rect rect; ///<- Placement of the photo in the printable area of the sheet [pixels]
+};
+
+using GangSheet = std::vector<GangSheetTile>;
+
+/*!@brief Places photos of different sizes on print sheets using a shelf algorithm:
+ * each photo goes into the first shelf (row) of the current sheet with enough room left, a new shelf is opened
+ * below the last one when none has room, and the sheet is considered full when no new shelf fits.
+ * Feeding the photos from tallest to shortest keeps the shelves tight. !*/
+class GangSheetPacker final
+{
+public:
+    /*!@brief Constructs a packer for sheets of the given printable area, with gutter pixels between photos !*/
+    GangSheetPacker(const cv::Size & sheetSize, int gutter);
+
+    /*!@brief Places a photo in the current sheet.
+     *  @returns false if the photo does not fit in the space left, the sheet should then be taken and the photo added
+     *  again to the next one !*/
+    bool add(size_t jobIndex, const cv::Size & tileSize);
+
+    /*!@brief Returns whether a photo of this size fits at all in an empty sheet !*/
+    bool fitsInSheet(const cv::Size & tileSize) const;
+
+    /*!@brief Returns the photos placed in the current sheet and starts a new empty one !*/
+    GangSheet takeSheet();
+
+    bool empty() const;
+
+private:
+    struct Shelf
+    {
+        int y; ///<- Top of the shelf
+        int height; ///<- Height of the tallest photo in the shelf
+        int usedWidth; ///<- Width taken by the photos in the shelf, gutters included
+    };
+
+    cv::Size m_sheetSize;
+    int m_gutter;
+
+    std::vector<Shelf> m_shelves;
+    GangSheet m_currentSheet;
+};
+} // namespace ppp
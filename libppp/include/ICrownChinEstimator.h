@@ -7,6 +7,7 @@ namespace ppp
 FWD_DECL(LandMarks)
 FWD_DECL(ConfigLoader)
 FWD_DECL(ICrownChinEstimator)
+struct ParameterOverrides;
 
 class ICrownChinEstimator : NonCopyable
 {
@@ -17,7 +18,8 @@ public:
     virtual void configure(const ConfigLoaderSPtr & config) = 0;
 
     /*!@brief Estimate chin and crown point from the available landmarks!
-     *  The result is written in the same LandMark structure !*/
-    virtual bool estimateCrownChin(LandMarks & landmarks) = 0;
+     *  The result is written in the same LandMark structure
+     *  param[in] overrides Optional coefficients of the request replacing the configured ones !*/
+    virtual bool estimateCrownChin(LandMarks & landmarks, const ParameterOverrides * overrides = nullptr) = 0;
 };
 } // namespace ppp
@@ -3,6 +3,10 @@
 #include "CommonHelpers.h"
 #include "IConfigurable.h"
 
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
 namespace cv
 {
 class Mat;
@@ -18,6 +22,8 @@ namespace ppp
 FWD_DECL(IImageStore)
 FWD_DECL(LandMarks);
 
+using EncodedImageSPtr = std::shared_ptr<const std::vector<BYTE>>;
+
 /*!@brief Caches input images that are going to be processed.
  * Only a certain amount of images are kept at any point in time. */
 class IImageStore : NonCopyable, public IConfigurable
@@ -26,17 +32,80 @@ public:
     /*!@brief Loads an image from file and returns the imageKey for later retrieval !*/
     virtual std::string setImage(const std::string & imageFilePath) = 0;
 
-    /*!@brief Decodes and store the image from bytes and computes an image key for latter retrieval !*/
+    /*!@brief Decodes and store the image from bytes and computes an image key for latter retrieval.
+     * Throws for images exceeding the byte or pixel limits of the configuration, before decoding them when their
+     * dimensions can be read from their header (JPEG, PNG, BMP and WebP), after decoding them otherwise !*/
     virtual std::string setImage(const char * bufferData, size_t bufferLength) = 0;
 
-    /*!@brief Gets a copy the image from the store !*/
+    /*!@brief Stores already decoded BGR pixels in place: the store keeps a reference to the buffer of the image
+     * instead of copying it (unless planar storage is enabled). Buffers owned by someone else, like a shared memory
+     * slot, should be wrapped in a reference counted cv::Mat so they are released when the image is evicted !*/
+    virtual std::string setImage(const cv::Mat & image) = 0;
+
+    /*!@brief Gets a copy the image from the store, empty if it is not in the store (any more) !*/
     virtual cv::Mat getImage(const std::string & imageKey) = 0;
 
+    /*!@brief Gets the luminance of the image, read without conversion when planar storage is enabled. Empty if the
+     * image is not in the store !*/
+    virtual cv::Mat getLumaImage(const std::string & imageKey) = 0;
+
+    /*!@brief Gets the pixels of a region of the image, filled with zeros outside of the image.
+     * With planar storage, the chroma is only upsampled within the region. Empty if the image is not in the store !*/
+    virtual cv::Mat getImageRegion(const std::string & imageKey, const cv::Rect & region) = 0;
+
+    /*!@brief Gets the dimensions of the image without retrieving its pixels, empty if it is not in the store !*/
+    virtual cv::Size getImageSize(const std::string & imageKey) = 0;
+
+    /*!@brief Returns whether images are kept as a luma plane and subsampled chroma planes (4:2:0) instead of BGR !*/
+    virtual bool isPlanarStorage() = 0;
+
+    /*!@brief Gets a screen resolution copy of the image for interactive previews.
+     * The proxy is created on first use and kept in the store along with the image. Empty if the image is not in the
+     * store.
+     *  @param[out] scale Ratio between the proxy and the image dimensions !*/
+    virtual cv::Mat getProxyImage(const std::string & imageKey, double & scale) = 0;
+
+    /*!@brief Decodes a region of the image from its encoded bytes, which works once the decoded image has been
+     * evicted from the store, as long as the bytes are still cached. JPEG files are cropped to the blocks covering
+     * the region before decoding, other formats (and JPEG files that can not be cropped) are decoded whole.
+     * The region is downscaled by the largest factor not above maxDownscale that the decoder supports (1/2, 1/4 or
+     * 1/8, done in the DCT domain for JPEG images). Parts of the region outside of the image are filled with zeros.
+     *  @param[out] scale Downscale ratio applied, the top left corner of the returned image matches
+     *  (floor(region.x * scale), floor(region.y * scale)) in the downscaled image
+     *  @returns The decoded region or an empty image if the image is not available !*/
+    virtual cv::Mat decodeImageRegion(const std::string & imageKey,
+                                      const cv::Rect & region,
+                                      double maxDownscale,
+                                      double & scale)
+        = 0;
+
+    /*!@brief Returns whether the encoded bytes of the image are still cached !*/
+    virtual bool containsEncodedImage(const std::string & imageKey) = 0;
+
+    /*!@brief Gets the reduction the image was decoded at when it was stored, because it was larger than the
+     * decoding limit: coordinates in the stored image times this scale are coordinates in the image file.
+     * Returns 1 for images decoded at full scale or whose encoded bytes are not cached !*/
+    virtual int getDecodeScale(const std::string & imageKey) = 0;
+
+    /*!@brief Gets the image file bytes as they were received, nullptr if they are not cached !*/
+    virtual EncodedImageSPtr getEncodedImage(const std::string & imageKey) = 0;
+
     /*!@brief Gets the image EXIF info if available !*/
     virtual easyexif::EXIFInfoSPtr getExifInfo(const std::string & imageKey) = 0;
 
+    /*!@brief Gets a copy of the landmarks detected so far, nullptr if the image is not stored.
+     * Changes to the copy are only seen by the other users of the image once passed to setLandMarks !*/
     virtual LandMarksSPtr getLandMarks(const std::string & imageKey) = 0;
 
+    /*!@brief Replaces the landmarks of the image, does nothing if the image is no longer stored !*/
+    virtual void setLandMarks(const std::string & imageKey, const LandMarks & landMarks) = 0;
+
+    /*!@brief Finds another image in the store that is a near duplicate of the specified one
+     * (e.g. a re-compressed or resized copy) and already has its landmarks detected.
+     * Returns a copy of its landmarks, taken along with its size so that it can be evicted right after,
+     * or nullptr if there is no such image !*/
+    virtual LandMarksSPtr findSimilarImage(const std::string & imageKey, cv::Size & similarImageSize) = 0;
+
     /*!@brief Returns whether an image with the specified key is in the store !*/
     virtual bool containsImage(const std::string & imageKey) = 0;
 
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ppp
+{
+/*!@brief Destination of encoded output (prints, previews ...), written in order as it is produced so that callers
+ * can send it to a file, a socket or their own buffer without an intermediate copy !*/
+class IOutputSink
+{
+public:
+    virtual ~IOutputSink() = default;
+
+    /*!@brief Appends the bytes to the output, throws if they cannot be written !*/
+    virtual void write(const char * data, size_t size) = 0;
+
+    /*!@brief Called once after the last write, flushes what the sink may still buffer !*/
+    virtual void finish()
+    {
+    }
+};
+} // namespace ppp
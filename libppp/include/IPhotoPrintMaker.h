@@ -1,6 +1,7 @@
 #pragma once
 
 #include "CommonHelpers.h"
+#include "GangSheetPacker.h"
 #include "IConfigurable.h"
 #include <opencv2/core/core.hpp>
 
@@ -9,6 +10,8 @@ namespace ppp
 FWD_DECL(PrintDefinition)
 FWD_DECL(PhotoStandard)
 FWD_DECL(ConfigLoader)
+FWD_DECL(ColorLut3D)
+struct ParameterOverrides;
 
 FWD_DECL(IPhotoPrintMaker)
 
@@ -17,13 +20,51 @@ class IPhotoPrintMaker : NonCopyable, public IConfigurable
 public:
     virtual ~IPhotoPrintMaker() = default;
 
+    /*!@brief Crops the picture upright to the photo standard
+     *  param[in] overrides Optional parameters of the request replacing the configured ones !*/
     virtual cv::Mat cropPicture(const cv::Mat & originalImage,
                                 const cv::Point & crownPoint,
                                 const cv::Point & chinPoint,
-                                const PhotoStandard & ps)
+                                const PhotoStandard & ps,
+                                const ParameterOverrides * overrides = nullptr)
         = 0;
 
-    virtual cv::Mat tileCroppedPhoto(const PrintDefinition & pd, const PhotoStandard & ps, const cv::Mat & croppedImage)
+    /*!@brief Region of the original image covered by the crop made by cropPicture !*/
+    virtual cv::Rect cropBoundingBox(const cv::Point & crownPoint,
+                                     const cv::Point & chinPoint,
+                                     const PhotoStandard & ps)
+        = 0;
+
+    /*!@brief Resizes the crop to the print resolution and tiles it on the canvas
+     *  param[in] colorCorrection Optional colour correction applied to the resized photo before it is tiled
+     *  param[in] overrides Optional parameters of the request replacing the configured ones !*/
+    virtual cv::Mat tileCroppedPhoto(const PrintDefinition & pd,
+                                     const PhotoStandard & ps,
+                                     const cv::Mat & croppedImage,
+                                     const ColorLut3D * colorCorrection = nullptr,
+                                     const ParameterOverrides * overrides = nullptr)
+        = 0;
+
+    /*!@brief Crops a JPEG file to the photo at print resolution by copying its DCT coefficients, without decoding
+     * nor re-encoding it. Only possible when the crop is upright, needs no resizing and starts on the MCU grid of
+     * the file (within the configured tolerances)
+     *  param[in] jpeg File of the picture, whose pixels are in the same orientation as crownPoint and chinPoint
+     *  param[out] output JPEG file of the photo
+     *  returns false if the crop can not be done losslessly, cropPicture has to be used instead !*/
+    virtual bool cropJpegLossless(const std::vector<BYTE> & jpeg,
+                                  const cv::Point & crownPoint,
+                                  const cv::Point & chinPoint,
+                                  const PhotoStandard & ps,
+                                  std::vector<BYTE> & output)
+        = 0;
+
+    /*!@brief Draws the photos of a gang sheet into a canvas, tileImages[i] being the photo placed at sheet[i]
+     * already resized to the print resolution
+     *  param[in] overrides Optional parameters of the request replacing the configured ones !*/
+    virtual cv::Mat renderGangSheet(const PrintDefinition & pd,
+                                    const GangSheet & sheet,
+                                    const std::vector<cv::Mat> & tileImages,
+                                    const ParameterOverrides * overrides = nullptr)
         = 0;
 };
 } // namespace ppp
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+FWD_DECL(IccProfile)
+class ColorLut3D;
+
+/*!@brief RGB colour profile of the matrix/TRC kind (tone curve per channel then a 3x3 matrix to the D50 XYZ
+ * connection space), which covers sRGB, Adobe RGB, display and most RGB print lab profiles.
+ * Profiles made of lookup tables only (A2B/B2A tags, e.g. CMYK printers) are not supported !*/
+class IccProfile final
+{
+public:
+    /*!@brief Parses the content of an .icc/.icm file, throws if it is not a supported profile !*/
+    static IccProfileSPtr fromData(const std::string & iccData);
+
+    static IccProfileSPtr sRgb();
+
+    /*!@brief Converts device RGB in [0, 1] to D50 XYZ !*/
+    cv::Vec3d toPcs(const cv::Vec3d & rgb) const;
+
+    /*!@brief Converts D50 XYZ to device RGB, clipped to [0, 1] !*/
+    cv::Vec3d fromPcs(const cv::Vec3d & xyz) const;
+
+    /*!@brief Samples the conversion of BGR pixels from the source to the destination profile
+     * (relative colorimetric, both profiles share the D50 connection space) !*/
+    static ColorLut3D transformLut(const IccProfile & source, const IccProfile & destination, int gridSize = 33);
+
+private:
+    /*!@brief Device to linear tone curve of one channel !*/
+    struct ToneCurve
+    {
+        std::vector<double> table; ///<- Sampled curve when not empty
+        int parametricType = 0; ///<- Function type of the ICC parametricCurveType, 0 being a plain gamma
+        double params[7] = { 1.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0 }; ///<- g, a, b, c, d, e, f
+
+        double eval(double x) const;
+
+        /*!@brief Inverse of the (monotonic) curve by bisection !*/
+        double inverse(double y) const;
+    };
+
+    ToneCurve m_curves[3]; ///<- Red, green and blue
+    cv::Matx33d m_toPcs; ///<- Columns are the XYZ of the red, green and blue primaries
+    cv::Matx33d m_fromPcs;
+};
+} // namespace ppp
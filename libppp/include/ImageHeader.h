@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+/*!@brief Dimensions of an encoded image read from its header, before any pixel is decoded, so that images can be
+ * refused or decoded at a reduced scale before the decoder allocates them. JPEG (any SOF type), PNG, BMP and WebP
+ * headers are recognized. The size is the one of the stored pixels, without applying the EXIF orientation !*/
+struct ImageHeader final
+{
+    enum class Format
+    {
+        UNKNOWN,
+        JPEG,
+        PNG,
+        BMP,
+        WEBP,
+    };
+
+    Format format = Format::UNKNOWN;
+    cv::Size size;
+
+    /*!@brief Reads the header at the start of the data, returns false if the format is not recognized or the header
+     * is truncated or invalid !*/
+    static bool read(const BYTE * data, size_t length, ImageHeader & header);
+};
+} // namespace ppp
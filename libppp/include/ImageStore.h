@@ -1,9 +1,10 @@
 #pragma once
 
 #include "IImageStore.h"
+#include "InstrumentedMutex.h"
+#include "LandMarksRecord.h"
 
 #include <list>
-#include <mutex>
 #include <unordered_map>
 
 #include <opencv2/core/core.hpp>
@@ -12,14 +13,28 @@ namespace ppp
 {
 
 FWD_DECL(ImageStore)
+
 struct ImageData final
 {
-    cv::Mat image;
+    cv::Mat image; ///<- BGR image, empty when planar storage is enabled
+    cv::Mat luma; ///<- Full resolution luma plane when planar storage is enabled
+    cv::Mat chroma; ///<- Cr and Cb planes at half the resolution when planar storage is enabled
     easyexif::EXIFInfoSPtr exifInfo;
-    LandMarksSPtr landMarks;
+    LandMarksRecord landMarks {}; ///<- Landmarks detected so far, packed, no shape points until detected
+    LandMarksContoursSPtr lipContours; ///<- Lip contours of the landmarks, nullptr if there are none
+    uint64_t perceptualHash = 0; ///<- Used to find near duplicate images in the store
+    cv::Mat proxyImage; ///<- Downscaled copy used for previews, created on demand
     std::list<std::string>::iterator storeListOrder; ///<- Where in the image store order it is located
 };
 
+struct EncodedImageData final
+{
+    EncodedImageSPtr bytes; ///<- Image file bytes as received
+    cv::Size imageSize; ///<- Size of the image once decoded
+    int decodeScale; ///<- Reduction applied when the image was decoded into the store (1, 2, 4 or 8)
+    std::list<std::string>::iterator storeListOrder; ///<- Where in the encoded image store order it is located
+};
+
 class ImageStore final : public IImageStore
 {
 public:
@@ -27,16 +42,57 @@ public:
 
     std::string setImage(const char * bufferData, size_t bufferLength) override;
 
+    std::string setImage(const cv::Mat & image) override;
+
     bool containsImage(const std::string & imageKey) override;
 
     void setStoreSize(size_t storeSize) override;
 
+    /*!@brief Sets the memory budget for the encoded images, zero disables keeping them !*/
+    void setEncodedStoreBytes(size_t encodedStoreBytes);
+
+    /*!@brief Sets the limits checked on an image, zero disables a limit. The pixel limits are checked before decoding
+     * for the formats whose header is read (JPEG, PNG, BMP and WebP), other formats are only refused by maxPixels
+     * once decoded. Images with more than maxDecodedPixels are stored at the smallest reduction (1/2, 1/4 or 1/8)
+     * that brings them under it. Only JPEG images are decoded at that scale directly (in the DCT domain), the
+     * decoders of the other formats allocate the full image before reducing it, so the memory needed to decode them
+     * is only bounded by maxPixels !*/
+    void setDecodeLimits(size_t maxEncodedBytes, size_t maxPixels, size_t maxDecodedPixels);
+
     cv::Mat getImage(const std::string & imageKey) override;
 
     LandMarksSPtr getLandMarks(const std::string & imageKey) override;
 
+    void setLandMarks(const std::string & imageKey, const LandMarks & landMarks) override;
+
     easyexif::EXIFInfoSPtr getExifInfo(const std::string & imageKey) override;
 
+    LandMarksSPtr findSimilarImage(const std::string & imageKey, cv::Size & similarImageSize) override;
+
+    cv::Mat getLumaImage(const std::string & imageKey) override;
+
+    cv::Mat getImageRegion(const std::string & imageKey, const cv::Rect & region) override;
+
+    cv::Size getImageSize(const std::string & imageKey) override;
+
+    bool isPlanarStorage() override;
+
+    /*!@brief Enables keeping newly stored images as luma and subsampled chroma planes !*/
+    void setPlanarStorage(bool planarStorage);
+
+    cv::Mat getProxyImage(const std::string & imageKey, double & scale) override;
+
+    cv::Mat decodeImageRegion(const std::string & imageKey,
+                              const cv::Rect & region,
+                              double maxDownscale,
+                              double & scale) override;
+
+    bool containsEncodedImage(const std::string & imageKey) override;
+
+    int getDecodeScale(const std::string & imageKey) override;
+
+    EncodedImageSPtr getEncodedImage(const std::string & imageKey) override;
+
 protected:
     void configureInternal(const ConfigLoaderSPtr & config) override;
 
@@ -51,7 +107,38 @@ private:
     ///<- oldest images are to be deleted
     size_t m_storeSize = 1;
 
-    mutable std::mutex m_mutex;
+    ///<- Maximum number of differing perceptual hash bits for two images to be considered
+    ///<- near duplicates, negative to disable the near duplicate search
+    int m_maxHammingDistance = 6;
+
+    ///<- Keep the images as a full resolution luma plane and half resolution chroma planes
+    bool m_planarStorage = false;
+
+    ///<- Maximum width or height of the preview proxy images
+    int m_proxyMaxSize = 1024;
+
+    ///<- Encoded bytes of the images, kept for longer than the decoded images so that
+    ///<- regions of evicted images can still be decoded for printing
+    std::unordered_map<std::string, EncodedImageData> m_encodedCollection;
+
+    ///<- Store the encoded image keys in the order they were added or accessed
+    std::list<std::string> m_encodedKeyOrder;
+
+    ///<- Memory budget for the encoded images, zero disables keeping them
+    size_t m_encodedStoreBytes = 0;
+
+    size_t m_encodedBytesInUse = 0;
+
+    ///<- Largest encoded image accepted, in bytes, zero for no limit
+    size_t m_maxEncodedBytes = 0;
+
+    ///<- Largest image accepted, in pixels read from its header or once decoded for other formats, zero for no limit
+    size_t m_maxPixels = 0;
+
+    ///<- Larger images are decoded at a reduced scale, zero to always decode them at full scale
+    size_t m_maxDecodedPixels = 0;
+
+    mutable InstrumentedMutex m_mutex { "imageStore" };
 
 private:
     ///<- Keeps the amount of images in the store to a maximum specified by m_storeSize
@@ -59,7 +146,15 @@ private:
 
     void boostImageToTopCache(const std::string & imageKey);
 
-    std::string storeImageData(const cv::Mat & image, const easyexif::EXIFInfoSPtr & exifInfo = nullptr);
+    void boostEncodedImageToTopCache(const std::string & imageKey);
+
+    std::string storeImageData(const cv::Mat & image,
+                               const easyexif::EXIFInfoSPtr & exifInfo = nullptr,
+                               const EncodedImageSPtr & encodedImage = nullptr,
+                               int decodeScale = 1);
+
+    /*!@brief Checks the limits against the header of the image and decodes it, at a reduced scale if needed !*/
+    cv::Mat decodeImage(const BYTE * bufferData, size_t bufferLength, int & decodeScale) const;
 
     static easyexif::EXIFInfoSPtr decodeExifInfo(const BYTE * bufferData, const size_t bufferLength);
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace ppp
+{
+/*!@brief Usage counters shared by all the mutexes with the same name !*/
+struct LockStats final
+{
+    std::atomic<uint64_t> acquisitions { 0 };
+    std::atomic<uint64_t> contentions { 0 }; ///<- Acquisitions that had to wait for another thread
+    std::atomic<uint64_t> waitTimeNs { 0 }; ///<- Total time spent waiting in contended acquisitions
+};
+
+/*!@brief Drop-in replacement for std::mutex that measures how often and for how long threads wait for it.
+ * Uncontended acquisitions only pay for an extra atomic increment !*/
+class InstrumentedMutex final : NonCopyable
+{
+public:
+    explicit InstrumentedMutex(const std::string & name);
+
+    void lock();
+
+    bool try_lock();
+
+    void unlock();
+
+    /*!@brief Calls visitor with the stats of every lock name used so far !*/
+    static void visitLockStats(const std::function<void(const std::string & name, const LockStats & stats)> & visitor);
+
+    static void resetLockStats();
+
+private:
+    std::mutex m_mutex;
+    LockStats * m_stats;
+};
+} // namespace ppp
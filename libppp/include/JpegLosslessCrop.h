@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+/*!@brief Frame layout of a JPEG file, as far as lossless cropping is concerned !*/
+struct JpegFrameInfo final
+{
+    cv::Size size;
+    cv::Size mcuSize; ///<- Regions starting on this grid can be cropped losslessly
+};
+
+/*!@brief Crops sequential Huffman coded JPEG files by copying the quantized DCT coefficients of the region into a
+ * new file. Pixels are neither decoded nor re-quantized, so the result has no generation loss, and only the entropy
+ * coded data down to the last row of the region is read. The region has to start on the MCU grid, its size is free.
+ * Progressive, arithmetic coded, 12 bit and multiple scan files are not supported !*/
+class JpegLosslessCrop final
+{
+public:
+    /*!@brief Reads the frame header, returns false if the file is not supported !*/
+    static bool readFrameInfo(const std::vector<BYTE> & jpeg, JpegFrameInfo & info);
+
+    /*!@brief Crops the file to the region, returns false if the file is not supported, is corrupt, or the region is
+     * not within the image or does not start on the MCU grid. The metadata of the file is kept except EXIF
+     * (its orientation and thumbnail would no longer match) !*/
+    static bool crop(const std::vector<BYTE> & jpeg, const cv::Rect & region, std::vector<BYTE> & output);
+};
+} // namespace ppp
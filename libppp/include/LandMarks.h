@@ -18,7 +18,7 @@ public:
     cv::Rect vjLeftEyeRect; ///<- Rectangle where the left eye was detected using Viola Jones algorithm
     cv::Rect vjRightEyeRect; ///<- Rectangle where the left eye was detected using Viola Jones algorithm
 
-    int imageRotation; ///<- Possible values are 0, 90, -90, 180
+    int imageRotation = 0; ///<- Possible values are 0, 90, -90, 180
 
     // Mouth marks
     cv::Point lipUpperCenter;
@@ -39,6 +39,10 @@ public:
     cv::Point eyeRightCorner;
 
     std::vector<cv::Point> allLandmarks;
+    int shapeCascades = 0; ///<- Cascade levels of the shape predictor evaluated, fewer than all if it converged early
+
+    /*!@brief Scales all landmark coordinates, e.g. to map them onto a resized copy of the image !*/
+    void scale(double sx, double sy);
 
     std::string toJson(bool prettyJson) const;
     void fromJson(const rapidjson::Value & v);
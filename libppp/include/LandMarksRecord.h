@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+FWD_DECL(LandMarks)
+FWD_DECL(LandMarksContours)
+
+/*!@brief Image point packed in 16 bits per coordinate (images up to 32767 pixels per side) !*/
+struct PackedPoint final
+{
+    int16_t x;
+    int16_t y;
+};
+
+/*!@brief Image rectangle packed in 16 bits per field !*/
+struct PackedRect final
+{
+    int16_t x;
+    int16_t y;
+    int16_t width;
+    int16_t height;
+};
+
+/*!@brief Compact, fixed layout version of LandMarks, the form in which the image store keeps them.
+ * It owns no heap memory, so it can be stored by value in large caches and copied with memcpy.
+ * The image key is not kept, it is the key of the store entry. Lip contours are variable in length and live in
+ * the optional LandMarksContours side structure !*/
+struct alignas(64) LandMarksRecord final
+{
+    static constexpr size_t MAX_SHAPE_POINTS = 68; ///<- Points in the iBUG 300-W markup used by the shape predictor
+
+    int16_t imageRotation; ///<- Possible values are 0, 90, -90, 180
+    uint16_t numShapePoints; ///<- Number of valid entries in shapePoints
+    uint16_t shapeCascades; ///<- Cascade levels of the shape predictor evaluated
+
+    PackedRect vjFaceRect;
+    PackedRect vjLeftEyeRect;
+    PackedRect vjRightEyeRect;
+    PackedRect vjMouthRect;
+
+    PackedPoint eyeLeftPupil;
+    PackedPoint eyeRightPupil;
+    PackedPoint eyeLeftCorner;
+    PackedPoint eyeRightCorner;
+    PackedPoint lipUpperCenter;
+    PackedPoint lipLowerCenter;
+    PackedPoint lipLeftCorner;
+    PackedPoint lipRightCorner;
+    PackedPoint noseTip;
+    PackedPoint crownPoint;
+    PackedPoint chinPoint;
+
+    PackedPoint shapePoints[MAX_SHAPE_POINTS]; ///<- Points detected by the shape predictor (allLandmarks)
+
+    /*!@brief Packs the landmarks, shape points beyond MAX_SHAPE_POINTS are dropped !*/
+    static LandMarksRecord fromLandMarks(const LandMarks & landMarks);
+
+    /*!@brief Unpacks the record into landMarks, the image key and lip contours are left untouched !*/
+    void toLandMarks(LandMarks & landMarks) const;
+};
+
+static_assert(std::is_trivially_copyable<LandMarksRecord>::value, "LandMarksRecord must be copyable with memcpy");
+static_assert(sizeof(LandMarksRecord) <= 6 * 64, "LandMarksRecord should fit in six cache lines");
+
+/*!@brief Lip contours detected by the lips detector, kept apart from LandMarksRecord
+ * as they are only needed for rendering and debugging !*/
+class LandMarksContours final
+{
+public:
+    std::vector<cv::Point> lipContour1st;
+    std::vector<cv::Point> lipContour2nd;
+
+    /*!@brief Returns the contours in landMarks or nullptr if no contours were detected !*/
+    static LandMarksContoursSPtr fromLandMarks(const LandMarks & landMarks);
+
+    void toLandMarks(LandMarks & landMarks) const;
+};
+} // namespace ppp
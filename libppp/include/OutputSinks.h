@@ -0,0 +1,96 @@
+#pragma once
+
+#include "CommonHelpers.h"
+#include "IOutputSink.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ppp
+{
+/*!@brief Appends the output to a string !*/
+class StringOutputSink final : public IOutputSink
+{
+public:
+    explicit StringOutputSink(std::string & output);
+
+    void write(const char * data, size_t size) override;
+
+private:
+    std::string & m_output;
+};
+
+/*!@brief Writes the output into a caller owned buffer, throws when it would overflow it !*/
+class BufferOutputSink final : public IOutputSink
+{
+public:
+    BufferOutputSink(char * buffer, size_t capacity);
+
+    void write(const char * data, size_t size) override;
+
+    /*!@brief Number of bytes written so far !*/
+    size_t size() const;
+
+private:
+    char * m_buffer;
+    size_t m_capacity;
+    size_t m_size = 0;
+};
+
+/*!@brief Writes the output to an open file descriptor (file, pipe or socket), which is left open !*/
+class FileDescriptorOutputSink final : public IOutputSink
+{
+public:
+    explicit FileDescriptorOutputSink(int fd);
+
+    void write(const char * data, size_t size) override;
+
+    /*!@brief Number of bytes written so far !*/
+    size_t size() const;
+
+private:
+    int m_fd;
+    size_t m_size = 0;
+};
+
+using OutputCallback = std::function<void(const char * data, size_t size)>;
+
+/*!@brief Passes the output to a callback in chunks of chunkSize bytes, except the last one which may be smaller.
+ * With a chunk size of 0 the writes are forwarded as they come, without buffering !*/
+class CallbackOutputSink final : public IOutputSink
+{
+public:
+    CallbackOutputSink(OutputCallback callback, size_t chunkSize);
+
+    void write(const char * data, size_t size) override;
+
+    void finish() override;
+
+private:
+    OutputCallback m_callback;
+    size_t m_chunkSize;
+    std::vector<char> m_chunk; ///<- Bytes not passed to the callback yet
+};
+
+/*!@brief Base64 encodes the output on the fly into another sink, with the same alphabet and padding as
+ * Utilities::base64Encode. Finishing it finishes the other sink !*/
+class Base64OutputSink final : public IOutputSink
+{
+public:
+    explicit Base64OutputSink(IOutputSink & output);
+
+    void write(const char * data, size_t size) override;
+
+    void finish() override;
+
+private:
+    void flush();
+
+    IOutputSink & m_output;
+    BYTE m_pending[3] {}; ///<- Input bytes of an incomplete group of three
+    size_t m_numPending = 0;
+    char m_encoded[4096]; ///<- Encoded characters are written by blocks
+    size_t m_numEncoded = 0;
+};
+} // namespace ppp
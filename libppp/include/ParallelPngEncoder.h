@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+class IOutputSink;
+
+/*!@brief Encodes PNG files with the rows split in blocks that are filtered and deflated on several threads. Each
+ * block but the last ends on a byte boundary (sync flush), so that the compressed blocks are concatenated into a
+ * single zlib stream whose Adler-32 checksum is combined from the ones of the blocks. Each block is written to the
+ * sink as an IDAT chunk, in order, as soon as it and the ones before it are ready.
+ * Rows are filtered with the Sub filter and deflated with the RLE strategy, as the OpenCV encoder does by default,
+ * so that rows of a block do not depend on the blocks before it. Only available when built with zlib !*/
+class ParallelPngEncoder final
+{
+public:
+    /*!@brief Whether the image can be encoded: the library was built with zlib and the image is 8 bit with 1, 3 or 4
+     * channels !*/
+    static bool supports(const cv::Mat & image);
+
+    /*!@brief Writes the PNG file of the image to the sink, which is not finished. BGR(A) pixels are stored as RGB(A).
+     * At most as many blocks as OpenCV uses threads (cv::getNumThreads) are deflated at once, each on its own
+     * thread, or in the calling thread if it is one
+     *  param[in] resolutionDpi Written in a pHYs chunk if positive !*/
+    static void write(const cv::Mat & image, IOutputSink & sink, double resolutionDpi = 0);
+};
+} // namespace ppp
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <optional>
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+/*!@brief Parameters carried by a request that replace the configured ones for that request only. The components
+ * read them next to their own configuration without changing it, so that a single configured engine, shared by
+ * concurrent requests, can serve each of them with different parameters. Unset fields keep the configured values.
+ * The fields are named after the configuration entries they replace !*/
+struct ParameterOverrides final
+{
+    std::optional<cv::Scalar> backgroundColor; ///<- photoPrintMaker.background
+    std::optional<double> chinCrownCoeff; ///<- crownChinEstimator.chinCrownCoeff
+    std::optional<double> chinFrownCoeff; ///<- crownChinEstimator.chinFrownCoeff
+
+    bool empty() const
+    {
+        return !backgroundColor && !chinCrownCoeff && !chinFrownCoeff;
+    }
+
+    void clear()
+    {
+        *this = ParameterOverrides();
+    }
+};
+} // namespace ppp
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <cstdint>
+
+namespace ppp
+{
+/*!@brief Hardware event counts of a thread !*/
+struct PerfCounterValues final
+{
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0; ///<- Last level cache misses
+    uint64_t branchMisses = 0;
+
+    PerfCounterValues operator-(const PerfCounterValues & other) const;
+    PerfCounterValues & operator+=(const PerfCounterValues & other);
+};
+
+/*!@brief Hardware performance counters of the calling thread, read through Linux perf_event_open.
+ * Counters are unavailable on other platforms or when the kernel does not allow user access
+ * (see /proc/sys/kernel/perf_event_paranoid), in which case all reads return zeros !*/
+class PerfCounters final : NonCopyable
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    bool isAvailable() const;
+
+    /*!@brief Current counts since the counters were opened !*/
+    PerfCounterValues read() const;
+
+    /*!@brief Counters of the calling thread, opened on first use !*/
+    static PerfCounters & forCurrentThread();
+
+private:
+    static constexpr int NUM_COUNTERS = 4;
+
+    int m_fds[NUM_COUNTERS] = { -1, -1, -1, -1 }; ///<- First one is the group leader
+};
+} // namespace ppp
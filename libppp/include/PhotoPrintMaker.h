@@ -1,5 +1,6 @@
 #pragma once
 
+#include "BackgroundReplacer.h"
 #include "CommonHelpers.h"
 #include "IPhotoPrintMaker.h"
 
@@ -17,14 +18,55 @@ public:
     cv::Mat cropPicture(const cv::Mat & originalImage,
                         const cv::Point & crownPoint,
                         const cv::Point & chinPoint,
-                        const PhotoStandard & ps) override;
+                        const PhotoStandard & ps,
+                        const ParameterOverrides * overrides = nullptr) override;
+
+    cv::Rect cropBoundingBox(const cv::Point & crownPoint,
+                             const cv::Point & chinPoint,
+                             const PhotoStandard & ps) override;
+
+    cv::Mat renderGangSheet(const PrintDefinition & pd,
+                            const GangSheet & sheet,
+                            const std::vector<cv::Mat> & tileImages,
+                            const ParameterOverrides * overrides = nullptr) override;
+
+    bool cropJpegLossless(const std::vector<BYTE> & jpeg,
+                          const cv::Point & crownPoint,
+                          const cv::Point & chinPoint,
+                          const PhotoStandard & ps,
+                          std::vector<BYTE> & output) override;
 
     // Creates a tiled photo from the cropped photo
     cv::Mat tileCroppedPhoto(const PrintDefinition & pd,
                              const PhotoStandard & ps,
-                             const cv::Mat & croppedImage) override;
+                             const cv::Mat & croppedImage,
+                             const ColorLut3D * colorCorrection = nullptr,
+                             const ParameterOverrides * overrides = nullptr) override;
 
 private:
+    /*!@brief Affine transform from the picture to the upright crop, cropSize receives the size of the crop !*/
+    cv::Mat cropTransform(const cv::Point & crownPoint,
+                          const cv::Point & chinPoint,
+                          const PhotoStandard & ps,
+                          cv::Size & cropSize) const;
+
+    /*!@brief Warps the crop region upright into its own image, transform receives the affine transform applied !*/
+    cv::Mat warpCrop(const cv::Mat & originalImage,
+                     const cv::Point & crownPoint,
+                     const cv::Point & chinPoint,
+                     const PhotoStandard & ps,
+                     cv::Mat & transform) const;
+
+    /*!@brief Tiles the photo when both the standard and the print definition have the same resolution !*/
+    cv::Mat tileAtPrintResolution(const PrintDefinition & pd,
+                                  const PhotoStandard & ps,
+                                  const cv::Mat & croppedImage,
+                                  const ColorLut3D * colorCorrection,
+                                  const cv::Scalar & backgroundColor);
+
+    /*!@brief Background colour of the request, the configured one unless it is overridden !*/
+    const cv::Scalar & backgroundColor(const ParameterOverrides * overrides) const;
+
     cv::Point2d centerCropEstimation(const PhotoStandard & ps,
                                      const cv::Point & crownPoint,
                                      const cv::Point & chinPoint) const;
@@ -32,6 +74,11 @@ private:
     void configureInternal(const ConfigLoaderSPtr & cfg) override;
 
     cv::Scalar m_backgroundColor = cv::Scalar(128, 128, 128);
+    BackgroundReplacer m_backgroundReplacer; ///<- Replaces the background of crops with m_backgroundColor if enabled
+
+    bool m_losslessJpegCrop = true;
+    double m_maxLosslessScaleError = 0.01; ///<- Relative size error of the photo accepted to skip resizing it
+    double m_maxLosslessShift = 0.01; ///<- Shift accepted to align the crop on the MCU grid, relative to its height
 };
 
 } // namespace ppp
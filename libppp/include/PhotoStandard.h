@@ -8,7 +8,8 @@ namespace ppp
 /*!\class PhotoStandard
 Defines a passport photo dimensions specified by a country.
 For example, Australia passport photos must be of at least 45mm x 35mm and the
-face height must be 34mm with +/- 2mm of tolerance
+face height must be 34mm with +/- 2mm of tolerance.
+Instances are immutable, so they can be shared across threads without locking
  */
 FWD_DECL(PhotoStandard)
 
@@ -19,10 +20,16 @@ private:
     double m_photoWidth; ///<- Width of the photo [mm]
     double m_faceHeight; ///<- Height of the face (crown to chin distance) [mm]
     double m_crownTop; ///<- Distance from the top of the photo to the crown [mm] (zero if not provided)
-    mutable double m_resolution_dpi; ///<- Standard required print resolution (dots per inch)
+    double m_resolution_dpi; ///<- Standard required print resolution (dots per inch)
 
     std::string m_units;
 
+    // Dimensions in pixels at m_resolution_dpi, precomputed as they are queried for every crop and tile
+    double m_photoHeightPix;
+    double m_photoWidthPix;
+    double m_faceHeightPix;
+    double m_crownTopPix;
+
 public:
     PhotoStandard(double photoWidth,
                   double photoHeight,
@@ -42,7 +49,8 @@ public:
 
     double resolutionDpi() const;
 
-    void overrideResolution(double newDpi) const;
+    /*!@brief Returns a copy of this standard to be printed at a different resolution !*/
+    PhotoStandard withResolution(double newDpi) const;
 
     static PhotoStandardSPtr fromJson(const rapidjson::Value & photoStandardJson);
     static PhotoStandardSPtr fromJson(const std::string & photoStandardJson);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CommonHelpers.h"
+#include "IConfigurable.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ppp
+{
+FWD_DECL(PhotoStandard)
+FWD_DECL(PrintDefinition)
+FWD_DECL(PhotoStandardCatalog)
+
+/*!@brief Contents of the catalog at one point in time. Never modified once published !*/
+struct CatalogSnapshot final
+{
+    std::unordered_map<std::string, PhotoStandardSPtr> photoStandards;
+    std::unordered_map<std::string, PrintDefinitionSPtr> printDefinitions;
+    ///<- Each photo standard rescaled to the resolution of every print definition, keyed by photo standard id
+    std::unordered_map<std::string, std::vector<PhotoStandardSPtr>> printResolutionStandards;
+};
+
+/*!@brief Interned photo standards and print definitions that requests can reference by id instead of describing
+ * them in full. Entries are immutable and readers get them from an atomically published snapshot, so all workers
+ * share the same objects without taking any lock. Registering an entry publishes a new snapshot (copy on write).
+ * The catalog is loaded from the "catalog" node of the configuration, with the same format as the webapp data:
+ .{
+ .    "photoStandards": [ { "id": "us_passport_2x2in_photo", "dimensions": { ... } } ],
+ .    "printDefinitions": [ { "id": "6x4in", "width": 6, "height": 4, ... } ]
+ .}
+ !*/
+class PhotoStandardCatalog final : public IConfigurable
+{
+public:
+    PhotoStandardCatalog();
+
+    /*!@brief Returns the photo standard with the given id or throws if there is none !*/
+    PhotoStandardSPtr photoStandard(const std::string & id) const;
+
+    /*!@brief Returns the photo standard with the given id rescaled to a print resolution. The result is precomputed
+     * for the resolution of every print definition in the catalog, other resolutions create a new object !*/
+    PhotoStandardSPtr photoStandard(const std::string & id, double dpi) const;
+
+    /*!@brief Returns the print definition with the given id or throws if there is none !*/
+    PrintDefinitionSPtr printDefinition(const std::string & id) const;
+
+    void registerPhotoStandard(const std::string & id, const PhotoStandardSPtr & photoStandard);
+
+    void registerPrintDefinition(const std::string & id, const PrintDefinitionSPtr & printDefinition);
+
+    std::shared_ptr<const CatalogSnapshot> snapshot() const;
+
+private:
+    void configureInternal(const ConfigLoaderSPtr & config) override;
+
+    /*!@brief Publishes a modified copy of the current snapshot !*/
+    void update(const std::function<void(CatalogSnapshot & snapshot)> & modify);
+
+    static void precomputePrintResolutions(CatalogSnapshot & snapshot);
+
+    std::shared_ptr<const CatalogSnapshot> m_snapshot; ///<- Only accessed with std::atomic_load/store
+};
+} // namespace ppp
@@ -3,12 +3,12 @@
 #include "CommonHelpers.h"
 #include "PhotoStandard.h"
 #include <opencv2/core/core.hpp>
+#include <functional>
 #include <unordered_map>
 
 namespace dlib
 {
 class full_object_detection;
-class shape_predictor;
 } // namespace dlib
 
 namespace ppp
@@ -20,7 +20,10 @@ FWD_DECL(IImageStore)
 FWD_DECL(IPhotoPrintMaker)
 FWD_DECL(IComplianceChecker)
 FWD_DECL(ConfigLoader)
-
+FWD_DECL(PhotoStandardCatalog)
+FWD_DECL(ColorProfileStore)
+FWD_DECL(BatchShapePredictor)
+struct ParameterOverrides;
 
 class PrintDefinition;
 class PhotoStandard;
@@ -40,6 +43,18 @@ enum class LandMarkType
 
 };
 
+/*!@brief Photo to be printed in a gang sheet !*/
+struct GangSheetJob
+{
+    std::string imageKey;
+    PhotoStandardSPtr photoStandard;
+    cv::Point crownPoint;
+    cv::Point chinPoint;
+    int copies = 1;
+};
+
+using GangSheetCallback = std::function<void(const cv::Mat & sheet)>;
+
 struct EnumClassHash
 {
     template <typename T>
@@ -64,15 +79,76 @@ public:
     // Native interface
     bool configure(const std::string & configFilePathOrString, void * callback);
 
+    /*!@brief Detects the landmarks of the picture and estimates its crown and chin points, into the landmarks kept
+     * with the image in the store !*/
     bool detectLandMarks(const std::string & imageKey) const;
 
+    /*!@brief Same as detectLandMarks, then estimates the crown and chin points with the coefficients of the
+     * overrides. The landmarks in the store are shared by all the requests on the image and keep the configured
+     * estimate, the overridden one is only written to a copy for the caller
+     *  @param[out] landMarks Copy of the landmarks of the picture, with the overridden crown and chin points !*/
+    bool detectLandMarks(const std::string & imageKey,
+                         const ParameterOverrides & overrides,
+                         LandMarks & landMarks) const;
+
+    /*!@brief Same as detectLandMarks on each image, with the shape predictor evaluated on all the faces together
+     *  @returns Whether the landmarks of each image were detected !*/
+    std::vector<bool> detectLandMarks(const std::vector<std::string> & imageKeys) const;
+
+    /*!@brief Renders the print of the picture cropped according to the photo standard
+     *  @param autoCorrect Whether the exposure, white balance and contrast of the photo are corrected
+     *  @param printProfile Id of the colour profile of the printer in the profile store, empty to output sRGB
+     *  @param overrides Optional parameters of the request replacing the configured ones, for this call only !*/
     cv::Mat createTiledPrint(const std::string & imageKey,
-                             PhotoStandard & ps,
-                             PrintDefinition & pd,
+                             const PhotoStandard & ps,
+                             const PrintDefinition & pd,
                              cv::Point & crownMark,
-                             cv::Point & chinMark) const;
+                             cv::Point & chinMark,
+                             bool autoCorrect = false,
+                             const std::string & printProfile = std::string(),
+                             const ParameterOverrides * overrides = nullptr) const;
+
+    /*!@brief Creates a digital size photo by cropping the JPEG file of the picture without decoding it, so that it
+     * has no generation loss. Only possible for upright crops that need no resizing, see IPhotoPrintMaker
+     *  @param[out] jpeg JPEG file of the photo
+     *  @returns false if the photo has to be rendered with createTiledPrint instead !*/
+    bool createLosslessDigitalPhoto(const std::string & imageKey,
+                                    const PhotoStandard & ps,
+                                    const PrintDefinition & pd,
+                                    const cv::Point & crownMark,
+                                    const cv::Point & chinMark,
+                                    std::vector<BYTE> & jpeg) const;
+
+    /*!@brief Renders the crop defined by the crown and chin points from the proxy image kept in the store.
+     * Meant for interactive adjustments of the crop, use createTiledPrint for the final render.
+     *  @param maxHeight Maximum height of the preview in pixels, zero to keep the proxy resolution !*/
+    cv::Mat createPreview(const std::string & imageKey,
+                          const PhotoStandard & ps,
+                          const cv::Point & crownMark,
+                          const cv::Point & chinMark,
+                          int maxHeight = 0,
+                          const ParameterOverrides * overrides = nullptr) const;
+
+    /*!@brief Packs the photos of many print jobs onto as few canvases as possible.
+     * Photos are rendered at the canvas resolution and sheets are rendered in parallel while the jobs are
+     * still being packed. Jobs whose decoded image was evicted are cropped from the image file, if still kept.
+     * onSheetReady is called from the calling thread for each sheet, in order.
+     *  @param overrides Optional parameters of the request replacing the configured ones, for all the jobs
+     *  @returns The number of sheets created !*/
+    size_t createGangSheets(const std::vector<GangSheetJob> & jobs,
+                            const PrintDefinition & pd,
+                            const GangSheetCallback & onSheetReady,
+                            const ParameterOverrides * overrides = nullptr) const;
+
+    /*!@brief Returns the time spent in each pipeline stage, plus hardware event counts when enabled, as JSON !*/
+    std::string getMetrics() const;
 
     IImageStoreSPtr getImageStore() const;
+
+    PhotoStandardCatalogSPtr getCatalog() const;
+
+    ColorProfileStoreSPtr getColorProfiles() const;
+
     std::string checkCompliance(const std::string & imageId,
                                 const PhotoStandardSPtr & photoStandard,
                                 const cv::Point & crownPoint,
@@ -88,14 +164,52 @@ private:
 
     IPhotoPrintMakerSPtr m_pPhotoPrintMaker;
     IImageStoreSPtr m_pImageStore;
+    PhotoStandardCatalogSPtr m_pCatalog;
+    ColorProfileStoreSPtr m_pColorProfiles;
 
     ConfigLoaderSPtr m_configLoader;
-    std::shared_ptr<dlib::shape_predictor> m_shapePredictor;
+    BatchShapePredictorSPtr m_batchShapePredictor;
 
     std::unordered_map<LandMarkType, std::vector<int>, EnumClassHash> m_landmarkIndexMapping;
 
+    ///<- Mean shape point displacement (relative to the face width) allowed between landmarks mapped from a
+    ///<- near duplicate image and the ones refined on the image itself
+    double m_maxNearDuplicateShapeError = 0.05;
+
     void verifyImageExists(const std::string & imageKey) const;
 
+    /*!@brief Crops the picture from the decoded image when it is still in the store, else from its file !*/
+    cv::Mat cropPicture(const std::string & imageKey,
+                        const PhotoStandard & ps,
+                        const PrintDefinition & pd,
+                        const cv::Point & crownMark,
+                        const cv::Point & chinMark,
+                        const ParameterOverrides * overrides) const;
+
+    /*!@brief Crop of the decoded image, empty if it was evicted from the store !*/
+    cv::Mat cropStoredPicture(const std::string & imageKey,
+                              const PhotoStandard & ps,
+                              const cv::Point & crownMark,
+                              const cv::Point & chinMark,
+                              const ParameterOverrides * overrides) const;
+
+    cv::Mat cropEvictedPicture(const std::string & imageKey,
+                               const PhotoStandard & ps,
+                               const PrintDefinition & pd,
+                               const cv::Point & crownMark,
+                               const cv::Point & chinMark,
+                               const ParameterOverrides * overrides) const;
+
+    void detectShapeLandMarks(const cv::Mat & grayImage, LandMarks & landMarks) const;
+
+    void assignShapeLandMarks(const dlib::full_object_detection & shape,
+                              size_t numCascades,
+                              LandMarks & landMarks) const;
+
+    bool reuseNearDuplicateLandMarks(const std::string & imageKey,
+                                     const cv::Mat & grayImage,
+                                     LandMarks & landMarks) const;
+
     cv::Point getLandMark(const std::vector<cv::Point> & landmarks, LandMarkType type) const;
 };
 } // namespace ppp
@@ -14,16 +14,23 @@ namespace ppp
 
 FWD_DECL(PrintDefinition)
 
+/*!@brief Print canvas layout. Instances are immutable, so they can be shared across threads without locking !*/
 class PrintDefinition final
 {
     double m_canvasWidth { 0.0 }; ///<- Output canvas width in mm
     double m_canvasHeight { 0.0 }; ///<- Output canvas height in mm
-    mutable double m_resolution_dpi { 0.0 }; ///<- Resolution in pixels per mm
+    double m_resolution_dpi { 0.0 }; ///<- Resolution in pixels per mm
     double m_gutter { 0.0 }; ///<- Separation between passport photos in the canvas in mm
     double m_padding { 1.5 };
 
     std::string m_units; ///<- Units of the input dimensions
 
+    // Dimensions in pixels at m_resolution_dpi, precomputed as they are queried for every tile
+    double m_canvasWidthPix { 0.0 };
+    double m_canvasHeightPix { 0.0 };
+    double m_gutterPix { 0.0 };
+    double m_paddingPix { 0.0 };
+
 public:
     PrintDefinition(double width,
                     double height,
@@ -56,6 +63,7 @@ public:
     static PrintDefinitionSPtr fromJson(rapidjson::Value & canvas);
     double resolutionDpi() const;
 
-    void overrideResolution(double newDpi) const;
+    /*!@brief Returns a copy of this print definition with a different resolution !*/
+    PrintDefinition withResolution(double newDpi) const;
 };
 } // namespace ppp
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ParameterOverrides.h"
+#include "PhotoStandard.h"
+#include "PrintDefinition.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <rapidjson/reader.h>
+
+namespace ppp
+{
+/*!@brief Photo of a createGangSheets request, fields absent from the request are empty !*/
+struct ApiGangSheetJob final
+{
+    std::string imageId;
+    std::string standardId; ///<- Id of the photo standard in the catalog, empty if it is given in full
+    std::optional<PhotoStandard> standard; ///<- Photo standard given in full
+    std::optional<cv::Point> crownPoint;
+    std::optional<cv::Point> chinPoint;
+    int copies = 1;
+};
+
+/*!@brief Fields of a request to the public API (createTiledPrint, createPreview, checkCompliance ...). Fields
+ * absent from the request are empty. Instances are meant to be reused, clearing them keeps the capacity of the
+ * strings, so that parsing similar requests again allocates nothing !*/
+struct ApiRequest final
+{
+    std::string imageId;
+    std::string standardId; ///<- Id of the photo standard in the catalog, empty if it is given in full
+    std::optional<PhotoStandard> standard; ///<- Photo standard given in full
+    std::string canvasId; ///<- Id of the print definition in the catalog, empty if it is given in full
+    std::optional<PrintDefinition> canvas; ///<- Print definition given in full
+    std::optional<cv::Point> crownPoint;
+    std::optional<cv::Point> chinPoint;
+    bool asBase64 = false;
+    bool autoCorrect = false;
+    std::string printProfile;
+    std::string format;
+    int maxHeight = 0;
+    std::vector<std::string> complianceChecks;
+    ParameterOverrides overrides; ///<- Configuration entries replaced for this request only
+    std::vector<ApiGangSheetJob> jobs; ///<- Photos of a createGangSheets request
+
+    void clear();
+};
+
+/*!@brief Parses API requests in a single pass over the JSON text, straight into an ApiRequest, without building a
+ * document. Values are type checked as they are read and unknown keys are skipped. Only the fields needed by the
+ * requests are recognized, see CommonHelpers.h for their names !*/
+class RequestParser final
+{
+public:
+    /*!@brief Clears the request and fills it from the JSON text, throws on malformed JSON or invalid values !*/
+    void parse(const std::string & json, ApiRequest & request);
+
+private:
+    rapidjson::Reader m_reader; ///<- Reused so that its parsing stack is only allocated once
+};
+} // namespace ppp
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ppp
+{
+FWD_DECL(RequestRecorder)
+
+/*!@brief One public API call as captured by the RequestRecorder !*/
+struct RecordedRequest final
+{
+    std::string name; ///<- Name of the PublicPppEngine method, e.g. "createTiledPrint"
+    std::vector<std::string> args; ///<- Arguments in call order, image buffers are stored as raw bytes
+    uint64_t startTimeUs = 0; ///<- Start of the call relative to the start of the recording
+    double durationMs = 0; ///<- Wall time of the call when it was recorded
+};
+
+/*!@brief Contents of a request archive !*/
+struct RequestArchive final
+{
+    uint32_t configHash = 0; ///<- Hash of the engine configuration the requests were recorded with
+    std::vector<RecordedRequest> requests; ///<- Sorted by start time
+};
+
+/*!@brief Captures the requests made to the public API into a compact local archive so slow production requests
+ * can be replayed, and profiled, offline. The archive is a binary file with the following layout (little endian):
+ * header: "PPPREC" | uint16 version | uint32 configHash
+ * then one entry per request:
+ * uint32 nameLength | name | uint64 startTimeUs | double durationMs | uint32 numArgs | { uint64 argLength | arg }
+ * Entries are appended when calls complete, so concurrent requests may appear out of start time order !*/
+class RequestRecorder final : NonCopyable
+{
+public:
+    /*!@brief Remembers the configuration (file path or JSON content) the engine was configured with !*/
+    void setConfiguration(const std::string & configFilePathOrContent);
+
+    /*!@brief Starts appending requests to a new archive, replacing the file if it exists !*/
+    void start(const std::string & archiveFilePath);
+
+    void stop();
+
+    bool isRecording() const;
+
+    void record(const std::string & name,
+                const std::vector<std::string> & args,
+                std::chrono::steady_clock::time_point startTime,
+                std::chrono::steady_clock::time_point endTime);
+
+    static RequestArchive readArchive(const std::string & archiveFilePath);
+
+    /*!@brief CRC32 of the configuration content, the file is read if configFilePathOrContent is a path !*/
+    static uint32_t configurationHash(const std::string & configFilePathOrContent);
+
+private:
+    std::mutex m_mutex;
+    std::atomic<bool> m_recording { false };
+    uint32_t m_configHash = 0;
+    std::ofstream m_archive;
+    std::chrono::steady_clock::time_point m_recordingStart;
+};
+
+/*!@brief Records the enclosing public API call, if recording is enabled, when it goes out of scope !*/
+class RecordedCall final : NonCopyable
+{
+public:
+    RecordedCall(RequestRecorder & recorder, const char * name);
+    ~RecordedCall();
+
+    /*!@brief Appends an argument of the call, arguments are only copied while recording !*/
+    RecordedCall & arg(const char * data, size_t length);
+
+    RecordedCall & arg(const std::string & value);
+
+private:
+    RequestRecorder & m_recorder;
+    const char * m_name;
+    bool m_recording;
+    std::vector<std::string> m_args;
+    std::chrono::steady_clock::time_point m_startTime;
+};
+} // namespace ppp
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ppp
+{
+FWD_DECL(SharedMemoryRing)
+struct RingHeader;
+
+/*!@brief Header at the start of every slot of a SharedMemoryRing, followed by the payload bytes !*/
+struct alignas(64) RingSlotHeader final
+{
+    std::atomic<uint32_t> state; ///<- SlotState, the only field both processes write
+    uint32_t kind; ///<- Meaning of the payload, defined by the protocol running on top of the ring
+    uint64_t requestId; ///<- Set by the producer, copied into the matching response
+    uint64_t sequence; ///<- Position of the slot in the publishing order, set when committed
+    uint64_t length; ///<- Bytes of payload in use
+    int32_t rows; ///<- Pixel layout when the payload is a raw image
+    int32_t cols;
+    int32_t type; ///<- OpenCV type of the pixels, e.g. CV_8UC3
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Slot states must be lock free to be shared by processes");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring positions must be lock free to be shared by processes");
+
+/*!@brief Fixed size slot ring in POSIX shared memory, with one producer process and one consumer process.
+ * The producer fills the payload of a free slot in place and publishes it, the consumer reads it in place and
+ * releases it when done. Slots may be released in any order, so the consumer can hold on to some of them (e.g. raw
+ * images kept in the image store) while the ring keeps moving: the producer fills any free slot, starting from the
+ * one after its last, and the consumer reads the slots in the order they were published, whatever their position.
+ * The read and write positions live in the shared memory too, so a restarted process carries on where the previous
+ * one stopped. No data is copied by the ring itself !*/
+class SharedMemoryRing final : NonCopyable
+{
+public:
+    enum SlotState : uint32_t
+    {
+        FREE = 0,
+        READY = 1, ///<- Published by the producer, not yet taken by the consumer
+        IN_USE = 2, ///<- Taken by the consumer
+    };
+
+    /*!@brief Creates (or replaces) the shared memory object, owned and unlinked by this instance !*/
+    static SharedMemoryRingSPtr create(const std::string & name, uint32_t numSlots, uint64_t slotCapacity);
+
+    /*!@brief Maps a ring created by another process !*/
+    static SharedMemoryRingSPtr open(const std::string & name);
+
+    ~SharedMemoryRing();
+
+    /*!@brief Producer: returns a free slot to fill or nullptr if the consumer holds all of them !*/
+    RingSlotHeader * beginWrite();
+
+    /*!@brief Producer: makes the slot returned by the last beginWrite available to the consumer !*/
+    void commitWrite(RingSlotHeader * slot);
+
+    /*!@brief Consumer: returns the next published slot or nullptr if there is none !*/
+    RingSlotHeader * beginRead();
+
+    /*!@brief Consumer: gives a slot back to the producer, slots can be released in any order !*/
+    static void release(RingSlotHeader * slot);
+
+    static uint8_t * payload(RingSlotHeader * slot);
+
+    uint64_t slotCapacity() const;
+
+    uint32_t numSlots() const;
+
+    /*!@brief Number of slots taken by the consumer and not released yet !*/
+    uint32_t numSlotsInUse() const;
+
+    /*!@brief Slots taken by the consumer and not released yet, in the order they were published !*/
+    std::vector<RingSlotHeader *> slotsInUse() const;
+
+    /*!@brief Number of slots published by the producer since the ring was created !*/
+    uint64_t numPublished() const;
+
+    /*!@brief Frees the slots still held by a consumer process that died, before another one takes over !*/
+    void reclaimConsumerSlots();
+
+private:
+    SharedMemoryRing(std::string name, void * mapping, size_t mappingSize, bool owner);
+
+    RingHeader * header() const;
+
+    RingSlotHeader * slot(uint64_t index) const;
+
+    std::string m_name;
+    void * m_mapping;
+    size_t m_mappingSize;
+    bool m_owner;
+};
+} // namespace ppp
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <functional>
+#include <string>
+
+namespace cv
+{
+class Mat;
+}
+
+namespace ppp
+{
+FWD_DECL(IImageStore)
+FWD_DECL(SharedMemoryRing)
+FWD_DECL(SharedMemoryServer)
+struct RingSlotHeader;
+
+/*!@brief Requests written by the producer process in the request ring (RingSlotHeader::kind) !*/
+enum class ShmRequestKind : uint32_t
+{
+    SET_IMAGE_ENCODED = 1, ///<- Payload is an encoded image file (JPEG, PNG ...)
+    SET_IMAGE_RAW = 2, ///<- Payload is continuous BGR pixels, rows and cols set in the slot header
+    CREATE_TILED_PRINT = 3, ///<- Payload is the JSON request of createTiledPrint plus the "imgKey" of the image
+};
+
+/*!@brief Responses written by the engine in the response ring, with the requestId of the request !*/
+enum class ShmResponseKind : uint32_t
+{
+    IMAGE_KEY = 1, ///<- Payload is the key of the stored image
+    PNG_IMAGE = 2, ///<- Payload is the PNG encoded print
+    ERROR_MESSAGE = 3, ///<- Payload is the error message
+};
+
+using TiledPrintRenderer = std::function<cv::Mat(const std::string & request, double & printDpi)>;
+
+/*!@brief Serves requests from a gateway process over a pair of shared memory rings, without copying images.
+ * Encoded images are decoded straight from the request slot. Raw images stay in their slot and are stored in
+ * place, the slot being released when the image store evicts the image. To never starve the producer, a raw image
+ * is copied instead when keeping it would leave no free request slot. Output prints are written into the
+ * response slot as they are encoded !*/
+class SharedMemoryServer final : NonCopyable
+{
+public:
+    SharedMemoryServer(IImageStoreSPtr imageStore,
+                       TiledPrintRenderer renderTiledPrint,
+                       SharedMemoryRingSPtr requests,
+                       SharedMemoryRingSPtr responses);
+
+    /*!@brief Processes the next pending request, if any, and returns whether there was one. Requests stay pending
+     * while the response ring is full !*/
+    bool serveOne();
+
+    /*!@brief Called once the consumer process died: answers the requests it was processing with the message, so
+     * that the gateway does not wait for them forever, then frees all the request slots it held !*/
+    static void answerAbandonedRequests(SharedMemoryRing & requests,
+                                        SharedMemoryRing & responses,
+                                        const std::string & message);
+
+private:
+    void ingestRawImage(RingSlotHeader * request, RingSlotHeader * response);
+
+    IImageStoreSPtr m_imageStore;
+    TiledPrintRenderer m_renderTiledPrint;
+    SharedMemoryRingSPtr m_requests;
+    SharedMemoryRingSPtr m_responses;
+};
+} // namespace ppp
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "AllocationTracker.h"
+#include "CommonHelpers.h"
+#include "PerfCounters.h"
+
+#include <chrono>
+#include <string>
+
+namespace ppp
+{
+/*!@brief Accumulated measurements of one pipeline stage or public API request !*/
+struct StageStats final
+{
+    uint64_t calls = 0;
+    double wallTimeMs = 0.0;
+    PerfCounterValues counters; ///<- Zeros unless hardware counters are enabled and available
+    AllocationCounts allocations; ///<- Zeros unless allocation tracking is compiled in
+};
+
+enum class ScopeKind
+{
+    STAGE, ///<- Step of the processing pipeline
+    REQUEST ///<- Call to the public API
+};
+
+/*!@brief Process wide registry of the time spent, the heap allocations made and optionally the hardware events
+ * counted in each stage of the engine (face detection, shape prediction, crop, tile, encode ...) and in each
+ * method of the public API. Requests are accumulated per API method, not per call. Measurements are inclusive of
+ * nested stages. See AllocationTracker for the allocations made on other threads !*/
+class StageMetrics final
+{
+public:
+    /*!@brief Enables reading hardware performance counters around each stage !*/
+    static void setHardwareCountersEnabled(bool enabled);
+
+    static bool hardwareCountersEnabled();
+
+    /*!@brief Adds one call to the metrics of the calling thread, which are merged with the ones of the other threads
+     * when read. Name must be a string literal or otherwise outlive the calling thread !*/
+    static void record(ScopeKind kind, const char * name, double wallTimeMs, const StageStats & measurements);
+
+    static StageStats get(const std::string & name, ScopeKind kind = ScopeKind::STAGE);
+
+    /*!@brief Serializes the metrics as a JSON object with "stages" and "requests" keyed by name
+     * and "locks" with the wait times of the instrumented mutexes !*/
+    static std::string toJson();
+
+    static void reset();
+};
+
+/*!@brief Measures the enclosing scope as one call of a stage or request !*/
+class StageScope final : NonCopyable
+{
+public:
+    explicit StageScope(const char * name, ScopeKind kind = ScopeKind::STAGE);
+    ~StageScope();
+
+private:
+    const char * m_name;
+    ScopeKind m_kind;
+    bool m_readCounters;
+    PerfCounterValues m_startCounters;
+    AllocationCounts m_startAllocations;
+    std::chrono::steady_clock::time_point m_startTime;
+};
+} // namespace ppp
+
+#define PPP_CONCAT_IMPL(a, b) a##b
+#define PPP_CONCAT(a, b) PPP_CONCAT_IMPL(a, b)
+#define PPP_STAGE_SCOPE(stageName) const ppp::StageScope PPP_CONCAT(stageScope_, __LINE__)(stageName)
+#define PPP_REQUEST_SCOPE(requestName)                                                                                 \
+    const ppp::StageScope PPP_CONCAT(requestScope_, __LINE__)(requestName, ppp::ScopeKind::REQUEST)
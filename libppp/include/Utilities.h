@@ -24,6 +24,11 @@
     if ((v) > (max))                                                                                                   \
         throw std::runtime_error(std::string(#v) + " should be less or equal than " + std::to_string((max)));
 
+namespace ppp
+{
+class IOutputSink;
+}
+
 namespace dlib
 {
 class rectangle;
@@ -61,6 +66,14 @@ public:
     /*!@brief Calculates CRC value for a buffer of specified length !*/
     static uint32_t crc32(uint32_t crc, const uint8_t * begin, const uint8_t * end);
 
+    /*!@brief Calculates a 64 bit perceptual hash (pHash) of the image.
+     * Low frequency DCT coefficients of a 32x32 grayscale thumbnail are compared against their median,
+     * so re-compressed or resized copies of the same photo produce hashes a few bits apart !*/
+    static uint64_t perceptualHash(const cv::Mat & image);
+
+    /*!@brief Number of bits that differ between two hashes !*/
+    static int hammingDistance(uint64_t hash1, uint64_t hash2);
+
     static std::vector<BYTE> base64Decode(const char * base64Str, size_t base64Len);
 
     static std::string base64Encode(const std::vector<BYTE> & rawStr);
@@ -104,6 +117,12 @@ public:
                                             const cv::Point2d & q1,
                                             const cv::Point2d & q2);
 
+    /*!@brief Splits a BGR image into its full resolution luma plane and the Cr, Cb planes subsampled by two !*/
+    static void splitLumaChroma(const cv::Mat & bgrImage, cv::Mat & luma, cv::Mat & chroma);
+
+    /*!@brief Merges luma and chroma planes back into a BGR image, upsampling the chroma to the luma size !*/
+    static cv::Mat mergeLumaChroma(const cv::Mat & luma, const cv::Mat & chroma);
+
     static cv::Mat rotateImage(const cv::Mat & inputImage, int rotationAngleDegrees);
 
     static cv::Point convert(const dlib::point & pt);
@@ -122,6 +141,22 @@ public:
 
     static std::string encodeImageAsPng(const cv::Mat & image, bool encodeBase64, double resolution_dpi = 0);
 
+    static std::string encodeImageAsJpeg(const cv::Mat & image, bool encodeBase64, int quality = 80);
+
+    /*!@brief Same bytes as encodeImageAsPng, written to the sink, which is finished afterwards. 8 bit images are
+     * encoded in parallel by ParallelPngEncoder when built with zlib, other ones by OpenCV, with the resolution chunk
+     * written in between the encoded chunks, so the encoded stream is not copied !*/
+    static void writeImageAsPng(const cv::Mat & image,
+                                ppp::IOutputSink & sink,
+                                bool encodeBase64,
+                                double resolution_dpi = 0);
+
+    /*!@brief Same bytes as encodeImageAsJpeg, written to the sink, which is finished afterwards !*/
+    static void writeImageAsJpeg(const cv::Mat & image, ppp::IOutputSink & sink, bool encodeBase64, int quality = 80);
+
+    /*!@brief Writes an already encoded image to the sink, base64 encoded if requested, then finishes the sink !*/
+    static void writeEncodedImage(const std::vector<BYTE> & imageStream, ppp::IOutputSink & sink, bool encodeBase64);
+
     /**
      * \brief Converts the value held by a variable into a byte vector in Little Endian notation
      * \tparam T Type of the variable to be serialized  to bytes
@@ -146,12 +181,12 @@ public:
     {
         if (!v.HasMember(fieldName))
             return defaultValue;
-        if constexpr (std::is_floating_point<T>::value)
+        if constexpr (std::is_same<bool, T>::value)
+            return v[fieldName].GetBool();
+        else if constexpr (std::is_floating_point<T>::value)
             return v[fieldName].GetDouble();
         else if constexpr (std::is_integral<T>::value)
             return v[fieldName].GetInt();
-        else if constexpr (std::is_same<bool, T>::value)
-            return v[fieldName].GetBool();
         else if constexpr (std::is_same<std::string, T>::value || std::is_same<char *, T>::value)
             return v[fieldName].GetString();
         else
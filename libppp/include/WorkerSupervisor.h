@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CommonHelpers.h"
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace ppp
+{
+FWD_DECL(WorkerSupervisor)
+
+/*!@brief Body of a worker process, runs until keepRunning returns false (the supervisor sent SIGTERM) !*/
+using WorkerMain = std::function<void(size_t workerIndex, const std::function<bool()> & keepRunning)>;
+
+/*!@brief Pre-fork supervisor: forks worker processes off the current one and respawns the ones that exit.
+ * Everything loaded before start() (the models of a configured engine) is shared copy-on-write by all workers, so
+ * as long as the workers only read it, each one only costs its own per request allocations.
+ * Must be started before the process creates any thread, only the forking thread survives in the children !*/
+class WorkerSupervisor final : NonCopyable
+{
+public:
+    /*!@brief param[in] onWorkerExit Called in the supervisor with the index of a worker that exited unexpectedly,
+     *  before it is respawned. Used to reclaim the resources the dead process held !*/
+    WorkerSupervisor(size_t numWorkers, WorkerMain workerMain, std::function<void(size_t)> onWorkerExit = nullptr);
+
+    ~WorkerSupervisor();
+
+    void start();
+
+    /*!@brief Reaps the workers that exited and respawns them. A worker that exits within a second of being spawned
+     *  is only respawned a second later, so a crash loop does not spin the supervisor !*/
+    void superviseOnce();
+
+    /*!@brief Asks all workers to stop (SIGTERM) and waits for them to exit !*/
+    void stop();
+
+    size_t numRespawns() const;
+
+    /*!@brief Process ids of the workers, -1 for a worker waiting to be respawned !*/
+    std::vector<int> workerPids() const;
+
+private:
+    struct Worker
+    {
+        int pid = -1;
+        std::chrono::steady_clock::time_point spawnTime;
+        std::chrono::steady_clock::time_point respawnTime; ///<- Earliest respawn after an unexpected exit
+    };
+
+    void spawn(size_t workerIndex);
+
+    WorkerMain m_workerMain;
+    std::function<void(size_t)> m_onWorkerExit;
+    std::vector<Worker> m_workers;
+    size_t m_numRespawns = 0;
+    bool m_running = false;
+};
+} // namespace ppp
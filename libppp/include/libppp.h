@@ -11,12 +11,15 @@
 #define DECLSPEC
 #endif
 
+#include <functional>
 #include <string>
 #include <vector>
 
 namespace ppp
 {
+class IOutputSink;
 class PppEngine;
+class RequestRecorder;
 
 /*!@brief Wrapper class for this lib.
 The purpose of this library is to decouple boost and opencv from the node add-on !*/
@@ -52,8 +55,13 @@ public:
 
     std::string detectLandmarks(const std::string & imageId) const;
 
+    /*!@brief Same as detectLandmarks, with the crown and chin estimated with the "overrides" of the request, see
+    *  createTiledPrint. The estimate is only returned, later calls on the image still get the configured one !*/
+    std::string detectLandmarks(const std::string & imageId, const std::string & request) const;
+
     /*!@brief Creates a tiled print from input image, crown/chin points and passport/canvas definition
-    *  Output definition is passed as a JSON string with the following format:
+    *  Output definition is passed as a JSON string with the following format, where "standard" and "canvas"
+    *  can also be the id of an entry in the catalog:
     .{
     .    "preprocessing": {
     .    },
@@ -78,15 +86,154 @@ public:
     .       "x": 500,
     .       "y": 600
     .    },
-    .    "asBase64": true|false
+    .    "asBase64": true|false,
+    .    "autoCorrect": true|false,
+    .    "printProfile": "lab_glossy",
+    .    "format": "png"|"jpeg",
+    .    "overrides": {
+    .       "photoPrintMaker": { "background": [255, 255, 255] },
+    .       "crownChinEstimator": { "chinCrownCoeff": 1.7699, "chinFrownCoeff": 0.8945 }
+    .    }
     .}
+    *  With "autoCorrect" the exposure, white balance and contrast of the photo are corrected from its statistics.
+    *  With "printProfile" the sRGB pixels are converted to the colour profile registered under that id.
+    *  Entries of "overrides", all optional, replace the configuration entries of the same name for this request
+    *  only, without reconfiguring the engine.
+    *  A digital size JPEG photo (canvas without width and height) of an upright JPEG picture is cropped from the
+    *  file without re-encoding it when no resizing is needed, so it has no generation loss
     !*/
     std::string createTiledPrint(const std::string & imageId, const std::string & request) const;
 
+    /*!@brief Same as createTiledPrint, writing the print to the sink as it is encoded instead of returning it.
+    *  The sink is finished after the last byte !*/
+    void createTiledPrint(const std::string & imageId, const std::string & request, IOutputSink & sink) const;
+
+    /*!@brief Packs the photos of many images and photo standards onto shared print sheets.
+    *  Request is passed as a JSON string with the following format:
+    .{
+    .    "canvas": { ... },
+    .    "jobs": [
+    .       {
+    .           "imgKey": "0a1b2c3d",
+    .           "standard": { ... },
+    .           "crownPoint": { "x": 500, "y": 10 },
+    .           "chinPoint": { "x": 500, "y": 600 },
+    .           "copies": 4
+    .       }
+    .    ],
+    .    "asBase64": true|false,
+    .    "overrides": { ... }
+    .}
+    *  Standards and canvas are given in full or by catalog id, and overrides apply to all the jobs, as for
+    *  createTiledPrint. Throws if a job lacks its image key, standard, crown or chin point
+    *  param[in] onSheetReady Called with each PNG encoded sheet, in order, as soon as it has been rendered
+    *  returns Number of sheets created
+    !*/
+    int createGangSheets(const std::string & request,
+                         const std::function<void(const std::string & sheetPng)> & onSheetReady) const;
+
+    /*!@brief Renders a low resolution preview of the crop, meant to be called repeatedly while the user
+    *  adjusts the crown and chin points. The request has the same format as for createTiledPrint, without the
+    *  canvas, plus the following optional fields:
+    .{
+    .    "format": "jpeg"|"rgba",
+    .    "maxHeight": 400
+    .}
+    *  param[out] width Width of the preview in pixels
+    *  param[out] height Height of the preview in pixels
+    *  returns The preview as JPEG (base64 encoded if asBase64 is set) or as raw RGBA rows
+    !*/
+    std::string createPreview(const std::string & imageId,
+                              const std::string & request,
+                              int & width,
+                              int & height) const;
+
     std::string checkCompliance(const std::string & request) const;
 
+    /*!@brief Returns per stage and per request metrics as JSON:
+    .{
+    .    "stages": {
+    .       "faceDetection": {
+    .          "calls": 3,
+    .          "wallTimeMs": 41.5,
+    .          "cycles": 123456789,
+    .          "instructions": 234567890,
+    .          "cacheMisses": 12345,
+    .          "branchMisses": 6789,
+    .          "instructionsPerCycle": 1.9,
+    .          "allocations": 120,
+    .          "allocatedBytes": 3456789
+    .       },
+    .       ...
+    .    },
+    .    "requests": {
+    .       "detectLandmarks": { ... },
+    .       ...
+    .    },
+    .    "locks": {
+    .       "imageStore": {
+    .          "acquisitions": 5321,
+    .          "contentions": 87,
+    .          "waitTimeMs": 12.4
+    .       },
+    .       ...
+    .    }
+    .}
+    *  Hardware event counts are only present if enabled in the configuration ("metrics": {"hardwareCounters": true})
+    *  and allocation counts if the library was built with the PPP_TRACK_ALLOCATIONS option.
+    *  Requests are accumulated per API method. Their allocations include the ones of the threads rendering gang
+    *  sheets and encoding PNG files, but not the ones made in the worker threads of OpenCV
+    !*/
+    std::string getMetrics() const;
+
+    /*!@brief Starts capturing every request made to this engine (arguments, input images, wall time and a hash of
+    *  the configuration) into a local archive that can be re-run with the ppp_replay tool
+    *  param[in] archiveFilePath File to create, replaced if it exists
+    !*/
+    void startRecording(const std::string & archiveFilePath) const;
+
+    void stopRecording() const;
+
+    /*!@brief Serves requests posted by another process on a shared memory ring until keepRunning returns false.
+    *  Raw BGR pictures are ingested in place (the store keeps the slot until the picture is evicted) and tiled prints
+    *  are written as PNG into the response ring, see SharedMemoryServer.h for the slot layout
+    *  param[in] requestRingName Name of the ring the client writes requests to, created by the client
+    *  param[in] responseRingName Name of the ring the responses are written to, created by the client
+    !*/
+    void serveSharedMemory(const std::string & requestRingName,
+                           const std::string & responseRingName,
+                           const std::function<bool()> & keepRunning) const;
+
+    /*!@brief Forks numWorkers processes serving shared memory rings, and respawns the ones that crash, until
+    *  keepRunning returns false. Worker i serves the rings "<ringPrefix>_requests_<i>" and
+    *  "<ringPrefix>_responses_<i>", created by the client, which spreads its requests over them.
+    *  The engine must be configured beforehand: the models are then loaded once and shared by all workers.
+    *  Must be called before the process creates any other thread.
+    *  The requests a crashed worker had taken are answered with the error "Worker exited while serving the
+    *  request" before it is respawned, unless its response ring is full, in which case they get no response.
+    !*/
+    void serveWorkers(const std::string & ringPrefix,
+                      size_t numWorkers,
+                      const std::function<bool()> & keepRunning) const;
+
+    /*!@brief Adds (or replaces) a photo standard in the catalog. Requests can then pass its id as "standard"
+    *  instead of the full definition, and all requests share the same precomputed instance
+    *  param[in] photoStandardJson Same format as the "standard" object in requests
+    !*/
+    void registerPhotoStandard(const std::string & id, const std::string & photoStandardJson) const;
+
+    /*!@brief Adds (or replaces) a print definition in the catalog, requests can then pass its id as "canvas" !*/
+    void registerPrintDefinition(const std::string & id, const std::string & printDefinitionJson) const;
+
+    /*!@brief Adds (or replaces) an output colour profile, requests can then pass its id as "printProfile".
+    *  Only RGB matrix/TRC profiles are supported, throws for other ones
+    *  param[in] iccData Content of the .icc/.icm file
+    !*/
+    void registerColorProfile(const std::string & id, const std::string & iccData) const;
+
 private:
     PppEngine * m_pPppEngine;
+    RequestRecorder * m_pRecorder;
 };
 } // namespace ppp
 
@@ -102,5 +249,31 @@ extern "C"
 
     bool detect_landmarks(const char * img_id, char * landmarks);
 
+    bool detect_landmarks_with_overrides(const char * img_id, const char * request, char * landmarks);
+
     int create_tiled_print(const char * img_id, const char * request, char * out_buf);
+
+    /*!@brief Writes the print to an open file descriptor, which is left open, returns the number of bytes written !*/
+    int create_tiled_print_to_fd(const char * img_id, const char * request, int fd);
+
+    typedef void (*ppp_output_callback)(const char * data, int size, void * user_data);
+
+    /*!@brief Passes the print to the callback in chunks of chunk_size bytes (the last one may be smaller), or as it
+    *  is encoded with a chunk_size of 0. Returns the total number of bytes !*/
+    int create_tiled_print_chunked(const char * img_id,
+                                   const char * request,
+                                   ppp_output_callback callback,
+                                   void * user_data,
+                                   int chunk_size);
+
+    int get_metrics(char * out_buf);
+
+    int create_preview(const char * img_id, const char * request, char * out_buf, int * width, int * height);
+
+    bool start_recording(const char * archive_path);
+
+    bool stop_recording();
+
+    /*!@brief Adds (or replaces) an output ICC colour profile, requests can then pass its id as "printProfile" !*/
+    bool register_color_profile(const char * profile_id, const char * icc_buf, int icc_buf_size);
 }
@@ -38,9 +38,18 @@ libppp.set_image.argtypes = [c_char_p, c_int, c_char_p]
 libppp.detect_landmarks.restype = bool
 libppp.detect_landmarks.argtypes = [c_char_p, c_char_p]
 
+libppp.detect_landmarks_with_overrides.restype = bool
+libppp.detect_landmarks_with_overrides.argtypes = [c_char_p, c_char_p, c_char_p]
+
 libppp.create_tiled_print.restype = int
 libppp.create_tiled_print.argtypes = [c_char_p, c_char_p, c_char_p]
 
+libppp.create_tiled_print_to_fd.restype = int
+libppp.create_tiled_print_to_fd.argtypes = [c_char_p, c_char_p, c_int]
+
+libppp.register_color_profile.restype = bool
+libppp.register_color_profile.argtypes = [c_char_p, c_char_p, c_int]
+
 def str2bytes(string):
     return bytes(string, 'ascii')
 
@@ -82,6 +91,18 @@ def detect_landmarks(img_key):
     return None
 
 
+def detect_landmarks_with_overrides(img_key, request):
+    """
+    """
+    assert img_key and isinstance(img_key, str), 'Invalid image key'
+
+    landmarks = create_string_buffer(65535)
+    success = libppp.detect_landmarks_with_overrides(str2bytes(img_key), str2bytes(request), landmarks)
+    if success:
+        return landmarks.value
+    return None
+
+
 def create_tiled_print(img_key, request):
     """
     """
@@ -95,6 +116,29 @@ def create_tiled_print(img_key, request):
     return png_d
 
 
+def write_tiled_print(img_key, request, file_path):
+    """
+    Writes the tiled print straight to the file, returns the number of bytes written
+    """
+    assert request, 'Request is empty'
+    if not isinstance(request, str):
+        request = json.dumps(request)
+
+    with open(file_path, 'wb') as fp:
+        return libppp.create_tiled_print_to_fd(str2bytes(img_key), str2bytes(request), fp.fileno())
+
+
+def register_color_profile(profile_id, icc_content):
+    """
+    Registers an ICC profile, given as a file path or its content, that requests can select as "printProfile"
+    """
+    assert profile_id and isinstance(profile_id, str), 'Invalid profile id'
+    if isinstance(icc_content, str):
+        with open(icc_content, 'rb') as fp:
+            icc_content = fp.read()
+    return libppp.register_color_profile(str2bytes(profile_id), icc_content, len(icc_content))
+
+
 def main():
     # Let's check that it works
     lib_cfg = resolve_filepath('config.json')
@@ -131,9 +175,7 @@ def main():
         }
     }
 
-    png_content = create_tiled_print(img_key, request)
-    with open('output.png', 'wb') as fp:
-        fp.write(png_content)
+    assert write_tiled_print(img_key, request, 'output.png') > 0
     print("Created tiled print from request")
 
 
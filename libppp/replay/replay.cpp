@@ -0,0 +1,145 @@
+/*
+ * Replays a request archive captured with PublicPppEngine::startRecording, one request at a time in the order they
+ * were started, and reports the replayed wall time against the recorded one together with the per stage metrics.
+ */
+#include <iomanip>
+#include <iostream>
+
+#include <tclap/CmdLine.h>
+
+#include "RequestRecorder.h"
+#include "StageMetrics.h"
+#include "libppp.h"
+
+using namespace std;
+using namespace ppp;
+
+namespace
+{
+void replayRequest(const PublicPppEngine & engine, const RecordedRequest & request)
+{
+    const auto & args = request.args;
+    if (request.name == "setImage")
+    {
+        engine.setImage(args[0].c_str(), stoul(args[1]));
+    }
+    else if (request.name == "getImage")
+    {
+        engine.getImage(args[0]);
+    }
+    else if (request.name == "detectLandmarks")
+    {
+        if (args.size() > 1)
+        {
+            engine.detectLandmarks(args[0], args[1]);
+        }
+        else
+        {
+            engine.detectLandmarks(args[0]);
+        }
+    }
+    else if (request.name == "createTiledPrint")
+    {
+        engine.createTiledPrint(args[0], args[1]);
+    }
+    else if (request.name == "createGangSheets")
+    {
+        engine.createGangSheets(args[0], [](const string &) {});
+    }
+    else if (request.name == "createPreview")
+    {
+        int width, height;
+        engine.createPreview(args[0], args[1], width, height);
+    }
+    else if (request.name == "checkCompliance")
+    {
+        engine.checkCompliance(args[0]);
+    }
+    else
+    {
+        throw runtime_error("Unknown request '" + request.name + "'");
+    }
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    TCLAP::CmdLine cmd("Replays requests captured with PublicPppEngine::startRecording", ' ', "1.0");
+    TCLAP::UnlabeledValueArg<string> archiveFile("archive", "Request archive to replay", true, "", "file path");
+    TCLAP::ValueArg<string> configFile("",
+                                       "config",
+                                       "Configuration file with Computer Vision models",
+                                       false,
+                                       "config.json",
+                                       "file path");
+    TCLAP::ValueArg<int> repeat("r", "repeat", "Number of times the whole archive is replayed", false, 1, "count");
+    TCLAP::SwitchArg noCounters("", "noCounters", "Do not read hardware performance counters", false);
+    TCLAP::SwitchArg perRequestMetrics("", "perRequestMetrics", "Print the stage metrics after every request", false);
+    cmd.add(archiveFile);
+    cmd.add(configFile);
+    cmd.add(repeat);
+    cmd.add(noCounters);
+    cmd.add(perRequestMetrics);
+    cmd.parse(argc, argv);
+
+    const auto archive = RequestRecorder::readArchive(archiveFile.getValue());
+    cout << "Replaying " << archive.requests.size() << " requests from " << archiveFile.getValue() << endl;
+
+    PublicPppEngine engine;
+    if (!engine.configure(configFile.getValue().c_str(), nullptr))
+    {
+        cerr << "Unable to load engine configuration from " << configFile.getValue() << endl;
+        return 1;
+    }
+    if (RequestRecorder::configurationHash(configFile.getValue()) != archive.configHash)
+    {
+        cerr << "Warning: the requests were recorded with a different configuration (hash " << hex << setw(8)
+             << setfill('0') << archive.configHash << dec << setfill(' ') << ")" << endl;
+    }
+    StageMetrics::setHardwareCountersEnabled(!noCounters.getValue());
+    StageMetrics::reset();
+
+    auto numFailed = 0;
+    for (auto iteration = 0; iteration < repeat.getValue(); ++iteration)
+    {
+        for (size_t i = 0; i < archive.requests.size(); ++i)
+        {
+            const auto & request = archive.requests[i];
+            if (perRequestMetrics.getValue())
+            {
+                StageMetrics::reset();
+            }
+            const auto start = chrono::steady_clock::now();
+            string error;
+            try
+            {
+                replayRequest(engine, request);
+            }
+            catch (const exception & ex)
+            {
+                error = ex.what();
+                ++numFailed;
+            }
+            const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+            cout << "#" << setw(5) << left << i << setw(18) << request.name << right << fixed << setprecision(2)
+                 << " recorded=" << setw(9) << request.durationMs << "ms replayed=" << setw(9) << elapsed.count()
+                 << "ms";
+            if (!error.empty())
+            {
+                cout << " failed: " << error;
+            }
+            cout << endl;
+            if (perRequestMetrics.getValue())
+            {
+                cout << engine.getMetrics() << endl;
+            }
+        }
+    }
+
+    if (!perRequestMetrics.getValue())
+    {
+        cout << engine.getMetrics() << endl;
+    }
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+/*
+ * Multi-threaded soak benchmark: drives one shared engine from 1..N threads with a realistic mix of public API
+ * requests and reports throughput scaling, per request tail latency and the time spent waiting for locks.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <rapidjson/document.h>
+#include <tclap/CmdLine.h>
+
+#include "StageMetrics.h"
+#include "libppp.h"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace
+{
+enum class Operation
+{
+    SET_IMAGE,
+    DETECT_LANDMARKS,
+    CHECK_COMPLIANCE,
+    CREATE_TILED_PRINT,
+    GET_IMAGE,
+};
+
+const map<Operation, string> OPERATION_NAMES = {
+    { Operation::SET_IMAGE, "setImage" },
+    { Operation::DETECT_LANDMARKS, "detectLandmarks" },
+    { Operation::CHECK_COMPLIANCE, "checkCompliance" },
+    { Operation::CREATE_TILED_PRINT, "createTiledPrint" },
+    { Operation::GET_IMAGE, "getImage" },
+};
+
+// Relative weights of each operation, roughly what a photo booth client sends per uploaded picture
+const vector<pair<Operation, int>> OPERATION_MIX = {
+    { Operation::SET_IMAGE, 20 },
+    { Operation::DETECT_LANDMARKS, 30 },
+    { Operation::CHECK_COMPLIANCE, 10 },
+    { Operation::CREATE_TILED_PRINT, 25 },
+    { Operation::GET_IMAGE, 15 },
+};
+
+const string PHOTO_STANDARD_JSON = R"({"pictureWidth": 2, "pictureHeight": 2, "faceHeight": 1.1875, "units": "inch"})";
+const string CANVAS_JSON = R"({"width": 6, "height": 4, "resolution": 300, "gutter": 0.1, "units": "inch"})";
+
+struct ImageState
+{
+    string imageKey;
+    string crownChinJson; ///<- "crownPoint" and "chinPoint" members once the landmarks have been detected
+};
+
+struct LevelResult
+{
+    size_t numThreads = 0;
+    double elapsedSec = 0;
+    size_t numErrors = 0;
+    map<Operation, vector<double>> latenciesMs;
+    string metricsJson;
+};
+
+vector<string> readImageFiles(const string & imagesDir)
+{
+    vector<string> images;
+    for (const auto & entry : fs::directory_iterator(imagesDir))
+    {
+        const auto ext = entry.path().extension().string();
+        if (ext == ".jpg" || ext == ".png")
+        {
+            ifstream fs(entry.path().string(), ios::binary);
+            images.emplace_back((istreambuf_iterator<char>(fs)), istreambuf_iterator<char>());
+        }
+    }
+    return images;
+}
+
+string crownChinFromLandmarks(const string & landmarksJson)
+{
+    rapidjson::Document d;
+    d.Parse(landmarksJson.c_str());
+    if (d.HasParseError() || !d.IsObject() || !d.HasMember("crownPoint") || !d.HasMember("chinPoint"))
+    {
+        return "";
+    }
+    const auto & crown = d["crownPoint"];
+    const auto & chin = d["chinPoint"];
+    ostringstream oss;
+    oss << R"("crownPoint": {"x": )" << crown["x"].GetInt() << R"(, "y": )" << crown["y"].GetInt() << "}, "
+        << R"("chinPoint": {"x": )" << chin["x"].GetInt() << R"(, "y": )" << chin["y"].GetInt() << "}";
+    return oss.str();
+}
+
+double percentile(vector<double> & values, const double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    const auto n = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+LevelResult runLevel(const ppp::PublicPppEngine & engine,
+                     const vector<string> & images,
+                     const size_t numThreads,
+                     const double durationSec,
+                     const unsigned seed)
+{
+    ppp::StageMetrics::reset();
+
+    vector<LevelResult> threadResults(numThreads);
+    atomic<bool> stop { false };
+
+    const auto worker = [&](const size_t threadIndex) {
+        auto & result = threadResults[threadIndex];
+        mt19937 rng(seed + static_cast<unsigned>(threadIndex));
+        vector<int> weights;
+        transform(OPERATION_MIX.begin(), OPERATION_MIX.end(), back_inserter(weights), [](const auto & p) {
+            return p.second;
+        });
+        discrete_distribution<size_t> pickOperation(weights.begin(), weights.end());
+        uniform_int_distribution<size_t> pickImage(0, images.size() - 1);
+        vector<ImageState> imageStates;
+        ImageState noImage;
+
+        while (!stop)
+        {
+            auto operation = OPERATION_MIX[pickOperation(rng)].first;
+            // Requests that need a picture (with landmarks) fall back to the request that provides it
+            if (imageStates.empty())
+            {
+                operation = Operation::SET_IMAGE;
+            }
+            auto & state = imageStates.empty() ? noImage : imageStates[rng() % imageStates.size()];
+            if ((operation == Operation::CHECK_COMPLIANCE || operation == Operation::CREATE_TILED_PRINT)
+                && state.crownChinJson.empty())
+            {
+                operation = Operation::DETECT_LANDMARKS;
+            }
+
+            const auto start = chrono::steady_clock::now();
+            try
+            {
+                switch (operation)
+                {
+                    case Operation::SET_IMAGE:
+                    {
+                        const auto & image = images[pickImage(rng)];
+                        rapidjson::Document d;
+                        d.Parse(engine.setImage(image.data(), image.size()).c_str());
+                        imageStates.push_back({ d["imgKey"].GetString(), "" });
+                        break;
+                    }
+                    case Operation::DETECT_LANDMARKS:
+                        state.crownChinJson = crownChinFromLandmarks(engine.detectLandmarks(state.imageKey));
+                        break;
+                    case Operation::CHECK_COMPLIANCE:
+                        engine.checkCompliance(R"({"imgKey": ")" + state.imageKey + R"(", "standard": )"
+                                               + PHOTO_STANDARD_JSON + ", " + state.crownChinJson
+                                               + R"(, "complianceChecks": ["inpuResolution"]})");
+                        break;
+                    case Operation::CREATE_TILED_PRINT:
+                        engine.createTiledPrint(state.imageKey,
+                                                R"({"standard": )" + PHOTO_STANDARD_JSON + R"(, "canvas": )"
+                                                    + CANVAS_JSON + ", " + state.crownChinJson + "}");
+                        break;
+                    case Operation::GET_IMAGE:
+                        engine.getImage(state.imageKey);
+                        break;
+                }
+            }
+            catch (const exception &)
+            {
+                // Pictures evicted from the store by other threads end up here, drop them and carry on
+                ++result.numErrors;
+                if (operation != Operation::SET_IMAGE)
+                {
+                    swap(state, imageStates.back());
+                    imageStates.pop_back();
+                }
+                continue;
+            }
+            const chrono::duration<double, milli> latency = chrono::steady_clock::now() - start;
+            result.latenciesMs[operation].push_back(latency.count());
+
+            // Keep a bounded working set per thread so the store sees both hits and evictions
+            if (imageStates.size() > 8)
+            {
+                imageStates.erase(imageStates.begin());
+            }
+        }
+    };
+
+    const auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        threads.emplace_back(worker, i);
+    }
+    this_thread::sleep_for(chrono::duration<double>(durationSec));
+    stop = true;
+    for (auto & t : threads)
+    {
+        t.join();
+    }
+
+    LevelResult levelResult;
+    levelResult.numThreads = numThreads;
+    levelResult.elapsedSec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (auto & threadResult : threadResults)
+    {
+        levelResult.numErrors += threadResult.numErrors;
+        for (auto & kv : threadResult.latenciesMs)
+        {
+            auto & all = levelResult.latenciesMs[kv.first];
+            all.insert(all.end(), kv.second.begin(), kv.second.end());
+        }
+    }
+    levelResult.metricsJson = engine.getMetrics();
+    return levelResult;
+}
+
+void printLevel(LevelResult & r, const double baselineOpsPerSec)
+{
+    size_t numOps = 0;
+    for (const auto & kv : r.latenciesMs)
+    {
+        numOps += kv.second.size();
+    }
+    const auto opsPerSec = numOps / r.elapsedSec;
+    const auto speedup = baselineOpsPerSec > 0 ? opsPerSec / baselineOpsPerSec : 1.0;
+
+    cout << "threads=" << r.numThreads << " ops/s=" << fixed << setprecision(1) << opsPerSec << " speedup=" << speedup
+         << " efficiency=" << setprecision(0) << 100.0 * speedup / r.numThreads << "% errors=" << r.numErrors << endl;
+
+    for (auto & kv : r.latenciesMs)
+    {
+        auto & latencies = kv.second;
+        cout << "  " << left << setw(18) << OPERATION_NAMES.at(kv.first) << right << " n=" << setw(6)
+             << latencies.size() << setprecision(2) << " p50=" << setw(9) << percentile(latencies, 0.50)
+             << "ms p99=" << setw(9) << percentile(latencies, 0.99) << "ms max=" << setw(9)
+             << *max_element(latencies.begin(), latencies.end()) << "ms" << endl;
+    }
+
+    rapidjson::Document d;
+    d.Parse(r.metricsJson.c_str());
+    if (d.HasMember("locks"))
+    {
+        for (const auto & lock : d["locks"].GetObject())
+        {
+            const auto & stats = lock.value;
+            const auto acquisitions = stats["acquisitions"].GetUint64();
+            if (acquisitions == 0)
+            {
+                continue;
+            }
+            const auto waitTimeMs = stats["waitTimeMs"].GetDouble();
+            cout << "  lock " << left << setw(13) << lock.name.GetString() << right << " acquisitions=" << acquisitions
+                 << " contended=" << setprecision(1) << 100.0 * stats["contentions"].GetUint64() / acquisitions
+                 << "% wait=" << setprecision(2) << waitTimeMs << "ms ("
+                 << 100.0 * waitTimeMs / (1000.0 * r.elapsedSec * r.numThreads) << "% of thread time)" << endl;
+        }
+    }
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    TCLAP::CmdLine cmd("Multi-threaded scaling and lock contention soak benchmark", ' ', "1.0");
+    TCLAP::ValueArg<string> configFile("",
+                                       "config",
+                                       "Configuration file with Computer Vision models",
+                                       false,
+                                       "config.json",
+                                       "file path");
+    TCLAP::ValueArg<string> imagesDir("",
+                                      "images",
+                                      "Directory with the input pictures",
+                                      false,
+                                      "research/sample_test_images",
+                                      "directory path");
+    TCLAP::ValueArg<size_t> maxThreads("t",
+                                       "threads",
+                                       "Maximum number of client threads, every power of two up to it is measured",
+                                       false,
+                                       thread::hardware_concurrency(),
+                                       "count");
+    TCLAP::ValueArg<double> duration("d", "duration", "Seconds of load per thread count", false, 20.0, "seconds");
+    TCLAP::ValueArg<unsigned> seed("", "seed", "Seed for the request mix", false, 42, "integer");
+    cmd.add(configFile);
+    cmd.add(imagesDir);
+    cmd.add(maxThreads);
+    cmd.add(duration);
+    cmd.add(seed);
+    cmd.parse(argc, argv);
+
+    const auto images = readImageFiles(imagesDir.getValue());
+    if (images.empty())
+    {
+        cerr << "No pictures found in " << imagesDir.getValue() << endl;
+        return 1;
+    }
+
+    ppp::PublicPppEngine engine;
+    if (!engine.configure(configFile.getValue().c_str(), nullptr))
+    {
+        cerr << "Unable to load engine configuration from " << configFile.getValue() << endl;
+        return 1;
+    }
+
+    vector<size_t> threadCounts;
+    for (size_t n = 1; n < maxThreads.getValue(); n *= 2)
+    {
+        threadCounts.push_back(n);
+    }
+    threadCounts.push_back(max<size_t>(maxThreads.getValue(), 1));
+
+    auto baselineOpsPerSec = 0.0;
+    for (const auto numThreads : threadCounts)
+    {
+        auto result = runLevel(engine, images, numThreads, duration.getValue(), seed.getValue());
+        printLevel(result, baselineOpsPerSec);
+        if (numThreads == 1)
+        {
+            size_t numOps = 0;
+            for (const auto & kv : result.latenciesMs)
+            {
+                numOps += kv.second.size();
+            }
+            baselineOpsPerSec = numOps / result.elapsedSec;
+        }
+    }
+    return 0;
+}
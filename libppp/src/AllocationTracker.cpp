@@ -0,0 +1,147 @@
+#include "AllocationTracker.h"
+
+#ifdef PPP_TRACK_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+
+#include <opencv2/core/mat.hpp>
+#endif
+
+namespace ppp
+{
+namespace
+{
+// Plain integers so that updating them never allocates
+thread_local uint64_t t_allocationCount = 0;
+thread_local uint64_t t_allocationBytes = 0;
+} // namespace
+
+AllocationCounts AllocationCounts::operator-(const AllocationCounts & other) const
+{
+    AllocationCounts result;
+    result.count = count - other.count;
+    result.bytes = bytes - other.bytes;
+    return result;
+}
+
+AllocationCounts & AllocationCounts::operator+=(const AllocationCounts & other)
+{
+    count += other.count;
+    bytes += other.bytes;
+    return *this;
+}
+
+AllocationCounts AllocationTracker::currentThreadCounts()
+{
+    AllocationCounts counts;
+    counts.count = t_allocationCount;
+    counts.bytes = t_allocationBytes;
+    return counts;
+}
+
+void AllocationTracker::recordAllocation(const size_t bytes) noexcept
+{
+    ++t_allocationCount;
+    t_allocationBytes += bytes;
+}
+
+void AllocationTracker::attributeToCurrentThread(const AllocationCounts & counts) noexcept
+{
+    t_allocationCount += counts.count;
+    t_allocationBytes += counts.bytes;
+}
+} // namespace ppp
+
+#ifdef PPP_TRACK_ALLOCATIONS
+namespace ppp
+{
+namespace
+{
+/*!@brief Pixel buffers of cv::Mat bypass operator new, count them through OpenCV's allocator hook !*/
+class CountingMatAllocator final : public cv::MatAllocator
+{
+public:
+    cv::UMatData * allocate(int dims,
+                            const int * sizes,
+                            int type,
+                            void * data,
+                            size_t * step,
+                            cv::AccessFlag flags,
+                            cv::UMatUsageFlags usageFlags) const override
+    {
+        const auto u = m_stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (u != nullptr && data == nullptr)
+        {
+            AllocationTracker::recordAllocation(u->size);
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData * data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return m_stdAllocator->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData * data) const override
+    {
+        m_stdAllocator->deallocate(data);
+    }
+
+private:
+    cv::MatAllocator * m_stdAllocator = cv::Mat::getStdAllocator();
+};
+
+const bool g_matAllocatorInstalled = []() {
+    static CountingMatAllocator allocator;
+    cv::Mat::setDefaultAllocator(&allocator);
+    return true;
+}();
+} // namespace
+} // namespace ppp
+
+void * operator new(const size_t size)
+{
+    ppp::AllocationTracker::recordAllocation(size);
+    if (auto p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void * operator new[](const size_t size)
+{
+    return operator new(size);
+}
+
+void * operator new(const size_t size, const std::nothrow_t &) noexcept
+{
+    ppp::AllocationTracker::recordAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void * operator new[](const size_t size, const std::nothrow_t & tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept
+{
+    std::free(p);
+}
+#endif
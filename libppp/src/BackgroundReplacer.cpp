@@ -0,0 +1,161 @@
+#include "BackgroundReplacer.h"
+#include "ConfigLoader.h"
+#include "StageMetrics.h"
+#include "Utilities.h"
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace cv;
+
+namespace ppp
+{
+namespace
+{
+// Weights of cv::COLOR_BGR2GRAY, the composite recomputes the guide on the fly with them
+constexpr float GRAY_B = 0.114f / 255.0f;
+constexpr float GRAY_G = 0.587f / 255.0f;
+constexpr float GRAY_R = 0.299f / 255.0f;
+
+Mat boxMean(const Mat & m, const int radius)
+{
+    Mat mean;
+    boxFilter(m, mean, CV_32F, Size(2 * radius + 1, 2 * radius + 1));
+    return mean;
+}
+} // namespace
+
+void BackgroundReplacer::configureInternal(const ConfigLoaderSPtr & config)
+{
+    auto & ppmConfig = config->get({ "photoPrintMaker" });
+    if (!ppmConfig.HasMember("backgroundReplacement"))
+    {
+        return;
+    }
+    const auto & cfg = ppmConfig["backgroundReplacement"];
+    m_enabled = Utilities::getField(cfg, "enabled", m_enabled);
+    m_proxySize = Utilities::getField(cfg, "proxySize", m_proxySize);
+    m_iterations = Utilities::getField(cfg, "iterations", m_iterations);
+    m_guidedFilterRadius = Utilities::getField(cfg, "guidedFilterRadius", m_guidedFilterRadius);
+    m_guidedFilterEps = Utilities::getField(cfg, "guidedFilterEps", m_guidedFilterEps);
+    m_isConfigured = true;
+}
+
+bool BackgroundReplacer::isEnabled() const
+{
+    return m_enabled;
+}
+
+Mat BackgroundReplacer::estimateProxyMatte(const Mat & proxyImage,
+                                           const Point2d & crownPoint,
+                                           const Point2d & chinPoint) const
+{
+    const auto chinCrownVec = crownPoint - chinPoint;
+    const auto faceHeight = norm(chinCrownVec);
+    if (faceHeight < 4)
+    {
+        // Face too small to seed anything meaningful, keep the whole picture
+        return Mat::ones(proxyImage.size(), CV_32F);
+    }
+    const auto up = chinCrownVec / faceHeight;
+    const auto right = Point2d(-up.y, up.x);
+    const auto angleDeg = atan2(up.x, -up.y) * 180.0 / CV_PI;
+    const auto at = [&](const double alongRight, const double alongUp) {
+        return Point(roundInteger(chinPoint.x + (right.x * alongRight + up.x * alongUp) * faceHeight),
+                     roundInteger(chinPoint.y + (right.y * alongRight + up.y * alongUp) * faceHeight));
+    };
+
+    Mat1b mask(proxyImage.size(), GC_PR_BGD);
+
+    // The borders are background, except the bottom one that the shoulders usually reach
+    const auto band = std::max(2, std::max(mask.rows, mask.cols) / 40);
+    const auto shouldersRow = std::clamp(at(0, -0.3).y, 0, mask.rows);
+    mask.rowRange(0, band).setTo(GC_BGD);
+    mask(Rect(0, 0, band, shouldersRow)).setTo(GC_BGD);
+    mask(Rect(mask.cols - band, 0, band, shouldersRow)).setTo(GC_BGD);
+
+    // Head with hair, neck and shoulders are probably foreground
+    const RotatedRect head(at(0, 0.55), Size2f(0.95 * faceHeight, 1.35 * faceHeight), static_cast<float>(angleDeg));
+    ellipse(mask, head, Scalar(GC_PR_FGD), FILLED);
+    const std::vector<Point> torso = { at(-0.3, 0.1), at(0.3, 0.1), at(1.4, -0.45), at(1.8, -10), at(-1.8, -10),
+                                       at(-1.4, -0.45) };
+    fillConvexPoly(mask, torso, Scalar(GC_PR_FGD));
+
+    // The inner face and the neck are certainly foreground
+    const RotatedRect face(at(0, 0.5), Size2f(0.45 * faceHeight, 0.7 * faceHeight), static_cast<float>(angleDeg));
+    ellipse(mask, face, Scalar(GC_FGD), FILLED);
+    const std::vector<Point> neck = { at(-0.15, 0.05), at(0.15, 0.05), at(0.15, -0.25), at(-0.15, -0.25) };
+    fillConvexPoly(mask, neck, Scalar(GC_FGD));
+
+    if (countNonZero(mask == GC_BGD) == 0)
+    {
+        // Crop too tight around the face to learn the background colours from
+        return Mat::ones(proxyImage.size(), CV_32F);
+    }
+
+    Mat bgdModel, fgdModel;
+    grabCut(proxyImage, mask, Rect(), bgdModel, fgdModel, m_iterations, GC_INIT_WITH_MASK);
+
+    // GC_FGD and GC_PR_FGD are the odd labels
+    Mat matte;
+    Mat(mask & 1).convertTo(matte, CV_32F);
+    return matte;
+}
+
+void BackgroundReplacer::replace(Mat & image,
+                                 const Point2d & crownPoint,
+                                 const Point2d & chinPoint,
+                                 const Scalar & backgroundColor) const
+{
+    PPP_STAGE_SCOPE("backgroundReplacement");
+    if (image.type() != CV_8UC3)
+    {
+        throw std::runtime_error("Background replacement needs a BGR picture");
+    }
+
+    const auto scale = std::min(1.0, static_cast<double>(m_proxySize) / std::max(image.rows, image.cols));
+    Mat proxyImage = image;
+    if (scale < 1.0)
+    {
+        resize(image, proxyImage, Size(), scale, scale, INTER_AREA);
+    }
+    const auto matte = estimateProxyMatte(proxyImage, crownPoint * scale, chinPoint * scale);
+
+    // Guided filter coefficients of the matte using the luminance as guide, computed on the proxy only. Upsampling
+    // the (smooth) coefficients rather than the matte keeps the full resolution edges (He and Sun, Fast Guided Filter)
+    Mat guide;
+    cvtColor(proxyImage, guide, COLOR_BGR2GRAY);
+    guide.convertTo(guide, CV_32F, 1.0 / 255.0);
+    const auto r = m_guidedFilterRadius;
+    const auto meanI = boxMean(guide, r);
+    const auto meanP = boxMean(matte, r);
+    const Mat varI = boxMean(guide.mul(guide), r) - meanI.mul(meanI);
+    const Mat covIp = boxMean(guide.mul(matte), r) - meanI.mul(meanP);
+    const Mat a = covIp / (varI + m_guidedFilterEps);
+    const Mat b = meanP - a.mul(meanI);
+    Mat coeffA, coeffB;
+    resize(boxMean(a, r), coeffA, image.size(), 0, 0, INTER_LINEAR);
+    resize(boxMean(b, r), coeffB, image.size(), 0, 0, INTER_LINEAR);
+
+    // Filter output and composite in one pass over the full resolution pixels
+    const float bg[3] = { static_cast<float>(backgroundColor[0]),
+                          static_cast<float>(backgroundColor[1]),
+                          static_cast<float>(backgroundColor[2]) };
+    for (auto row = 0; row < image.rows; ++row)
+    {
+        auto pixel = image.ptr<uchar>(row);
+        const auto pa = coeffA.ptr<float>(row);
+        const auto pb = coeffB.ptr<float>(row);
+        for (auto col = 0; col < image.cols; ++col, pixel += 3)
+        {
+            const auto gray = GRAY_B * pixel[0] + GRAY_G * pixel[1] + GRAY_R * pixel[2];
+            const auto alpha = std::clamp(pa[col] * gray + pb[col], 0.0f, 1.0f);
+            for (auto c = 0; c < 3; ++c)
+            {
+                pixel[c] = saturate_cast<uchar>(bg[c] + alpha * (pixel[c] - bg[c]));
+            }
+        }
+    }
+}
+} // namespace ppp
@@ -0,0 +1,152 @@
+#include "BatchShapePredictor.h"
+
+#include <cmath>
+#include <sstream>
+
+namespace ppp
+{
+BatchShapePredictor::BatchShapePredictor(const dlib::shape_predictor & shapePredictor)
+{
+    // The model is private to dlib::shape_predictor, read it back from its serialization
+    std::stringstream stream;
+    serialize(shapePredictor, stream);
+    int version;
+    std::vector<std::vector<dlib::impl::regression_tree>> forests;
+    std::vector<std::vector<unsigned long>> anchorIdx;
+    std::vector<std::vector<dlib::vector<float, 2>>> deltas;
+    dlib::deserialize(version, stream);
+    if (version != 1)
+    {
+        throw std::runtime_error("Unsupported shape predictor version");
+    }
+    dlib::deserialize(m_initialShape, stream);
+    dlib::deserialize(forests, stream);
+    dlib::deserialize(anchorIdx, stream);
+    dlib::deserialize(deltas, stream);
+
+    if (forests.empty() || forests.front().empty())
+    {
+        throw std::runtime_error("Empty shape predictor");
+    }
+    m_numTrees = forests.front().size();
+    m_numFeatures = deltas.front().size();
+    m_numSplits = forests.front().front().splits.size();
+    m_numLeaves = forests.front().front().leaf_values.size();
+    while ((size_t(1) << m_depth) < m_numLeaves)
+    {
+        ++m_depth;
+    }
+    const auto numShapeValues = static_cast<size_t>(m_initialShape.size());
+
+    m_cascades.resize(forests.size());
+    for (size_t level = 0; level < forests.size(); ++level)
+    {
+        auto & cascade = m_cascades[level];
+        cascade.anchorIdx = anchorIdx[level];
+        cascade.deltas = deltas[level];
+        if (forests[level].size() != m_numTrees || cascade.deltas.size() != m_numFeatures)
+        {
+            throw std::runtime_error("Shape predictor cascade levels differ in size");
+        }
+        cascade.splits.reserve(m_numTrees * m_numSplits);
+        cascade.leafValues.reserve(m_numTrees * m_numLeaves * numShapeValues);
+        for (const auto & tree : forests[level])
+        {
+            // Lockstep walks need every leaf at the same depth, which is how dlib trains its trees
+            if (tree.splits.size() != m_numSplits || tree.leaf_values.size() != m_numLeaves
+                || m_numLeaves != (size_t(1) << m_depth) || m_numSplits + 1 != m_numLeaves)
+            {
+                throw std::runtime_error("Shape predictor trees are not complete trees of the same depth");
+            }
+            for (const auto & split : tree.splits)
+            {
+                if (split.idx1 >= m_numFeatures || split.idx2 >= m_numFeatures)
+                {
+                    throw std::runtime_error("Invalid shape predictor feature index");
+                }
+                cascade.splits.push_back(
+                    { static_cast<uint32_t>(split.idx1), static_cast<uint32_t>(split.idx2), split.thresh });
+            }
+            for (const auto & leafValue : tree.leaf_values)
+            {
+                for (long i = 0; i < leafValue.size(); ++i)
+                {
+                    cascade.leafValues.push_back(leafValue(i));
+                }
+            }
+        }
+    }
+}
+
+size_t BatchShapePredictor::numParts() const
+{
+    return static_cast<size_t>(m_initialShape.size() / 2);
+}
+
+size_t BatchShapePredictor::numCascades() const
+{
+    return m_cascades.size();
+}
+
+void BatchShapePredictor::setConvergenceThreshold(const float threshold)
+{
+    m_convergenceThreshold = threshold;
+}
+
+void BatchShapePredictor::applyCascade(const Cascade & cascade,
+                                       const float * featurePixelValues,
+                                       const std::vector<size_t> & activeFaces,
+                                       std::vector<dlib::matrix<float, 0, 1>> & shapes) const
+{
+    const auto numShapeValues = static_cast<size_t>(m_initialShape.size());
+    const auto count = activeFaces.size();
+    uint32_t nodes[BLOCK_SIZE];
+    for (size_t tree = 0; tree < m_numTrees; ++tree)
+    {
+        const auto splits = &cascade.splits[tree * m_numSplits];
+        std::fill(nodes, nodes + count, 0);
+        for (size_t depth = 0; depth < m_depth; ++depth)
+        {
+            // Same comparison as dlib (left child when true), as arithmetic instead of a branch
+            for (size_t f = 0; f < count; ++f)
+            {
+                const auto & split = splits[nodes[f]];
+                const auto values = featurePixelValues + f * m_numFeatures;
+                const auto goLeft = values[split.idx1] - values[split.idx2] > split.threshold;
+                nodes[f] = 2 * nodes[f] + 2 - static_cast<uint32_t>(goLeft);
+            }
+        }
+
+        // Leaves are added in the order of the trees, so the float sums are the same as dlib's
+        const auto leaves = &cascade.leafValues[tree * m_numLeaves * numShapeValues];
+        for (size_t f = 0; f < count; ++f)
+        {
+            const auto leafValues = leaves + (nodes[f] - m_numSplits) * numShapeValues;
+            auto shape = &shapes[activeFaces[f]](0);
+            for (size_t i = 0; i < numShapeValues; ++i)
+            {
+                shape[i] += leafValues[i];
+            }
+        }
+    }
+}
+
+void BatchShapePredictor::removeConvergedFaces(const std::vector<dlib::matrix<float, 0, 1>> & previousShapes,
+                                               const std::vector<dlib::matrix<float, 0, 1>> & shapes,
+                                               std::vector<size_t> & activeFaces) const
+{
+    // Shapes are normalized to the face rectangle, so the threshold is relative to the size of the face
+    const auto numParts = this->numParts();
+    const auto hasConverged = [&](const size_t f) {
+        auto displacement = 0.0f;
+        for (size_t i = 0; i < numParts; ++i)
+        {
+            const auto dx = shapes[f](2 * i) - previousShapes[f](2 * i);
+            const auto dy = shapes[f](2 * i + 1) - previousShapes[f](2 * i + 1);
+            displacement += std::sqrt(dx * dx + dy * dy);
+        }
+        return displacement < m_convergenceThreshold * numParts;
+    };
+    activeFaces.erase(std::remove_if(activeFaces.begin(), activeFaces.end(), hasConverged), activeFaces.end());
+}
+} // namespace ppp
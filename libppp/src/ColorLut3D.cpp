@@ -0,0 +1,257 @@
+#include "ColorLut3D.h"
+#include "StageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace ppp
+{
+namespace
+{
+constexpr auto STATS_PROXY_SIZE = 64; ///<- Largest side of the proxy the statistics are computed on
+constexpr auto MIN_WB_GAIN = 0.8;
+constexpr auto MAX_WB_GAIN = 1.25;
+// Faces with a mid level within this range are left alone, so that darker and lighter skin tones are not all
+// pulled to the same brightness, only actual under and over exposure is corrected
+constexpr auto MIN_FACE_LEVEL = 0.35;
+constexpr auto MAX_FACE_LEVEL = 0.7;
+constexpr auto SEPARABLE_TOLERANCE = 0.01f; ///<- Largest cross channel dependency of a per channel LUT, in levels
+
+/*!@brief Input level of the histogram below which the given fraction of the pixels lies !*/
+double percentile(const cv::Mat1b & luma, const double fraction)
+{
+    std::array<int, 256> histogram {};
+    for (auto row = 0; row < luma.rows; ++row)
+    {
+        const auto p = luma.ptr<uchar>(row);
+        for (auto col = 0; col < luma.cols; ++col)
+        {
+            ++histogram[p[col]];
+        }
+    }
+    const auto target = fraction * luma.total();
+    auto count = 0.0;
+    for (auto level = 0; level < 256; ++level)
+    {
+        count += histogram[level];
+        if (count >= target)
+        {
+            return level / 255.0;
+        }
+    }
+    return 1.0;
+}
+} // namespace
+
+ColorLut3D::ColorLut3D(const int gridSize)
+: m_gridSize(gridSize)
+, m_nodes(gridSize * gridSize * gridSize)
+{
+    if (gridSize < 2)
+    {
+        throw std::runtime_error("A colour LUT needs at least two nodes per channel");
+    }
+    for (auto level = 0; level < 256; ++level)
+    {
+        const auto position = level * (gridSize - 1) / 255.0f;
+        m_lowerNode[level] = std::min(static_cast<int>(position), gridSize - 2);
+        m_weight[level] = position - m_lowerNode[level];
+    }
+}
+
+ColorLut3D ColorLut3D::fromTransform(const ColorTransform & transform, const int gridSize)
+{
+    ColorLut3D lut(gridSize);
+    const auto step = 1.0f / (gridSize - 1);
+    auto node = lut.m_nodes.begin();
+    for (auto b = 0; b < gridSize; ++b)
+    {
+        for (auto g = 0; g < gridSize; ++g)
+        {
+            for (auto r = 0; r < gridSize; ++r)
+            {
+                *node++ = transform(cv::Vec3f(b * step, g * step, r * step)) * 255.0f;
+            }
+        }
+    }
+    lut.buildChannelTable();
+    return lut;
+}
+
+ColorLut3D ColorLut3D::autoCorrection(const cv::Mat & image, const cv::Rect & faceRegion)
+{
+    PPP_STAGE_SCOPE("autoCorrection");
+    const auto scale = std::min(1.0, static_cast<double>(STATS_PROXY_SIZE) / std::max(image.rows, image.cols));
+    cv::Mat proxyImage = image;
+    if (scale < 1.0)
+    {
+        cv::resize(image, proxyImage, cv::Size(), scale, scale, cv::INTER_AREA);
+    }
+    auto faceProxyRegion = cv::Rect(cvRound(faceRegion.x * scale),
+                                    cvRound(faceRegion.y * scale),
+                                    std::max(1, cvRound(faceRegion.width * scale)),
+                                    std::max(1, cvRound(faceRegion.height * scale)))
+        & cv::Rect(0, 0, proxyImage.cols, proxyImage.rows);
+    if (faceProxyRegion.empty())
+    {
+        faceProxyRegion = cv::Rect(0, 0, proxyImage.cols, proxyImage.rows);
+    }
+
+    // White balance: grey world over the whole picture
+    const auto means = cv::mean(proxyImage);
+    const auto grey = (means[0] + means[1] + means[2]) / 3.0;
+    cv::Vec3f gains;
+    for (auto c = 0; c < 3; ++c)
+    {
+        gains[c] = static_cast<float>(means[c] > 0 ? std::clamp(grey / means[c], MIN_WB_GAIN, MAX_WB_GAIN) : 1.0);
+    }
+
+    // Contrast: stretch the levels, limited so that a low key or high key picture is not turned into a grey one
+    cv::Mat1b luma;
+    cv::cvtColor(proxyImage, luma, cv::COLOR_BGR2GRAY);
+    const auto blackLevel = static_cast<float>(std::min(percentile(luma, 0.005), 0.1));
+    const auto whiteLevel = static_cast<float>(std::max(percentile(luma, 0.995), 0.8));
+
+    // Exposure: gamma bringing the face level within the expected range
+    const auto faceLevel
+        = std::clamp((cv::mean(luma(faceProxyRegion))[0] / 255.0 - blackLevel) / (whiteLevel - blackLevel), 0.01, 0.99);
+    const auto targetLevel = std::clamp(faceLevel, MIN_FACE_LEVEL, MAX_FACE_LEVEL);
+    const auto gamma = static_cast<float>(std::log(targetLevel) / std::log(faceLevel));
+
+    return fromTransform([gains, blackLevel, whiteLevel, gamma](const cv::Vec3f & bgr) {
+        cv::Vec3f out;
+        for (auto c = 0; c < 3; ++c)
+        {
+            const auto level = std::clamp((bgr[c] * gains[c] - blackLevel) / (whiteLevel - blackLevel), 0.0f, 1.0f);
+            out[c] = std::pow(level, gamma);
+        }
+        return out;
+    });
+}
+
+ColorLut3D ColorLut3D::compose(const ColorLut3D & first, const ColorLut3D & second)
+{
+    return fromTransform([&first, &second](const cv::Vec3f & bgr) { return second.map(first.map(bgr)); },
+                         std::max(first.gridSize(), second.gridSize()));
+}
+
+cv::Vec3f ColorLut3D::map(const cv::Vec3f & bgr) const
+{
+    int lower[3];
+    float weight[3];
+    for (auto c = 0; c < 3; ++c)
+    {
+        const auto position = std::clamp(bgr[c], 0.0f, 1.0f) * (m_gridSize - 1);
+        lower[c] = std::min(static_cast<int>(position), m_gridSize - 2);
+        weight[c] = position - lower[c];
+    }
+    cv::Vec3f result;
+    for (auto corner = 0; corner < 8; ++corner)
+    {
+        const auto db = corner >> 2 & 1, dg = corner >> 1 & 1, dr = corner & 1;
+        const auto cornerWeight = (db ? weight[0] : 1 - weight[0]) * (dg ? weight[1] : 1 - weight[1])
+            * (dr ? weight[2] : 1 - weight[2]);
+        result += node(lower[0] + db, lower[1] + dg, lower[2] + dr) * cornerWeight;
+    }
+    return result / 255.0f;
+}
+
+void ColorLut3D::apply(cv::Mat & image) const
+{
+    apply(image, image);
+}
+
+void ColorLut3D::apply(const cv::Mat & src, cv::Mat & dst) const
+{
+    PPP_STAGE_SCOPE("colorLut");
+    if (src.type() != CV_8UC3)
+    {
+        throw std::runtime_error("Colour LUTs only apply to BGR images");
+    }
+    if (!m_channelTable.empty())
+    {
+        cv::LUT(src, m_channelTable, dst);
+        return;
+    }
+    dst.create(src.size(), src.type());
+    const auto strideR = 1;
+    const auto strideG = m_gridSize;
+    const auto strideB = m_gridSize * m_gridSize;
+    const auto lerp = [](const cv::Vec3f & a, const cv::Vec3f & b, const float t) { return a + (b - a) * t; };
+
+    // Pixels are independent, rows are split across the OpenCV threads. Each pixel is read before it is written, so
+    // src and dst can be the same image
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range & rows) {
+        for (auto row = rows.start; row < rows.end; ++row)
+        {
+            auto pixel = src.ptr<uchar>(row);
+            auto out = dst.ptr<uchar>(row);
+            for (auto col = 0; col < src.cols; ++col, pixel += 3, out += 3)
+            {
+                const auto wb = m_weight[pixel[0]];
+                const auto wg = m_weight[pixel[1]];
+                const auto wr = m_weight[pixel[2]];
+                const auto n = &node(m_lowerNode[pixel[0]], m_lowerNode[pixel[1]], m_lowerNode[pixel[2]]);
+
+                const auto c00 = lerp(n[0], n[strideR], wr);
+                const auto c01 = lerp(n[strideG], n[strideG + strideR], wr);
+                const auto c10 = lerp(n[strideB], n[strideB + strideR], wr);
+                const auto c11 = lerp(n[strideB + strideG], n[strideB + strideG + strideR], wr);
+                const auto c = lerp(lerp(c00, c01, wg), lerp(c10, c11, wg), wb);
+
+                out[0] = cv::saturate_cast<uchar>(c[0]);
+                out[1] = cv::saturate_cast<uchar>(c[1]);
+                out[2] = cv::saturate_cast<uchar>(c[2]);
+            }
+        }
+    });
+}
+
+int ColorLut3D::gridSize() const
+{
+    return m_gridSize;
+}
+
+const cv::Vec3f & ColorLut3D::node(const int b, const int g, const int r) const
+{
+    return m_nodes[(b * m_gridSize + g) * m_gridSize + r];
+}
+
+void ColorLut3D::buildChannelTable()
+{
+    for (auto b = 0; b < m_gridSize; ++b)
+    {
+        for (auto g = 0; g < m_gridSize; ++g)
+        {
+            for (auto r = 0; r < m_gridSize; ++r)
+            {
+                const auto & n = node(b, g, r);
+                if (std::abs(n[0] - node(b, 0, 0)[0]) > SEPARABLE_TOLERANCE
+                    || std::abs(n[1] - node(0, g, 0)[1]) > SEPARABLE_TOLERANCE
+                    || std::abs(n[2] - node(0, 0, r)[2]) > SEPARABLE_TOLERANCE)
+                {
+                    return;
+                }
+            }
+        }
+    }
+    // Trilinear interpolation then reduces to a linear one along the axis of each channel
+    cv::Mat table(1, 256, CV_8UC3);
+    auto entry = table.ptr<cv::Vec3b>();
+    for (auto level = 0; level < 256; ++level)
+    {
+        const auto lower = m_lowerNode[level];
+        const auto weight = m_weight[level];
+        const cv::Vec3f low(node(lower, 0, 0)[0], node(0, lower, 0)[1], node(0, 0, lower)[2]);
+        const cv::Vec3f high(node(lower + 1, 0, 0)[0], node(0, lower + 1, 0)[1], node(0, 0, lower + 1)[2]);
+        const auto c = low + (high - low) * weight;
+        entry[level] = cv::Vec3b(
+            cv::saturate_cast<uchar>(c[0]), cv::saturate_cast<uchar>(c[1]), cv::saturate_cast<uchar>(c[2]));
+    }
+    m_channelTable = table;
+}
+} // namespace ppp
@@ -0,0 +1,102 @@
+#include "ColorProfileStore.h"
+#include "ColorLut3D.h"
+#include "ConfigLoader.h"
+#include "IccProfile.h"
+#include "StageMetrics.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+
+namespace ppp
+{
+void ColorProfileStore::registerProfile(const std::string & id, const std::string & iccData)
+{
+    const auto profile = IccProfile::fromData(iccData);
+    const auto begin = reinterpret_cast<const uint8_t *>(iccData.data());
+    const auto hash = Utilities::crc32(0, begin, begin + iccData.size());
+    const auto data = std::make_shared<const std::string>(iccData);
+
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    m_profiles[id] = { hash, data, profile };
+}
+
+bool ColorProfileStore::hasProfile(const std::string & id) const
+{
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    return m_profiles.find(id) != m_profiles.end();
+}
+
+ColorLut3DSPtr ColorProfileStore::printTransform(const std::string & id)
+{
+    Entry entry;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        const auto it = m_profiles.find(id);
+        if (it == m_profiles.end())
+        {
+            throw std::runtime_error("Unknown colour profile '" + id + "'");
+        }
+        entry = it->second;
+        if (const auto lut = findLut(entry))
+        {
+            return lut;
+        }
+    }
+
+    // Sampling the transform takes a few milliseconds, do it without holding the lock. Two requests racing for the
+    // same new profile both build it and the first one is kept
+    ColorLut3DSPtr lut;
+    {
+        PPP_STAGE_SCOPE("colorProfileLut");
+        lut = std::make_shared<ColorLut3D>(IccProfile::transformLut(*IccProfile::sRgb(), *entry.profile));
+    }
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    if (const auto cachedLut = findLut(entry))
+    {
+        return cachedLut;
+    }
+    m_luts.push_front({ entry.hash, entry.data, lut });
+    if (m_luts.size() > MAX_CACHED_LUTS)
+    {
+        m_luts.pop_back();
+    }
+    return lut;
+}
+
+ColorLut3DSPtr ColorProfileStore::findLut(const Entry & entry)
+{
+    // Different profiles can have the same CRC32, only the data tells them apart
+    const auto it = std::find_if(m_luts.begin(), m_luts.end(), [&entry](const CachedLut & cachedLut) {
+        return cachedLut.hash == entry.hash && *cachedLut.data == *entry.data;
+    });
+    if (it == m_luts.end())
+    {
+        return nullptr;
+    }
+    m_luts.splice(m_luts.begin(), m_luts, it);
+    return it->lut;
+}
+
+void ColorProfileStore::configureInternal(const ConfigLoaderSPtr & config)
+{
+    auto & rootConfig = config->get({});
+    if (rootConfig.HasMember("colorProfiles"))
+    {
+        for (const auto & member : config->get({ "colorProfiles" }).GetObject())
+        {
+            const std::string id = member.name.GetString();
+            config->loadResource({ "colorProfiles", id }, [this, id](const bool success, std::istream & stream) {
+                if (!success)
+                {
+                    throw std::runtime_error("Unable to load colour profile '" + id + "'");
+                }
+                registerProfile(id, std::string(std::istreambuf_iterator<char>(stream), {}));
+            });
+        }
+    }
+    m_isConfigured = true;
+}
+} // namespace ppp
@@ -1,6 +1,7 @@
 ﻿#include "CrownChinEstimator.h"
 #include "ConfigLoader.h"
 #include "LandMarks.h"
+#include "ParameterOverrides.h"
 #include "Utilities.h"
 
 namespace ppp
@@ -13,7 +14,7 @@ void CrownChinEstimator::configure(const ConfigLoaderSPtr & config)
     m_chinFrownCoeff = lipsDetectorCfg["chinFrownCoeff"].GetDouble();
 }
 
-bool CrownChinEstimator::estimateCrownChin(LandMarks & landMarks)
+bool CrownChinEstimator::estimateCrownChin(LandMarks & landMarks, const ParameterOverrides * overrides)
 {
     // Using normalized distance to be the sum of the distance between eye pupils and the distance mouth to frown
     // Distance chin to crown is estimated as 1.7699 of that value with correlation 0.7954
@@ -41,8 +42,12 @@ bool CrownChinEstimator::estimateCrownChin(LandMarks & landMarks)
     const auto normalizedDistancePixels = norm(landMarks.eyeLeftPupil - landMarks.eyeRightPupil)
         + norm(frownPointPix - mouthCenterPoint);
 
-    const auto chinFrownDistancePix = m_chinFrownCoeff * normalizedDistancePixels;
-    const auto chinCrownDistancePix = m_chinCrownCoeff * normalizedDistancePixels;
+    const auto chinFrownCoeff = overrides != nullptr ? overrides->chinFrownCoeff.value_or(m_chinFrownCoeff)
+                                                     : m_chinFrownCoeff;
+    const auto chinCrownCoeff = overrides != nullptr ? overrides->chinCrownCoeff.value_or(m_chinCrownCoeff)
+                                                     : m_chinCrownCoeff;
+    const auto chinFrownDistancePix = chinFrownCoeff * normalizedDistancePixels;
+    const auto chinCrownDistancePix = chinCrownCoeff * normalizedDistancePixels;
 
     if (landMarks.chinPoint == cv::Point())
     {
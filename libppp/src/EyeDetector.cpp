@@ -5,6 +5,7 @@
 #include <queue>
 
 #include "ConfigLoader.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
 
 using namespace std;
@@ -34,6 +35,7 @@ void EyeDetector::configureInternal(const ConfigLoaderSPtr & cfg)
 
 bool EyeDetector::detectLandMarks(const cv::Mat & grayImage, LandMarks & landMarks)
 {
+    PPP_STAGE_SCOPE("eyeDetection");
     const auto & faceRect = landMarks.vjFaceRect;
 
     if (faceRect.width <= 10 && faceRect.height <= 10)
@@ -1,6 +1,7 @@
 #include "FaceDetector.h"
 #include "ConfigLoader.h"
 #include "LandMarks.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
 
 #include <vector>
@@ -18,6 +19,7 @@ namespace ppp
 
 bool FaceDetector::detectLandMarks(const Mat & inputImage, LandMarks & landmarks)
 {
+    PPP_STAGE_SCOPE("faceDetection");
     // if (m_useDlibFaceDetection)
     //{
     //    using namespace dlib;
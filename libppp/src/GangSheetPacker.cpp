@@ -0,0 +1,51 @@
+#include "GangSheetPacker.h"
+
+namespace ppp
+{
+GangSheetPacker::GangSheetPacker(const cv::Size & sheetSize, const int gutter)
+: m_sheetSize(sheetSize)
+, m_gutter(gutter)
+{
+}
+
+bool GangSheetPacker::add(const size_t jobIndex, const cv::Size & tileSize)
+{
+    for (auto & shelf : m_shelves)
+    {
+        const auto x = shelf.usedWidth > 0 ? shelf.usedWidth + m_gutter : 0;
+        if (tileSize.height <= shelf.height && x + tileSize.width <= m_sheetSize.width)
+        {
+            m_currentSheet.push_back({ jobIndex, cv::Rect(cv::Point(x, shelf.y), tileSize) });
+            shelf.usedWidth = x + tileSize.width;
+            return true;
+        }
+    }
+
+    const auto y = m_shelves.empty() ? 0 : m_shelves.back().y + m_shelves.back().height + m_gutter;
+    if (y + tileSize.height > m_sheetSize.height || tileSize.width > m_sheetSize.width)
+    {
+        return false;
+    }
+    m_shelves.push_back({ y, tileSize.height, tileSize.width });
+    m_currentSheet.push_back({ jobIndex, cv::Rect(cv::Point(0, y), tileSize) });
+    return true;
+}
+
+bool GangSheetPacker::fitsInSheet(const cv::Size & tileSize) const
+{
+    return tileSize.width <= m_sheetSize.width && tileSize.height <= m_sheetSize.height;
+}
+
+GangSheet GangSheetPacker::takeSheet()
+{
+    m_shelves.clear();
+    GangSheet sheet;
+    sheet.swap(m_currentSheet);
+    return sheet;
+}
+
+bool GangSheetPacker::empty() const
+{
+    return m_currentSheet.empty();
+}
+} // namespace ppp
@@ -0,0 +1,251 @@
+#include "IccProfile.h"
+#include "ColorLut3D.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace ppp
+{
+namespace
+{
+constexpr auto ICC_HEADER_SIZE = 128;
+
+/*!@brief Big endian reader over the profile bytes, all reads are bounds checked !*/
+class IccReader final
+{
+public:
+    explicit IccReader(const std::string & data)
+    : m_data(data)
+    {
+    }
+
+    uint32_t u32(const size_t offset) const
+    {
+        check(offset, 4);
+        const auto p = reinterpret_cast<const uint8_t *>(m_data.data()) + offset;
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+    }
+
+    uint16_t u16(const size_t offset) const
+    {
+        check(offset, 2);
+        const auto p = reinterpret_cast<const uint8_t *>(m_data.data()) + offset;
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    double s15Fixed16(const size_t offset) const
+    {
+        return static_cast<int32_t>(u32(offset)) / 65536.0;
+    }
+
+    std::string signature(const size_t offset) const
+    {
+        check(offset, 4);
+        return m_data.substr(offset, 4);
+    }
+
+private:
+    void check(const size_t offset, const size_t length) const
+    {
+        if (offset + length > m_data.size())
+        {
+            throw std::runtime_error("Truncated ICC profile");
+        }
+    }
+
+    const std::string & m_data;
+};
+
+cv::Vec3d readXyzTag(const IccReader & reader, const size_t offset)
+{
+    if (reader.signature(offset) != "XYZ ")
+    {
+        throw std::runtime_error("Invalid XYZ tag in ICC profile");
+    }
+    return cv::Vec3d(reader.s15Fixed16(offset + 8), reader.s15Fixed16(offset + 12), reader.s15Fixed16(offset + 16));
+}
+} // namespace
+
+double IccProfile::ToneCurve::eval(double x) const
+{
+    x = std::clamp(x, 0.0, 1.0);
+    if (!table.empty())
+    {
+        const auto position = x * (table.size() - 1);
+        const auto lower = std::min(static_cast<size_t>(position), table.size() - 2);
+        const auto weight = position - lower;
+        return table[lower] + (table[lower + 1] - table[lower]) * weight;
+    }
+
+    const auto g = params[0], a = params[1], b = params[2], c = params[3], d = params[4], e = params[5],
+               f = params[6];
+    double y;
+    switch (parametricType)
+    {
+        case 0:
+            y = std::pow(x, g);
+            break;
+        case 1:
+            y = x >= -b / a ? std::pow(a * x + b, g) : 0.0;
+            break;
+        case 2:
+            y = x >= -b / a ? std::pow(a * x + b, g) + c : c;
+            break;
+        case 3:
+            y = x >= d ? std::pow(a * x + b, g) : c * x;
+            break;
+        default:
+            y = x >= d ? std::pow(a * x + b, g) + e : c * x + f;
+            break;
+    }
+    return std::clamp(y, 0.0, 1.0);
+}
+
+double IccProfile::ToneCurve::inverse(const double y) const
+{
+    auto low = 0.0, high = 1.0;
+    for (auto i = 0; i < 32; ++i)
+    {
+        const auto mid = (low + high) / 2.0;
+        if (eval(mid) < y)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+IccProfileSPtr IccProfile::fromData(const std::string & iccData)
+{
+    const IccReader reader(iccData);
+    if (iccData.size() < ICC_HEADER_SIZE + 4 || reader.signature(36) != "acsp")
+    {
+        throw std::runtime_error("Not an ICC profile");
+    }
+    if (reader.signature(16) != "RGB ")
+    {
+        throw std::runtime_error("Only RGB colour profiles are supported");
+    }
+    if (reader.signature(20) != "XYZ ")
+    {
+        throw std::runtime_error("Only colour profiles with an XYZ connection space are supported");
+    }
+
+    std::map<std::string, size_t> tagOffsets;
+    const auto tagCount = reader.u32(ICC_HEADER_SIZE);
+    for (uint32_t i = 0; i < tagCount; ++i)
+    {
+        const auto entry = ICC_HEADER_SIZE + 4 + 12 * static_cast<size_t>(i);
+        tagOffsets[reader.signature(entry)] = reader.u32(entry + 4);
+    }
+    for (const auto & tag : { "rXYZ", "gXYZ", "bXYZ", "rTRC", "gTRC", "bTRC" })
+    {
+        if (tagOffsets.find(tag) == tagOffsets.end())
+        {
+            throw std::runtime_error("Only matrix/TRC colour profiles are supported, lookup table ones are not");
+        }
+    }
+
+    auto profile = std::make_shared<IccProfile>();
+    const auto red = readXyzTag(reader, tagOffsets["rXYZ"]);
+    const auto green = readXyzTag(reader, tagOffsets["gXYZ"]);
+    const auto blue = readXyzTag(reader, tagOffsets["bXYZ"]);
+    profile->m_toPcs = cv::Matx33d(red[0], green[0], blue[0], red[1], green[1], blue[1], red[2], green[2], blue[2]);
+    if (std::abs(cv::determinant(profile->m_toPcs)) < 1e-9)
+    {
+        throw std::runtime_error("Colour profile primaries are degenerate");
+    }
+    profile->m_fromPcs = profile->m_toPcs.inv();
+
+    const char * trcTags[3] = { "rTRC", "gTRC", "bTRC" };
+    for (auto channel = 0; channel < 3; ++channel)
+    {
+        const auto offset = tagOffsets[trcTags[channel]];
+        auto & curve = profile->m_curves[channel];
+        const auto type = reader.signature(offset);
+        if (type == "curv")
+        {
+            const auto count = reader.u32(offset + 8);
+            if (count == 1)
+            {
+                curve.params[0] = reader.u16(offset + 12) / 256.0;
+            }
+            for (uint32_t i = 0; count > 1 && i < count; ++i)
+            {
+                curve.table.push_back(reader.u16(offset + 12 + 2 * static_cast<size_t>(i)) / 65535.0);
+            }
+        }
+        else if (type == "para")
+        {
+            static const int NUM_PARAMS[5] = { 1, 3, 4, 5, 7 };
+            curve.parametricType = reader.u16(offset + 8);
+            if (curve.parametricType > 4)
+            {
+                throw std::runtime_error("Unknown parametric curve in colour profile");
+            }
+            for (auto i = 0; i < NUM_PARAMS[curve.parametricType]; ++i)
+            {
+                curve.params[i] = reader.s15Fixed16(offset + 12 + 4 * static_cast<size_t>(i));
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Unsupported tone curve type '" + type + "' in colour profile");
+        }
+    }
+    return profile;
+}
+
+IccProfileSPtr IccProfile::sRgb()
+{
+    static const auto profile = []() {
+        // sRGB primaries adapted to D50 and the sRGB transfer function, as in the profiles shipped with most systems
+        auto p = std::make_shared<IccProfile>();
+        p->m_toPcs = cv::Matx33d(0.4360747, 0.3850649, 0.1430804, 0.2225045, 0.7168786, 0.0606169, 0.0139322,
+                                 0.0971045, 0.7141733);
+        p->m_fromPcs = p->m_toPcs.inv();
+        for (auto & curve : p->m_curves)
+        {
+            curve.parametricType = 3;
+            const double params[5] = { 2.4, 1.0 / 1.055, 0.055 / 1.055, 1.0 / 12.92, 0.04045 };
+            std::copy(params, params + 5, curve.params);
+        }
+        return p;
+    }();
+    return profile;
+}
+
+cv::Vec3d IccProfile::toPcs(const cv::Vec3d & rgb) const
+{
+    const cv::Vec3d linear(m_curves[0].eval(rgb[0]), m_curves[1].eval(rgb[1]), m_curves[2].eval(rgb[2]));
+    return m_toPcs * linear;
+}
+
+cv::Vec3d IccProfile::fromPcs(const cv::Vec3d & xyz) const
+{
+    const cv::Vec3d linear = m_fromPcs * xyz;
+    cv::Vec3d rgb;
+    for (auto channel = 0; channel < 3; ++channel)
+    {
+        rgb[channel] = m_curves[channel].inverse(std::clamp(linear[channel], 0.0, 1.0));
+    }
+    return rgb;
+}
+
+ColorLut3D IccProfile::transformLut(const IccProfile & source, const IccProfile & destination, const int gridSize)
+{
+    return ColorLut3D::fromTransform(
+        [&source, &destination](const cv::Vec3f & bgr) {
+            const auto rgb = destination.fromPcs(source.toPcs(cv::Vec3d(bgr[2], bgr[1], bgr[0])));
+            return cv::Vec3f(static_cast<float>(rgb[2]), static_cast<float>(rgb[1]), static_cast<float>(rgb[0]));
+        },
+        gridSize);
+}
+} // namespace ppp
@@ -0,0 +1,169 @@
+#include "ImageHeader.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace ppp
+{
+namespace
+{
+uint32_t readBigEndian16(const BYTE * p)
+{
+    return static_cast<uint32_t>(p[0]) << 8 | p[1];
+}
+
+uint32_t readBigEndian32(const BYTE * p)
+{
+    return readBigEndian16(p) << 16 | readBigEndian16(p + 2);
+}
+
+uint32_t readLittleEndian16(const BYTE * p)
+{
+    return static_cast<uint32_t>(p[1]) << 8 | p[0];
+}
+
+uint32_t readLittleEndian24(const BYTE * p)
+{
+    return static_cast<uint32_t>(p[2]) << 16 | readLittleEndian16(p);
+}
+
+uint32_t readLittleEndian32(const BYTE * p)
+{
+    return readLittleEndian16(p + 2) << 16 | readLittleEndian16(p);
+}
+
+bool setSize(ImageHeader & header, const ImageHeader::Format format, const int64_t width, const int64_t height)
+{
+    if (width <= 0 || height <= 0 || width > INT32_MAX || height > INT32_MAX)
+    {
+        return false;
+    }
+    header.format = format;
+    header.size = cv::Size(static_cast<int>(width), static_cast<int>(height));
+    return true;
+}
+
+bool readJpegHeader(const BYTE * data, const size_t length, ImageHeader & header)
+{
+    // Segments up to the frame header, whichever the coding process (baseline, progressive, lossless ...)
+    size_t offset = 2;
+    while (offset + 4 <= length)
+    {
+        if (data[offset] != 0xFF)
+        {
+            return false;
+        }
+        const auto marker = data[offset + 1];
+        if (marker == 0xFF)
+        {
+            ++offset; // Fill byte
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            offset += 2; // Markers without a segment
+            continue;
+        }
+        const auto segmentLength = readBigEndian16(data + offset + 2);
+        const auto isFrameHeader = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8
+            && marker != 0xCC;
+        if (isFrameHeader)
+        {
+            // Sample precision, then the number of lines and samples per line
+            return segmentLength >= 8 && offset + 9 <= length
+                && setSize(header,
+                           ImageHeader::Format::JPEG,
+                           readBigEndian16(data + offset + 7),
+                           readBigEndian16(data + offset + 5));
+        }
+        if (marker == 0xDA || marker == 0xD9 || segmentLength < 2)
+        {
+            // Scan or end of image without a frame header
+            return false;
+        }
+        offset += 2 + segmentLength;
+    }
+    return false;
+}
+
+bool readPngHeader(const BYTE * data, const size_t length, ImageHeader & header)
+{
+    // The IHDR chunk comes first, right after the signature
+    return length >= 24 && std::memcmp(data + 12, "IHDR", 4) == 0
+        && setSize(header, ImageHeader::Format::PNG, readBigEndian32(data + 16), readBigEndian32(data + 20));
+}
+
+bool readBmpHeader(const BYTE * data, const size_t length, ImageHeader & header)
+{
+    if (length < 26)
+    {
+        return false;
+    }
+    if (readLittleEndian32(data + 14) == 12)
+    {
+        // OS/2 core header with 16 bit dimensions
+        return setSize(header, ImageHeader::Format::BMP, readLittleEndian16(data + 18), readLittleEndian16(data + 20));
+    }
+    // The height is negative for top-down bitmaps
+    const auto width = static_cast<int32_t>(readLittleEndian32(data + 18));
+    const auto height = static_cast<int32_t>(readLittleEndian32(data + 22));
+    return setSize(header, ImageHeader::Format::BMP, width, std::abs(static_cast<int64_t>(height)));
+}
+
+bool readWebpHeader(const BYTE * data, const size_t length, ImageHeader & header)
+{
+    if (length < 30)
+    {
+        return false;
+    }
+    const auto chunk = data + 12;
+    if (std::memcmp(chunk, "VP8 ", 4) == 0)
+    {
+        // Lossy bitstream, dimensions follow the frame tag and the start code
+        return data[23] == 0x9D && data[24] == 0x01 && data[25] == 0x2A
+            && setSize(header,
+                       ImageHeader::Format::WEBP,
+                       readLittleEndian16(data + 26) & 0x3FFF,
+                       readLittleEndian16(data + 28) & 0x3FFF);
+    }
+    if (std::memcmp(chunk, "VP8L", 4) == 0)
+    {
+        // Lossless bitstream, 14 bit dimensions minus one after the signature byte
+        const auto bits = readLittleEndian32(data + 21);
+        return data[20] == 0x2F
+            && setSize(header, ImageHeader::Format::WEBP, (bits & 0x3FFF) + 1, ((bits >> 14) & 0x3FFF) + 1);
+    }
+    if (std::memcmp(chunk, "VP8X", 4) == 0)
+    {
+        // Extended format, 24 bit canvas dimensions minus one after the flags
+        return setSize(
+            header, ImageHeader::Format::WEBP, readLittleEndian24(data + 24) + 1, readLittleEndian24(data + 27) + 1);
+    }
+    return false;
+}
+} // namespace
+
+bool ImageHeader::read(const BYTE * data, const size_t length, ImageHeader & header)
+{
+    header = ImageHeader();
+    static const BYTE PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (length >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+    {
+        return readJpegHeader(data, length, header);
+    }
+    if (length >= sizeof(PNG_SIGNATURE) && std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+    {
+        return readPngHeader(data, length, header);
+    }
+    if (length >= 2 && data[0] == 'B' && data[1] == 'M')
+    {
+        return readBmpHeader(data, length, header);
+    }
+    if (length >= 12 && std::memcmp(data, "RIFF", 4) == 0 && std::memcmp(data + 8, "WEBP", 4) == 0)
+    {
+        return readWebpHeader(data, length, header);
+    }
+    return false;
+}
+} // namespace ppp
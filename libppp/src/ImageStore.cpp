@@ -1,17 +1,95 @@
 
 #include <iomanip>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
 #include <regex>
 
 #include "EasyExif.h"
 #include "ConfigLoader.h"
+#include "ImageHeader.h"
 #include "ImageStore.h"
+#include "JpegLosslessCrop.h"
 #include "LandMarks.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
 
 namespace ppp
 {
-std::string ImageStore::storeImageData(const cv::Mat & image, const easyexif::EXIFInfoSPtr & exifInfo)
+namespace
+{
+// Reduced decoding modes, JPEG decoders scale down in the DCT domain, skipping most of the inverse DCT work
+const std::vector<std::pair<int, int>> REDUCED_DECODE_MODES = { { 8, cv::IMREAD_REDUCED_COLOR_8 },
+                                                                { 4, cv::IMREAD_REDUCED_COLOR_4 },
+                                                                { 2, cv::IMREAD_REDUCED_COLOR_2 } };
+
+int decodeFlagsOf(const int decodeScale)
+{
+    for (const auto & mode : REDUCED_DECODE_MODES)
+    {
+        if (mode.first == decodeScale)
+        {
+            return mode.second;
+        }
+    }
+    return cv::IMREAD_COLOR;
+}
+
+// Crops the JPEG file to the MCUs covering the region before decoding it, so that only the blocks of the region go
+// through the inverse DCT and the entropy coded rows below it are not read. Returns an empty image when the file
+// can not be cropped, else the decoded pixels whose top left corner is at origin in the file
+cv::Mat decodeJpegRegion(const std::vector<BYTE> & jpeg,
+                         const cv::Rect & region,
+                         const int decodeFlags,
+                         cv::Point & origin)
+{
+    JpegFrameInfo frameInfo;
+    if (!JpegLosslessCrop::readFrameInfo(jpeg, frameInfo))
+    {
+        return cv::Mat();
+    }
+    // The decoder turns rotated pictures upright, the region is not in the coordinates of the file
+    easyexif::EXIFInfo exifInfo;
+    if (exifInfo.parseFrom(jpeg.data(), static_cast<unsigned>(jpeg.size())) == PARSE_EXIF_SUCCESS
+        && exifInfo.Orientation > 1)
+    {
+        return cv::Mat();
+    }
+    const auto regionInFile = region & cv::Rect(cv::Point(), frameInfo.size);
+    if (regionInFile.empty())
+    {
+        return cv::Mat();
+    }
+    const auto & mcuSize = frameInfo.mcuSize;
+    origin = cv::Point(regionInFile.x - regionInFile.x % mcuSize.width,
+                       regionInFile.y - regionInFile.y % mcuSize.height);
+    std::vector<BYTE> croppedJpeg;
+    if (!JpegLosslessCrop::crop(jpeg, cv::Rect(origin, regionInFile.br()), croppedJpeg))
+    {
+        return cv::Mat();
+    }
+    return cv::imdecode(croppedJpeg, decodeFlags);
+}
+
+// Users of the landmarks get their own copy, the store only keeps them packed
+LandMarksSPtr unpackLandMarks(const std::string & imageKey,
+                              const LandMarksRecord & record,
+                              const LandMarksContoursSPtr & lipContours)
+{
+    auto landMarks = std::make_shared<LandMarks>();
+    landMarks->imageKey = imageKey;
+    record.toLandMarks(*landMarks);
+    if (lipContours != nullptr)
+    {
+        lipContours->toLandMarks(*landMarks);
+    }
+    return landMarks;
+}
+} // namespace
+
+std::string ImageStore::storeImageData(const cv::Mat & image,
+                                       const easyexif::EXIFInfoSPtr & exifInfo,
+                                       const EncodedImageSPtr & encodedImage,
+                                       const int decodeScale)
 {
     const auto crc32val = Utilities::crc32(0, image.datastart, image.dataend);
     std::stringstream s;
@@ -19,9 +97,42 @@ std::string ImageStore::storeImageData(const cv::Mat & image, const easyexif::EX
     const auto && imageKey = s.str();
 
     {
-        std::lock_guard<std::mutex> lg(m_mutex);
-        const auto it = m_imageKeyOrder.insert(m_imageKeyOrder.end(), imageKey);
-        m_imageCollection[imageKey] = ImageData { image, exifInfo, std::make_shared<LandMarks>(), it };
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        if (encodedImage && m_encodedCollection.find(imageKey) == m_encodedCollection.end())
+        {
+            const auto it = m_encodedKeyOrder.insert(m_encodedKeyOrder.end(), imageKey);
+            m_encodedCollection[imageKey] = EncodedImageData { encodedImage, image.size(), decodeScale, it };
+            m_encodedBytesInUse += encodedImage->size();
+        }
+        if (m_imageCollection.find(imageKey) != m_imageCollection.end())
+        {
+            // Same pixels already in the store, keep the landmarks detected so far
+            boostImageToTopCache(imageKey);
+            return imageKey;
+        }
+    }
+
+    ImageData imageData;
+    imageData.exifInfo = exifInfo;
+    imageData.perceptualHash = m_maxHammingDistance >= 0 ? Utilities::perceptualHash(image) : 0;
+    if (m_planarStorage)
+    {
+        Utilities::splitLumaChroma(image, imageData.luma, imageData.chroma);
+    }
+    else
+    {
+        imageData.image = image;
+    }
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        // Another thread may have stored the same pixels while these were prepared, its landmarks are kept
+        if (m_imageCollection.find(imageKey) != m_imageCollection.end())
+        {
+            boostImageToTopCache(imageKey);
+            return imageKey;
+        }
+        imageData.storeListOrder = m_imageKeyOrder.insert(m_imageKeyOrder.end(), imageKey);
+        m_imageCollection.emplace(imageKey, std::move(imageData));
     }
 
     handleStoreSize();
@@ -39,6 +150,50 @@ easyexif::EXIFInfoSPtr ImageStore::decodeExifInfo(const BYTE * bufferData, const
     return exifInfo;
 }
 
+cv::Mat ImageStore::decodeImage(const BYTE * bufferData, const size_t bufferLength, int & decodeScale) const
+{
+    decodeScale = 1;
+    if (m_maxEncodedBytes > 0 && bufferLength > m_maxEncodedBytes)
+    {
+        throw std::runtime_error("Image of " + std::to_string(bufferLength) + " bytes exceeds the limit of "
+                                 + std::to_string(m_maxEncodedBytes) + " bytes");
+    }
+    const auto checkPixels = [this](const cv::Size & size) {
+        if (m_maxPixels > 0 && static_cast<uint64_t>(size.width) * size.height > m_maxPixels)
+        {
+            throw std::runtime_error("Image of " + std::to_string(size.width) + "x" + std::to_string(size.height)
+                                     + " pixels exceeds the limit of " + std::to_string(m_maxPixels) + " pixels");
+        }
+    };
+    // The decoder allocates the image from the dimensions in the header, check them first when the format is known
+    ImageHeader header;
+    const auto hasHeader
+        = (m_maxPixels > 0 || m_maxDecodedPixels > 0) && ImageHeader::read(bufferData, bufferLength, header);
+    if (hasHeader)
+    {
+        checkPixels(header.size);
+        const auto numPixels = static_cast<uint64_t>(header.size.width) * header.size.height;
+        if (m_maxDecodedPixels > 0)
+        {
+            while (decodeScale < REDUCED_DECODE_MODES.front().first
+                   && numPixels > static_cast<uint64_t>(m_maxDecodedPixels) * decodeScale * decodeScale)
+            {
+                decodeScale *= 2;
+            }
+        }
+    }
+
+    PPP_STAGE_SCOPE("decode");
+    const cv::_InputArray inputArray(bufferData, static_cast<int>(bufferLength));
+    auto image = imdecode(inputArray, decodeFlagsOf(decodeScale));
+    if (!hasHeader)
+    {
+        // Other formats (PPM, Sun raster, JPEG 2000 ...) are only bounded by maxEncodedBytes while decoding
+        checkPixels(image.size());
+    }
+    return image;
+}
+
 std::string ImageStore::setImage(const std::string & imageFilePath)
 {
     std::ifstream file(imageFilePath, std::ios::binary);
@@ -50,6 +205,8 @@ std::string ImageStore::setImage(const char * bufferData, const size_t bufferLen
 {
     cv::Mat inputImage;
     easyexif::EXIFInfoSPtr exifInfo;
+    EncodedImageSPtr encodedImage;
+    auto decodeScale = 1;
 
     if (bufferLength <= 0)
     {
@@ -65,53 +222,411 @@ std::string ImageStore::setImage(const char * bufferData, const size_t bufferLen
             dataLen -= offset;
         }
 
+        // Checked before decoding the base64 text too, it holds 3 bytes per 4 characters
+        if (m_maxEncodedBytes > 0 && dataLen / 4 * 3 > m_maxEncodedBytes)
+        {
+            throw std::runtime_error("Image of " + std::to_string(dataLen / 4 * 3) + " bytes exceeds the limit of "
+                                     + std::to_string(m_maxEncodedBytes) + " bytes");
+        }
         auto decodedBytes = Utilities::base64Decode(bufferData + offset, dataLen);
         const auto decodedBytesSize = static_cast<int>(decodedBytes.size());
-        const cv::_InputArray inputArray(decodedBytes.data(), decodedBytesSize);
-        inputImage = imdecode(inputArray, cv::IMREAD_COLOR);
+        inputImage = decodeImage(decodedBytes.data(), decodedBytes.size(), decodeScale);
         exifInfo = decodeExifInfo(decodedBytes.data(), decodedBytesSize);
+        if (m_encodedStoreBytes > 0)
+        {
+            encodedImage = std::make_shared<const std::vector<BYTE>>(std::move(decodedBytes));
+        }
     }
     else
     {
-        const cv::_InputArray inputArray(bufferData, static_cast<int>(bufferLength));
-        inputImage = imdecode(inputArray, cv::IMREAD_COLOR);
-        exifInfo = decodeExifInfo(reinterpret_cast<const unsigned char *>(bufferData), bufferLength);
+        const auto bytes = reinterpret_cast<const BYTE *>(bufferData);
+        inputImage = decodeImage(bytes, bufferLength, decodeScale);
+        exifInfo = decodeExifInfo(bytes, bufferLength);
+        if (m_encodedStoreBytes > 0)
+        {
+            encodedImage = std::make_shared<const std::vector<BYTE>>(bytes, bytes + bufferLength);
+        }
     }
-    return storeImageData(inputImage, exifInfo);
+    return storeImageData(inputImage, exifInfo, encodedImage, decodeScale);
+}
+
+std::string ImageStore::setImage(const cv::Mat & image)
+{
+    if (image.type() != CV_8UC3 || !image.isContinuous())
+    {
+        throw std::runtime_error("Only continuous BGR images can be stored in place");
+    }
+    return storeImageData(image);
 }
 
 bool ImageStore::containsImage(const std::string & imageKey)
 {
-    std::lock_guard<std::mutex> lg(m_mutex);
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
     boostImageToTopCache(imageKey);
     return m_imageCollection.find(imageKey) != m_imageCollection.end();
 }
 
 cv::Mat ImageStore::getImage(const std::string & imageKey)
 {
-    std::lock_guard<std::mutex> lg(m_mutex);
-    boostImageToTopCache(imageKey);
-    return m_imageCollection[imageKey].image;
+    cv::Mat luma, chroma;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        boostImageToTopCache(imageKey);
+        const auto it = m_imageCollection.find(imageKey);
+        if (it == m_imageCollection.end())
+        {
+            return cv::Mat();
+        }
+        const auto & imageData = it->second;
+        if (imageData.luma.empty())
+        {
+            return imageData.image;
+        }
+        luma = imageData.luma;
+        chroma = imageData.chroma;
+    }
+    return Utilities::mergeLumaChroma(luma, chroma);
+}
+
+cv::Mat ImageStore::getLumaImage(const std::string & imageKey)
+{
+    cv::Mat image;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        boostImageToTopCache(imageKey);
+        const auto it = m_imageCollection.find(imageKey);
+        if (it == m_imageCollection.end())
+        {
+            return cv::Mat();
+        }
+        const auto & imageData = it->second;
+        if (!imageData.luma.empty())
+        {
+            return imageData.luma;
+        }
+        image = imageData.image;
+    }
+    cv::Mat grayImage;
+    cvtColor(image, grayImage, cv::COLOR_BGR2GRAY);
+    return grayImage;
+}
+
+cv::Mat ImageStore::getImageRegion(const std::string & imageKey, const cv::Rect & region)
+{
+    cv::Mat image, luma, chroma;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        boostImageToTopCache(imageKey);
+        const auto it = m_imageCollection.find(imageKey);
+        if (it == m_imageCollection.end())
+        {
+            return cv::Mat();
+        }
+        const auto & imageData = it->second;
+        image = imageData.image;
+        luma = imageData.luma;
+        chroma = imageData.chroma;
+    }
+
+    const auto imageSize = luma.empty() ? image.size() : luma.size();
+    const auto regionInImage = region & cv::Rect(cv::Point(), imageSize);
+    if (luma.empty() && regionInImage == region)
+    {
+        return image(region);
+    }
+
+    cv::Mat result(region.size(), CV_8UC3, cv::Scalar::all(0));
+    if (regionInImage.area() <= 0)
+    {
+        return result;
+    }
+    const auto target = result(regionInImage - region.tl());
+    if (luma.empty())
+    {
+        image(regionInImage).copyTo(target);
+        return result;
+    }
+
+    // Upsample the chroma of the region only, with one extra chroma pixel around for the interpolation
+    const cv::Point chromaTopLeft(regionInImage.x / 2 - 1, regionInImage.y / 2 - 1);
+    const cv::Point chromaBottomRight((regionInImage.br().x + 1) / 2 + 1, (regionInImage.br().y + 1) / 2 + 1);
+    const auto chromaRegion = cv::Rect(chromaTopLeft, chromaBottomRight) & cv::Rect(cv::Point(), chroma.size());
+    const cv::Mat regionLuma = luma(regionInImage);
+    cv::Mat upsampledChroma;
+    cv::resize(chroma(chromaRegion), upsampledChroma, chromaRegion.size() * 2, 0, 0, cv::INTER_LINEAR);
+    const cv::Rect lumaInUpsampled(regionInImage.tl() - chromaRegion.tl() * 2, regionInImage.size());
+
+    const cv::Mat planes[] = { regionLuma, upsampledChroma(lumaInUpsampled) };
+    cv::Mat yCrCbRegion(regionInImage.size(), CV_8UC3);
+    const int fromTo[] = { 0, 0, 1, 1, 2, 2 };
+    cv::mixChannels(planes, 2, &yCrCbRegion, 1, fromTo, 3);
+    cvtColor(yCrCbRegion, target, cv::COLOR_YCrCb2BGR);
+    return result;
+}
+
+cv::Size ImageStore::getImageSize(const std::string & imageKey)
+{
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    const auto it = m_imageCollection.find(imageKey);
+    if (it == m_imageCollection.end())
+    {
+        return cv::Size();
+    }
+    const auto & imageData = it->second;
+    return imageData.luma.empty() ? imageData.image.size() : imageData.luma.size();
+}
+
+bool ImageStore::isPlanarStorage()
+{
+    return m_planarStorage;
+}
+
+void ImageStore::setPlanarStorage(const bool planarStorage)
+{
+    m_planarStorage = planarStorage;
 }
 
 LandMarksSPtr ImageStore::getLandMarks(const std::string & imageKey)
 {
-    std::lock_guard<std::mutex> lg(m_mutex);
-    boostImageToTopCache(imageKey);
-    return m_imageCollection[imageKey].landMarks;
+    // Only the packed record is copied under the lock, it is unpacked once the lock is released
+    LandMarksRecord record;
+    LandMarksContoursSPtr lipContours;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        boostImageToTopCache(imageKey);
+        const auto it = m_imageCollection.find(imageKey);
+        if (it == m_imageCollection.end())
+        {
+            return nullptr;
+        }
+        record = it->second.landMarks;
+        lipContours = it->second.lipContours;
+    }
+    return unpackLandMarks(imageKey, record, lipContours);
+}
+
+void ImageStore::setLandMarks(const std::string & imageKey, const LandMarks & landMarks)
+{
+    const auto record = LandMarksRecord::fromLandMarks(landMarks);
+    const auto lipContours = LandMarksContours::fromLandMarks(landMarks);
+
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    const auto it = m_imageCollection.find(imageKey);
+    if (it != m_imageCollection.end())
+    {
+        it->second.landMarks = record;
+        it->second.lipContours = lipContours;
+    }
 }
 
 easyexif::EXIFInfoSPtr ImageStore::getExifInfo(const std::string & imageKey)
 {
-    std::lock_guard<std::mutex> lg(m_mutex);
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
     boostImageToTopCache(imageKey);
-    return m_imageCollection[imageKey].exifInfo;
+    const auto it = m_imageCollection.find(imageKey);
+    return it == m_imageCollection.end() ? nullptr : it->second.exifInfo;
+}
+
+LandMarksSPtr ImageStore::findSimilarImage(const std::string & imageKey, cv::Size & similarImageSize)
+{
+    std::string bestKey;
+    LandMarksRecord record;
+    LandMarksContoursSPtr lipContours;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        const auto it = m_imageCollection.find(imageKey);
+        if (m_maxHammingDistance < 0 || it == m_imageCollection.end())
+        {
+            return nullptr;
+        }
+
+        const std::pair<const std::string, ImageData> * bestMatch = nullptr;
+        auto bestDistance = m_maxHammingDistance + 1;
+        for (const auto & kv : m_imageCollection)
+        {
+            const auto & imageData = kv.second;
+            if (kv.first == imageKey || imageData.landMarks.numShapePoints == 0)
+            {
+                continue;
+            }
+            const auto distance = Utilities::hammingDistance(it->second.perceptualHash, imageData.perceptualHash);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                bestMatch = &kv;
+            }
+        }
+        if (bestMatch == nullptr)
+        {
+            return nullptr;
+        }
+        // Copied under the lock, the match can be evicted as soon as it is released
+        const auto & matchData = bestMatch->second;
+        similarImageSize = matchData.luma.empty() ? matchData.image.size() : matchData.luma.size();
+        bestKey = bestMatch->first;
+        record = matchData.landMarks;
+        lipContours = matchData.lipContours;
+    }
+    return unpackLandMarks(bestKey, record, lipContours);
+}
+
+bool ImageStore::containsEncodedImage(const std::string & imageKey)
+{
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    return m_encodedCollection.find(imageKey) != m_encodedCollection.end();
+}
+
+int ImageStore::getDecodeScale(const std::string & imageKey)
+{
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    const auto it = m_encodedCollection.find(imageKey);
+    return it == m_encodedCollection.end() ? 1 : it->second.decodeScale;
+}
+
+EncodedImageSPtr ImageStore::getEncodedImage(const std::string & imageKey)
+{
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    const auto it = m_encodedCollection.find(imageKey);
+    if (it == m_encodedCollection.end())
+    {
+        return nullptr;
+    }
+    boostEncodedImageToTopCache(imageKey);
+    return it->second.bytes;
+}
+
+cv::Mat ImageStore::getProxyImage(const std::string & imageKey, double & scale)
+{
+    cv::Mat image, luma, chroma;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        boostImageToTopCache(imageKey);
+        const auto it = m_imageCollection.find(imageKey);
+        if (it == m_imageCollection.end())
+        {
+            scale = 1.0;
+            return cv::Mat();
+        }
+        const auto & imageData = it->second;
+        image = imageData.image;
+        luma = imageData.luma;
+        chroma = imageData.chroma;
+        if (!imageData.proxyImage.empty())
+        {
+            scale = static_cast<double>(imageData.proxyImage.cols) / std::max(image.cols, luma.cols);
+            return imageData.proxyImage;
+        }
+    }
+
+    const auto imageSize = luma.empty() ? image.size() : luma.size();
+    scale = std::min(1.0, static_cast<double>(m_proxyMaxSize) / std::max(imageSize.width, imageSize.height));
+    if (scale >= 1.0 && luma.empty())
+    {
+        return image;
+    }
+
+    const cv::Size proxySize(roundInteger(imageSize.width * scale), roundInteger(imageSize.height * scale));
+    cv::Mat proxyImage;
+    if (luma.empty())
+    {
+        cv::resize(image, proxyImage, proxySize, 0, 0, cv::INTER_AREA);
+    }
+    else
+    {
+        cv::Mat proxyLuma;
+        cv::resize(luma, proxyLuma, proxySize, 0, 0, cv::INTER_AREA);
+        proxyImage = Utilities::mergeLumaChroma(proxyLuma, chroma);
+    }
+    scale = static_cast<double>(proxyImage.cols) / imageSize.width;
+
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
+    const auto it = m_imageCollection.find(imageKey);
+    if (it != m_imageCollection.end())
+    {
+        it->second.proxyImage = proxyImage;
+    }
+    return proxyImage;
+}
+
+cv::Mat ImageStore::decodeImageRegion(const std::string & imageKey,
+                                      const cv::Rect & region,
+                                      const double maxDownscale,
+                                      double & scale)
+{
+    EncodedImageSPtr encodedImage;
+    cv::Size imageSize;
+    auto storedDecodeScale = 1;
+    {
+        std::lock_guard<InstrumentedMutex> lg(m_mutex);
+        const auto it = m_encodedCollection.find(imageKey);
+        if (it == m_encodedCollection.end())
+        {
+            return cv::Mat();
+        }
+        encodedImage = it->second.bytes;
+        imageSize = it->second.imageSize;
+        storedDecodeScale = it->second.decodeScale;
+        boostEncodedImageToTopCache(imageKey);
+    }
+
+    // Downscales are relative to the stored image, which may already be reduced, and never decode a larger image
+    auto decodeScale = storedDecodeScale;
+    for (const auto & mode : REDUCED_DECODE_MODES)
+    {
+        if (mode.first >= storedDecodeScale && mode.first <= maxDownscale * storedDecodeScale)
+        {
+            decodeScale = mode.first;
+            break;
+        }
+    }
+    const auto decodeFlags = decodeFlagsOf(decodeScale);
+
+    // Top left corner of the decoded pixels in the downscaled image
+    cv::Point decodedOrigin;
+    cv::Point originInFile;
+    const cv::Rect regionInFile(region.tl() * storedDecodeScale, region.br() * storedDecodeScale);
+    auto decodedImage = decodeJpegRegion(*encodedImage, regionInFile, decodeFlags, originInFile);
+    if (!decodedImage.empty())
+    {
+        // MCUs are multiples of 8 pixels, the largest reduction
+        scale = static_cast<double>(storedDecodeScale) / decodeScale;
+        decodedOrigin = originInFile / decodeScale;
+    }
+    else
+    {
+        // Other formats and files that can not be cropped are decoded whole, at the reduced scale
+        const cv::_InputArray inputArray(encodedImage->data(), static_cast<int>(encodedImage->size()));
+        decodedImage = imdecode(inputArray, decodeFlags);
+        if (decodedImage.empty())
+        {
+            throw std::runtime_error("Unable to decode image with key='" + imageKey + "'");
+        }
+        scale = static_cast<double>(decodedImage.cols) / imageSize.width;
+    }
+
+    const cv::Rect scaledRegion(cv::Point(floorInteger(region.x * scale), floorInteger(region.y * scale)),
+                                cv::Point(ceilInteger(region.br().x * scale), ceilInteger(region.br().y * scale)));
+    const auto regionInImage = scaledRegion & cv::Rect(decodedOrigin, decodedImage.size());
+
+    cv::Mat result(scaledRegion.size(), decodedImage.type(), cv::Scalar::all(0));
+    if (regionInImage.area() > 0)
+    {
+        decodedImage(regionInImage - decodedOrigin).copyTo(result(regionInImage - scaledRegion.tl()));
+    }
+    return result;
 }
 
 void ImageStore::configureInternal(const ConfigLoaderSPtr & config)
 {
     auto & imageStoreCfg = config->get({ "imageStore" });
     const size_t imageStoreSize = imageStoreCfg["size"].GetInt();
+    m_maxHammingDistance = Utilities::getField(imageStoreCfg, "nearDuplicateHammingDistance", m_maxHammingDistance);
+    m_encodedStoreBytes = Utilities::getField(imageStoreCfg, "encodedCacheBytes", m_encodedStoreBytes);
+    m_proxyMaxSize = Utilities::getField(imageStoreCfg, "proxyMaxSize", m_proxyMaxSize);
+    m_planarStorage = Utilities::getField(imageStoreCfg, "planarStorage", m_planarStorage);
+    m_maxEncodedBytes = Utilities::getField(imageStoreCfg, "maxEncodedBytes", m_maxEncodedBytes);
+    m_maxPixels = Utilities::getField(imageStoreCfg, "maxPixels", m_maxPixels);
+    m_maxDecodedPixels = Utilities::getField(imageStoreCfg, "maxDecodedPixels", m_maxDecodedPixels);
     setStoreSize(imageStoreSize);
 }
 
@@ -125,15 +640,35 @@ void ImageStore::setStoreSize(const size_t storeSize)
     handleStoreSize();
 }
 
+void ImageStore::setEncodedStoreBytes(const size_t encodedStoreBytes)
+{
+    m_encodedStoreBytes = encodedStoreBytes;
+    handleStoreSize();
+}
+
+void ImageStore::setDecodeLimits(const size_t maxEncodedBytes, const size_t maxPixels, const size_t maxDecodedPixels)
+{
+    m_maxEncodedBytes = maxEncodedBytes;
+    m_maxPixels = maxPixels;
+    m_maxDecodedPixels = maxDecodedPixels;
+}
+
 void ImageStore::handleStoreSize()
 {
-    std::lock_guard<std::mutex> lg(m_mutex);
+    std::lock_guard<InstrumentedMutex> lg(m_mutex);
     while (m_imageKeyOrder.size() > m_storeSize)
     {
         const auto & imageKey = m_imageKeyOrder.front();
         m_imageCollection.erase(imageKey);
         m_imageKeyOrder.pop_front();
     }
+    while (m_encodedBytesInUse > m_encodedStoreBytes)
+    {
+        const auto & imageKey = m_encodedKeyOrder.front();
+        m_encodedBytesInUse -= m_encodedCollection[imageKey].bytes->size();
+        m_encodedCollection.erase(imageKey);
+        m_encodedKeyOrder.pop_front();
+    }
 }
 
 void ImageStore::boostImageToTopCache(const std::string & imageKey)
@@ -147,4 +682,15 @@ void ImageStore::boostImageToTopCache(const std::string & imageKey)
         it->second.storeListOrder = newOrderIt;
     }
 }
+
+void ImageStore::boostEncodedImageToTopCache(const std::string & imageKey)
+{
+    auto it = m_encodedCollection.find(imageKey);
+    if (it != m_encodedCollection.end())
+    {
+        m_encodedKeyOrder.erase(it->second.storeListOrder);
+        const auto newOrderIt = m_encodedKeyOrder.insert(m_encodedKeyOrder.end(), imageKey);
+        it->second.storeListOrder = newOrderIt;
+    }
+}
 } // namespace ppp
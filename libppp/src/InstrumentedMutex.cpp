@@ -0,0 +1,79 @@
+#include "InstrumentedMutex.h"
+
+#include <chrono>
+#include <map>
+
+namespace ppp
+{
+namespace
+{
+std::mutex & lockStatsRegistryMutex()
+{
+    static std::mutex registryMutex;
+    return registryMutex;
+}
+
+std::map<std::string, LockStats> & lockStatsRegistry()
+{
+    // Entries are never removed, so the stats pointers held by the mutexes stay valid
+    static std::map<std::string, LockStats> registry;
+    return registry;
+}
+} // namespace
+
+InstrumentedMutex::InstrumentedMutex(const std::string & name)
+{
+    std::lock_guard<std::mutex> lg(lockStatsRegistryMutex());
+    m_stats = &lockStatsRegistry()[name];
+}
+
+void InstrumentedMutex::lock()
+{
+    if (!m_mutex.try_lock())
+    {
+        const auto start = std::chrono::steady_clock::now();
+        m_mutex.lock();
+        const auto waitTime = std::chrono::steady_clock::now() - start;
+        m_stats->contentions.fetch_add(1, std::memory_order_relaxed);
+        m_stats->waitTimeNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waitTime).count(),
+                                      std::memory_order_relaxed);
+    }
+    m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedMutex::try_lock()
+{
+    if (m_mutex.try_lock())
+    {
+        m_stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void InstrumentedMutex::unlock()
+{
+    m_mutex.unlock();
+}
+
+void InstrumentedMutex::visitLockStats(
+    const std::function<void(const std::string & name, const LockStats & stats)> & visitor)
+{
+    std::lock_guard<std::mutex> lg(lockStatsRegistryMutex());
+    for (const auto & kv : lockStatsRegistry())
+    {
+        visitor(kv.first, kv.second);
+    }
+}
+
+void InstrumentedMutex::resetLockStats()
+{
+    std::lock_guard<std::mutex> lg(lockStatsRegistryMutex());
+    for (auto & kv : lockStatsRegistry())
+    {
+        kv.second.acquisitions = 0;
+        kv.second.contentions = 0;
+        kv.second.waitTimeNs = 0;
+    }
+}
+} // namespace ppp
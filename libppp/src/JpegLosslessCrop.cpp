@@ -0,0 +1,709 @@
+#include "JpegLosslessCrop.h"
+#include "StageMetrics.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <stdexcept>
+
+namespace ppp
+{
+namespace
+{
+constexpr auto BLOCK_SIZE = 64;
+
+// Huffman tables of the JPEG specification (annex K.3). They hold a code for every symbol a baseline file can use,
+// so any coefficients can be encoded with them whatever the tables of the source file were
+const uint8_t STD_DC_LUMA_BITS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const uint8_t STD_DC_CHROMA_BITS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const uint8_t STD_DC_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const uint8_t STD_AC_LUMA_BITS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+const uint8_t STD_AC_LUMA_VALUES[162]
+    = { 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71,
+        0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+        0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37,
+        0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+        0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+        0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+        0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa };
+const uint8_t STD_AC_CHROMA_BITS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const uint8_t STD_AC_CHROMA_VALUES[162]
+    = { 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22,
+        0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+        0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36,
+        0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+        0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+        0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+        0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+        0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa };
+
+/*!@brief Canonical Huffman code, with the tables to decode it (JPEG specification F.2.2.3) and to encode it !*/
+struct HuffmanTable final
+{
+    bool defined = false;
+    std::array<int, 18> maxCode {}; ///<- Largest code of each length, -1 if there is none
+    std::array<int, 17> valueOffset {}; ///<- Index in values of a code of each length, minus the code
+    std::vector<uint8_t> values;
+    std::array<uint16_t, 256> code {}; ///<- Code of each symbol
+    std::array<uint8_t, 256> codeLength {}; ///<- Length of the code of each symbol, zero if it has none
+
+    void build(const uint8_t * bits, const uint8_t * symbols, const size_t numSymbols)
+    {
+        values.assign(symbols, symbols + numSymbols);
+        code.fill(0);
+        codeLength.fill(0);
+        auto nextCode = 0;
+        size_t index = 0;
+        for (auto length = 1; length <= 16; ++length)
+        {
+            valueOffset[length] = static_cast<int>(index) - nextCode;
+            for (auto i = 0; i < bits[length - 1]; ++i, ++index, ++nextCode)
+            {
+                if (index >= numSymbols)
+                {
+                    throw std::runtime_error("Invalid Huffman table");
+                }
+                code[values[index]] = static_cast<uint16_t>(nextCode);
+                codeLength[values[index]] = static_cast<uint8_t>(length);
+            }
+            maxCode[length] = bits[length - 1] > 0 ? nextCode - 1 : -1;
+            nextCode <<= 1;
+        }
+        maxCode[17] = INT_MAX;
+        defined = true;
+    }
+};
+
+struct Component final
+{
+    int id;
+    int h; ///<- Horizontal sampling factor
+    int v; ///<- Vertical sampling factor
+    int quantTable;
+    int dcTable = 0;
+    int acTable = 0;
+    std::vector<int16_t> blocks; ///<- Coefficients of the blocks within the crop, in zigzag order
+    int blocksPerLine = 0; ///<- Within the crop
+};
+
+/*!@brief Reads the entropy coded data, removing the byte stuffing. Valid data never needs bits past the next
+ * marker, so reaching one (or the end of the file) means the data is corrupt or truncated !*/
+class BitReader final
+{
+public:
+    BitReader(const BYTE * data, const size_t length)
+    : m_data(data)
+    , m_length(length)
+    {
+    }
+
+    int bit()
+    {
+        if (m_numBits == 0)
+        {
+            fill();
+        }
+        return static_cast<int>(m_buffer >> --m_numBits & 1);
+    }
+
+    int bits(int count)
+    {
+        auto value = 0;
+        while (count-- > 0)
+        {
+            value = value << 1 | bit();
+        }
+        return value;
+    }
+
+    /*!@brief Skips to the byte after the next restart marker !*/
+    void restart()
+    {
+        m_numBits = 0;
+        while (m_position + 1 < m_length && m_data[m_position] == 0xFF && m_data[m_position + 1] == 0xFF)
+        {
+            ++m_position;
+        }
+        if (m_position + 1 >= m_length || m_data[m_position] != 0xFF || (m_data[m_position + 1] & 0xF8) != 0xD0)
+        {
+            throw std::runtime_error("Missing JPEG restart marker");
+        }
+        m_position += 2;
+    }
+
+private:
+    void fill()
+    {
+        if (m_position >= m_length)
+        {
+            throw std::runtime_error("Truncated JPEG data");
+        }
+        m_buffer = m_data[m_position++];
+        if (m_buffer == 0xFF)
+        {
+            if (m_position >= m_length || m_data[m_position] != 0x00)
+            {
+                throw std::runtime_error("Unexpected marker in JPEG data");
+            }
+            ++m_position;
+        }
+        m_numBits = 8;
+    }
+
+    const BYTE * m_data;
+    size_t m_length;
+    size_t m_position = 0;
+    uint32_t m_buffer = 0;
+    int m_numBits = 0;
+};
+
+/*!@brief Writes entropy coded data, stuffing a zero after each 0xFF byte !*/
+class BitWriter final
+{
+public:
+    explicit BitWriter(std::vector<BYTE> & output)
+    : m_output(output)
+    {
+    }
+
+    void put(const uint32_t value, const int length)
+    {
+        m_buffer = m_buffer << length | (value & ((1u << length) - 1));
+        m_numBits += length;
+        while (m_numBits >= 8)
+        {
+            m_numBits -= 8;
+            const auto byte = static_cast<BYTE>(m_buffer >> m_numBits);
+            m_output.push_back(byte);
+            if (byte == 0xFF)
+            {
+                m_output.push_back(0x00);
+            }
+        }
+        m_buffer &= (1u << m_numBits) - 1;
+    }
+
+    void flush()
+    {
+        // Padding with ones, as required by the specification
+        if (m_numBits > 0)
+        {
+            put((1u << (8 - m_numBits)) - 1, 8 - m_numBits);
+        }
+    }
+
+private:
+    std::vector<BYTE> & m_output;
+    uint32_t m_buffer = 0;
+    int m_numBits = 0;
+};
+
+int decodeSymbol(BitReader & reader, const HuffmanTable & table)
+{
+    auto code = 0;
+    for (auto length = 1; length <= 16; ++length)
+    {
+        code = code << 1 | reader.bit();
+        if (code <= table.maxCode[length])
+        {
+            return table.values[code + table.valueOffset[length]];
+        }
+    }
+    throw std::runtime_error("Invalid Huffman code in JPEG data");
+}
+
+int receiveExtend(BitReader & reader, const int size)
+{
+    const auto value = reader.bits(size);
+    return value < 1 << (size - 1) ? value - (1 << size) + 1 : value;
+}
+
+int magnitudeCategory(int value)
+{
+    value = std::abs(value);
+    auto category = 0;
+    while (value > 0)
+    {
+        ++category;
+        value >>= 1;
+    }
+    return category;
+}
+
+void encodeSymbol(BitWriter & writer, const HuffmanTable & table, const int symbol)
+{
+    if (table.codeLength[symbol] == 0)
+    {
+        throw std::runtime_error("JPEG coefficient out of the baseline range");
+    }
+    writer.put(table.code[symbol], table.codeLength[symbol]);
+}
+
+void encodeValue(BitWriter & writer, const int value, const int category)
+{
+    writer.put(static_cast<uint32_t>(value < 0 ? value - 1 : value), category);
+}
+
+uint16_t readU16(const std::vector<BYTE> & data, const size_t offset)
+{
+    if (offset + 2 > data.size())
+    {
+        throw std::runtime_error("Truncated JPEG file");
+    }
+    return static_cast<uint16_t>(data[offset] << 8 | data[offset + 1]);
+}
+
+void writeU16(std::vector<BYTE> & output, const int value)
+{
+    output.push_back(static_cast<BYTE>(value >> 8));
+    output.push_back(static_cast<BYTE>(value));
+}
+
+/*!@brief Headers of a JPEG file up to the start of its entropy coded data !*/
+struct JpegFile final
+{
+    int sofMarker = 0;
+    cv::Size size;
+    std::vector<Component> components;
+    HuffmanTable dcTables[4];
+    HuffmanTable acTables[4];
+    int restartInterval = 0;
+    std::vector<BYTE> copiedSegments; ///<- Quantization tables and metadata to carry over to the cropped file
+    size_t scanDataOffset = 0;
+
+    /*!@brief Parses the headers, returns false if the file uses a coding process that is not supported !*/
+    bool parse(const std::vector<BYTE> & data)
+    {
+        if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        {
+            return false;
+        }
+        size_t position = 2;
+        while (true)
+        {
+            if (position + 4 > data.size() || data[position] != 0xFF)
+            {
+                return false;
+            }
+            const auto marker = data[position + 1];
+            if (marker == 0xFF)
+            {
+                // Fill byte
+                ++position;
+                continue;
+            }
+            const auto segmentStart = position + 4;
+            const auto segmentEnd = position + 2 + readU16(data, position + 2);
+            if (segmentEnd > data.size() || segmentEnd < segmentStart)
+            {
+                return false;
+            }
+
+            if (marker == 0xC0 || marker == 0xC1)
+            {
+                sofMarker = marker;
+                if (!parseFrame(data, segmentStart, segmentEnd))
+                {
+                    return false;
+                }
+            }
+            else if ((marker & 0xF0) == 0xC0 && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                // Progressive, lossless, hierarchical or arithmetic coding
+                return false;
+            }
+            else if (marker == 0xC4)
+            {
+                parseHuffmanTables(data, segmentStart, segmentEnd);
+            }
+            else if (marker == 0xDD)
+            {
+                restartInterval = readU16(data, segmentStart);
+            }
+            else if (marker == 0xDB || (marker >= 0xE0 && marker <= 0xEF && marker != 0xE1))
+            {
+                copiedSegments.insert(copiedSegments.end(), data.begin() + position, data.begin() + segmentEnd);
+            }
+            else if (marker == 0xDA)
+            {
+                scanDataOffset = segmentEnd;
+                return sofMarker != 0 && parseScan(data, segmentStart);
+            }
+            else if (marker == 0xD9)
+            {
+                return false;
+            }
+            position = segmentEnd;
+        }
+    }
+
+    cv::Size mcuSize() const
+    {
+        auto maxH = 1, maxV = 1;
+        for (const auto & component : components)
+        {
+            maxH = std::max(maxH, component.h);
+            maxV = std::max(maxV, component.v);
+        }
+        return { 8 * maxH, 8 * maxV };
+    }
+
+private:
+    bool parseFrame(const std::vector<BYTE> & data, const size_t start, const size_t end)
+    {
+        if (end < start + 6 || data[start] != 8)
+        {
+            return false;
+        }
+        size = cv::Size(readU16(data, start + 3), readU16(data, start + 1));
+        const auto numComponents = data[start + 5];
+        if (size.area() == 0 || (numComponents != 1 && numComponents != 3) || end < start + 6 + 3 * numComponents)
+        {
+            return false;
+        }
+        for (auto i = 0; i < numComponents; ++i)
+        {
+            const auto offset = start + 6 + 3 * i;
+            Component component;
+            component.id = data[offset];
+            component.h = data[offset + 1] >> 4;
+            component.v = data[offset + 1] & 15;
+            component.quantTable = data[offset + 2];
+            if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4)
+            {
+                return false;
+            }
+            components.push_back(component);
+        }
+        if (numComponents == 1)
+        {
+            // A single component scan is not interleaved: its MCU is one block whatever its sampling factors
+            components[0].h = components[0].v = 1;
+        }
+        return true;
+    }
+
+    void parseHuffmanTables(const std::vector<BYTE> & data, size_t position, const size_t end)
+    {
+        while (position + 17 <= end)
+        {
+            const auto tableClass = data[position] >> 4;
+            const auto tableId = data[position] & 15;
+            if (tableClass > 1 || tableId > 3)
+            {
+                throw std::runtime_error("Invalid JPEG Huffman table");
+            }
+            const auto bits = &data[position + 1];
+            size_t numSymbols = 0;
+            for (auto i = 0; i < 16; ++i)
+            {
+                numSymbols += bits[i];
+            }
+            if (numSymbols > 256 || position + 17 + numSymbols > end)
+            {
+                throw std::runtime_error("Invalid JPEG Huffman table");
+            }
+            auto & table = tableClass == 0 ? dcTables[tableId] : acTables[tableId];
+            table.build(bits, &data[position + 17], numSymbols);
+            position += 17 + numSymbols;
+        }
+    }
+
+    bool parseScan(const std::vector<BYTE> & data, const size_t start)
+    {
+        const auto numComponents = data[start];
+        if (numComponents != components.size())
+        {
+            // Components coded in separate scans
+            return false;
+        }
+        for (auto i = 0; i < numComponents; ++i)
+        {
+            const auto id = data[start + 1 + 2 * i];
+            const auto tables = data[start + 2 + 2 * i];
+            const auto component = std::find_if(
+                components.begin(), components.end(), [id](const Component & c) { return c.id == id; });
+            if (component == components.end() || (tables >> 4) > 3 || (tables & 15) > 3)
+            {
+                return false;
+            }
+            component->dcTable = tables >> 4;
+            component->acTable = tables & 15;
+            if (!dcTables[component->dcTable].defined || !acTables[component->acTable].defined)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/*!@brief Decodes the coefficients of a block, the DC one is made absolute with the predictor of the component !*/
+void decodeBlock(BitReader & reader,
+                 const HuffmanTable & dcTable,
+                 const HuffmanTable & acTable,
+                 int & dcPredictor,
+                 int16_t * block)
+{
+    std::fill(block, block + BLOCK_SIZE, 0);
+    const auto dcCategory = decodeSymbol(reader, dcTable);
+    if (dcCategory > 11)
+    {
+        throw std::runtime_error("Invalid DC coefficient in JPEG data");
+    }
+    dcPredictor += dcCategory > 0 ? receiveExtend(reader, dcCategory) : 0;
+    block[0] = static_cast<int16_t>(dcPredictor);
+    for (auto k = 1; k < BLOCK_SIZE;)
+    {
+        const auto symbol = decodeSymbol(reader, acTable);
+        const auto run = symbol >> 4;
+        const auto category = symbol & 15;
+        if (category == 0)
+        {
+            if (run != 15)
+            {
+                // End of block
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += run;
+        if (k >= BLOCK_SIZE)
+        {
+            throw std::runtime_error("Invalid AC coefficients in JPEG data");
+        }
+        block[k++] = static_cast<int16_t>(receiveExtend(reader, category));
+    }
+}
+
+void encodeBlock(BitWriter & writer,
+                 const HuffmanTable & dcTable,
+                 const HuffmanTable & acTable,
+                 int & dcPredictor,
+                 const int16_t * block)
+{
+    const auto dcDifference = block[0] - dcPredictor;
+    dcPredictor = block[0];
+    const auto dcCategory = magnitudeCategory(dcDifference);
+    encodeSymbol(writer, dcTable, dcCategory);
+    encodeValue(writer, dcDifference, dcCategory);
+
+    auto run = 0;
+    for (auto k = 1; k < BLOCK_SIZE; ++k)
+    {
+        if (block[k] == 0)
+        {
+            ++run;
+            continue;
+        }
+        for (; run > 15; run -= 16)
+        {
+            encodeSymbol(writer, acTable, 0xF0);
+        }
+        const auto category = magnitudeCategory(block[k]);
+        encodeSymbol(writer, acTable, run << 4 | category);
+        encodeValue(writer, block[k], category);
+        run = 0;
+    }
+    if (run > 0)
+    {
+        encodeSymbol(writer, acTable, 0x00);
+    }
+}
+
+void writeHuffmanTable(std::vector<BYTE> & output,
+                       const int tableClass,
+                       const int tableId,
+                       const uint8_t * bits,
+                       const uint8_t * values,
+                       const size_t numValues)
+{
+    output.insert(output.end(), { 0xFF, 0xC4 });
+    writeU16(output, static_cast<int>(2 + 1 + 16 + numValues));
+    output.push_back(static_cast<BYTE>(tableClass << 4 | tableId));
+    output.insert(output.end(), bits, bits + 16);
+    output.insert(output.end(), values, values + numValues);
+}
+} // namespace
+
+bool JpegLosslessCrop::readFrameInfo(const std::vector<BYTE> & jpeg, JpegFrameInfo & info)
+{
+    JpegFile file;
+    try
+    {
+        if (!file.parse(jpeg))
+        {
+            return false;
+        }
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+    info.size = file.size;
+    info.mcuSize = file.mcuSize();
+    return true;
+}
+
+bool JpegLosslessCrop::crop(const std::vector<BYTE> & jpeg, const cv::Rect & region, std::vector<BYTE> & output)
+{
+    PPP_STAGE_SCOPE("losslessJpegCrop");
+    // Corrupt data is reported as unsupported so that the caller falls back to decoding the file
+    try
+    {
+        JpegFile file;
+        if (!file.parse(jpeg))
+        {
+            return false;
+        }
+        const auto mcuSize = file.mcuSize();
+        if (region.empty() || (region & cv::Rect(cv::Point(), file.size)) != region || region.x % mcuSize.width != 0
+            || region.y % mcuSize.height != 0)
+        {
+            return false;
+        }
+
+        // Decode the MCU rows down to the last one of the region, keeping the blocks within the region
+        const auto numMcuCols = (file.size.width + mcuSize.width - 1) / mcuSize.width;
+        const auto firstMcuCol = region.x / mcuSize.width;
+        const auto firstMcuRow = region.y / mcuSize.height;
+        const auto numCropMcuCols = (region.width + mcuSize.width - 1) / mcuSize.width;
+        const auto numCropMcuRows = (region.height + mcuSize.height - 1) / mcuSize.height;
+        for (auto & component : file.components)
+        {
+            component.blocksPerLine = numCropMcuCols * component.h;
+            component.blocks.resize(static_cast<size_t>(component.blocksPerLine) * numCropMcuRows * component.v
+                                    * BLOCK_SIZE);
+        }
+
+        BitReader reader(jpeg.data() + file.scanDataOffset, jpeg.size() - file.scanDataOffset);
+        std::vector<int> dcPredictors(file.components.size(), 0);
+        std::array<int16_t, BLOCK_SIZE> discardedBlock {};
+        auto mcusToRestart = file.restartInterval;
+        for (auto mcuRow = 0; mcuRow < firstMcuRow + numCropMcuRows; ++mcuRow)
+        {
+            const auto rowInCrop = mcuRow >= firstMcuRow;
+            for (auto mcuCol = 0; mcuCol < numMcuCols; ++mcuCol)
+            {
+                if (file.restartInterval > 0)
+                {
+                    if (mcusToRestart == 0)
+                    {
+                        reader.restart();
+                        std::fill(dcPredictors.begin(), dcPredictors.end(), 0);
+                        mcusToRestart = file.restartInterval;
+                    }
+                    --mcusToRestart;
+                }
+                const auto inCrop = rowInCrop && mcuCol >= firstMcuCol && mcuCol < firstMcuCol + numCropMcuCols;
+                for (size_t c = 0; c < file.components.size(); ++c)
+                {
+                    auto & component = file.components[c];
+                    for (auto by = 0; by < component.v; ++by)
+                    {
+                        for (auto bx = 0; bx < component.h; ++bx)
+                        {
+                            auto block = discardedBlock.data();
+                            if (inCrop)
+                            {
+                                const auto blockRow = (mcuRow - firstMcuRow) * component.v + by;
+                                const auto blockCol = (mcuCol - firstMcuCol) * component.h + bx;
+                                block = &component.blocks[(static_cast<size_t>(blockRow) * component.blocksPerLine
+                                                           + blockCol)
+                                                          * BLOCK_SIZE];
+                            }
+                            decodeBlock(reader,
+                                        file.dcTables[component.dcTable],
+                                        file.acTables[component.acTable],
+                                        dcPredictors[c],
+                                        block);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Write the cropped file with the same quantization tables and the standard Huffman tables
+        output.clear();
+        output.insert(output.end(), { 0xFF, 0xD8 });
+        output.insert(output.end(), file.copiedSegments.begin(), file.copiedSegments.end());
+
+        const auto numComponents = static_cast<int>(file.components.size());
+        output.insert(output.end(), { 0xFF, static_cast<BYTE>(file.sofMarker) });
+        writeU16(output, 8 + 3 * numComponents);
+        output.push_back(8);
+        writeU16(output, region.height);
+        writeU16(output, region.width);
+        output.push_back(static_cast<BYTE>(numComponents));
+        for (const auto & component : file.components)
+        {
+            output.push_back(static_cast<BYTE>(component.id));
+            output.push_back(static_cast<BYTE>(component.h << 4 | component.v));
+            output.push_back(static_cast<BYTE>(component.quantTable));
+        }
+
+        HuffmanTable dcTables[2], acTables[2];
+        dcTables[0].build(STD_DC_LUMA_BITS, STD_DC_VALUES, sizeof(STD_DC_VALUES));
+        acTables[0].build(STD_AC_LUMA_BITS, STD_AC_LUMA_VALUES, sizeof(STD_AC_LUMA_VALUES));
+        writeHuffmanTable(output, 0, 0, STD_DC_LUMA_BITS, STD_DC_VALUES, sizeof(STD_DC_VALUES));
+        writeHuffmanTable(output, 1, 0, STD_AC_LUMA_BITS, STD_AC_LUMA_VALUES, sizeof(STD_AC_LUMA_VALUES));
+        if (numComponents > 1)
+        {
+            dcTables[1].build(STD_DC_CHROMA_BITS, STD_DC_VALUES, sizeof(STD_DC_VALUES));
+            acTables[1].build(STD_AC_CHROMA_BITS, STD_AC_CHROMA_VALUES, sizeof(STD_AC_CHROMA_VALUES));
+            writeHuffmanTable(output, 0, 1, STD_DC_CHROMA_BITS, STD_DC_VALUES, sizeof(STD_DC_VALUES));
+            writeHuffmanTable(output, 1, 1, STD_AC_CHROMA_BITS, STD_AC_CHROMA_VALUES, sizeof(STD_AC_CHROMA_VALUES));
+        }
+
+        output.insert(output.end(), { 0xFF, 0xDA });
+        writeU16(output, 6 + 2 * numComponents);
+        output.push_back(static_cast<BYTE>(numComponents));
+        for (auto c = 0; c < numComponents; ++c)
+        {
+            output.push_back(static_cast<BYTE>(file.components[c].id));
+            output.push_back(c == 0 ? 0x00 : 0x11);
+        }
+        output.insert(output.end(), { 0x00, 0x3F, 0x00 });
+
+        BitWriter writer(output);
+        std::fill(dcPredictors.begin(), dcPredictors.end(), 0);
+        for (auto mcuRow = 0; mcuRow < numCropMcuRows; ++mcuRow)
+        {
+            for (auto mcuCol = 0; mcuCol < numCropMcuCols; ++mcuCol)
+            {
+                for (auto c = 0; c < numComponents; ++c)
+                {
+                    const auto & component = file.components[c];
+                    const auto tables = c == 0 ? 0 : 1;
+                    for (auto by = 0; by < component.v; ++by)
+                    {
+                        for (auto bx = 0; bx < component.h; ++bx)
+                        {
+                            const auto blockRow = mcuRow * component.v + by;
+                            const auto blockCol = mcuCol * component.h + bx;
+                            encodeBlock(
+                                writer,
+                                dcTables[tables],
+                                acTables[tables],
+                                dcPredictors[c],
+                                &component.blocks[(static_cast<size_t>(blockRow) * component.blocksPerLine + blockCol)
+                                                  * BLOCK_SIZE]);
+                        }
+                    }
+                }
+            }
+        }
+        writer.flush();
+        output.insert(output.end(), { 0xFF, 0xD9 });
+        return true;
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+}
+} // namespace ppp
@@ -70,6 +70,11 @@ std::string LandMarks::toJson(const bool prettyJson) const
     SERIALIZE_POINT(lipLowerCenter);
     SERIALIZE_POINT(lipLeftCorner);
     SERIALIZE_POINT(lipRightCorner);
+
+    if (shapeCascades != 0)
+    {
+        d.AddMember("shapeCascades", shapeCascades, alloc);
+    }
     return Utilities::serializeJson(d, prettyJson);
 }
 
@@ -104,6 +109,48 @@ void LandMarks::fromJson(const rapidjson::Value & v)
     PARSE_POINT(lipRightCorner);
     PARSE_POINT(crownPoint);
     PARSE_POINT(chinPoint);
+
+    shapeCascades = Utilities::getField(v, "shapeCascades", 0);
+}
+
+void LandMarks::scale(const double sx, const double sy)
+{
+    const auto scalePoint = [sx, sy](cv::Point & p) {
+        p.x = roundInteger(p.x * sx);
+        p.y = roundInteger(p.y * sy);
+    };
+    const auto scaleRect = [sx, sy](cv::Rect & r) {
+        r = cv::Rect(cv::Point(roundInteger(r.x * sx), roundInteger(r.y * sy)),
+                     cv::Point(roundInteger(r.br().x * sx), roundInteger(r.br().y * sy)));
+    };
+
+    scaleRect(vjFaceRect);
+    scaleRect(vjLeftEyeRect);
+    scaleRect(vjRightEyeRect);
+    scaleRect(vjMouthRect);
+
+    for (auto pt : { &eyeLeftPupil,
+                     &eyeRightPupil,
+                     &eyeLeftCorner,
+                     &eyeRightCorner,
+                     &lipUpperCenter,
+                     &lipLowerCenter,
+                     &lipLeftCorner,
+                     &lipRightCorner,
+                     &noseTip,
+                     &crownPoint,
+                     &chinPoint })
+    {
+        scalePoint(*pt);
+    }
+
+    for (auto contour : { &lipContour1st, &lipContour2nd, &allLandmarks })
+    {
+        for (auto & pt : *contour)
+        {
+            scalePoint(pt);
+        }
+    }
 }
 
 LandMarksSPtr LandMarks::create()
@@ -0,0 +1,112 @@
+#include "LandMarksRecord.h"
+#include "LandMarks.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ppp
+{
+
+static PackedPoint packPoint(const cv::Point & p)
+{
+    return PackedPoint { cv::saturate_cast<int16_t>(p.x), cv::saturate_cast<int16_t>(p.y) };
+}
+
+static PackedRect packRect(const cv::Rect & r)
+{
+    return PackedRect { cv::saturate_cast<int16_t>(r.x),
+                        cv::saturate_cast<int16_t>(r.y),
+                        cv::saturate_cast<int16_t>(r.width),
+                        cv::saturate_cast<int16_t>(r.height) };
+}
+
+static cv::Point unpackPoint(const PackedPoint & p)
+{
+    return cv::Point(p.x, p.y);
+}
+
+static cv::Rect unpackRect(const PackedRect & r)
+{
+    return cv::Rect(r.x, r.y, r.width, r.height);
+}
+
+LandMarksRecord LandMarksRecord::fromLandMarks(const LandMarks & landMarks)
+{
+    LandMarksRecord r;
+    std::memset(&r, 0, sizeof(r));
+
+    r.imageRotation = static_cast<int16_t>(landMarks.imageRotation);
+    r.shapeCascades = cv::saturate_cast<uint16_t>(landMarks.shapeCascades);
+
+    r.vjFaceRect = packRect(landMarks.vjFaceRect);
+    r.vjLeftEyeRect = packRect(landMarks.vjLeftEyeRect);
+    r.vjRightEyeRect = packRect(landMarks.vjRightEyeRect);
+    r.vjMouthRect = packRect(landMarks.vjMouthRect);
+
+    r.eyeLeftPupil = packPoint(landMarks.eyeLeftPupil);
+    r.eyeRightPupil = packPoint(landMarks.eyeRightPupil);
+    r.eyeLeftCorner = packPoint(landMarks.eyeLeftCorner);
+    r.eyeRightCorner = packPoint(landMarks.eyeRightCorner);
+    r.lipUpperCenter = packPoint(landMarks.lipUpperCenter);
+    r.lipLowerCenter = packPoint(landMarks.lipLowerCenter);
+    r.lipLeftCorner = packPoint(landMarks.lipLeftCorner);
+    r.lipRightCorner = packPoint(landMarks.lipRightCorner);
+    r.noseTip = packPoint(landMarks.noseTip);
+    r.crownPoint = packPoint(landMarks.crownPoint);
+    r.chinPoint = packPoint(landMarks.chinPoint);
+
+    r.numShapePoints = static_cast<uint16_t>(std::min(landMarks.allLandmarks.size(), MAX_SHAPE_POINTS));
+    for (size_t i = 0; i < r.numShapePoints; ++i)
+    {
+        r.shapePoints[i] = packPoint(landMarks.allLandmarks[i]);
+    }
+    return r;
+}
+
+void LandMarksRecord::toLandMarks(LandMarks & landMarks) const
+{
+    landMarks.imageRotation = imageRotation;
+    landMarks.shapeCascades = shapeCascades;
+
+    landMarks.vjFaceRect = unpackRect(vjFaceRect);
+    landMarks.vjLeftEyeRect = unpackRect(vjLeftEyeRect);
+    landMarks.vjRightEyeRect = unpackRect(vjRightEyeRect);
+    landMarks.vjMouthRect = unpackRect(vjMouthRect);
+
+    landMarks.eyeLeftPupil = unpackPoint(eyeLeftPupil);
+    landMarks.eyeRightPupil = unpackPoint(eyeRightPupil);
+    landMarks.eyeLeftCorner = unpackPoint(eyeLeftCorner);
+    landMarks.eyeRightCorner = unpackPoint(eyeRightCorner);
+    landMarks.lipUpperCenter = unpackPoint(lipUpperCenter);
+    landMarks.lipLowerCenter = unpackPoint(lipLowerCenter);
+    landMarks.lipLeftCorner = unpackPoint(lipLeftCorner);
+    landMarks.lipRightCorner = unpackPoint(lipRightCorner);
+    landMarks.noseTip = unpackPoint(noseTip);
+    landMarks.crownPoint = unpackPoint(crownPoint);
+    landMarks.chinPoint = unpackPoint(chinPoint);
+
+    landMarks.allLandmarks.resize(numShapePoints);
+    for (size_t i = 0; i < numShapePoints; ++i)
+    {
+        landMarks.allLandmarks[i] = unpackPoint(shapePoints[i]);
+    }
+}
+
+LandMarksContoursSPtr LandMarksContours::fromLandMarks(const LandMarks & landMarks)
+{
+    if (landMarks.lipContour1st.empty() && landMarks.lipContour2nd.empty())
+    {
+        return nullptr;
+    }
+    auto contours = std::make_shared<LandMarksContours>();
+    contours->lipContour1st = landMarks.lipContour1st;
+    contours->lipContour2nd = landMarks.lipContour2nd;
+    return contours;
+}
+
+void LandMarksContours::toLandMarks(LandMarks & landMarks) const
+{
+    landMarks.lipContour1st = lipContour1st;
+    landMarks.lipContour2nd = lipContour2nd;
+}
+} // namespace ppp
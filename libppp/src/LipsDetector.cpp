@@ -1,5 +1,6 @@
 #include "LipsDetector.h"
 #include "LandMarks.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
 
 #include "ConfigLoader.h"
@@ -29,6 +30,7 @@ void LipsDetector::configureInternal(const ConfigLoaderSPtr & config)
 
 bool LipsDetector::detectLandMarks(const Mat & inputImage, LandMarks & landmarks)
 {
+    PPP_STAGE_SCOPE("lipsDetection");
     auto faceRectHeight = landmarks.vjFaceRect.height;
     auto leftEyePos = landmarks.eyeLeftPupil;
     auto rightEyePos = landmarks.eyeRightPupil;
@@ -0,0 +1,188 @@
+#include "OutputSinks.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ppp
+{
+namespace
+{
+constexpr char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+} // namespace
+
+StringOutputSink::StringOutputSink(std::string & output)
+: m_output(output)
+{
+}
+
+void StringOutputSink::write(const char * data, const size_t size)
+{
+    m_output.append(data, size);
+}
+
+BufferOutputSink::BufferOutputSink(char * buffer, const size_t capacity)
+: m_buffer(buffer)
+, m_capacity(capacity)
+{
+}
+
+void BufferOutputSink::write(const char * data, const size_t size)
+{
+    if (size > m_capacity - m_size)
+    {
+        throw std::runtime_error("Output of more than " + std::to_string(m_capacity)
+                                 + " bytes does not fit in the buffer");
+    }
+    std::memcpy(m_buffer + m_size, data, size);
+    m_size += size;
+}
+
+size_t BufferOutputSink::size() const
+{
+    return m_size;
+}
+
+FileDescriptorOutputSink::FileDescriptorOutputSink(const int fd)
+: m_fd(fd)
+{
+}
+
+void FileDescriptorOutputSink::write(const char * data, size_t size)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        const auto written = _write(m_fd, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+#else
+        const auto written = ::write(m_fd, data, size);
+#endif
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::runtime_error(std::string("Unable to write the output: ") + std::strerror(errno));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        m_size += static_cast<size_t>(written);
+    }
+}
+
+size_t FileDescriptorOutputSink::size() const
+{
+    return m_size;
+}
+
+CallbackOutputSink::CallbackOutputSink(OutputCallback callback, const size_t chunkSize)
+: m_callback(std::move(callback))
+, m_chunkSize(chunkSize)
+{
+    m_chunk.reserve(m_chunkSize);
+}
+
+void CallbackOutputSink::write(const char * data, size_t size)
+{
+    if (m_chunkSize == 0)
+    {
+        m_callback(data, size);
+        return;
+    }
+    // Fill the pending chunk first, then pass full chunks straight from the data
+    if (!m_chunk.empty())
+    {
+        const auto count = std::min(size, m_chunkSize - m_chunk.size());
+        m_chunk.insert(m_chunk.end(), data, data + count);
+        data += count;
+        size -= count;
+        if (m_chunk.size() < m_chunkSize)
+        {
+            return;
+        }
+        m_callback(m_chunk.data(), m_chunk.size());
+        m_chunk.clear();
+    }
+    for (; size >= m_chunkSize; data += m_chunkSize, size -= m_chunkSize)
+    {
+        m_callback(data, m_chunkSize);
+    }
+    m_chunk.insert(m_chunk.end(), data, data + size);
+}
+
+void CallbackOutputSink::finish()
+{
+    if (!m_chunk.empty())
+    {
+        m_callback(m_chunk.data(), m_chunk.size());
+        m_chunk.clear();
+    }
+}
+
+Base64OutputSink::Base64OutputSink(IOutputSink & output)
+: m_output(output)
+{
+}
+
+void Base64OutputSink::write(const char * data, const size_t size)
+{
+    const auto bytes = reinterpret_cast<const BYTE *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        m_pending[m_numPending++] = bytes[i];
+        if (m_numPending < 3)
+        {
+            continue;
+        }
+        if (m_numEncoded + 4 > sizeof(m_encoded))
+        {
+            flush();
+        }
+        auto encoded = m_encoded + m_numEncoded;
+        encoded[0] = BASE64_CHARS[m_pending[0] >> 2];
+        encoded[1] = BASE64_CHARS[((m_pending[0] & 0x03) << 4) | (m_pending[1] >> 4)];
+        encoded[2] = BASE64_CHARS[((m_pending[1] & 0x0f) << 2) | (m_pending[2] >> 6)];
+        encoded[3] = BASE64_CHARS[m_pending[2] & 0x3f];
+        m_numEncoded += 4;
+        m_numPending = 0;
+    }
+}
+
+void Base64OutputSink::finish()
+{
+    if (m_numPending > 0)
+    {
+        std::fill(m_pending + m_numPending, m_pending + 3, 0);
+        if (m_numEncoded + 4 > sizeof(m_encoded))
+        {
+            flush();
+        }
+        auto encoded = m_encoded + m_numEncoded;
+        encoded[0] = BASE64_CHARS[m_pending[0] >> 2];
+        encoded[1] = BASE64_CHARS[((m_pending[0] & 0x03) << 4) | (m_pending[1] >> 4)];
+        encoded[2] = m_numPending > 1 ? BASE64_CHARS[((m_pending[1] & 0x0f) << 2)] : '=';
+        encoded[3] = '=';
+        m_numEncoded += 4;
+        m_numPending = 0;
+    }
+    flush();
+    m_output.finish();
+}
+
+void Base64OutputSink::flush()
+{
+    if (m_numEncoded > 0)
+    {
+        m_output.write(m_encoded, m_numEncoded);
+        m_numEncoded = 0;
+    }
+}
+} // namespace ppp
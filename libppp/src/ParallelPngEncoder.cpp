@@ -0,0 +1,222 @@
+#include "ParallelPngEncoder.h"
+#include "AllocationTracker.h"
+#include "IOutputSink.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include <opencv2/core/utility.hpp>
+
+#ifdef PPP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace ppp
+{
+#ifdef PPP_HAVE_ZLIB
+namespace
+{
+constexpr size_t BLOCK_BYTES = 1 << 20; ///<- Unfiltered bytes per block, large enough for the RLE matches to pay off
+constexpr BYTE ZLIB_HEADER[] = { 0x78, 0x01 }; ///<- Deflate with a 32K window, fastest compression level
+
+/*!@brief Compressed rows of a block, with the checksum of the filtered rows it was made of !*/
+struct EncodedBlock
+{
+    std::vector<BYTE> data;
+    uLong adler = 0;
+    size_t filteredSize = 0;
+    AllocationCounts allocations; ///<- Made to encode the block, by the thread that encoded it
+};
+
+void appendBigEndian32(std::vector<BYTE> & bytes, const uint32_t value)
+{
+    bytes.insert(bytes.end(),
+                 { static_cast<BYTE>(value >> 24),
+                   static_cast<BYTE>(value >> 16),
+                   static_cast<BYTE>(value >> 8),
+                   static_cast<BYTE>(value) });
+}
+
+void writeChunk(IOutputSink & sink, const char * type, const std::vector<BYTE> & data)
+{
+    std::vector<BYTE> header;
+    appendBigEndian32(header, static_cast<uint32_t>(data.size()));
+    header.insert(header.end(), type, type + 4);
+    auto crc = crc32(0, header.data() + 4, 4);
+    sink.write(reinterpret_cast<const char *>(header.data()), header.size());
+    if (!data.empty())
+    {
+        // A null buffer would make zlib return its initial value instead
+        crc = crc32(crc, data.data(), static_cast<uInt>(data.size()));
+        sink.write(reinterpret_cast<const char *>(data.data()), data.size());
+    }
+    std::vector<BYTE> trailer;
+    appendBigEndian32(trailer, static_cast<uint32_t>(crc));
+    sink.write(reinterpret_cast<const char *>(trailer.data()), trailer.size());
+}
+
+/*!@brief Filters the rows with the Sub filter, in RGB(A) order !*/
+std::vector<BYTE> filterRows(const cv::Mat & image, const int firstRow, const int endRow)
+{
+    const auto channels = image.channels();
+    const auto rowBytes = static_cast<size_t>(image.cols) * channels;
+    std::vector<BYTE> filtered((rowBytes + 1) * (endRow - firstRow));
+    auto out = filtered.data();
+    // Position of each output channel in the BGR(A) pixels
+    const int order[] = { channels >= 3 ? 2 : 0, 1, 0, 3 };
+    for (auto row = firstRow; row < endRow; ++row)
+    {
+        const auto pixels = image.ptr<BYTE>(row);
+        *out++ = 1;
+        for (auto c = 0; c < channels; ++c)
+        {
+            *out++ = pixels[order[c]];
+        }
+        for (size_t i = channels; i < rowBytes; i += channels)
+        {
+            for (auto c = 0; c < channels; ++c)
+            {
+                *out++ = static_cast<BYTE>(pixels[i + order[c]] - pixels[i - channels + order[c]]);
+            }
+        }
+    }
+    return filtered;
+}
+
+EncodedBlock encodeBlock(const cv::Mat & image, const int firstRow, const int endRow)
+{
+    const auto startAllocations = AllocationTracker::currentThreadCounts();
+    const auto filtered = filterRows(image, firstRow, endRow);
+    const auto isFirst = firstRow == 0;
+    const auto isLast = endRow == image.rows;
+
+    EncodedBlock block;
+    block.filteredSize = filtered.size();
+    block.adler = adler32(adler32(0, nullptr, 0), filtered.data(), static_cast<uInt>(filtered.size()));
+
+    z_stream stream {};
+    // Raw deflate, the zlib header and checksum are written around the concatenated blocks
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, -15, 8, Z_RLE) != Z_OK)
+    {
+        throw std::runtime_error("Unable to initialize the PNG compressor");
+    }
+    const auto headerSize = isFirst ? sizeof(ZLIB_HEADER) : 0;
+    block.data.resize(headerSize + deflateBound(&stream, static_cast<uLong>(filtered.size())) + 16);
+    std::copy(ZLIB_HEADER, ZLIB_HEADER + headerSize, block.data.begin());
+    stream.next_in = const_cast<BYTE *>(filtered.data());
+    stream.avail_in = static_cast<uInt>(filtered.size());
+    size_t size = headerSize;
+    const auto flush = isLast ? Z_FINISH : Z_SYNC_FLUSH;
+    for (;;)
+    {
+        stream.next_out = block.data.data() + size;
+        stream.avail_out = static_cast<uInt>(block.data.size() - size);
+        const auto result = deflate(&stream, flush);
+        size = block.data.size() - stream.avail_out;
+        if (result == Z_STREAM_ERROR)
+        {
+            deflateEnd(&stream);
+            throw std::runtime_error("Unable to compress the PNG rows");
+        }
+        if (isLast ? result == Z_STREAM_END : stream.avail_in == 0 && stream.avail_out > 0)
+        {
+            break;
+        }
+        block.data.resize(block.data.size() * 2);
+    }
+    deflateEnd(&stream);
+    block.data.resize(size);
+    block.allocations = AllocationTracker::currentThreadCounts() - startAllocations;
+    return block;
+}
+} // namespace
+
+bool ParallelPngEncoder::supports(const cv::Mat & image)
+{
+    const auto channels = image.channels();
+    return !image.empty() && image.depth() == CV_8U && (channels == 1 || channels == 3 || channels == 4);
+}
+
+void ParallelPngEncoder::write(const cv::Mat & image, IOutputSink & sink, const double resolutionDpi)
+{
+    if (!supports(image))
+    {
+        throw std::runtime_error("Only 8 bit images with 1, 3 or 4 channels can be encoded as PNG");
+    }
+    static const BYTE PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    sink.write(reinterpret_cast<const char *>(PNG_SIGNATURE), sizeof(PNG_SIGNATURE));
+
+    const auto channels = image.channels();
+    std::vector<BYTE> header;
+    appendBigEndian32(header, static_cast<uint32_t>(image.cols));
+    appendBigEndian32(header, static_cast<uint32_t>(image.rows));
+    // Bit depth, colour type (grayscale, RGB or RGBA), then deflate, adaptive filtering and no interlacing
+    header.insert(header.end(), { 8, static_cast<BYTE>(channels == 1 ? 0 : channels == 3 ? 2 : 6), 0, 0, 0 });
+    writeChunk(sink, "IHDR", header);
+
+    if (resolutionDpi > 0)
+    {
+        std::vector<BYTE> resolution;
+        const auto pixelsPerMeter = static_cast<uint32_t>(roundInteger(resolutionDpi * 1000.0 / 25.4));
+        appendBigEndian32(resolution, pixelsPerMeter);
+        appendBigEndian32(resolution, pixelsPerMeter);
+        resolution.push_back(1); // Unit is the meter
+        writeChunk(sink, "pHYs", resolution);
+    }
+
+    const auto rowBytes = static_cast<size_t>(image.cols) * channels + 1;
+    const auto blockRows = static_cast<int>(std::max<size_t>(1, BLOCK_BYTES / rowBytes));
+    const auto numThreads = std::max(1, cv::getNumThreads());
+    // One thread per block in flight, the calling one only waits and writes
+    const auto maxPendingBlocks = static_cast<size_t>(numThreads);
+    const auto policy = numThreads > 1 ? std::launch::async : std::launch::deferred;
+
+    std::deque<std::future<EncodedBlock>> pendingBlocks;
+    auto adler = adler32(0, nullptr, 0);
+    // Writes the oldest block, the last one ends with the checksum of the whole stream
+    const auto writeOldestBlock = [&](const bool isLast) {
+        auto block = pendingBlocks.front().get();
+        pendingBlocks.pop_front();
+        // Deferred blocks were encoded on this thread, their allocations are already counted
+        if (policy == std::launch::async)
+        {
+            AllocationTracker::attributeToCurrentThread(block.allocations);
+        }
+        adler = adler32_combine(adler, block.adler, static_cast<z_off_t>(block.filteredSize));
+        if (isLast)
+        {
+            appendBigEndian32(block.data, static_cast<uint32_t>(adler));
+        }
+        writeChunk(sink, "IDAT", block.data);
+    };
+    for (auto firstRow = 0; firstRow < image.rows; firstRow += blockRows)
+    {
+        if (pendingBlocks.size() == maxPendingBlocks)
+        {
+            writeOldestBlock(false);
+        }
+        const auto endRow = std::min(image.rows, firstRow + blockRows);
+        pendingBlocks.push_back(std::async(policy, encodeBlock, std::cref(image), firstRow, endRow));
+    }
+    while (!pendingBlocks.empty())
+    {
+        writeOldestBlock(pendingBlocks.size() == 1);
+    }
+    writeChunk(sink, "IEND", {});
+}
+#else
+bool ParallelPngEncoder::supports(const cv::Mat & /*image*/)
+{
+    return false;
+}
+
+void ParallelPngEncoder::write(const cv::Mat & /*image*/, IOutputSink & /*sink*/, const double /*resolutionDpi*/)
+{
+    throw std::runtime_error("The library was built without zlib, PNG files can not be encoded in parallel");
+}
+#endif
+} // namespace ppp
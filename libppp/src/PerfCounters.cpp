@@ -0,0 +1,124 @@
+#include "PerfCounters.h"
+
+#if defined(__linux__) && !defined(__ANDROID__) && !defined(EMSCRIPTEN)
+#define PPP_HAS_PERF_EVENTS
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ppp
+{
+PerfCounterValues PerfCounterValues::operator-(const PerfCounterValues & other) const
+{
+    PerfCounterValues result;
+    result.cycles = cycles - other.cycles;
+    result.instructions = instructions - other.instructions;
+    result.cacheMisses = cacheMisses - other.cacheMisses;
+    result.branchMisses = branchMisses - other.branchMisses;
+    return result;
+}
+
+PerfCounterValues & PerfCounterValues::operator+=(const PerfCounterValues & other)
+{
+    cycles += other.cycles;
+    instructions += other.instructions;
+    cacheMisses += other.cacheMisses;
+    branchMisses += other.branchMisses;
+    return *this;
+}
+
+#ifdef PPP_HAS_PERF_EVENTS
+static int openCounter(const uint64_t config, const int groupFd)
+{
+    perf_event_attr attr {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // Count the calling thread on any CPU
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+#ifdef PPP_HAS_PERF_EVENTS
+    const uint64_t events[NUM_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES,
+                                            PERF_COUNT_HW_INSTRUCTIONS,
+                                            PERF_COUNT_HW_CACHE_MISSES,
+                                            PERF_COUNT_HW_BRANCH_MISSES };
+    for (auto i = 0; i < NUM_COUNTERS; ++i)
+    {
+        m_fds[i] = openCounter(events[i], m_fds[0]);
+        if (m_fds[i] < 0)
+        {
+            // All or nothing, partial groups would report misleading ratios
+            for (auto & fd : m_fds)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+                fd = -1;
+            }
+            return;
+        }
+    }
+    ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef PPP_HAS_PERF_EVENTS
+    for (const auto fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::isAvailable() const
+{
+    return m_fds[0] >= 0;
+}
+
+PerfCounterValues PerfCounters::read() const
+{
+    PerfCounterValues values;
+#ifdef PPP_HAS_PERF_EVENTS
+    if (!isAvailable())
+    {
+        return values;
+    }
+    struct
+    {
+        uint64_t numValues;
+        uint64_t values[NUM_COUNTERS];
+    } groupData {};
+    if (::read(m_fds[0], &groupData, sizeof(groupData)) == sizeof(groupData))
+    {
+        values.cycles = groupData.values[0];
+        values.instructions = groupData.values[1];
+        values.cacheMisses = groupData.values[2];
+        values.branchMisses = groupData.values[3];
+    }
+#endif
+    return values;
+}
+
+PerfCounters & PerfCounters::forCurrentThread()
+{
+    thread_local PerfCounters counters;
+    return counters;
+}
+} // namespace ppp
@@ -1,9 +1,15 @@
 #include "PhotoPrintMaker.h"
+#include "ColorLut3D.h"
 #include "ConfigLoader.h"
+#include "JpegLosslessCrop.h"
+#include "ParameterOverrides.h"
 #include "PhotoStandard.h"
 #include "PrintDefinition.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
 
+#include <algorithm>
+
 #include <opencv2/imgproc/imgproc.hpp>
 
 using namespace cv;
@@ -16,12 +22,53 @@ void PhotoPrintMaker::configureInternal(const ConfigLoaderSPtr & cfg)
     auto & ppmConfig = cfg->get({ "photoPrintMaker" });
     const auto rgbArr = ppmConfig["background"].GetArray();
     m_backgroundColor = Scalar(rgbArr[0].GetInt(), rgbArr[1].GetInt(), rgbArr[2].GetInt());
+    m_backgroundReplacer.configure(cfg);
+    if (ppmConfig.HasMember("losslessJpegCrop"))
+    {
+        const auto & losslessConfig = ppmConfig["losslessJpegCrop"];
+        m_losslessJpegCrop = Utilities::getField(losslessConfig, "enabled", m_losslessJpegCrop);
+        m_maxLosslessScaleError = Utilities::getField(losslessConfig, "maxScaleError", m_maxLosslessScaleError);
+        m_maxLosslessShift = Utilities::getField(losslessConfig, "maxShift", m_maxLosslessShift);
+    }
 }
 
 Mat PhotoPrintMaker::cropPicture(const Mat & originalImage,
                                  const Point & crownPoint,
                                  const Point & chinPoint,
-                                 const PhotoStandard & ps)
+                                 const PhotoStandard & ps,
+                                 const ParameterOverrides * overrides)
+{
+    Mat transform;
+    auto cropImage = warpCrop(originalImage, crownPoint, chinPoint, ps, transform);
+    if (m_backgroundReplacer.isEnabled())
+    {
+        const std::vector<Point2d> marks = { crownPoint, chinPoint };
+        std::vector<Point2d> cropMarks;
+        cv::transform(marks, cropMarks, transform);
+        m_backgroundReplacer.replace(cropImage, cropMarks[0], cropMarks[1], backgroundColor(overrides));
+    }
+    return cropImage;
+}
+
+Mat PhotoPrintMaker::warpCrop(const Mat & originalImage,
+                              const Point & crownPoint,
+                              const Point & chinPoint,
+                              const PhotoStandard & ps,
+                              Mat & transform) const
+{
+    PPP_STAGE_SCOPE("crop");
+    Size cropSize;
+    transform = cropTransform(crownPoint, chinPoint, ps, cropSize);
+
+    Mat cropImage;
+    warpAffine(originalImage, cropImage, transform, cropSize);
+    return cropImage;
+}
+
+Mat PhotoPrintMaker::cropTransform(const Point & crownPoint,
+                                   const Point & chinPoint,
+                                   const PhotoStandard & ps,
+                                   Size & cropSize) const
 {
     const auto centerCrop = centerCropEstimation(ps, crownPoint, chinPoint);
 
@@ -40,24 +87,92 @@ Mat PhotoPrintMaker::cropPicture(const Mat & originalImage,
     const Point2f dstPoints[3] = { Point2d(cropWidthPix / 2.0, cropHeightPix / 2.0),
                                    Point2d(0.0, cropHeightPix / 2.0),
                                    Point2d(cropWidthPix / 2.0, 0.0) };
-    const auto transform = getAffineTransform(srcPoints, dstPoints);
+    cropSize = Size(roundInteger(cropWidthPix), roundInteger(cropHeightPix));
+    return getAffineTransform(srcPoints, dstPoints);
+}
 
-    Mat cropImage;
-    warpAffine(originalImage, cropImage, transform, Size(roundInteger(cropWidthPix), roundInteger(cropHeightPix)));
-    return cropImage;
+Rect PhotoPrintMaker::cropBoundingBox(const Point & crownPoint, const Point & chinPoint, const PhotoStandard & ps)
+{
+    // Corners of the crop mapped back into the picture
+    Size cropSize;
+    Mat toPicture;
+    invertAffineTransform(cropTransform(crownPoint, chinPoint, ps, cropSize), toPicture);
+    const Matx23d inverse = toPicture;
+    std::vector<Point2f> corners;
+    for (const auto & corner : { Point(0, 0), Point(cropSize.width, 0), Point(0, cropSize.height), Point(cropSize) })
+    {
+        const Vec2d cornerInPicture = inverse * Vec3d(corner.x, corner.y, 1.0);
+        corners.emplace_back(static_cast<float>(cornerInPicture[0]), static_cast<float>(cornerInPicture[1]));
+    }
+
+    // Leave one extra pixel around for the interpolation done by warpAffine
+    const auto boundingBox = boundingRect(corners);
+    return Rect(boundingBox.x - 1, boundingBox.y - 1, boundingBox.width + 2, boundingBox.height + 2);
 }
 
-Mat PhotoPrintMaker::tileCroppedPhoto(const PrintDefinition & pd, const PhotoStandard & ps, const Mat & croppedImage)
+bool PhotoPrintMaker::cropJpegLossless(const std::vector<BYTE> & jpeg,
+                                       const Point & crownPoint,
+                                       const Point & chinPoint,
+                                       const PhotoStandard & ps,
+                                       std::vector<BYTE> & output)
 {
-    if (ps.resolutionDpi() > pd.resolutionDpi())
+    JpegFrameInfo frameInfo;
+    if (!m_losslessJpegCrop || m_backgroundReplacer.isEnabled() || !JpegLosslessCrop::readFrameInfo(jpeg, frameInfo))
     {
-        pd.overrideResolution(ps.resolutionDpi());
+        return false;
     }
-    else if (ps.resolutionDpi() < pd.resolutionDpi())
+
+    // Transform from the picture to the photo at print resolution (crop then resize), which has to be a translation
+    Size cropSize;
+    const Matx23d transform = cropTransform(crownPoint, chinPoint, ps, cropSize);
+    const Size photoSize(roundInteger(ps.photoWidth()), roundInteger(ps.photoHeight()));
+    const auto sx = static_cast<double>(photoSize.width) / cropSize.width;
+    const auto sy = static_cast<double>(photoSize.height) / cropSize.height;
+    const Matx22d linear(transform(0, 0) * sx, transform(0, 1) * sx, transform(1, 0) * sy, transform(1, 1) * sy);
+    if (norm(linear - Matx22d::eye(), NORM_INF) > m_maxLosslessScaleError)
     {
-        ps.overrideResolution(pd.resolutionDpi());
+        return false;
     }
 
+    // Top left corner of the photo in the picture, moved onto the MCU grid
+    const auto origin = -(linear.inv() * Vec2d(transform(0, 2) * sx, transform(1, 2) * sy));
+    const auto & mcuSize = frameInfo.mcuSize;
+    const Point alignedOrigin(roundInteger(origin[0] / mcuSize.width) * mcuSize.width,
+                              roundInteger(origin[1] / mcuSize.height) * mcuSize.height);
+    if (norm(Point2d(alignedOrigin) - Point2d(origin[0], origin[1])) > m_maxLosslessShift * photoSize.height)
+    {
+        return false;
+    }
+    return JpegLosslessCrop::crop(jpeg, Rect(alignedOrigin, photoSize), output);
+}
+
+Mat PhotoPrintMaker::tileCroppedPhoto(const PrintDefinition & pd,
+                                      const PhotoStandard & ps,
+                                      const Mat & croppedImage,
+                                      const ColorLut3D * colorCorrection,
+                                      const ParameterOverrides * overrides)
+{
+    PPP_STAGE_SCOPE("tile");
+    const auto & background = backgroundColor(overrides);
+    // Print at the highest of both resolutions, copies are only made when the resolutions differ
+    const auto printDpi = std::max(ps.resolutionDpi(), pd.resolutionDpi());
+    if (ps.resolutionDpi() != printDpi)
+    {
+        return tileAtPrintResolution(pd, ps.withResolution(printDpi), croppedImage, colorCorrection, background);
+    }
+    if (pd.resolutionDpi() != printDpi)
+    {
+        return tileAtPrintResolution(pd.withResolution(printDpi), ps, croppedImage, colorCorrection, background);
+    }
+    return tileAtPrintResolution(pd, ps, croppedImage, colorCorrection, background);
+}
+
+Mat PhotoPrintMaker::tileAtPrintResolution(const PrintDefinition & pd,
+                                           const PhotoStandard & ps,
+                                           const Mat & croppedImage,
+                                           const ColorLut3D * colorCorrection,
+                                           const Scalar & backgroundColor)
+{
     const Size tileSizePixels(roundInteger(ps.photoWidth()), roundInteger(ps.photoHeight()));
     // Resize input crop to the print resolution
     Mat templateImage;
@@ -65,6 +180,10 @@ Mat PhotoPrintMaker::tileCroppedPhoto(const PrintDefinition & pd, const PhotoSta
     if (pd.width() <= 0 || pd.height() <= 0)
     {
         // This is digital size output
+        if (colorCorrection != nullptr)
+        {
+            colorCorrection->apply(templateImage);
+        }
         return templateImage;
     }
 
@@ -75,7 +194,7 @@ Mat PhotoPrintMaker::tileCroppedPhoto(const PrintDefinition & pd, const PhotoSta
     const auto numPhotoRows = floorInteger(pd.height() / (ps.photoHeight() + pd.gutter()));
     const auto numPhotoCols = floorInteger(pd.width() / (ps.photoWidth() + pd.gutter()));
 
-    Mat printPhoto(canvasHeightPixels, canvasWidthPixels, croppedImage.type(), m_backgroundColor);
+    Mat printPhoto(canvasHeightPixels, canvasWidthPixels, croppedImage.type(), backgroundColor);
 
     const auto dx = roundInteger(ps.photoWidth() + pd.gutter());
     const auto dy = roundInteger(ps.photoHeight() + pd.gutter());
@@ -88,12 +207,44 @@ Mat PhotoPrintMaker::tileCroppedPhoto(const PrintDefinition & pd, const PhotoSta
         for (auto col = 0; col < numPhotoCols; ++col)
         {
             Point topLeft(xOffset + col * dx, yOffset + row * dy);
-            templateImage.copyTo(printPhoto(Rect(topLeft, tileSizePixels)));
+            auto tile = printPhoto(Rect(topLeft, tileSizePixels));
+            if (colorCorrection != nullptr && row == 0 && col == 0)
+            {
+                // Corrected once, straight into the first tile, which the other tiles are then copied from
+                colorCorrection->apply(templateImage, tile);
+                templateImage = tile;
+                continue;
+            }
+            templateImage.copyTo(tile);
         }
     }
     return printPhoto;
 }
 
+Mat PhotoPrintMaker::renderGangSheet(const PrintDefinition & pd,
+                                     const GangSheet & sheet,
+                                     const std::vector<Mat> & tileImages,
+                                     const ParameterOverrides * overrides)
+{
+    PPP_STAGE_SCOPE("gangSheet");
+    const auto canvasWidthPixels = roundInteger(pd.totalWidth());
+    const auto canvasHeightPixels = roundInteger(pd.totalHeight());
+    const auto canvasPaddingPixels = roundInteger(pd.padding());
+
+    Mat printPhoto(canvasHeightPixels, canvasWidthPixels, CV_8UC3, backgroundColor(overrides));
+    for (size_t i = 0; i < sheet.size(); ++i)
+    {
+        const auto tileRect = sheet[i].rect + Point(canvasPaddingPixels, canvasPaddingPixels);
+        tileImages[i].copyTo(printPhoto(tileRect));
+    }
+    return printPhoto;
+}
+
+const Scalar & PhotoPrintMaker::backgroundColor(const ParameterOverrides * overrides) const
+{
+    return overrides != nullptr && overrides->backgroundColor ? *overrides->backgroundColor : m_backgroundColor;
+}
+
 Point2d PhotoPrintMaker::centerCropEstimation(const PhotoStandard & ps,
                                               const Point & crownPoint,
                                               const Point & chinPoint) const
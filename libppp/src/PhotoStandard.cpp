@@ -1,6 +1,8 @@
 #include "PhotoStandard.h"
 #include "Utilities.h"
 
+#include <algorithm>
+
 namespace ppp
 {
 PhotoStandard::PhotoStandard(const double photoWidth,
@@ -34,26 +36,46 @@ PhotoStandard::PhotoStandard(const double photoWidth,
     m_crownTop = crownTop;
     m_resolution_dpi = picResolution;
     m_units = units;
+
+    m_photoWidthPix = Utilities::toPixels(m_photoWidth, m_units, m_resolution_dpi);
+    m_photoHeightPix = Utilities::toPixels(m_photoHeight, m_units, m_resolution_dpi);
+    m_faceHeightPix = Utilities::toPixels(m_faceHeight, m_units, m_resolution_dpi);
+    m_crownTopPix = Utilities::toPixels(m_crownTop, m_units, m_resolution_dpi);
 }
 
 double PhotoStandard::photoWidth(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_photoWidthPix;
+    }
     return Utilities::convert(m_photoWidth, m_units, units, m_resolution_dpi);
 }
 
 double PhotoStandard::photoHeight(const std::string & units) const
 {
-
+    if (units == "pixel")
+    {
+        return m_photoHeightPix;
+    }
     return Utilities::convert(m_photoHeight, m_units, units, m_resolution_dpi);
 }
 
 double PhotoStandard::faceHeight(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_faceHeightPix;
+    }
     return Utilities::convert(m_faceHeight, m_units, units, m_resolution_dpi);
 }
 
 double PhotoStandard::crownTop(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_crownTopPix;
+    }
     return Utilities::convert(m_crownTop, m_units, units, m_resolution_dpi);
 }
 
@@ -62,9 +84,10 @@ double PhotoStandard::resolutionDpi() const
     return m_resolution_dpi;
 }
 
-void PhotoStandard::overrideResolution(const double newDpi) const
+PhotoStandard PhotoStandard::withResolution(const double newDpi) const
 {
-    m_resolution_dpi = newDpi;
+    // Crown top is already resolved from the eye line, negative values have the same meaning as zero
+    return PhotoStandard(m_photoWidth, m_photoHeight, m_faceHeight, std::max(m_crownTop, 0.0), 0.0, newDpi, m_units);
 }
 
 PhotoStandardSPtr PhotoStandard::fromJson(const std::string & photoStandardJson)
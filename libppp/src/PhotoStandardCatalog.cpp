@@ -0,0 +1,141 @@
+#include "PhotoStandardCatalog.h"
+#include "ConfigLoader.h"
+#include "PhotoStandard.h"
+#include "PrintDefinition.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace ppp
+{
+PhotoStandardCatalog::PhotoStandardCatalog()
+: m_snapshot(std::make_shared<const CatalogSnapshot>())
+{
+}
+
+PhotoStandardSPtr PhotoStandardCatalog::photoStandard(const std::string & id) const
+{
+    const auto catalog = snapshot();
+    const auto it = catalog->photoStandards.find(id);
+    if (it == catalog->photoStandards.end())
+    {
+        throw std::runtime_error("Photo standard '" + id + "' not found in the catalog");
+    }
+    return it->second;
+}
+
+PhotoStandardSPtr PhotoStandardCatalog::photoStandard(const std::string & id, const double dpi) const
+{
+    const auto catalog = snapshot();
+    const auto it = catalog->photoStandards.find(id);
+    if (it == catalog->photoStandards.end())
+    {
+        throw std::runtime_error("Photo standard '" + id + "' not found in the catalog");
+    }
+    if (it->second->resolutionDpi() == dpi)
+    {
+        return it->second;
+    }
+    const auto & rescaled = catalog->printResolutionStandards.at(id);
+    const auto match = std::find_if(rescaled.begin(), rescaled.end(), [dpi](const PhotoStandardSPtr & ps) {
+        return ps->resolutionDpi() == dpi;
+    });
+    return match != rescaled.end() ? *match : std::make_shared<PhotoStandard>(it->second->withResolution(dpi));
+}
+
+PrintDefinitionSPtr PhotoStandardCatalog::printDefinition(const std::string & id) const
+{
+    const auto catalog = snapshot();
+    const auto it = catalog->printDefinitions.find(id);
+    if (it == catalog->printDefinitions.end())
+    {
+        throw std::runtime_error("Print definition '" + id + "' not found in the catalog");
+    }
+    return it->second;
+}
+
+void PhotoStandardCatalog::registerPhotoStandard(const std::string & id, const PhotoStandardSPtr & photoStandard)
+{
+    update([&](CatalogSnapshot & catalog) { catalog.photoStandards[id] = photoStandard; });
+}
+
+void PhotoStandardCatalog::registerPrintDefinition(const std::string & id, const PrintDefinitionSPtr & printDefinition)
+{
+    update([&](CatalogSnapshot & catalog) { catalog.printDefinitions[id] = printDefinition; });
+}
+
+std::shared_ptr<const CatalogSnapshot> PhotoStandardCatalog::snapshot() const
+{
+    return std::atomic_load(&m_snapshot);
+}
+
+void PhotoStandardCatalog::configureInternal(const ConfigLoaderSPtr & config)
+{
+    auto & rootConfig = config->get({});
+    if (!rootConfig.HasMember("catalog"))
+    {
+        return;
+    }
+    auto & catalogConfig = config->get({ "catalog" });
+    update([&catalogConfig](CatalogSnapshot & catalog) {
+        if (catalogConfig.HasMember("photoStandards"))
+        {
+            for (const auto & entry : catalogConfig["photoStandards"].GetArray())
+            {
+                catalog.photoStandards[entry["id"].GetString()] = PhotoStandard::fromJson(entry["dimensions"]);
+            }
+        }
+        if (catalogConfig.HasMember("printDefinitions"))
+        {
+            for (auto & entry : catalogConfig["printDefinitions"].GetArray())
+            {
+                catalog.printDefinitions[entry["id"].GetString()] = PrintDefinition::fromJson(entry);
+            }
+        }
+    });
+}
+
+void PhotoStandardCatalog::update(const std::function<void(CatalogSnapshot & snapshot)> & modify)
+{
+    auto current = snapshot();
+    while (true)
+    {
+        auto next = std::make_shared<CatalogSnapshot>(*current);
+        modify(*next);
+        precomputePrintResolutions(*next);
+        std::shared_ptr<const CatalogSnapshot> published = std::move(next);
+        // Retry on top of the newer snapshot if another thread registered something in the meantime
+        if (std::atomic_compare_exchange_strong(&m_snapshot, &current, published))
+        {
+            return;
+        }
+    }
+}
+
+void PhotoStandardCatalog::precomputePrintResolutions(CatalogSnapshot & snapshot)
+{
+    std::vector<double> printResolutions;
+    for (const auto & kv : snapshot.printDefinitions)
+    {
+        const auto dpi = kv.second->resolutionDpi();
+        if (dpi > 0 && std::find(printResolutions.begin(), printResolutions.end(), dpi) == printResolutions.end())
+        {
+            printResolutions.push_back(dpi);
+        }
+    }
+
+    snapshot.printResolutionStandards.clear();
+    for (const auto & kv : snapshot.photoStandards)
+    {
+        auto & rescaled = snapshot.printResolutionStandards[kv.first];
+        for (const auto dpi : printResolutions)
+        {
+            if (dpi != kv.second->resolutionDpi())
+            {
+                rescaled.push_back(std::make_shared<PhotoStandard>(kv.second->withResolution(dpi)));
+            }
+        }
+    }
+}
+} // namespace ppp
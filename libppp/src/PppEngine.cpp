@@ -1,20 +1,31 @@
 
+#include <chrono>
+#include <deque>
+#include <future>
 #include <istream>
 #include <streambuf>
+#include <thread>
 
+#include "BatchShapePredictor.h"
 #include "ComplianceChecker.h"
 #include "ComplianceResult.h"
+#include "ColorLut3D.h"
+#include "ColorProfileStore.h"
 #include "CrownChinEstimator.h"
+#include "EasyExif.h"
 #include "EyeDetector.h"
 #include "FaceDetector.h"
+#include "GangSheetPacker.h"
 #include "ConfigLoader.h"
 #include "ImageStore.h"
 #include "LandMarks.h"
 #include "LipsDetector.h"
 #include "PhotoPrintMaker.h"
 #include "PhotoStandard.h"
+#include "PhotoStandardCatalog.h"
 #include "PppEngine.h"
 #include "PrintDefinition.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
 
 #include <dlib/image_processing/shape_predictor.h>
@@ -26,6 +37,20 @@ using namespace std;
 
 namespace ppp
 {
+namespace
+{
+/*!@brief Skin area of the face in a crop made for the photo standard, i.e. without the hair above the forehead !*/
+cv::Rect faceRegionInCrop(const PhotoStandard & ps, const cv::Size & cropSize)
+{
+    const auto faceHeight = cropSize.height * ps.faceHeight() / ps.photoHeight();
+    const auto crownY = ps.crownTop() > 0 ? cropSize.height * ps.crownTop() / ps.photoHeight()
+                                          : (cropSize.height - faceHeight) / 2.0;
+    return cv::Rect(roundInteger(cropSize.width / 2.0 - 0.3 * faceHeight),
+                    roundInteger(crownY + 0.25 * faceHeight),
+                    roundInteger(0.6 * faceHeight),
+                    roundInteger(0.65 * faceHeight));
+}
+} // namespace
 
 PppEngine::PppEngine(const IDetectorSPtr & pFaceDetector,
                      const IDetectorSPtr & pEyesDetector,
@@ -41,12 +66,14 @@ PppEngine::PppEngine(const IDetectorSPtr & pFaceDetector,
 , m_complianceChecker(pComplianceChecker ? pComplianceChecker : make_shared<ComplianceChecker>())
 , m_pPhotoPrintMaker(pPhotoPrintMaker ? pPhotoPrintMaker : make_shared<PhotoPrintMaker>())
 , m_pImageStore(pImageStore ? pImageStore : make_shared<ImageStore>())
+, m_pCatalog(make_shared<PhotoStandardCatalog>())
+, m_pColorProfiles(make_shared<ColorProfileStore>())
 {
 }
 
 bool PppEngine::isConfigured() const
 {
-    return m_shapePredictor != nullptr && m_pFaceDetector->isConfigured() && m_pEyesDetector->isConfigured()
+    return m_batchShapePredictor != nullptr && m_pFaceDetector->isConfigured() && m_pEyesDetector->isConfigured()
         && m_pLipsDetector->isConfigured();
 }
 
@@ -58,23 +85,38 @@ bool PppEngine::configure(const std::string & configFilePathOrContent, void * ca
             reinterpret_cast<VoidFn *>(callback)();
     });
 
-    configLoader->loadResource({ "shapePredictor" }, [this](const bool success, std::istream & stream) {
-        const auto shapePredictorObj = std::make_shared<dlib::shape_predictor>();
-        if (stream.good())
-        {
-            deserialize(*shapePredictorObj, stream);
-            m_shapePredictor = shapePredictorObj;
-        }
-    });
+    // Stops the shape predictor early once the shape moves less than this fraction of the face size, 0 to disable
+    const auto convergenceThreshold
+        = Utilities::getField(configLoader->get({ "shapePredictor" }), "convergenceThreshold", 0.0f);
+    configLoader->loadResource({ "shapePredictor" },
+                               [this, convergenceThreshold](const bool success, std::istream & stream) {
+                                   if (stream.good())
+                                   {
+                                       dlib::shape_predictor shapePredictor;
+                                       deserialize(shapePredictor, stream);
+                                       const auto batchShapePredictor
+                                           = std::make_shared<BatchShapePredictor>(shapePredictor);
+                                       batchShapePredictor->setConvergenceThreshold(convergenceThreshold);
+                                       m_batchShapePredictor = batchShapePredictor;
+                                   }
+                               });
 
     m_pFaceDetector->configure(configLoader);
     m_pEyesDetector->configure(configLoader);
     m_pLipsDetector->configure(configLoader);
     m_pCrownChinEstimator->configure(configLoader);
     m_pImageStore->configure(configLoader);
+    m_pCatalog->configure(configLoader);
+    m_pColorProfiles->configure(configLoader);
 
     m_pPhotoPrintMaker->configure(configLoader);
 
+    // Hardware counters cost a system call at each stage boundary, so they are opt-in
+    const auto & rootConfig = configLoader->get({});
+    StageMetrics::setHardwareCountersEnabled(
+        rootConfig.HasMember("metrics")
+        && Utilities::getField(configLoader->get({ "metrics" }), "hardwareCounters", false));
+
     const auto & spConfig = configLoader->get({ "shapePredictor" });
 
     // Prepare landmark mapping
@@ -118,53 +160,202 @@ void PppEngine::verifyImageExists(const string & imageKey) const
 bool PppEngine::detectLandMarks(const string & imageKey) const
 {
     verifyImageExists(imageKey);
-    // Convert the image to gray scale as needed by some algorithms
 
-    const auto & inputImage = m_pImageStore->getImage(imageKey);
-    const auto & landMarks = m_pImageStore->getLandMarks(imageKey);
-    cv::Mat grayImage;
-    cvtColor(inputImage, grayImage, cv::COLOR_BGR2GRAY);
+    // The detectors and the shape predictor all read the luma, so that the landmarks do not depend on whether the
+    // store keeps the image as BGR pixels or as planes
+    const auto grayImage = m_pImageStore->getLumaImage(imageKey);
+    const auto landMarks = m_pImageStore->getLandMarks(imageKey);
+    if (grayImage.empty() || landMarks == nullptr)
+    {
+        // Evicted by another request since it was checked
+        throw runtime_error("Image with key='" + imageKey + "' not found!");
+    }
 
+    auto detected = reuseNearDuplicateLandMarks(imageKey, grayImage, *landMarks);
     // Detect the face
-    if (!m_pFaceDetector->detectLandMarks(grayImage, *landMarks))
+    if (!detected && m_pFaceDetector->detectLandMarks(grayImage, *landMarks))
     {
-        return false;
+        detectShapeLandMarks(grayImage, *landMarks);
+
+        // Estimate chin and crown point (maths from existing landmarks)
+        detected = m_pCrownChinEstimator->estimateCrownChin(*landMarks);
     }
+    // Detected into a copy, the store keeps them packed
+    m_pImageStore->setLandMarks(imageKey, *landMarks);
+    return detected;
+}
 
+bool PppEngine::detectLandMarks(const string & imageKey,
+                                const ParameterOverrides & overrides,
+                                LandMarks & landMarks) const
+{
+    const auto detected = detectLandMarks(imageKey);
+    const auto storedLandMarks = m_pImageStore->getLandMarks(imageKey);
+    if (storedLandMarks == nullptr)
+    {
+        throw runtime_error("Image with key='" + imageKey + "' not found!");
+    }
+    landMarks = *storedLandMarks;
+    if (!detected || (!overrides.chinCrownCoeff && !overrides.chinFrownCoeff))
+    {
+        return detected;
+    }
+    return m_pCrownChinEstimator->estimateCrownChin(landMarks, &overrides);
+}
+
+std::vector<bool> PppEngine::detectLandMarks(const std::vector<std::string> & imageKeys) const
+{
+    std::vector<bool> detected(imageKeys.size(), false);
+    // Faces still needing the shape predictor
+    std::vector<size_t> faces;
+    std::vector<cv::Mat> grayImages(imageKeys.size());
+    // Copies detected into, stored back at the end
+    std::vector<LandMarksSPtr> landMarksOf(imageKeys.size());
+    const auto storeLandMarks = [&]() {
+        for (size_t i = 0; i < imageKeys.size(); ++i)
+        {
+            m_pImageStore->setLandMarks(imageKeys[i], *landMarksOf[i]);
+        }
+    };
+    for (size_t i = 0; i < imageKeys.size(); ++i)
+    {
+        const auto & imageKey = imageKeys[i];
+        verifyImageExists(imageKey);
+        const auto grayImage = m_pImageStore->getLumaImage(imageKey);
+        const auto landMarks = landMarksOf[i] = m_pImageStore->getLandMarks(imageKey);
+        if (grayImage.empty() || landMarks == nullptr)
+        {
+            throw runtime_error("Image with key='" + imageKey + "' not found!");
+        }
+        if (reuseNearDuplicateLandMarks(imageKey, grayImage, *landMarks))
+        {
+            detected[i] = true;
+        }
+        else if (m_pFaceDetector->detectLandMarks(grayImage, *landMarks))
+        {
+            grayImages[i] = grayImage;
+            faces.push_back(i);
+        }
+    }
+    if (faces.empty())
+    {
+        storeLandMarks();
+        return detected;
+    }
+
+    PPP_STAGE_SCOPE("shapePrediction");
     using namespace dlib;
-    // Detect the face
-    if (!m_pFaceDetector->detectLandMarks(grayImage, *landMarks))
+    std::vector<array2d<unsigned char>> dlibImages(faces.size());
+    std::vector<const array2d<unsigned char> *> images;
+    std::vector<rectangle> faceRects;
+    for (size_t j = 0; j < faces.size(); ++j)
     {
-        return false;
+        assign_image(dlibImages[j], cv_image<unsigned char>(grayImages[faces[j]]));
+        images.push_back(&dlibImages[j]);
+        const auto & r = landMarksOf[faces[j]]->vjFaceRect;
+        faceRects.emplace_back(r.x, r.y, r.x + r.width, r.y + r.height);
+    }
+    std::vector<size_t> numCascades;
+    const auto shapes = (*m_batchShapePredictor)(images, faceRects, &numCascades);
+    for (size_t j = 0; j < faces.size(); ++j)
+    {
+        auto & landMarks = *landMarksOf[faces[j]];
+        assignShapeLandMarks(shapes[j], numCascades[j], landMarks);
+        detected[faces[j]] = m_pCrownChinEstimator->estimateCrownChin(landMarks);
     }
-    array2d<bgr_pixel> dlibImage;
-    assign_image(dlibImage, cv_image<bgr_pixel>(inputImage));
+    storeLandMarks();
+    return detected;
+}
 
-    const auto & r = landMarks->vjFaceRect;
+void PppEngine::detectShapeLandMarks(const cv::Mat & grayImage, LandMarks & landMarks) const
+{
+    PPP_STAGE_SCOPE("shapePrediction");
+    using namespace dlib;
+    const auto & r = landMarks.vjFaceRect;
     const auto faceRect = rectangle(r.x, r.y, r.x + r.width, r.y + r.height);
-    auto shape = (*m_shapePredictor)(dlibImage, faceRect);
 
+    // Also for a single face, as the batch predictor can stop once the shape has converged
+    array2d<unsigned char> dlibImage;
+    assign_image(dlibImage, cv_image<unsigned char>(grayImage));
+    std::vector<size_t> numCascades;
+    const auto shapes = (*m_batchShapePredictor)(
+        std::vector<const array2d<unsigned char> *> { &dlibImage }, { faceRect }, &numCascades);
+
+    assignShapeLandMarks(shapes.front(), numCascades.front(), landMarks);
+}
+
+void PppEngine::assignShapeLandMarks(const dlib::full_object_detection & shape,
+                                     const size_t numCascades,
+                                     LandMarks & landMarks) const
+{
+    landMarks.shapeCascades = static_cast<int>(numCascades);
     const auto numParts = shape.num_parts();
-    landMarks->allLandmarks.clear();
-    landMarks->allLandmarks.reserve(numParts);
+    landMarks.allLandmarks.clear();
+    landMarks.allLandmarks.reserve(numParts);
     for (size_t i = 0; i < numParts; ++i)
     {
-        auto & part = shape.part(i);
-        landMarks->allLandmarks.emplace_back(part.x(), part.y());
+        const auto & part = shape.part(i);
+        landMarks.allLandmarks.emplace_back(part.x(), part.y());
     }
 
-    const auto & lms = landMarks->allLandmarks;
-    landMarks->lipLeftCorner = getLandMark(lms, LandMarkType::MOUTH_CORNER_LEFT);
-    landMarks->lipRightCorner = getLandMark(lms, LandMarkType::MOUTH_CORNER_RIGHT);
-    landMarks->eyeLeftPupil = getLandMark(lms, LandMarkType::EYE_PUPIL_CENTER_LEFT);
-    landMarks->eyeRightPupil = getLandMark(lms, LandMarkType::EYE_PUPIL_CENTER_RIGHT);
-    landMarks->chinPoint = getLandMark(lms, LandMarkType::CHIN_LOWEST_POINT);
-    landMarks->noseTip = getLandMark(lms, LandMarkType::NOSE_TIP_POINT);
-    landMarks->eyeLeftCorner = getLandMark(lms, LandMarkType::EYE_OUTER_CORNER_LEFT);
-    landMarks->eyeRightCorner = getLandMark(lms, LandMarkType::EYE_OUTER_CORNER_RIGHT);
+    const auto & lms = landMarks.allLandmarks;
+    landMarks.lipLeftCorner = getLandMark(lms, LandMarkType::MOUTH_CORNER_LEFT);
+    landMarks.lipRightCorner = getLandMark(lms, LandMarkType::MOUTH_CORNER_RIGHT);
+    landMarks.eyeLeftPupil = getLandMark(lms, LandMarkType::EYE_PUPIL_CENTER_LEFT);
+    landMarks.eyeRightPupil = getLandMark(lms, LandMarkType::EYE_PUPIL_CENTER_RIGHT);
+    landMarks.chinPoint = getLandMark(lms, LandMarkType::CHIN_LOWEST_POINT);
+    landMarks.noseTip = getLandMark(lms, LandMarkType::NOSE_TIP_POINT);
+    landMarks.eyeLeftCorner = getLandMark(lms, LandMarkType::EYE_OUTER_CORNER_LEFT);
+    landMarks.eyeRightCorner = getLandMark(lms, LandMarkType::EYE_OUTER_CORNER_RIGHT);
+}
+
+bool PppEngine::reuseNearDuplicateLandMarks(const std::string & imageKey,
+                                            const cv::Mat & grayImage,
+                                            LandMarks & landMarks) const
+{
+    cv::Size similarImageSize;
+    const auto similarLandMarks = m_pImageStore->findSimilarImage(imageKey, similarImageSize);
+    if (similarLandMarks == nullptr)
+    {
+        return false;
+    }
+
+    // Only a change of scale can be mapped, a different aspect ratio means the photo was cropped
+    const auto sx = static_cast<double>(grayImage.cols) / similarImageSize.width;
+    const auto sy = static_cast<double>(grayImage.rows) / similarImageSize.height;
+    if (std::abs(sx - sy) > 0.01 * std::max(sx, sy))
+    {
+        return false;
+    }
+
+    auto candidate = *similarLandMarks;
+    candidate.scale(sx, sy);
+    candidate.imageKey = landMarks.imageKey;
+    const auto mappedShape = candidate.allLandmarks;
+
+    // Refine the mapped landmarks on this image, skipping the face search
+    detectShapeLandMarks(grayImage, candidate);
+    if (mappedShape.size() != candidate.allLandmarks.size() || mappedShape.empty())
+    {
+        return false;
+    }
+    auto shapeError = 0.0;
+    for (size_t i = 0; i < mappedShape.size(); ++i)
+    {
+        shapeError += norm(mappedShape[i] - candidate.allLandmarks[i]);
+    }
+    shapeError /= mappedShape.size();
+    if (shapeError > m_maxNearDuplicateShapeError * candidate.vjFaceRect.width)
+    {
+        return false;
+    }
 
-    // Estimate chin and crown point (maths from existing landmarks)
-    return m_pCrownChinEstimator->estimateCrownChin(*landMarks);
+    if (!m_pCrownChinEstimator->estimateCrownChin(candidate))
+    {
+        return false;
+    }
+    landMarks = candidate;
+    return true;
 }
 
 cv::Point PppEngine::getLandMark(const std::vector<cv::Point> & landmarks, const LandMarkType type) const
@@ -185,16 +376,273 @@ cv::Point PppEngine::getLandMark(const std::vector<cv::Point> & landmarks, const
 }
 
 cv::Mat PppEngine::createTiledPrint(const string & imageKey,
-                                    PhotoStandard & ps,
-                                    PrintDefinition & pd,
+                                    const PhotoStandard & ps,
+                                    const PrintDefinition & pd,
                                     cv::Point & crownMark,
-                                    cv::Point & chinMark) const
+                                    cv::Point & chinMark,
+                                    const bool autoCorrect,
+                                    const std::string & printProfile,
+                                    const ParameterOverrides * overrides) const
+{
+    const auto croppedImage = cropPicture(imageKey, ps, pd, crownMark, chinMark, overrides);
+    // Both colour stages are folded into a single LUT so that the tile is only processed once
+    ColorLut3DSPtr colorCorrection;
+    if (autoCorrect)
+    {
+        colorCorrection = std::make_shared<ColorLut3D>(
+            ColorLut3D::autoCorrection(croppedImage, faceRegionInCrop(ps, croppedImage.size())));
+    }
+    if (!printProfile.empty())
+    {
+        const auto profileTransform = m_pColorProfiles->printTransform(printProfile);
+        colorCorrection = colorCorrection
+            ? std::make_shared<ColorLut3D>(ColorLut3D::compose(*colorCorrection, *profileTransform))
+            : profileTransform;
+    }
+    return m_pPhotoPrintMaker->tileCroppedPhoto(pd, ps, croppedImage, colorCorrection.get(), overrides);
+}
+
+bool PppEngine::createLosslessDigitalPhoto(const std::string & imageKey,
+                                           const PhotoStandard & ps,
+                                           const PrintDefinition & pd,
+                                           const cv::Point & crownMark,
+                                           const cv::Point & chinMark,
+                                           std::vector<BYTE> & jpeg) const
+{
+    if (pd.width() > 0 && pd.height() > 0)
+    {
+        // Not digital size, the photo gets tiled
+        return false;
+    }
+    const auto encodedImage = m_pImageStore->getEncodedImage(imageKey);
+    if (encodedImage == nullptr)
+    {
+        return false;
+    }
+    // The landmarks are in the upright picture, which only matches the coefficients without EXIF rotation
+    easyexif::EXIFInfo exifInfo;
+    if (exifInfo.parseFrom(encodedImage->data(), static_cast<unsigned>(encodedImage->size())) == PARSE_EXIF_SUCCESS
+        && exifInfo.Orientation > 1)
+    {
+        return false;
+    }
+    // Pictures larger than the decoding limit are stored reduced, the file has the full resolution
+    const auto decodeScale = m_pImageStore->getDecodeScale(imageKey);
+    const auto printDpi = std::max(ps.resolutionDpi(), pd.resolutionDpi());
+    return m_pPhotoPrintMaker->cropJpegLossless(*encodedImage,
+                                                crownMark * decodeScale,
+                                                chinMark * decodeScale,
+                                                ps.resolutionDpi() == printDpi ? ps : ps.withResolution(printDpi),
+                                                jpeg);
+}
+
+cv::Mat PppEngine::createPreview(const std::string & imageKey,
+                                 const PhotoStandard & ps,
+                                 const cv::Point & crownMark,
+                                 const cv::Point & chinMark,
+                                 const int maxHeight,
+                                 const ParameterOverrides * overrides) const
 {
     verifyImageExists(imageKey);
-    const auto & inputImage = m_pImageStore->getImage(imageKey);
-    const auto croppedImage = m_pPhotoPrintMaker->cropPicture(inputImage, crownMark, chinMark, ps);
-    auto tiledPrintPhoto = m_pPhotoPrintMaker->tileCroppedPhoto(pd, ps, croppedImage);
-    return tiledPrintPhoto;
+    auto scale = 1.0;
+    const auto proxyImage = m_pImageStore->getProxyImage(imageKey, scale);
+    if (proxyImage.empty())
+    {
+        // Evicted by another request since it was checked
+        throw runtime_error("Image with key='" + imageKey + "' not found!");
+    }
+
+    const auto toProxy = [scale](const cv::Point & p) {
+        return cv::Point(roundInteger(p.x * scale), roundInteger(p.y * scale));
+    };
+    auto previewImage
+        = m_pPhotoPrintMaker->cropPicture(proxyImage, toProxy(crownMark), toProxy(chinMark), ps, overrides);
+    if (maxHeight > 0 && previewImage.rows > maxHeight)
+    {
+        const auto previewScale = static_cast<double>(maxHeight) / previewImage.rows;
+        cv::resize(previewImage, previewImage, cv::Size(), previewScale, previewScale, cv::INTER_AREA);
+    }
+    return previewImage;
+}
+
+size_t PppEngine::createGangSheets(const std::vector<GangSheetJob> & jobs,
+                                   const PrintDefinition & pd,
+                                   const GangSheetCallback & onSheetReady,
+                                   const ParameterOverrides * overrides) const
+{
+    if (pd.width() <= 0 || pd.height() <= 0)
+    {
+        throw runtime_error("Gang sheets require a canvas with non-zero dimensions");
+    }
+
+    // All photos are rendered at the resolution of the canvas
+    vector<cv::Size> tileSizes;
+    vector<size_t> jobOrder;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        // Queues can be longer than the image store, photos of evicted images are cropped from their file
+        if (!m_pImageStore->containsImage(jobs[i].imageKey) && !m_pImageStore->containsEncodedImage(jobs[i].imageKey))
+        {
+            throw runtime_error("Image with key='" + jobs[i].imageKey + "' not found!");
+        }
+        const auto & ps = *jobs[i].photoStandard;
+        tileSizes.emplace_back(roundInteger(ps.photoWidth("inch") * pd.resolutionDpi()),
+                               roundInteger(ps.photoHeight("inch") * pd.resolutionDpi()));
+        jobOrder.push_back(i);
+    }
+    // Tallest photos first, so that shelves are filled with photos of similar height
+    stable_sort(jobOrder.begin(), jobOrder.end(), [&tileSizes](const size_t a, const size_t b) {
+        return tileSizes[a].height > tileSizes[b].height;
+    });
+
+    GangSheetPacker packer(cv::Size(floorInteger(pd.width()), floorInteger(pd.height())), roundInteger(pd.gutter()));
+
+    // Each photo is cropped once and shared by all the sheets where its copies are placed
+    vector<shared_future<cv::Mat>> tileImages(jobs.size());
+    // Sheets with the allocations made to render them, counted in the request waiting for them
+    deque<future<pair<cv::Mat, AllocationCounts>>> pendingSheets;
+    const size_t maxPendingSheets = max(1u, thread::hardware_concurrency());
+    size_t numSheets = 0;
+
+    const auto deliverSheets = [&](const size_t maxPending) {
+        while (!pendingSheets.empty()
+               && (pendingSheets.size() > maxPending
+                   || pendingSheets.front().wait_for(chrono::seconds(0)) == future_status::ready))
+        {
+            const auto sheet = pendingSheets.front().get();
+            pendingSheets.pop_front();
+            AllocationTracker::attributeToCurrentThread(sheet.second);
+            onSheetReady(sheet.first);
+        }
+    };
+
+    const auto flushSheet = [&]() {
+        auto sheet = packer.takeSheet();
+        vector<shared_future<cv::Mat>> sheetTiles;
+        for (const auto & tile : sheet)
+        {
+            sheetTiles.push_back(tileImages[tile.jobIndex]);
+        }
+        auto renderSheet = [this, &pd, overrides, sheet = move(sheet), sheetTiles = move(sheetTiles)]() {
+            const auto startAllocations = AllocationTracker::currentThreadCounts();
+            vector<cv::Mat> images;
+            for (const auto & tileImage : sheetTiles)
+            {
+                images.push_back(tileImage.get());
+            }
+            auto sheetImage = m_pPhotoPrintMaker->renderGangSheet(pd, sheet, images, overrides);
+            return make_pair(move(sheetImage), AllocationTracker::currentThreadCounts() - startAllocations);
+        };
+        pendingSheets.push_back(async(launch::async, move(renderSheet)));
+        ++numSheets;
+        deliverSheets(maxPendingSheets);
+    };
+
+    for (const auto jobIndex : jobOrder)
+    {
+        const auto & job = jobs[jobIndex];
+        const auto & tileSize = tileSizes[jobIndex];
+        if (!packer.fitsInSheet(tileSize))
+        {
+            throw runtime_error("Photo of image with key='" + job.imageKey + "' does not fit in the canvas");
+        }
+
+        const auto renderTile = [this, &job, &pd, overrides, tileSize]() {
+            const auto croppedImage
+                = cropPicture(job.imageKey, *job.photoStandard, pd, job.crownPoint, job.chinPoint, overrides);
+            cv::Mat tileImage;
+            cv::resize(croppedImage, tileImage, tileSize);
+            return tileImage;
+        };
+        // Evaluated by the first sheet rendering that needs it, so work is bounded by the sheets in flight
+        tileImages[jobIndex] = async(launch::deferred, renderTile).share();
+
+        for (auto copyIndex = 0; copyIndex < job.copies; ++copyIndex)
+        {
+            if (!packer.add(jobIndex, tileSize))
+            {
+                flushSheet();
+                packer.add(jobIndex, tileSize);
+            }
+        }
+    }
+    if (!packer.empty())
+    {
+        flushSheet();
+    }
+    deliverSheets(0);
+    return numSheets;
+}
+
+cv::Mat PppEngine::cropPicture(const std::string & imageKey,
+                               const PhotoStandard & ps,
+                               const PrintDefinition & pd,
+                               const cv::Point & crownMark,
+                               const cv::Point & chinMark,
+                               const ParameterOverrides * overrides) const
+{
+    if (m_pImageStore->containsImage(imageKey))
+    {
+        auto croppedImage = cropStoredPicture(imageKey, ps, crownMark, chinMark, overrides);
+        if (!croppedImage.empty())
+        {
+            return croppedImage;
+        }
+        // Evicted by another request since it was checked
+    }
+    if (m_pImageStore->containsEncodedImage(imageKey))
+    {
+        // The decoded image was evicted, decode only the pixels needed for the crop
+        return cropEvictedPicture(imageKey, ps, pd, crownMark, chinMark, overrides);
+    }
+    throw runtime_error("Image with key='" + imageKey + "' not found!");
+}
+
+cv::Mat PppEngine::cropStoredPicture(const std::string & imageKey,
+                                     const PhotoStandard & ps,
+                                     const cv::Point & crownMark,
+                                     const cv::Point & chinMark,
+                                     const ParameterOverrides * overrides) const
+{
+    // Only fetch the pixels covered by the crop, with planar storage that is where the chroma gets upsampled
+    const auto cropRegion = m_pPhotoPrintMaker->cropBoundingBox(crownMark, chinMark, ps);
+    const auto regionImage = m_pImageStore->getImageRegion(imageKey, cropRegion);
+    if (regionImage.empty())
+    {
+        return cv::Mat();
+    }
+    const auto regionCrownMark = crownMark - cropRegion.tl();
+    const auto regionChinMark = chinMark - cropRegion.tl();
+    return m_pPhotoPrintMaker->cropPicture(regionImage, regionCrownMark, regionChinMark, ps, overrides);
+}
+
+cv::Mat PppEngine::cropEvictedPicture(const std::string & imageKey,
+                                      const PhotoStandard & ps,
+                                      const PrintDefinition & pd,
+                                      const cv::Point & crownMark,
+                                      const cv::Point & chinMark,
+                                      const ParameterOverrides * overrides) const
+{
+    // The crop can be downscaled as long as it keeps at least as many pixels as the print needs
+    const auto printDpi = std::max(ps.resolutionDpi(), pd.resolutionDpi());
+    const auto printHeightPix = ps.photoHeight("inch") * printDpi;
+    const auto cropHeightPix = ps.photoHeight() / ps.faceHeight() * cv::norm(crownMark - chinMark);
+    const auto maxDownscale = cropHeightPix / printHeightPix;
+
+    const auto cropRegion = m_pPhotoPrintMaker->cropBoundingBox(crownMark, chinMark, ps);
+    auto scale = 1.0;
+    const auto regionImage = m_pImageStore->decodeImageRegion(imageKey, cropRegion, maxDownscale, scale);
+
+    const cv::Point regionOrigin(floorInteger(cropRegion.x * scale), floorInteger(cropRegion.y * scale));
+    const auto toRegion = [scale, &regionOrigin](const cv::Point & p) {
+        return cv::Point(roundInteger(p.x * scale) - regionOrigin.x, roundInteger(p.y * scale) - regionOrigin.y);
+    };
+    return m_pPhotoPrintMaker->cropPicture(regionImage, toRegion(crownMark), toRegion(chinMark), ps, overrides);
+}
+
+std::string PppEngine::getMetrics() const
+{
+    return StageMetrics::toJson();
 }
 
 IImageStoreSPtr PppEngine::getImageStore() const
@@ -202,6 +650,16 @@ IImageStoreSPtr PppEngine::getImageStore() const
     return m_pImageStore;
 }
 
+PhotoStandardCatalogSPtr PppEngine::getCatalog() const
+{
+    return m_pCatalog;
+}
+
+ColorProfileStoreSPtr PppEngine::getColorProfiles() const
+{
+    return m_pColorProfiles;
+}
+
 std::string PppEngine::checkCompliance(const std::string & imageId,
                                        const PhotoStandardSPtr & photoStandard,
                                        const cv::Point & crownPoint,
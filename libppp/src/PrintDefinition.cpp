@@ -22,35 +22,64 @@ PrintDefinition::PrintDefinition(const double width,
     m_gutter = gutter;
     m_padding = padding;
     m_units = units;
+
+    m_canvasWidthPix = Utilities::toPixels(m_canvasWidth, m_units, m_resolution_dpi);
+    m_canvasHeightPix = Utilities::toPixels(m_canvasHeight, m_units, m_resolution_dpi);
+    m_gutterPix = Utilities::toPixels(m_gutter, m_units, m_resolution_dpi);
+    m_paddingPix = Utilities::toPixels(m_padding, m_units, m_resolution_dpi);
 }
 
 double PrintDefinition::height(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_canvasHeightPix;
+    }
     return Utilities::convert(m_canvasHeight, m_units, units, m_resolution_dpi);
 }
 
 double PrintDefinition::width(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_canvasWidthPix;
+    }
     return Utilities::convert(m_canvasWidth, m_units, units, m_resolution_dpi);
 }
 
 double PrintDefinition::gutter(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_gutterPix;
+    }
     return Utilities::convert(m_gutter, m_units, units, m_resolution_dpi);
 }
 
 double PrintDefinition::padding(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_paddingPix;
+    }
     return Utilities::convert(m_padding, m_units, units, m_resolution_dpi);
 }
 
 double PrintDefinition::totalWidth(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_canvasWidthPix + 2 * m_paddingPix;
+    }
     return Utilities::convert(m_canvasWidth + 2 * m_padding, m_units, units, m_resolution_dpi);
 }
 
 double PrintDefinition::totalHeight(const std::string & units) const
 {
+    if (units == "pixel")
+    {
+        return m_canvasHeightPix + 2 * m_paddingPix;
+    }
     return Utilities::convert(m_canvasHeight + 2 * m_padding, m_units, units, m_resolution_dpi);
 }
 
@@ -71,8 +100,8 @@ double PrintDefinition::resolutionDpi() const
     return m_resolution_dpi;
 }
 
-void PrintDefinition::overrideResolution(const double newDpi) const
+PrintDefinition PrintDefinition::withResolution(const double newDpi) const
 {
-    m_resolution_dpi = newDpi;
+    return PrintDefinition(m_canvasWidth, m_canvasHeight, newDpi, m_units, m_gutter, m_padding);
 }
 } // namespace ppp
@@ -0,0 +1,598 @@
+#include "RequestParser.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <rapidjson/error/en.h>
+
+namespace ppp
+{
+void ApiRequest::clear()
+{
+    imageId.clear();
+    standardId.clear();
+    standard.reset();
+    canvasId.clear();
+    canvas.reset();
+    crownPoint.reset();
+    chinPoint.reset();
+    asBase64 = false;
+    autoCorrect = false;
+    printProfile.clear();
+    format.clear();
+    maxHeight = 0;
+    complianceChecks.clear();
+    overrides.clear();
+    jobs.clear();
+}
+
+namespace
+{
+enum class Scope
+{
+    NONE, ///<- Before the request object
+    ROOT,
+    STANDARD,
+    CANVAS,
+    CROWN_POINT,
+    CHIN_POINT,
+    COMPLIANCE_CHECKS,
+    OVERRIDES,
+    PRINT_MAKER_OVERRIDES,
+    ESTIMATOR_OVERRIDES,
+    BACKGROUND_COLOR,
+    GANG_SHEET_JOBS,
+    GANG_SHEET_JOB,
+    IGNORED ///<- Value of an unknown key, and everything nested in it
+};
+
+enum class Field
+{
+    UNKNOWN,
+    IMAGE_ID,
+    STANDARD,
+    CANVAS,
+    CROWN_POINT,
+    CHIN_POINT,
+    AS_BASE64,
+    AUTO_CORRECT,
+    PRINT_PROFILE,
+    FORMAT,
+    MAX_HEIGHT,
+    COMPLIANCE_CHECKS,
+    OVERRIDES,
+    PHOTO_PRINT_MAKER,
+    CROWN_CHIN_ESTIMATOR,
+    BACKGROUND_COLOR,
+    GANG_SHEET_JOBS,
+    GANG_SHEET_COPIES,
+    CHIN_CROWN_COEFF,
+    CHIN_FROWN_COEFF,
+    PHOTO_WIDTH,
+    PHOTO_HEIGHT,
+    PHOTO_FACE_HEIGHT,
+    PHOTO_CROWN_TOP,
+    PHOTO_EYELINE_BOTTOM,
+    PHOTO_RESOLUTION,
+    PRINT_WIDTH,
+    PRINT_HEIGHT,
+    PRINT_GUTTER,
+    PRINT_PADDING,
+    PRINT_RESOLUTION,
+    UNITS,
+    X,
+    Y
+};
+
+struct KeyDefinition
+{
+    Scope scope;
+    const char * name;
+    Field field;
+};
+
+constexpr KeyDefinition KEYS[] = {
+    { Scope::ROOT, IMAGE_ID, Field::IMAGE_ID },
+    { Scope::ROOT, PHOTO_STANDARD, Field::STANDARD },
+    { Scope::ROOT, PRINT_DEFINITION, Field::CANVAS },
+    { Scope::ROOT, CROWN_POINT, Field::CROWN_POINT },
+    { Scope::ROOT, CHIN_POINT, Field::CHIN_POINT },
+    { Scope::ROOT, AS_BASE64, Field::AS_BASE64 },
+    { Scope::ROOT, AUTO_CORRECT, Field::AUTO_CORRECT },
+    { Scope::ROOT, PRINT_PROFILE, Field::PRINT_PROFILE },
+    { Scope::ROOT, OUTPUT_FORMAT, Field::FORMAT },
+    { Scope::ROOT, PREVIEW_MAX_HEIGHT, Field::MAX_HEIGHT },
+    { Scope::ROOT, COMPLIANCE_CHECKS, Field::COMPLIANCE_CHECKS },
+    { Scope::ROOT, PARAMETER_OVERRIDES, Field::OVERRIDES },
+    { Scope::ROOT, GANG_SHEET_JOBS, Field::GANG_SHEET_JOBS },
+    { Scope::GANG_SHEET_JOB, IMAGE_ID, Field::IMAGE_ID },
+    { Scope::GANG_SHEET_JOB, PHOTO_STANDARD, Field::STANDARD },
+    { Scope::GANG_SHEET_JOB, CROWN_POINT, Field::CROWN_POINT },
+    { Scope::GANG_SHEET_JOB, CHIN_POINT, Field::CHIN_POINT },
+    { Scope::GANG_SHEET_JOB, GANG_SHEET_COPIES, Field::GANG_SHEET_COPIES },
+    { Scope::OVERRIDES, PHOTO_PRINT_MAKER, Field::PHOTO_PRINT_MAKER },
+    { Scope::OVERRIDES, CROWN_CHIN_ESTIMATOR, Field::CROWN_CHIN_ESTIMATOR },
+    { Scope::PRINT_MAKER_OVERRIDES, BACKGROUND_COLOR, Field::BACKGROUND_COLOR },
+    { Scope::ESTIMATOR_OVERRIDES, CHIN_CROWN_COEFF, Field::CHIN_CROWN_COEFF },
+    { Scope::ESTIMATOR_OVERRIDES, CHIN_FROWN_COEFF, Field::CHIN_FROWN_COEFF },
+    { Scope::STANDARD, PHOTO_WIDTH, Field::PHOTO_WIDTH },
+    { Scope::STANDARD, PHOTO_HEIGHT, Field::PHOTO_HEIGHT },
+    { Scope::STANDARD, PHOTO_FACE_HEIGHT, Field::PHOTO_FACE_HEIGHT },
+    { Scope::STANDARD, PHOTO_CROWN_TOP, Field::PHOTO_CROWN_TOP },
+    { Scope::STANDARD, PHOTO_EYELINE_BOTTOM, Field::PHOTO_EYELINE_BOTTOM },
+    { Scope::STANDARD, PHOTO_RESOLUTION, Field::PHOTO_RESOLUTION },
+    { Scope::STANDARD, UNITS, Field::UNITS },
+    { Scope::CANVAS, PRINT_WIDTH, Field::PRINT_WIDTH },
+    { Scope::CANVAS, PRINT_HEIGHT, Field::PRINT_HEIGHT },
+    { Scope::CANVAS, PRINT_GUTTER, Field::PRINT_GUTTER },
+    { Scope::CANVAS, PRINT_PADDING, Field::PRINT_PADDING },
+    { Scope::CANVAS, PRINT_RESOLUTION, Field::PRINT_RESOLUTION },
+    { Scope::CANVAS, UNITS, Field::UNITS },
+    { Scope::CROWN_POINT, "x", Field::X },
+    { Scope::CROWN_POINT, "y", Field::Y },
+    { Scope::CHIN_POINT, "x", Field::X },
+    { Scope::CHIN_POINT, "y", Field::Y },
+};
+
+/*!@brief Dimensions of a photo standard or print definition, or components of a colour, as read so far !*/
+struct Dimensions
+{
+    double width = 0.0;
+    double height = 0.0;
+    double faceHeight = 0.0;
+    double crownTop = 0.0;
+    double eyeLineBottom = 0.0;
+    double resolution = 0.0;
+    double gutter = 0.0;
+    double padding = 0.0;
+    std::array<char, 16> units {};
+    std::array<double, 3> color {};
+    size_t numColorComponents = 0;
+    bool hasWidth = false;
+    bool hasHeight = false;
+    bool hasFaceHeight = false;
+};
+
+/*!@brief Receives the events of the rapidjson reader and stores the values in the request as they come.
+ * An invalid value stops the reader, the reason is then kept in m_error !*/
+class RequestHandler final : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, RequestHandler>
+{
+public:
+    explicit RequestHandler(ApiRequest & request)
+    : m_request(request)
+    {
+    }
+
+    const char * error() const
+    {
+        return m_error;
+    }
+
+    const char * errorKey() const
+    {
+        return m_key;
+    }
+
+    bool Null()
+    {
+        return isSkipped() || fail("null is not a valid value");
+    }
+
+    bool Bool(const bool b)
+    {
+        if (isSkipped())
+        {
+            return true;
+        }
+        if (scope() == Scope::ROOT && m_field == Field::AS_BASE64)
+        {
+            m_request.asBase64 = b;
+            return true;
+        }
+        if (scope() == Scope::ROOT && m_field == Field::AUTO_CORRECT)
+        {
+            m_request.autoCorrect = b;
+            return true;
+        }
+        return fail("Unexpected boolean");
+    }
+
+    bool Int(const int i)
+    {
+        return number(i);
+    }
+
+    bool Uint(const unsigned u)
+    {
+        return number(u);
+    }
+
+    bool Int64(const int64_t i)
+    {
+        return number(static_cast<double>(i));
+    }
+
+    bool Uint64(const uint64_t u)
+    {
+        return number(static_cast<double>(u));
+    }
+
+    bool Double(const double d)
+    {
+        return number(d);
+    }
+
+    bool String(const char * str, const rapidjson::SizeType length, bool /*copy*/)
+    {
+        if (isSkipped())
+        {
+            return true;
+        }
+        switch (scope())
+        {
+            case Scope::ROOT:
+                switch (m_field)
+                {
+                    case Field::IMAGE_ID:
+                        m_request.imageId.assign(str, length);
+                        return true;
+                    case Field::STANDARD:
+                        m_request.standardId.assign(str, length);
+                        m_request.standard.reset();
+                        return true;
+                    case Field::CANVAS:
+                        m_request.canvasId.assign(str, length);
+                        m_request.canvas.reset();
+                        return true;
+                    case Field::PRINT_PROFILE:
+                        m_request.printProfile.assign(str, length);
+                        return true;
+                    case Field::FORMAT:
+                        m_request.format.assign(str, length);
+                        return true;
+                    default:
+                        break;
+                }
+                break;
+            case Scope::GANG_SHEET_JOB:
+                switch (m_field)
+                {
+                    case Field::IMAGE_ID:
+                        m_request.jobs.back().imageId.assign(str, length);
+                        return true;
+                    case Field::STANDARD:
+                        m_request.jobs.back().standardId.assign(str, length);
+                        m_request.jobs.back().standard.reset();
+                        return true;
+                    default:
+                        break;
+                }
+                break;
+            case Scope::STANDARD:
+            case Scope::CANVAS:
+                if (m_field == Field::UNITS)
+                {
+                    if (length >= m_dimensions.units.size())
+                    {
+                        return fail("Unknown units");
+                    }
+                    std::memcpy(m_dimensions.units.data(), str, length);
+                    m_dimensions.units[length] = '\0';
+                    return true;
+                }
+                break;
+            case Scope::COMPLIANCE_CHECKS:
+                m_request.complianceChecks.emplace_back(str, length);
+                return true;
+            default:
+                break;
+        }
+        return fail("Unexpected string");
+    }
+
+    bool StartObject()
+    {
+        if (m_depth == 0)
+        {
+            return push(Scope::ROOT);
+        }
+        if (isSkipped())
+        {
+            return push(Scope::IGNORED);
+        }
+        if (scope() == Scope::GANG_SHEET_JOBS)
+        {
+            m_request.jobs.emplace_back();
+            return push(Scope::GANG_SHEET_JOB);
+        }
+        if (scope() == Scope::ROOT || scope() == Scope::GANG_SHEET_JOB)
+        {
+            switch (m_field)
+            {
+                case Field::STANDARD:
+                    m_dimensions = Dimensions();
+                    m_dimensions.resolution = 300.0;
+                    return push(Scope::STANDARD);
+                case Field::CANVAS:
+                    m_dimensions = Dimensions();
+                    return push(Scope::CANVAS);
+                case Field::CROWN_POINT:
+                    m_dimensions = Dimensions();
+                    return push(Scope::CROWN_POINT);
+                case Field::CHIN_POINT:
+                    m_dimensions = Dimensions();
+                    return push(Scope::CHIN_POINT);
+                case Field::OVERRIDES:
+                    return push(Scope::OVERRIDES);
+                default:
+                    break;
+            }
+        }
+        if (scope() == Scope::OVERRIDES)
+        {
+            switch (m_field)
+            {
+                case Field::PHOTO_PRINT_MAKER:
+                    return push(Scope::PRINT_MAKER_OVERRIDES);
+                case Field::CROWN_CHIN_ESTIMATOR:
+                    return push(Scope::ESTIMATOR_OVERRIDES);
+                default:
+                    break;
+            }
+        }
+        return fail("Unexpected object");
+    }
+
+    bool Key(const char * str, const rapidjson::SizeType length, bool /*copy*/)
+    {
+        m_field = Field::UNKNOWN;
+        m_key = nullptr;
+        for (const auto & key : KEYS)
+        {
+            if (key.scope == scope() && std::strlen(key.name) == length && std::memcmp(key.name, str, length) == 0)
+            {
+                m_field = key.field;
+                m_key = key.name;
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool EndObject(rapidjson::SizeType /*memberCount*/)
+    {
+        const auto closedScope = scope();
+        --m_depth;
+        // Fields of the enclosing object are all scalars or objects, so there is no key to restore but its own
+        m_field = Field::UNKNOWN;
+        const auto & d = m_dimensions;
+        const auto units = d.units[0] != '\0' ? d.units.data() : "mm";
+        // Standards and points of a gang sheet job belong to the job
+        auto * const job = scope() == Scope::GANG_SHEET_JOB ? &m_request.jobs.back() : nullptr;
+        switch (closedScope)
+        {
+            case Scope::STANDARD:
+                m_key = PHOTO_STANDARD;
+                if (!d.hasWidth || !d.hasHeight || !d.hasFaceHeight)
+                {
+                    return fail("The photo standard needs its width, height and face height");
+                }
+                (job != nullptr ? job->standard : m_request.standard)
+                    .emplace(d.width, d.height, d.faceHeight, d.crownTop, d.eyeLineBottom, d.resolution, units);
+                (job != nullptr ? job->standardId : m_request.standardId).clear();
+                return true;
+            case Scope::CANVAS:
+                m_key = PRINT_DEFINITION;
+                m_request.canvas.emplace(d.width, d.height, d.resolution, units, d.gutter, d.padding);
+                m_request.canvasId.clear();
+                return true;
+            case Scope::CROWN_POINT:
+            case Scope::CHIN_POINT:
+            {
+                m_key = closedScope == Scope::CROWN_POINT ? CROWN_POINT : CHIN_POINT;
+                if (!d.hasWidth || !d.hasHeight)
+                {
+                    return fail("A point needs both x and y");
+                }
+                auto & point = closedScope == Scope::CROWN_POINT
+                    ? (job != nullptr ? job->crownPoint : m_request.crownPoint)
+                    : (job != nullptr ? job->chinPoint : m_request.chinPoint);
+                point = cv::Point(static_cast<int>(std::lround(d.width)), static_cast<int>(std::lround(d.height)));
+                return true;
+            }
+            case Scope::GANG_SHEET_JOB:
+            {
+                m_key = GANG_SHEET_JOBS;
+                const auto & closedJob = m_request.jobs.back();
+                if (closedJob.imageId.empty() || (closedJob.standardId.empty() && !closedJob.standard)
+                    || !closedJob.crownPoint || !closedJob.chinPoint)
+                {
+                    return fail("A job needs its image key, photo standard, crown point and chin point");
+                }
+                return true;
+            }
+            default:
+                return true;
+        }
+    }
+
+    bool StartArray()
+    {
+        if (isSkipped())
+        {
+            return push(Scope::IGNORED);
+        }
+        if (scope() == Scope::ROOT && m_field == Field::COMPLIANCE_CHECKS)
+        {
+            m_request.complianceChecks.clear();
+            return push(Scope::COMPLIANCE_CHECKS);
+        }
+        if (scope() == Scope::ROOT && m_field == Field::GANG_SHEET_JOBS)
+        {
+            m_request.jobs.clear();
+            return push(Scope::GANG_SHEET_JOBS);
+        }
+        if (scope() == Scope::PRINT_MAKER_OVERRIDES && m_field == Field::BACKGROUND_COLOR)
+        {
+            m_dimensions = Dimensions();
+            return push(Scope::BACKGROUND_COLOR);
+        }
+        return fail("Unexpected array");
+    }
+
+    bool EndArray(rapidjson::SizeType /*elementCount*/)
+    {
+        const auto closedScope = scope();
+        --m_depth;
+        m_field = Field::UNKNOWN;
+        if (closedScope == Scope::BACKGROUND_COLOR)
+        {
+            const auto & d = m_dimensions;
+            if (d.numColorComponents != d.color.size())
+            {
+                return fail("The background colour needs three components");
+            }
+            m_request.overrides.backgroundColor = cv::Scalar(d.color[0], d.color[1], d.color[2]);
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t MAX_DEPTH = 32;
+
+    ApiRequest & m_request;
+    std::array<Scope, MAX_DEPTH> m_scopes {};
+    size_t m_depth = 0;
+    Field m_field = Field::UNKNOWN; ///<- Field of the value to come, from the last key
+    const char * m_key = nullptr; ///<- Name of that field, for error messages
+    Dimensions m_dimensions; ///<- Of the object being read, only one can be open at a time
+    const char * m_error = nullptr;
+
+    Scope scope() const
+    {
+        return m_depth > 0 ? m_scopes[m_depth - 1] : Scope::NONE;
+    }
+
+    /*!@brief Whether the value to come belongs to an unknown key !*/
+    bool isSkipped() const
+    {
+        const auto current = scope();
+        return current == Scope::IGNORED
+            || (current != Scope::NONE && current != Scope::COMPLIANCE_CHECKS && current != Scope::BACKGROUND_COLOR
+                && current != Scope::GANG_SHEET_JOBS && m_field == Field::UNKNOWN);
+    }
+
+    bool push(const Scope scope)
+    {
+        if (m_depth == MAX_DEPTH)
+        {
+            return fail("Too deeply nested");
+        }
+        m_scopes[m_depth++] = scope;
+        return true;
+    }
+
+    bool fail(const char * error)
+    {
+        m_error = error;
+        return false;
+    }
+
+    bool number(const double value)
+    {
+        if (isSkipped())
+        {
+            return true;
+        }
+        auto & d = m_dimensions;
+        if (scope() == Scope::BACKGROUND_COLOR)
+        {
+            if (d.numColorComponents == d.color.size() || value < 0.0 || value > 255.0)
+            {
+                return fail("The background colour needs three components between 0 and 255");
+            }
+            d.color[d.numColorComponents++] = value;
+            return true;
+        }
+        switch (m_field)
+        {
+            case Field::MAX_HEIGHT:
+                m_request.maxHeight = static_cast<int>(value);
+                return true;
+            case Field::GANG_SHEET_COPIES:
+                if (value < 0.0 || value != std::floor(value))
+                {
+                    return fail("Copies must be a non-negative integer");
+                }
+                m_request.jobs.back().copies = static_cast<int>(value);
+                return true;
+            case Field::PHOTO_WIDTH:
+            case Field::PRINT_WIDTH:
+            case Field::X:
+                d.width = value;
+                d.hasWidth = true;
+                return true;
+            case Field::PHOTO_HEIGHT:
+            case Field::PRINT_HEIGHT:
+            case Field::Y:
+                d.height = value;
+                d.hasHeight = true;
+                return true;
+            case Field::PHOTO_FACE_HEIGHT:
+                d.faceHeight = value;
+                d.hasFaceHeight = true;
+                return true;
+            case Field::PHOTO_CROWN_TOP:
+                d.crownTop = value;
+                return true;
+            case Field::PHOTO_EYELINE_BOTTOM:
+                d.eyeLineBottom = value;
+                return true;
+            case Field::PHOTO_RESOLUTION:
+            case Field::PRINT_RESOLUTION:
+                d.resolution = value;
+                return true;
+            case Field::PRINT_GUTTER:
+                d.gutter = value;
+                return true;
+            case Field::PRINT_PADDING:
+                d.padding = value;
+                return true;
+            case Field::CHIN_CROWN_COEFF:
+            case Field::CHIN_FROWN_COEFF:
+                if (value <= 0.0)
+                {
+                    return fail("Coefficients must be positive");
+                }
+                (m_field == Field::CHIN_CROWN_COEFF ? m_request.overrides.chinCrownCoeff
+                                                    : m_request.overrides.chinFrownCoeff)
+                    = value;
+                return true;
+            default:
+                return fail("Unexpected number");
+        }
+    }
+};
+} // namespace
+
+void RequestParser::parse(const std::string & json, ApiRequest & request)
+{
+    request.clear();
+    RequestHandler handler(request);
+    rapidjson::StringStream stream(json.c_str());
+    const auto result = m_reader.Parse(stream, handler);
+    if (handler.error() != nullptr)
+    {
+        const std::string key = handler.errorKey() != nullptr ? handler.errorKey() : "";
+        throw std::runtime_error("Invalid request: " + std::string(handler.error())
+                                 + (key.empty() ? "" : " for '" + key + "'"));
+    }
+    if (result.IsError())
+    {
+        throw std::runtime_error("Invalid request JSON: " + std::string(rapidjson::GetParseError_En(result.Code()))
+                                 + " at offset " + std::to_string(result.Offset()));
+    }
+}
+} // namespace ppp
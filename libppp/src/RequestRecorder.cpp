@@ -0,0 +1,241 @@
+#include "RequestRecorder.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace ppp
+{
+namespace
+{
+constexpr char ARCHIVE_MAGIC[] = { 'P', 'P', 'P', 'R', 'E', 'C' };
+constexpr uint16_t ARCHIVE_VERSION = 1;
+
+template <typename T>
+uint64_t bitsOf(const T value)
+{
+    return static_cast<uint64_t>(value);
+}
+
+template <>
+uint64_t bitsOf(const double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+template <typename T>
+T valueOf(const uint64_t bits)
+{
+    return static_cast<T>(bits);
+}
+
+template <>
+double valueOf(const uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*!@brief Writes the value least significant byte first, whatever the byte order of the host !*/
+template <typename T>
+void writeValue(std::ostream & os, const T & value)
+{
+    const auto bits = bitsOf(value);
+    char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        bytes[i] = static_cast<char>(bits >> (8 * i));
+    }
+    os.write(bytes, sizeof(T));
+}
+
+void writeString(std::ostream & os, const std::string & str, const bool longLength)
+{
+    if (longLength)
+    {
+        writeValue(os, static_cast<uint64_t>(str.size()));
+    }
+    else
+    {
+        writeValue(os, static_cast<uint32_t>(str.size()));
+    }
+    os.write(str.data(), str.size());
+}
+
+template <typename T>
+T readValue(std::istream & is)
+{
+    unsigned char bytes[sizeof(T)];
+    if (!is.read(reinterpret_cast<char *>(bytes), sizeof(T)))
+    {
+        throw std::runtime_error("Request archive is truncated");
+    }
+    uint64_t bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        bits |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return valueOf<T>(bits);
+}
+
+std::string readString(std::istream & is, const bool longLength, const uint64_t fileSize)
+{
+    const auto length = longLength ? readValue<uint64_t>(is) : readValue<uint32_t>(is);
+    // A corrupted length must not make the reader allocate more than the file holds
+    if (length > fileSize - static_cast<uint64_t>(is.tellg()))
+    {
+        throw std::runtime_error("Request archive is truncated");
+    }
+    std::string str(length, '\0');
+    if (!is.read(&str[0], length))
+    {
+        throw std::runtime_error("Request archive is truncated");
+    }
+    return str;
+}
+} // namespace
+
+void RequestRecorder::setConfiguration(const std::string & configFilePathOrContent)
+{
+    const auto configHash = configurationHash(configFilePathOrContent);
+    std::lock_guard<std::mutex> lg(m_mutex);
+    m_configHash = configHash;
+}
+
+void RequestRecorder::start(const std::string & archiveFilePath)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    m_archive.close();
+    m_archive.open(archiveFilePath, std::ios::binary | std::ios::trunc);
+    if (!m_archive.good())
+    {
+        throw std::runtime_error("Unable to create request archive " + archiveFilePath);
+    }
+    m_archive.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    writeValue(m_archive, ARCHIVE_VERSION);
+    writeValue(m_archive, m_configHash);
+    m_recordingStart = std::chrono::steady_clock::now();
+    m_recording = true;
+}
+
+void RequestRecorder::stop()
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    m_recording = false;
+    m_archive.close();
+}
+
+bool RequestRecorder::isRecording() const
+{
+    return m_recording;
+}
+
+void RequestRecorder::record(const std::string & name,
+                             const std::vector<std::string> & args,
+                             const std::chrono::steady_clock::time_point startTime,
+                             const std::chrono::steady_clock::time_point endTime)
+{
+    std::lock_guard<std::mutex> lg(m_mutex);
+    if (!m_recording)
+    {
+        return;
+    }
+    const auto startTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::max(startTime, m_recordingStart) - m_recordingStart);
+    const std::chrono::duration<double, std::milli> duration = endTime - startTime;
+
+    writeString(m_archive, name, false);
+    writeValue(m_archive, static_cast<uint64_t>(startTimeUs.count()));
+    writeValue(m_archive, duration.count());
+    writeValue(m_archive, static_cast<uint32_t>(args.size()));
+    for (const auto & arg : args)
+    {
+        writeString(m_archive, arg, true);
+    }
+    // Flush every entry so the archive is usable even if the process is killed
+    m_archive.flush();
+}
+
+RequestArchive RequestRecorder::readArchive(const std::string & archiveFilePath)
+{
+    std::ifstream is(archiveFilePath, std::ios::binary | std::ios::ate);
+    const auto fileSize = static_cast<uint64_t>(std::max<std::streamoff>(0, is.tellg()));
+    is.seekg(0);
+    char magic[sizeof(ARCHIVE_MAGIC)];
+    if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error(archiveFilePath + " is not a request archive");
+    }
+    if (readValue<uint16_t>(is) != ARCHIVE_VERSION)
+    {
+        throw std::runtime_error("Unsupported request archive version in " + archiveFilePath);
+    }
+
+    RequestArchive archive;
+    archive.configHash = readValue<uint32_t>(is);
+    while (is.peek() != std::char_traits<char>::eof())
+    {
+        RecordedRequest request;
+        request.name = readString(is, false, fileSize);
+        request.startTimeUs = readValue<uint64_t>(is);
+        request.durationMs = readValue<double>(is);
+        const auto numArgs = readValue<uint32_t>(is);
+        for (uint32_t i = 0; i < numArgs; ++i)
+        {
+            request.args.push_back(readString(is, true, fileSize));
+        }
+        archive.requests.push_back(std::move(request));
+    }
+    std::stable_sort(archive.requests.begin(), archive.requests.end(), [](const auto & a, const auto & b) {
+        return a.startTimeUs < b.startTimeUs;
+    });
+    return archive;
+}
+
+uint32_t RequestRecorder::configurationHash(const std::string & configFilePathOrContent)
+{
+    // Same logic as the ConfigLoader: a readable file path or the configuration content itself
+    std::ifstream ifs(configFilePathOrContent, std::ios_base::binary);
+    const auto config = ifs.good()
+        ? std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>())
+        : configFilePathOrContent;
+
+    const auto begin = reinterpret_cast<const uint8_t *>(config.data());
+    return Utilities::crc32(0, begin, begin + config.size());
+}
+
+RecordedCall::RecordedCall(RequestRecorder & recorder, const char * name)
+: m_recorder(recorder)
+, m_name(name)
+, m_recording(recorder.isRecording())
+, m_startTime(std::chrono::steady_clock::now())
+{
+}
+
+RecordedCall::~RecordedCall()
+{
+    if (m_recording)
+    {
+        m_recorder.record(m_name, m_args, m_startTime, std::chrono::steady_clock::now());
+    }
+}
+
+RecordedCall & RecordedCall::arg(const char * data, const size_t length)
+{
+    // Copying the arguments, images included, is only paid for while recording
+    if (m_recording)
+    {
+        m_args.emplace_back(data, length);
+    }
+    return *this;
+}
+
+RecordedCall & RecordedCall::arg(const std::string & value)
+{
+    return arg(value.data(), value.size());
+}
+} // namespace ppp
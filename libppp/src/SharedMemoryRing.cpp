@@ -0,0 +1,261 @@
+#include "SharedMemoryRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(EMSCRIPTEN) && !defined(__ANDROID__)
+#define PPP_HAS_POSIX_SHM 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ppp
+{
+struct alignas(64) RingHeader final
+{
+    char magic[8];
+    uint32_t numSlots;
+    uint64_t slotSize; ///<- Bytes between two consecutive slot headers
+    std::atomic<uint64_t> writeIndex; ///<- Sequence of the next slot published by the producer
+    std::atomic<uint64_t> readIndex; ///<- Sequence of the next slot taken by the consumer
+};
+
+namespace
+{
+constexpr char RING_MAGIC[8] = { 'P', 'P', 'P', 'R', 'I', 'N', 'G', '2' };
+
+uint64_t alignTo64(const uint64_t size)
+{
+    return (size + 63) & ~uint64_t(63);
+}
+
+std::string shmName(const std::string & name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+} // namespace
+
+SharedMemoryRing::SharedMemoryRing(std::string name, void * mapping, const size_t mappingSize, const bool owner)
+: m_name(std::move(name))
+, m_mapping(mapping)
+, m_mappingSize(mappingSize)
+, m_owner(owner)
+{
+}
+
+#ifdef PPP_HAS_POSIX_SHM
+SharedMemoryRingSPtr SharedMemoryRing::create(const std::string & name,
+                                              const uint32_t numSlots,
+                                              const uint64_t slotCapacity)
+{
+    if (numSlots == 0 || slotCapacity == 0)
+    {
+        throw std::runtime_error("Shared memory ring needs at least one slot of non-zero capacity");
+    }
+    const auto slotSize = alignTo64(sizeof(RingSlotHeader) + slotCapacity);
+    const auto mappingSize = static_cast<size_t>(sizeof(RingHeader) + numSlots * slotSize);
+
+    const auto fullName = shmName(name);
+    shm_unlink(fullName.c_str());
+    const auto fd = shm_open(fullName.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(mappingSize)) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        throw std::runtime_error("Unable to create shared memory ring " + fullName);
+    }
+    const auto mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(fullName.c_str());
+        throw std::runtime_error("Unable to map shared memory ring " + fullName);
+    }
+
+    const auto header = new (mapping) RingHeader();
+    header->numSlots = numSlots;
+    header->slotSize = slotSize;
+    const SharedMemoryRingSPtr ring(new SharedMemoryRing(fullName, mapping, mappingSize, true));
+    for (uint32_t i = 0; i < numSlots; ++i)
+    {
+        new (ring->slot(i)) RingSlotHeader { { FREE }, 0, 0, 0, 0, 0, 0, 0 };
+    }
+    // Written last, so a process opening the ring too early sees an invalid ring rather than a half initialized one
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+    return ring;
+}
+
+SharedMemoryRingSPtr SharedMemoryRing::open(const std::string & name)
+{
+    const auto fullName = shmName(name);
+    const auto fd = shm_open(fullName.c_str(), O_RDWR, 0);
+    struct stat fileStat {};
+    if (fd < 0 || fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(RingHeader))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        throw std::runtime_error("Unable to open shared memory ring " + fullName);
+    }
+    const auto mappingSize = static_cast<size_t>(fileStat.st_size);
+    const auto mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map shared memory ring " + fullName);
+    }
+
+    const SharedMemoryRingSPtr ring(new SharedMemoryRing(fullName, mapping, mappingSize, false));
+    const auto header = static_cast<const RingHeader *>(mapping);
+    if (std::memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0
+        || sizeof(RingHeader) + header->numSlots * header->slotSize > mappingSize)
+    {
+        throw std::runtime_error(fullName + " is not a valid shared memory ring");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return ring;
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    munmap(m_mapping, m_mappingSize);
+    if (m_owner)
+    {
+        shm_unlink(m_name.c_str());
+    }
+}
+#else
+SharedMemoryRingSPtr SharedMemoryRing::create(const std::string &, uint32_t, uint64_t)
+{
+    throw std::runtime_error("Shared memory rings are not supported on this platform");
+}
+
+SharedMemoryRingSPtr SharedMemoryRing::open(const std::string &)
+{
+    throw std::runtime_error("Shared memory rings are not supported on this platform");
+}
+
+SharedMemoryRing::~SharedMemoryRing() = default;
+#endif
+
+RingSlotHeader * SharedMemoryRing::beginWrite()
+{
+    // Starts from the slot after the last one written, so that a consumer releasing in order sees the ring order
+    const auto writeIndex = header()->writeIndex.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < numSlots(); ++i)
+    {
+        const auto s = slot(writeIndex + i);
+        if (s->state.load(std::memory_order_acquire) == FREE)
+        {
+            return s;
+        }
+    }
+    return nullptr;
+}
+
+void SharedMemoryRing::commitWrite(RingSlotHeader * slot)
+{
+    auto & writeIndex = header()->writeIndex;
+    slot->sequence = writeIndex.load(std::memory_order_relaxed);
+    // Release ordering publishes the payload and the header fields along with the state
+    slot->state.store(READY, std::memory_order_release);
+    writeIndex.fetch_add(1, std::memory_order_relaxed);
+}
+
+RingSlotHeader * SharedMemoryRing::beginRead()
+{
+    auto & readIndex = header()->readIndex;
+    const auto sequence = readIndex.load(std::memory_order_relaxed);
+    // The slot published next is usually at the same position in the ring, unless the producer skipped held slots
+    for (uint32_t i = 0; i < numSlots(); ++i)
+    {
+        const auto s = slot(sequence + i);
+        if (s->state.load(std::memory_order_acquire) == READY && s->sequence == sequence)
+        {
+            s->state.store(IN_USE, std::memory_order_relaxed);
+            readIndex.fetch_add(1, std::memory_order_relaxed);
+            return s;
+        }
+    }
+    return nullptr;
+}
+
+void SharedMemoryRing::release(RingSlotHeader * slot)
+{
+    slot->state.store(FREE, std::memory_order_release);
+}
+
+uint8_t * SharedMemoryRing::payload(RingSlotHeader * slot)
+{
+    return reinterpret_cast<uint8_t *>(slot) + sizeof(RingSlotHeader);
+}
+
+uint64_t SharedMemoryRing::slotCapacity() const
+{
+    return header()->slotSize - sizeof(RingSlotHeader);
+}
+
+uint32_t SharedMemoryRing::numSlots() const
+{
+    return header()->numSlots;
+}
+
+uint32_t SharedMemoryRing::numSlotsInUse() const
+{
+    uint32_t inUse = 0;
+    for (uint32_t i = 0; i < numSlots(); ++i)
+    {
+        inUse += slot(i)->state.load(std::memory_order_relaxed) == IN_USE ? 1 : 0;
+    }
+    return inUse;
+}
+
+std::vector<RingSlotHeader *> SharedMemoryRing::slotsInUse() const
+{
+    std::vector<RingSlotHeader *> slots;
+    for (uint32_t i = 0; i < numSlots(); ++i)
+    {
+        if (slot(i)->state.load(std::memory_order_acquire) == IN_USE)
+        {
+            slots.push_back(slot(i));
+        }
+    }
+    std::sort(slots.begin(), slots.end(), [](const RingSlotHeader * a, const RingSlotHeader * b) {
+        return a->sequence < b->sequence;
+    });
+    return slots;
+}
+
+uint64_t SharedMemoryRing::numPublished() const
+{
+    return header()->writeIndex.load(std::memory_order_acquire);
+}
+
+void SharedMemoryRing::reclaimConsumerSlots()
+{
+    for (uint32_t i = 0; i < numSlots(); ++i)
+    {
+        auto expected = static_cast<uint32_t>(IN_USE);
+        slot(i)->state.compare_exchange_strong(expected, FREE, std::memory_order_release);
+    }
+}
+
+RingHeader * SharedMemoryRing::header() const
+{
+    return static_cast<RingHeader *>(m_mapping);
+}
+
+RingSlotHeader * SharedMemoryRing::slot(const uint64_t index) const
+{
+    const auto offset = sizeof(RingHeader) + (index % header()->numSlots) * header()->slotSize;
+    return reinterpret_cast<RingSlotHeader *>(static_cast<uint8_t *>(m_mapping) + offset);
+}
+} // namespace ppp
@@ -0,0 +1,217 @@
+#include "SharedMemoryServer.h"
+#include "IImageStore.h"
+#include "OutputSinks.h"
+#include "SharedMemoryRing.h"
+#include "StageMetrics.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ppp
+{
+namespace
+{
+/*!@brief Request slot kept alive by the image it holds !*/
+struct PinnedSlot final
+{
+    SharedMemoryRingSPtr ring; ///<- Keeps the mapping alive for as long as the image is referenced
+    RingSlotHeader * slot;
+};
+
+/*!@brief Gives cv::Mat reference counting to pixels living in a ring slot, the slot is released along with the
+ * last cv::Mat referencing it. Same approach as OpenCV's own numpy allocator !*/
+class PinnedSlotAllocator final : public cv::MatAllocator
+{
+public:
+    cv::UMatData * allocate(int dims,
+                            const int * sizes,
+                            int type,
+                            void * data,
+                            size_t * step,
+                            cv::AccessFlag flags,
+                            cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData * data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData * u) const override
+    {
+        if (u != nullptr && u->refcount == 0)
+        {
+            const auto pinnedSlot = static_cast<PinnedSlot *>(u->userdata);
+            SharedMemoryRing::release(pinnedSlot->slot);
+            delete pinnedSlot;
+            delete u;
+        }
+    }
+
+    static cv::Mat wrap(const SharedMemoryRingSPtr & ring, RingSlotHeader * slot)
+    {
+        static PinnedSlotAllocator allocator;
+        const auto data = SharedMemoryRing::payload(slot);
+        cv::Mat image(slot->rows, slot->cols, slot->type, data);
+        const auto u = new cv::UMatData(&allocator);
+        u->data = u->origdata = data;
+        u->size = image.total() * image.elemSize();
+        u->userdata = new PinnedSlot { ring, slot };
+        image.u = u;
+        image.addref();
+        image.allocator = &allocator;
+        return image;
+    }
+};
+
+void writeResponse(const SharedMemoryRing & responses,
+                   RingSlotHeader * response,
+                   const ShmResponseKind kind,
+                   const void * data,
+                   const size_t length)
+{
+    const auto capacity = responses.slotCapacity();
+    if (length > capacity && kind != ShmResponseKind::ERROR_MESSAGE)
+    {
+        const std::string message = "Response of " + std::to_string(length) + " bytes does not fit in a slot";
+        writeResponse(responses, response, ShmResponseKind::ERROR_MESSAGE, message.data(), message.size());
+        return;
+    }
+    response->kind = static_cast<uint32_t>(kind);
+    response->length = std::min<uint64_t>(length, capacity);
+    std::memcpy(SharedMemoryRing::payload(response), data, response->length);
+}
+} // namespace
+
+SharedMemoryServer::SharedMemoryServer(IImageStoreSPtr imageStore,
+                                       TiledPrintRenderer renderTiledPrint,
+                                       SharedMemoryRingSPtr requests,
+                                       SharedMemoryRingSPtr responses)
+: m_imageStore(std::move(imageStore))
+, m_renderTiledPrint(std::move(renderTiledPrint))
+, m_requests(std::move(requests))
+, m_responses(std::move(responses))
+{
+}
+
+bool SharedMemoryServer::serveOne()
+{
+    // A request is only taken once there is room for its response, so a gateway that stops reading the responses
+    // leaves the requests pending instead of blocking the server
+    const auto response = m_responses->beginWrite();
+    if (response == nullptr)
+    {
+        return false;
+    }
+    const auto request = m_requests->beginRead();
+    if (request == nullptr)
+    {
+        return false;
+    }
+    PPP_REQUEST_SCOPE("sharedMemory");
+
+    response->requestId = request->requestId;
+
+    auto requestReleased = false;
+    try
+    {
+        // The length is written by the other process, a payload must never be read past the end of its slot
+        if (request->length > m_requests->slotCapacity())
+        {
+            throw std::runtime_error("Request length " + std::to_string(request->length)
+                                     + " exceeds the slot capacity " + std::to_string(m_requests->slotCapacity()));
+        }
+        const auto payload = reinterpret_cast<const char *>(SharedMemoryRing::payload(request));
+        switch (static_cast<ShmRequestKind>(request->kind))
+        {
+            case ShmRequestKind::SET_IMAGE_ENCODED:
+            {
+                const auto imageKey = m_imageStore->setImage(payload, request->length);
+                writeResponse(*m_responses, response, ShmResponseKind::IMAGE_KEY, imageKey.data(), imageKey.size());
+                break;
+            }
+            case ShmRequestKind::SET_IMAGE_RAW:
+                requestReleased = true; // Ownership of the slot goes to the wrapping cv::Mat
+                ingestRawImage(request, response);
+                break;
+            case ShmRequestKind::CREATE_TILED_PRINT:
+            {
+                const std::string tiledPrintRequest(payload, request->length);
+                SharedMemoryRing::release(request);
+                requestReleased = true;
+
+                auto printDpi = 0.0;
+                const auto print = m_renderTiledPrint(tiledPrintRequest, printDpi);
+                // Encoded straight into the response slot, a print too large for it fails with an error message
+                BufferOutputSink sink(reinterpret_cast<char *>(SharedMemoryRing::payload(response)),
+                                      m_responses->slotCapacity());
+                Utilities::writeImageAsPng(print, sink, false, printDpi);
+                response->kind = static_cast<uint32_t>(ShmResponseKind::PNG_IMAGE);
+                response->length = sink.size();
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown shared memory request kind " + std::to_string(request->kind));
+        }
+    }
+    catch (const std::exception & ex)
+    {
+        const std::string message = ex.what();
+        writeResponse(*m_responses, response, ShmResponseKind::ERROR_MESSAGE, message.data(), message.size());
+    }
+    if (!requestReleased)
+    {
+        SharedMemoryRing::release(request);
+    }
+    m_responses->commitWrite(response);
+    return true;
+}
+
+void SharedMemoryServer::ingestRawImage(RingSlotHeader * request, RingSlotHeader * response)
+{
+    if (request->type != CV_8UC3 || request->rows <= 0 || request->cols <= 0
+        || uint64_t(request->rows) * request->cols * 3 > request->length)
+    {
+        SharedMemoryRing::release(request);
+        throw std::runtime_error("Raw images must be BGR pixels filling the payload");
+    }
+    auto image = PinnedSlotAllocator::wrap(m_requests, request);
+    // Keeping the slot must leave at least another one for the producer, else it could wait forever for evictions.
+    // The producer takes any free slot, so the one left does not have to be the next in the ring
+    if (m_requests->numSlotsInUse() >= m_requests->numSlots())
+    {
+        image = image.clone();
+    }
+    const auto imageKey = m_imageStore->setImage(image);
+    writeResponse(*m_responses, response, ShmResponseKind::IMAGE_KEY, imageKey.data(), imageKey.size());
+}
+
+void SharedMemoryServer::answerAbandonedRequests(SharedMemoryRing & requests,
+                                                SharedMemoryRing & responses,
+                                                const std::string & message)
+{
+    // Each request taken gets exactly one response, in order, so the ones without a response are those published
+    // after the last response. The other slots in use hold raw images kept in place, already answered
+    const auto numAnswered = responses.numPublished();
+    for (const auto request : requests.slotsInUse())
+    {
+        if (request->sequence < numAnswered)
+        {
+            continue;
+        }
+        const auto response = responses.beginWrite();
+        if (response == nullptr)
+        {
+            // The gateway stopped reading the responses, it can not be told
+            break;
+        }
+        response->requestId = request->requestId;
+        writeResponse(responses, response, ShmResponseKind::ERROR_MESSAGE, message.data(), message.size());
+        responses.commitWrite(response);
+    }
+    requests.reclaimConsumerSlots();
+}
+} // namespace ppp
@@ -0,0 +1,222 @@
+#include "StageMetrics.h"
+#include "InstrumentedMutex.h"
+#include "Utilities.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+namespace ppp
+{
+namespace
+{
+using MetricsByName = std::map<std::string, StageStats>;
+
+std::atomic<bool> g_hardwareCountersEnabled { false };
+
+void accumulate(StageStats & total, const StageStats & stats)
+{
+    total.calls += stats.calls;
+    total.wallTimeMs += stats.wallTimeMs;
+    total.counters += stats.counters;
+    total.allocations += stats.allocations;
+}
+
+/*!@brief Metrics recorded by one thread, so that recording never waits for another thread. They are merged with
+ * the ones of the other threads when read !*/
+struct ThreadMetrics final : NonCopyable
+{
+    ThreadMetrics();
+    ~ThreadMetrics();
+
+    std::mutex mutex; ///<- Only contended while the metrics are read or reset
+    // Keyed by the address of the scope name, a literal, so that recording does not allocate once a name is known
+    std::unordered_map<const char *, StageStats> metrics[2]; ///<- Indexed by ScopeKind
+};
+
+// Threads currently recording, and the totals of the threads that have exited
+InstrumentedMutex g_stageMetricsMutex { "stageMetrics" };
+std::set<ThreadMetrics *> g_threadMetrics;
+MetricsByName g_exitedThreadMetrics[2];
+
+ThreadMetrics::ThreadMetrics()
+{
+    std::lock_guard<InstrumentedMutex> lg(g_stageMetricsMutex);
+    g_threadMetrics.insert(this);
+}
+
+ThreadMetrics::~ThreadMetrics()
+{
+    std::lock_guard<InstrumentedMutex> lg(g_stageMetricsMutex);
+    for (auto kind = 0; kind < 2; ++kind)
+    {
+        for (const auto & kv : metrics[kind])
+        {
+            accumulate(g_exitedThreadMetrics[kind][kv.first], kv.second);
+        }
+    }
+    g_threadMetrics.erase(this);
+}
+
+ThreadMetrics & currentThreadMetrics()
+{
+    thread_local ThreadMetrics threadMetrics;
+    return threadMetrics;
+}
+
+/*!@brief Metrics of all the threads, merged by name. Must be called with g_stageMetricsMutex held !*/
+MetricsByName mergedMetrics(const ScopeKind kind)
+{
+    const auto k = static_cast<int>(kind);
+    auto merged = g_exitedThreadMetrics[k];
+    for (const auto threadMetrics : g_threadMetrics)
+    {
+        std::lock_guard<std::mutex> lg(threadMetrics->mutex);
+        for (const auto & kv : threadMetrics->metrics[k])
+        {
+            accumulate(merged[kv.first], kv.second);
+        }
+    }
+    return merged;
+}
+
+rapidjson::Value toJson(const std::map<std::string, StageStats> & metrics, rapidjson::Document::AllocatorType & alloc)
+{
+    using namespace rapidjson;
+    Value metricsJson(kObjectType);
+    for (const auto & kv : metrics)
+    {
+        const auto & stats = kv.second;
+        Value stageJson(kObjectType);
+        stageJson.AddMember("calls", stats.calls, alloc);
+        stageJson.AddMember("wallTimeMs", stats.wallTimeMs, alloc);
+        if (g_hardwareCountersEnabled)
+        {
+            const auto & c = stats.counters;
+            stageJson.AddMember("cycles", c.cycles, alloc);
+            stageJson.AddMember("instructions", c.instructions, alloc);
+            stageJson.AddMember("cacheMisses", c.cacheMisses, alloc);
+            stageJson.AddMember("branchMisses", c.branchMisses, alloc);
+            // Low IPC with many cache misses points to a memory bound stage
+            const auto ipc = c.cycles > 0 ? static_cast<double>(c.instructions) / c.cycles : 0.0;
+            stageJson.AddMember("instructionsPerCycle", ipc, alloc);
+        }
+        if (AllocationTracker::isEnabled())
+        {
+            stageJson.AddMember("allocations", stats.allocations.count, alloc);
+            stageJson.AddMember("allocatedBytes", stats.allocations.bytes, alloc);
+        }
+        metricsJson.AddMember(Value(kv.first, alloc), stageJson, alloc);
+    }
+    return metricsJson;
+}
+
+rapidjson::Value lockStatsToJson(rapidjson::Document::AllocatorType & alloc)
+{
+    using namespace rapidjson;
+    Value locksJson(kObjectType);
+    InstrumentedMutex::visitLockStats([&](const std::string & name, const LockStats & stats) {
+        Value lockJson(kObjectType);
+        lockJson.AddMember("acquisitions", stats.acquisitions.load(), alloc);
+        lockJson.AddMember("contentions", stats.contentions.load(), alloc);
+        lockJson.AddMember("waitTimeMs", stats.waitTimeNs.load() / 1e6, alloc);
+        locksJson.AddMember(Value(name, alloc), lockJson, alloc);
+    });
+    return locksJson;
+}
+} // namespace
+
+void StageMetrics::setHardwareCountersEnabled(const bool enabled)
+{
+    g_hardwareCountersEnabled = enabled;
+}
+
+bool StageMetrics::hardwareCountersEnabled()
+{
+    return g_hardwareCountersEnabled;
+}
+
+void StageMetrics::record(const ScopeKind kind,
+                          const char * name,
+                          const double wallTimeMs,
+                          const StageStats & measurements)
+{
+    auto & threadMetrics = currentThreadMetrics();
+    std::lock_guard<std::mutex> lg(threadMetrics.mutex);
+    auto & stats = threadMetrics.metrics[static_cast<int>(kind)][name];
+    ++stats.calls;
+    stats.wallTimeMs += wallTimeMs;
+    stats.counters += measurements.counters;
+    stats.allocations += measurements.allocations;
+}
+
+StageStats StageMetrics::get(const std::string & name, const ScopeKind kind)
+{
+    std::lock_guard<InstrumentedMutex> lg(g_stageMetricsMutex);
+    const auto metrics = mergedMetrics(kind);
+    const auto it = metrics.find(name);
+    return it == metrics.end() ? StageStats() : it->second;
+}
+
+std::string StageMetrics::toJson()
+{
+    rapidjson::Document d;
+    d.SetObject();
+    auto & alloc = d.GetAllocator();
+
+    {
+        std::lock_guard<InstrumentedMutex> lg(g_stageMetricsMutex);
+        d.AddMember("stages", ppp::toJson(mergedMetrics(ScopeKind::STAGE), alloc), alloc);
+        d.AddMember("requests", ppp::toJson(mergedMetrics(ScopeKind::REQUEST), alloc), alloc);
+    }
+    d.AddMember("locks", lockStatsToJson(alloc), alloc);
+    return Utilities::serializeJson(d, false);
+}
+
+void StageMetrics::reset()
+{
+    {
+        std::lock_guard<InstrumentedMutex> lg(g_stageMetricsMutex);
+        for (auto & metrics : g_exitedThreadMetrics)
+        {
+            metrics.clear();
+        }
+        for (const auto threadMetrics : g_threadMetrics)
+        {
+            std::lock_guard<std::mutex> threadLock(threadMetrics->mutex);
+            for (auto & metrics : threadMetrics->metrics)
+            {
+                metrics.clear();
+            }
+        }
+    }
+    InstrumentedMutex::resetLockStats();
+}
+
+StageScope::StageScope(const char * name, const ScopeKind kind)
+: m_name(name)
+, m_kind(kind)
+, m_readCounters(StageMetrics::hardwareCountersEnabled())
+, m_startAllocations(AllocationTracker::currentThreadCounts())
+, m_startTime(std::chrono::steady_clock::now())
+{
+    if (m_readCounters)
+    {
+        m_startCounters = PerfCounters::forCurrentThread().read();
+    }
+}
+
+StageScope::~StageScope()
+{
+    StageStats measurements;
+    if (m_readCounters)
+    {
+        measurements.counters = PerfCounters::forCurrentThread().read() - m_startCounters;
+    }
+    measurements.allocations = AllocationTracker::currentThreadCounts() - m_startAllocations;
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_startTime;
+    StageMetrics::record(m_kind, m_name, elapsed.count(), measurements);
+}
+} // namespace ppp
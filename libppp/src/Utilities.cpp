@@ -1,5 +1,9 @@
 ﻿#include "Utilities.h"
+#include "OutputSinks.h"
+#include "ParallelPngEncoder.h"
+#include "StageMetrics.h"
 
+#include <bitset>
 #include <numeric>
 #include <unordered_set>
 
@@ -220,6 +224,79 @@ uint32_t Utilities::crc32(uint32_t crc, const uint8_t * begin, const uint8_t * e
     return crc;
 }
 
+void Utilities::splitLumaChroma(const cv::Mat & bgrImage, cv::Mat & luma, cv::Mat & chroma)
+{
+    cv::Mat yCrCbImage;
+    cvtColor(bgrImage, yCrCbImage, cv::COLOR_BGR2YCrCb);
+
+    luma.create(bgrImage.size(), CV_8UC1);
+    cv::Mat fullChroma(bgrImage.size(), CV_8UC2);
+    cv::Mat planes[] = { luma, fullChroma };
+    const int fromTo[] = { 0, 0, 1, 1, 2, 2 };
+    mixChannels(&yCrCbImage, 1, planes, 2, fromTo, 3);
+
+    const cv::Size chromaSize((bgrImage.cols + 1) / 2, (bgrImage.rows + 1) / 2);
+    resize(fullChroma, chroma, chromaSize, 0, 0, cv::INTER_AREA);
+}
+
+cv::Mat Utilities::mergeLumaChroma(const cv::Mat & luma, const cv::Mat & chroma)
+{
+    cv::Mat fullChroma;
+    resize(chroma, fullChroma, luma.size(), 0, 0, cv::INTER_LINEAR);
+
+    cv::Mat yCrCbImage(luma.size(), CV_8UC3);
+    const cv::Mat planes[] = { luma, fullChroma };
+    const int fromTo[] = { 0, 0, 1, 1, 2, 2 };
+    mixChannels(planes, 2, &yCrCbImage, 1, fromTo, 3);
+
+    cv::Mat bgrImage;
+    cvtColor(yCrCbImage, bgrImage, cv::COLOR_YCrCb2BGR);
+    return bgrImage;
+}
+
+uint64_t Utilities::perceptualHash(const cv::Mat & image)
+{
+    constexpr auto thumbnailSize = 32;
+    constexpr auto lowFreqSize = 8;
+
+    cv::Mat grayImage = image;
+    if (image.channels() != 1)
+    {
+        cvtColor(image, grayImage, cv::COLOR_BGR2GRAY);
+    }
+    cv::Mat thumbnail, thumbnailFloat, dctCoeffs;
+    resize(grayImage, thumbnail, cv::Size(thumbnailSize, thumbnailSize), 0, 0, cv::INTER_AREA);
+    thumbnail.convertTo(thumbnailFloat, CV_32F);
+    dct(thumbnailFloat, dctCoeffs);
+
+    // The DC term is left out of the median as it only carries the average brightness
+    std::vector<float> lowFreqs;
+    lowFreqs.reserve(lowFreqSize * lowFreqSize);
+    for (auto row = 0; row < lowFreqSize; ++row)
+    {
+        const auto coeffRow = dctCoeffs.ptr<float>(row);
+        lowFreqs.insert(lowFreqs.end(), coeffRow, coeffRow + lowFreqSize);
+    }
+    auto sortedFreqs = std::vector<float>(lowFreqs.begin() + 1, lowFreqs.end());
+    std::nth_element(sortedFreqs.begin(), sortedFreqs.begin() + sortedFreqs.size() / 2, sortedFreqs.end());
+    const auto medianFreq = sortedFreqs[sortedFreqs.size() / 2];
+
+    uint64_t hash = 0;
+    for (size_t i = 0; i < lowFreqs.size(); ++i)
+    {
+        if (lowFreqs[i] > medianFreq)
+        {
+            hash |= uint64_t(1) << i;
+        }
+    }
+    return hash;
+}
+
+int Utilities::hammingDistance(const uint64_t hash1, const uint64_t hash2)
+{
+    return static_cast<int>(std::bitset<64>(hash1 ^ hash2).count());
+}
+
 cv::Mat Utilities::rotateImage(const cv::Mat & inputImage, const int rotationAngleDegrees)
 {
     if (rotationAngleDegrees == 0)
@@ -456,10 +533,12 @@ The following values are defined for the unit specifier:
 pHYs has to go before IDAT chunk
 */
 
-void Utilities::setPngResolutionDpi(std::vector<BYTE> & imageStream, const double resolution_dpi)
+namespace
+{
+std::vector<BYTE> pngResolutionChunk(const double resolution_dpi)
 {
-    const auto chunkLenBytes = toBytes(9);
-    auto resolutionBytes = toBytes(roundInteger(resolution_dpi * 1000.0 / 25.4));
+    const auto chunkLenBytes = Utilities::toBytes(9);
+    auto resolutionBytes = Utilities::toBytes(roundInteger(resolution_dpi * 1000.0 / 25.4));
     const std::string physStr = "pHYs";
 
     auto pHYsChunk(chunkLenBytes);
@@ -469,31 +548,106 @@ void Utilities::setPngResolutionDpi(std::vector<BYTE> & imageStream, const doubl
     pHYsChunk.insert(pHYsChunk.end(), resolutionBytes.begin(), resolutionBytes.end());
     pHYsChunk.push_back(1); // Unit is the meter
 
-    auto crcBytes = toBytes(crc32(0, &pHYsChunk[4], &pHYsChunk[4] + pHYsChunk.size() - 4));
+    auto crcBytes = Utilities::toBytes(Utilities::crc32(0, &pHYsChunk[4], &pHYsChunk[4] + pHYsChunk.size() - 4));
     pHYsChunk.insert(pHYsChunk.end(), crcBytes.begin(), crcBytes.end());
+    return pHYsChunk;
+}
 
+// Start of the chunk (its length field) before which the pHYs chunk goes, or the end of the stream
+std::vector<BYTE>::const_iterator pngResolutionChunkPosition(const std::vector<BYTE> & imageStream)
+{
     static const std::string idat = "IDAT";
     const auto it = search(imageStream.begin(), imageStream.end(), idat.begin(), idat.end());
+    return it != imageStream.end() && it - imageStream.begin() >= 4 ? it - 4 : imageStream.end();
+}
+
+void writeBytes(ppp::IOutputSink & sink, const BYTE * begin, const BYTE * end)
+{
+    sink.write(reinterpret_cast<const char *>(begin), static_cast<size_t>(end - begin));
+}
+} // namespace
+
+void Utilities::setPngResolutionDpi(std::vector<BYTE> & imageStream, const double resolution_dpi)
+{
+    const auto it = pngResolutionChunkPosition(imageStream);
     if (it != imageStream.end())
     {
         // Insert the chunk in the stream
-        imageStream.insert(it - 4, pHYsChunk.begin(), pHYsChunk.end());
+        const auto pHYsChunk = pngResolutionChunk(resolution_dpi);
+        imageStream.insert(it, pHYsChunk.begin(), pHYsChunk.end());
     }
 }
 
 std::string Utilities::encodeImageAsPng(const cv::Mat & image, const bool encodeBase64, double resolution_dpi)
 {
+    std::string result;
+    ppp::StringOutputSink sink(result);
+    writeImageAsPng(image, sink, encodeBase64, resolution_dpi);
+    return result;
+}
+
+std::string Utilities::encodeImageAsJpeg(const cv::Mat & image, const bool encodeBase64, const int quality)
+{
+    std::string result;
+    ppp::StringOutputSink sink(result);
+    writeImageAsJpeg(image, sink, encodeBase64, quality);
+    return result;
+}
+
+void Utilities::writeImageAsPng(const cv::Mat & image,
+                                ppp::IOutputSink & sink,
+                                const bool encodeBase64,
+                                const double resolution_dpi)
+{
+    PPP_STAGE_SCOPE("encode");
+    ppp::Base64OutputSink base64Sink(sink);
+    auto & output = encodeBase64 ? static_cast<ppp::IOutputSink &>(base64Sink) : sink;
+    if (ppp::ParallelPngEncoder::supports(image))
+    {
+        ppp::ParallelPngEncoder::write(image, output, resolution_dpi);
+        output.finish();
+        return;
+    }
     std::vector<BYTE> pictureData;
     imencode(".png", image, pictureData);
-    if (resolution_dpi > 0)
-    {
-        setPngResolutionDpi(pictureData, resolution_dpi);
+    const auto begin = pictureData.data();
+    const auto end = begin + pictureData.size();
+    const auto it = pngResolutionChunkPosition(pictureData);
+    if (resolution_dpi > 0 && it != pictureData.end())
+    {
+        // The chunk is written in between, instead of being inserted into the encoded stream
+        const auto position = begin + (it - pictureData.begin());
+        const auto pHYsChunk = pngResolutionChunk(resolution_dpi);
+        writeBytes(output, begin, position);
+        writeBytes(output, pHYsChunk.data(), pHYsChunk.data() + pHYsChunk.size());
+        writeBytes(output, position, end);
     }
-    if (encodeBase64)
+    else
     {
-        return base64Encode(pictureData);
+        writeBytes(output, begin, end);
     }
-    return std::string(pictureData.begin(), pictureData.end());
+    output.finish();
+}
+
+void Utilities::writeImageAsJpeg(const cv::Mat & image,
+                                 ppp::IOutputSink & sink,
+                                 const bool encodeBase64,
+                                 const int quality)
+{
+    PPP_STAGE_SCOPE("encode");
+    std::vector<BYTE> pictureData;
+    imencode(".jpg", image, pictureData, { cv::IMWRITE_JPEG_QUALITY, quality });
+    writeEncodedImage(pictureData, sink, encodeBase64);
+}
+
+void Utilities::writeEncodedImage(const std::vector<BYTE> & imageStream,
+                                  ppp::IOutputSink & sink,
+                                  const bool encodeBase64)
+{
+    ppp::Base64OutputSink base64Sink(sink);
+    auto & output = encodeBase64 ? static_cast<ppp::IOutputSink &>(base64Sink) : sink;
+    writeBytes(output, imageStream.data(), imageStream.data() + imageStream.size());
+    output.finish();
 }
 
 std::string Utilities::serializeJson(rapidjson::Document & d, const bool pretty)
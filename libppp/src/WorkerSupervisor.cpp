@@ -0,0 +1,172 @@
+#include "WorkerSupervisor.h"
+
+#include <stdexcept>
+#include <string>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(EMSCRIPTEN) && !defined(__ANDROID__)
+#define PPP_HAS_FORK 1
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace ppp
+{
+namespace
+{
+constexpr std::chrono::seconds RESPAWN_THROTTLE(1);
+
+#ifdef PPP_HAS_FORK
+volatile std::sig_atomic_t g_stopRequested = 0;
+
+void onStopSignal(int)
+{
+    g_stopRequested = 1;
+}
+#endif
+} // namespace
+
+WorkerSupervisor::WorkerSupervisor(const size_t numWorkers,
+                                   WorkerMain workerMain,
+                                   std::function<void(size_t)> onWorkerExit)
+: m_workerMain(std::move(workerMain))
+, m_onWorkerExit(std::move(onWorkerExit))
+, m_workers(numWorkers)
+{
+    if (numWorkers == 0)
+    {
+        throw std::runtime_error("At least one worker process is needed");
+    }
+}
+
+WorkerSupervisor::~WorkerSupervisor()
+{
+    stop();
+}
+
+void WorkerSupervisor::start()
+{
+    m_running = true;
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        if (m_workers[i].pid < 0)
+        {
+            spawn(i);
+        }
+    }
+}
+
+size_t WorkerSupervisor::numRespawns() const
+{
+    return m_numRespawns;
+}
+
+std::vector<int> WorkerSupervisor::workerPids() const
+{
+    std::vector<int> pids;
+    for (const auto & worker : m_workers)
+    {
+        pids.push_back(worker.pid);
+    }
+    return pids;
+}
+
+#ifdef PPP_HAS_FORK
+void WorkerSupervisor::spawn(const size_t workerIndex)
+{
+    const auto pid = fork();
+    if (pid < 0)
+    {
+        throw std::runtime_error("Unable to fork worker process " + std::to_string(workerIndex));
+    }
+    if (pid == 0)
+    {
+        g_stopRequested = 0;
+        std::signal(SIGTERM, onStopSignal);
+        auto exitCode = 0;
+        try
+        {
+            m_workerMain(workerIndex, []() { return g_stopRequested == 0; });
+        }
+        catch (...)
+        {
+            // Nothing may unwind past this frame, it would run the supervisor's code in the child
+            exitCode = 1;
+        }
+        // Skip the static destructors and atexit handlers, they belong to the supervisor
+        _exit(exitCode);
+    }
+    auto & worker = m_workers[workerIndex];
+    worker.pid = pid;
+    worker.spawnTime = std::chrono::steady_clock::now();
+}
+
+void WorkerSupervisor::superviseOnce()
+{
+    if (!m_running)
+    {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        auto & worker = m_workers[i];
+        int status;
+        // Only wait for our own workers, other children of the process are none of our business
+        if (worker.pid < 0 || waitpid(worker.pid, &status, WNOHANG) != worker.pid)
+        {
+            continue;
+        }
+        worker.pid = -1;
+        worker.respawnTime = now - worker.spawnTime < RESPAWN_THROTTLE ? now + RESPAWN_THROTTLE : now;
+        if (m_onWorkerExit)
+        {
+            m_onWorkerExit(i);
+        }
+    }
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        if (m_workers[i].pid < 0 && m_workers[i].respawnTime <= now)
+        {
+            spawn(i);
+            ++m_numRespawns;
+        }
+    }
+}
+
+void WorkerSupervisor::stop()
+{
+    m_running = false;
+    for (const auto & worker : m_workers)
+    {
+        if (worker.pid > 0)
+        {
+            kill(worker.pid, SIGTERM);
+        }
+    }
+    for (auto & worker : m_workers)
+    {
+        if (worker.pid > 0)
+        {
+            int status;
+            waitpid(worker.pid, &status, 0);
+            worker.pid = -1;
+        }
+    }
+}
+#else
+void WorkerSupervisor::spawn(size_t)
+{
+    throw std::runtime_error("Worker processes are not supported on this platform");
+}
+
+void WorkerSupervisor::superviseOnce()
+{
+}
+
+void WorkerSupervisor::stop()
+{
+}
+#endif
+} // namespace ppp
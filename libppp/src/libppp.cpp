@@ -1,16 +1,32 @@
 //
 //
 #include "libppp.h"
+#include "ColorProfileStore.h"
 #include "EasyExif.h"
 #include "ImageStore.h"
 #include "LandMarks.h"
+#include "OutputSinks.h"
 #include "PhotoStandard.h"
+#include "PhotoStandardCatalog.h"
 #include "PppEngine.h"
 #include "PrintDefinition.h"
+#include "RequestParser.h"
+#include "RequestRecorder.h"
+#include "SharedMemoryRing.h"
+#include "SharedMemoryServer.h"
+#include "StageMetrics.h"
 #include "Utilities.h"
+#include "WorkerSupervisor.h"
 
+#include <opencv2/core/utility.hpp>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <regex>
+#include <thread>
 
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
@@ -25,26 +41,129 @@ namespace ppp
 PublicPppEngine g_c_pppInstance;
 string g_last_error;
 
-cv::Point fromJson(rapidjson::Value & v)
+// Prints rendered as JPEG are final outputs, not previews, so they are encoded close to losslessly
+constexpr auto FINAL_JPEG_QUALITY = 95;
+
+// Parses a request into the request object of the calling thread, reused so that parsing allocates nothing
+const ApiRequest & parseRequest(const std::string & json)
+{
+    thread_local RequestParser parser;
+    thread_local ApiRequest request;
+    parser.parse(json, request);
+    return request;
+}
+
+template <typename T>
+const T & required(const std::optional<T> & field, const char * key)
+{
+    if (!field)
+    {
+        throw std::runtime_error(std::string("Missing '") + key + "' in the request");
+    }
+    return *field;
+}
+
+// The catalog entry, if any, is kept alive by catalogEntry
+const PrintDefinition & printDefinitionOf(const PhotoStandardCatalog & catalog,
+                                          const ApiRequest & request,
+                                          PrintDefinitionSPtr & catalogEntry)
+{
+    if (request.canvasId.empty())
+    {
+        return required(request.canvas, PRINT_DEFINITION);
+    }
+    catalogEntry = catalog.printDefinition(request.canvasId);
+    return *catalogEntry;
+}
+
+// Requests and gang sheet jobs either reference a catalog entry by id or describe the standard in full
+template <typename Request>
+const PhotoStandard & photoStandardOf(const PhotoStandardCatalog & catalog,
+                                      const Request & request,
+                                      PhotoStandardSPtr & catalogEntry,
+                                      const double printDpi = 0.0)
+{
+    if (request.standardId.empty())
+    {
+        return required(request.standard, PHOTO_STANDARD);
+    }
+    catalogEntry = catalog.photoStandard(request.standardId);
+    if (printDpi > catalogEntry->resolutionDpi())
+    {
+        catalogEntry = catalog.photoStandard(request.standardId, printDpi);
+    }
+    return *catalogEntry;
+}
+
+// Renders the tiled print of a createTiledPrint request, printDpi receives the resolution of the result
+cv::Mat renderTiledPrint(PppEngine & engine, const std::string & imageId, const ApiRequest & request, double & printDpi)
 {
-    return cv::Point(v["x"].GetInt(), v["y"].GetInt());
+    const auto & catalog = *engine.getCatalog();
+    PrintDefinitionSPtr canvasEntry;
+    PhotoStandardSPtr standardEntry;
+    const auto & canvas = printDefinitionOf(catalog, request, canvasEntry);
+    const auto & ps = photoStandardOf(catalog, request, standardEntry, canvas.resolutionDpi());
+    const auto & crownPoint = required(request.crownPoint, CROWN_POINT);
+    const auto & chinPoint = required(request.chinPoint, CHIN_POINT);
+
+    // The print is rendered at the highest of both resolutions
+    printDpi = std::max(ps.resolutionDpi(), canvas.resolutionDpi());
+    return engine.createTiledPrint(
+        imageId, ps, canvas, crownPoint, chinPoint, request.autoCorrect, request.printProfile, &request.overrides);
+}
+
+// Crops the photo of a digital size createTiledPrint request from the JPEG file of the picture, when possible
+bool createLosslessDigitalPhoto(PppEngine & engine,
+                                const std::string & imageId,
+                                const ApiRequest & request,
+                                std::vector<BYTE> & jpeg)
+{
+    if (request.autoCorrect || !request.printProfile.empty())
+    {
+        // The pixels have to be modified
+        return false;
+    }
+    const auto & catalog = *engine.getCatalog();
+    PrintDefinitionSPtr canvasEntry;
+    PhotoStandardSPtr standardEntry;
+    const auto & canvas = printDefinitionOf(catalog, request, canvasEntry);
+    const auto & ps = photoStandardOf(catalog, request, standardEntry, canvas.resolutionDpi());
+    return engine.createLosslessDigitalPhoto(imageId,
+                                             ps,
+                                             canvas,
+                                             required(request.crownPoint, CROWN_POINT),
+                                             required(request.chinPoint, CHIN_POINT),
+                                             jpeg);
 }
 
 PublicPppEngine::PublicPppEngine()
 : m_pPppEngine(new PppEngine)
+, m_pRecorder(new RequestRecorder)
 {
 }
 
 PublicPppEngine::~PublicPppEngine()
 {
+    delete m_pRecorder;
     delete m_pPppEngine;
 }
 
 bool PublicPppEngine::configure(const char * jsonConfig, void * callback) const
 {
+    m_pRecorder->setConfiguration(jsonConfig);
     return m_pPppEngine->configure(jsonConfig, callback);
 }
 
+void PublicPppEngine::startRecording(const std::string & archiveFilePath) const
+{
+    m_pRecorder->start(archiveFilePath);
+}
+
+void PublicPppEngine::stopRecording() const
+{
+    m_pRecorder->stop();
+}
+
 bool PublicPppEngine::isConfigured() const
 {
     return m_pPppEngine->isConfigured();
@@ -52,6 +171,9 @@ bool PublicPppEngine::isConfigured() const
 
 std::string PublicPppEngine::setImage(const char * bufferData, const size_t bufferLength) const
 {
+    PPP_REQUEST_SCOPE("setImage");
+    RecordedCall recordedCall(*m_pRecorder, "setImage");
+    recordedCall.arg(bufferData, bufferLength > 0 ? bufferLength : strlen(bufferData)).arg(to_string(bufferLength));
     const auto & imageStore = m_pPppEngine->getImageStore();
     const auto imageKey = imageStore->setImage(bufferData, bufferLength);
 
@@ -73,66 +195,264 @@ std::string PublicPppEngine::setImage(const char * bufferData, const size_t buff
 
 std::string PublicPppEngine::getImage(const std::string & imageKey) const
 {
+    PPP_REQUEST_SCOPE("getImage");
+    RecordedCall recordedCall(*m_pRecorder, "getImage");
+    recordedCall.arg(imageKey);
     const auto & imageStore = m_pPppEngine->getImageStore();
     if (!imageStore->containsImage(imageKey))
     {
         return "";
     }
+    // Empty if evicted since it was checked
     const auto & image = imageStore->getImage(imageKey);
-    return Utilities::encodeImageAsPng(image, false);
+    return image.empty() ? "" : Utilities::encodeImageAsPng(image, false);
 }
 
-std::string PublicPppEngine::detectLandmarks(const std::string & imageId) const
+// Detects the landmarks of the image, returns them as JSON or an empty string if the image is not in the store
+std::string detectLandmarksOf(PppEngine & engine, const std::string & imageId, const ParameterOverrides & overrides)
 {
-    const auto & imageStore = m_pPppEngine->getImageStore();
+    const auto & imageStore = engine.getImageStore();
     if (!imageStore->containsImage(imageId))
     {
         return "";
     }
-    m_pPppEngine->detectLandMarks(imageId);
+    if (!overrides.empty())
+    {
+        // The overridden estimate only goes to this request, the landmarks in the store are shared
+        LandMarks landMarks;
+        engine.detectLandMarks(imageId, overrides, landMarks);
+        return landMarks.toJson(false);
+    }
+    engine.detectLandMarks(imageId);
     const auto & landMarks = imageStore->getLandMarks(imageId);
-    return landMarks->toJson(false);
+    return landMarks == nullptr ? "" : landMarks->toJson(false);
+}
+
+std::string PublicPppEngine::detectLandmarks(const std::string & imageId) const
+{
+    PPP_REQUEST_SCOPE("detectLandmarks");
+    RecordedCall recordedCall(*m_pRecorder, "detectLandmarks");
+    recordedCall.arg(imageId);
+    return detectLandmarksOf(*m_pPppEngine, imageId, ParameterOverrides());
+}
+
+std::string PublicPppEngine::detectLandmarks(const std::string & imageId, const std::string & request) const
+{
+    PPP_REQUEST_SCOPE("detectLandmarks");
+    RecordedCall recordedCall(*m_pRecorder, "detectLandmarks");
+    recordedCall.arg(imageId).arg(request);
+    const auto & r = parseRequest(request);
+    return detectLandmarksOf(*m_pPppEngine, imageId, r.overrides);
 }
 
 std::string PublicPppEngine::createTiledPrint(const std::string & imageId, const std::string & request) const
 {
-    rapidjson::Document d;
-    d.Parse(request.c_str());
+    std::string output;
+    StringOutputSink sink(output);
+    createTiledPrint(imageId, request, sink);
+    return output;
+}
 
-    const auto ps = PhotoStandard::fromJson(d[PHOTO_STANDARD]);
-    const auto canvas = PrintDefinition::fromJson(d[PRINT_DEFINITION]);
-    auto crownPoint = fromJson(d[CROWN_POINT]);
-    auto chinPoint = fromJson(d[CHIN_POINT]);
-    auto asBase64Encode = false;
+void PublicPppEngine::createTiledPrint(const std::string & imageId,
+                                       const std::string & request,
+                                       IOutputSink & sink) const
+{
+    PPP_REQUEST_SCOPE("createTiledPrint");
+    RecordedCall recordedCall(*m_pRecorder, "createTiledPrint");
+    recordedCall.arg(imageId).arg(request);
+    const auto & r = parseRequest(request);
 
-    if (d.HasMember(AS_BASE64))
+    double printDpi;
+    if (r.format == "jpeg")
     {
-        asBase64Encode = d[AS_BASE64].GetBool();
+        std::vector<BYTE> jpeg;
+        if (createLosslessDigitalPhoto(*m_pPppEngine, imageId, r, jpeg))
+        {
+            Utilities::writeEncodedImage(jpeg, sink, r.asBase64);
+            return;
+        }
+        Utilities::writeImageAsJpeg(
+            renderTiledPrint(*m_pPppEngine, imageId, r, printDpi), sink, r.asBase64, FINAL_JPEG_QUALITY);
+        return;
     }
+    const auto result = renderTiledPrint(*m_pPppEngine, imageId, r, printDpi);
+    Utilities::writeImageAsPng(result, sink, r.asBase64, printDpi);
+}
 
-    const auto result = m_pPppEngine->createTiledPrint(imageId, *ps, *canvas, crownPoint, chinPoint);
-    return Utilities::encodeImageAsPng(result, asBase64Encode, canvas->resolutionDpi());
+void PublicPppEngine::serveSharedMemory(const std::string & requestRingName,
+                                        const std::string & responseRingName,
+                                        const std::function<bool()> & keepRunning) const
+{
+    const auto requests = SharedMemoryRing::open(requestRingName);
+    const auto responses = SharedMemoryRing::open(responseRingName);
+    const auto renderer = [this](const std::string & request, double & printDpi) {
+        PPP_REQUEST_SCOPE("createTiledPrint");
+        const auto & r = parseRequest(request);
+        if (r.imageId.empty())
+        {
+            throw std::runtime_error(std::string("Missing '") + IMAGE_ID + "' in the request");
+        }
+        return renderTiledPrint(*m_pPppEngine, r.imageId, r, printDpi);
+    };
+    SharedMemoryServer server(m_pPppEngine->getImageStore(), renderer, requests, responses);
+    while (keepRunning())
+    {
+        if (!server.serveOne())
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
 }
 
-std::string PublicPppEngine::checkCompliance(const std::string & request) const
+void PublicPppEngine::serveWorkers(const std::string & ringPrefix,
+                                   const size_t numWorkers,
+                                   const std::function<bool()> & keepRunning) const
 {
-    rapidjson::Document d;
-    d.Parse(request.c_str());
+    const auto ringName = [ringPrefix](const char * direction, const size_t workerIndex) {
+        return ringPrefix + "_" + direction + "_" + std::to_string(workerIndex);
+    };
+    const auto workerMain = [this, ringName](const size_t workerIndex, const std::function<bool()> & workerRunning) {
+        // The parent's thread pool does not survive fork, and workers are the unit of parallelism anyway
+        cv::setNumThreads(0);
+        serveSharedMemory(ringName("requests", workerIndex), ringName("responses", workerIndex), workerRunning);
+    };
+    const auto onWorkerExit = [ringName](const size_t workerIndex) {
+        // Images the dead worker kept in place are gone with its image store, the request it was processing is
+        // answered so that the gateway can retry it
+        const auto requests = SharedMemoryRing::open(ringName("requests", workerIndex));
+        const auto responses = SharedMemoryRing::open(ringName("responses", workerIndex));
+        SharedMemoryServer::answerAbandonedRequests(*requests, *responses, "Worker exited while serving the request");
+    };
+
+    WorkerSupervisor supervisor(numWorkers, workerMain, onWorkerExit);
+    supervisor.start();
+    while (keepRunning())
+    {
+        supervisor.superviseOnce();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    supervisor.stop();
+}
 
-    const std::string imageId = d[IMAGE_ID].GetString();
-    const auto ps = PhotoStandard::fromJson(d[PHOTO_STANDARD]);
-    const auto crownPoint = fromJson(d[CROWN_POINT]);
-    const auto chinPoint = fromJson(d[CHIN_POINT]);
+int PublicPppEngine::createGangSheets(const std::string & request,
+                                      const std::function<void(const std::string & sheetPng)> & onSheetReady) const
+{
+    PPP_REQUEST_SCOPE("createGangSheets");
+    RecordedCall recordedCall(*m_pRecorder, "createGangSheets");
+    recordedCall.arg(request);
+    const auto & r = parseRequest(request);
+
+    const auto & catalog = *m_pPppEngine->getCatalog();
+    PrintDefinitionSPtr canvasEntry;
+    // Copied, onSheetReady may make other requests from this thread, which reuse the parsed request
+    const auto canvas = printDefinitionOf(catalog, r, canvasEntry);
+    const auto overrides = r.overrides;
+    const auto asBase64Encode = r.asBase64;
+    if (r.jobs.empty())
+    {
+        throw std::runtime_error(std::string("Missing '") + GANG_SHEET_JOBS + "' in the request");
+    }
 
-    vector<std::string> complianceCheckNames;
+    vector<GangSheetJob> jobs;
+    for (const auto & jobRequest : r.jobs)
+    {
+        GangSheetJob job;
+        job.imageKey = jobRequest.imageId;
+        const auto & ps = photoStandardOf(catalog, jobRequest, job.photoStandard, canvas.resolutionDpi());
+        if (job.photoStandard == nullptr)
+        {
+            job.photoStandard = std::make_shared<PhotoStandard>(ps);
+        }
+        job.crownPoint = *jobRequest.crownPoint;
+        job.chinPoint = *jobRequest.chinPoint;
+        job.copies = jobRequest.copies;
+        jobs.push_back(job);
+    }
 
-    const auto array = d[COMPLIANCE_CHECKS].GetArray();
-    for (rapidjson::SizeType i = 0; i < array.Size(); i++)
+    const auto numSheets = m_pPppEngine->createGangSheets(
+        jobs,
+        canvas,
+        [&](const cv::Mat & sheet) {
+            onSheetReady(Utilities::encodeImageAsPng(sheet, asBase64Encode, canvas.resolutionDpi()));
+        },
+        &overrides);
+    return static_cast<int>(numSheets);
+}
+
+std::string PublicPppEngine::createPreview(const std::string & imageId,
+                                           const std::string & request,
+                                           int & width,
+                                           int & height) const
+{
+    PPP_REQUEST_SCOPE("createPreview");
+    RecordedCall recordedCall(*m_pRecorder, "createPreview");
+    recordedCall.arg(imageId).arg(request);
+    const auto & r = parseRequest(request);
+
+    PhotoStandardSPtr standardEntry;
+    const auto & ps = photoStandardOf(*m_pPppEngine->getCatalog(), r, standardEntry);
+    const auto & crownPoint = required(r.crownPoint, CROWN_POINT);
+    const auto & chinPoint = required(r.chinPoint, CHIN_POINT);
+    const auto format = r.format.empty() ? std::string("jpeg") : r.format;
+    const auto asBase64Encode = r.asBase64;
+
+    const auto preview = m_pPppEngine->createPreview(imageId, ps, crownPoint, chinPoint, r.maxHeight, &r.overrides);
+    width = preview.cols;
+    height = preview.rows;
+    if (format == "rgba")
+    {
+        cv::Mat rgbaImage;
+        cv::cvtColor(preview, rgbaImage, cv::COLOR_BGR2RGBA);
+        return std::string(rgbaImage.datastart, rgbaImage.dataend);
+    }
+    if (format != "jpeg")
     {
-        complianceCheckNames.emplace_back(array[i].GetString());
+        throw std::runtime_error("Unsupported preview format '" + format + "'");
     }
+    return Utilities::encodeImageAsJpeg(preview, asBase64Encode);
+}
+
+std::string PublicPppEngine::checkCompliance(const std::string & request) const
+{
+    PPP_REQUEST_SCOPE("checkCompliance");
+    RecordedCall recordedCall(*m_pRecorder, "checkCompliance");
+    recordedCall.arg(request);
+    const auto & r = parseRequest(request);
+
+    // The compliance checkers share the standard, so one given in full is copied into a shared object
+    PhotoStandardSPtr ps;
+    const auto & standard = photoStandardOf(*m_pPppEngine->getCatalog(), r, ps);
+    if (ps == nullptr)
+    {
+        ps = std::make_shared<PhotoStandard>(standard);
+    }
+    return m_pPppEngine->checkCompliance(r.imageId,
+                                         ps,
+                                         required(r.crownPoint, CROWN_POINT),
+                                         required(r.chinPoint, CHIN_POINT),
+                                         r.complianceChecks);
+}
+
+std::string PublicPppEngine::getMetrics() const
+{
+    return m_pPppEngine->getMetrics();
+}
+
+void PublicPppEngine::registerPhotoStandard(const std::string & id, const std::string & photoStandardJson) const
+{
+    m_pPppEngine->getCatalog()->registerPhotoStandard(id, PhotoStandard::fromJson(photoStandardJson));
+}
+
+void PublicPppEngine::registerPrintDefinition(const std::string & id, const std::string & printDefinitionJson) const
+{
+    rapidjson::Document d;
+    d.Parse(printDefinitionJson.c_str());
+    m_pPppEngine->getCatalog()->registerPrintDefinition(id, PrintDefinition::fromJson(d));
+}
 
-    return m_pPppEngine->checkCompliance(imageId, ps, crownPoint, chinPoint, complianceCheckNames);
+void PublicPppEngine::registerColorProfile(const std::string & id, const std::string & iccData) const
+{
+    m_pPppEngine->getColorProfiles()->registerProfile(id, iccData);
 }
 } // namespace ppp
 
@@ -180,13 +500,83 @@ bool detect_landmarks(const char * img_id, char * landmarks)
     TRYRUN(auto landmarksStr = g_c_pppInstance.detectLandmarks(img_id); strcpy(landmarks, landmarksStr.c_str()););
 }
 
+EMSCRIPTEN_KEEPALIVE
+bool detect_landmarks_with_overrides(const char * img_id, const char * request, char * landmarks)
+{
+    using namespace ppp;
+    TRYRUN(auto landmarksStr = g_c_pppInstance.detectLandmarks(img_id, request);
+           strcpy(landmarks, landmarksStr.c_str()););
+}
+
 EMSCRIPTEN_KEEPALIVE
 int create_tiled_print(const char * img_id, const char * request, char * out_buf)
 {
     using namespace ppp;
     try
     {
-        auto output = g_c_pppInstance.createTiledPrint(img_id, request);
+        // The capacity of the buffer is not known, it is up to the caller to size it for the print
+        BufferOutputSink sink(out_buf, SIZE_MAX);
+        g_c_pppInstance.createTiledPrint(img_id, request, sink);
+        return static_cast<int>(sink.size());
+    }
+    catch (const std::exception & ex)
+    {
+        g_last_error = ex.what();
+        return 0;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int create_tiled_print_to_fd(const char * img_id, const char * request, int fd)
+{
+    using namespace ppp;
+    try
+    {
+        FileDescriptorOutputSink sink(fd);
+        g_c_pppInstance.createTiledPrint(img_id, request, sink);
+        return static_cast<int>(sink.size());
+    }
+    catch (const std::exception & ex)
+    {
+        g_last_error = ex.what();
+        return 0;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int create_tiled_print_chunked(const char * img_id,
+                               const char * request,
+                               ppp_output_callback callback,
+                               void * user_data,
+                               int chunk_size)
+{
+    using namespace ppp;
+    try
+    {
+        size_t out_size = 0;
+        CallbackOutputSink sink(
+            [&](const char * data, const size_t size) {
+                out_size += size;
+                callback(data, static_cast<int>(size), user_data);
+            },
+            static_cast<size_t>(std::max(chunk_size, 0)));
+        g_c_pppInstance.createTiledPrint(img_id, request, sink);
+        return static_cast<int>(out_size);
+    }
+    catch (const std::exception & ex)
+    {
+        g_last_error = ex.what();
+        return 0;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int create_preview(const char * img_id, const char * request, char * out_buf, int * width, int * height)
+{
+    using namespace ppp;
+    try
+    {
+        auto output = g_c_pppInstance.createPreview(img_id, request, *width, *height);
         const auto out_size = static_cast<int>(output.size());
         copy(output.begin(), output.end(), out_buf);
         return out_size;
@@ -198,6 +588,45 @@ int create_tiled_print(const char * img_id, const char * request, char * out_buf
     }
 }
 
+EMSCRIPTEN_KEEPALIVE
+int get_metrics(char * out_buf)
+{
+    using namespace ppp;
+    try
+    {
+        auto output = g_c_pppInstance.getMetrics();
+        const auto out_size = static_cast<int>(output.size());
+        copy(output.begin(), output.end(), out_buf);
+        return out_size;
+    }
+    catch (const std::exception & ex)
+    {
+        g_last_error = ex.what();
+        return 0;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool start_recording(const char * archive_path)
+{
+    using namespace ppp;
+    TRYRUN(g_c_pppInstance.startRecording(archive_path););
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool stop_recording()
+{
+    using namespace ppp;
+    TRYRUN(g_c_pppInstance.stopRecording(););
+}
+
+EMSCRIPTEN_KEEPALIVE
+bool register_color_profile(const char * profile_id, const char * icc_buf, int icc_buf_size)
+{
+    using namespace ppp;
+    TRYRUN(g_c_pppInstance.registerColorProfile(profile_id, std::string(icc_buf, icc_buf_size)););
+}
+
 EMSCRIPTEN_KEEPALIVE
 int get_image(const char * img_id, char * out_buf)
 {
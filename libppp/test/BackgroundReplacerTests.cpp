@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "BackgroundReplacer.h"
+#include "ConfigLoader.h"
+
+#include <opencv2/imgproc.hpp>
+
+namespace ppp
+{
+class BackgroundReplacerTests : public testing::Test
+{
+protected:
+    BackgroundReplacerTests()
+    {
+        m_backgroundReplacer.configure(std::make_shared<ConfigLoader>(R"({
+            "photoPrintMaker": {"background": [255, 255, 255], "backgroundReplacement": {"enabled": true}}
+        })"));
+
+        // Portrait with a head and shoulders over a green background
+        m_image = cv::Mat(400, 300, CV_8UC3, cv::Scalar(60, 170, 40));
+        cv::rectangle(m_image, cv::Point(50, 260), cv::Point(250, 400), cv::Scalar(150, 60, 40), cv::FILLED);
+        cv::ellipse(m_image, cv::Point(150, 150), cv::Size(60, 80), 0, 0, 360, cv::Scalar(120, 150, 210), cv::FILLED);
+        cv::Mat noise(m_image.size(), CV_8UC3);
+        cv::randn(noise, 0, 4);
+        m_image += noise;
+    }
+
+    BackgroundReplacer m_backgroundReplacer;
+    cv::Mat m_image;
+    const cv::Point2d m_crownPoint { 150, 70 };
+    const cv::Point2d m_chinPoint { 150, 230 };
+};
+
+TEST_F(BackgroundReplacerTests, BackgroundIsReplacedAndPortraitKept)
+{
+    ASSERT_TRUE(m_backgroundReplacer.isEnabled());
+    auto image = m_image.clone();
+    m_backgroundReplacer.replace(image, m_crownPoint, m_chinPoint, cv::Scalar(255, 255, 255));
+
+    const cv::Vec3b white(255, 255, 255);
+    for (const auto & backgroundPoint : { cv::Point(10, 10), cv::Point(30, 200), cv::Point(290, 250) })
+    {
+        EXPECT_LE(cv::norm(image.at<cv::Vec3b>(backgroundPoint), white, cv::NORM_INF), 8) << backgroundPoint;
+    }
+    for (const auto & foregroundPoint : { cv::Point(150, 150), cv::Point(150, 350), cv::Point(100, 300) })
+    {
+        EXPECT_EQ(image.at<cv::Vec3b>(foregroundPoint), m_image.at<cv::Vec3b>(foregroundPoint)) << foregroundPoint;
+    }
+}
+
+TEST_F(BackgroundReplacerTests, MatteIsEstimatedOnTheProxy)
+{
+    const auto matte = m_backgroundReplacer.estimateProxyMatte(m_image, m_crownPoint, m_chinPoint);
+    ASSERT_EQ(matte.size(), m_image.size());
+    EXPECT_EQ(matte.type(), CV_32F);
+    EXPECT_EQ(matte.at<float>(150, 150), 1.0f);
+    EXPECT_EQ(matte.at<float>(10, 10), 0.0f);
+}
+} // namespace ppp
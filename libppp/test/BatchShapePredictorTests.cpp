@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include "BatchShapePredictor.h"
+#include "TestHelpers.h"
+
+#include <dlib/image_transforms/assign_image.h>
+#include <dlib/opencv/cv_image.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <fstream>
+
+namespace ppp
+{
+class BatchShapePredictorTests : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::ifstream stream(resolvePath("libppp/share/sp_model.dat"), std::ios::binary);
+        dlib::deserialize(m_shapePredictor, stream);
+
+        // Faces of several sizes and positions, some of them partly outside of the image, in two images
+        const auto image = cv::imread(resolvePath("research/my_database/000.jpg"));
+        ASSERT_FALSE(image.empty());
+        cv::Mat smallImage;
+        cv::resize(image, smallImage, cv::Size(), 0.5, 0.5, cv::INTER_AREA);
+        const std::vector<cv::Mat> colorImages { image, smallImage };
+        m_grayImages.resize(colorImages.size());
+        m_colorImages.resize(colorImages.size());
+        for (size_t i = 0; i < colorImages.size(); ++i)
+        {
+            cv::Mat grayImage;
+            cv::cvtColor(colorImages[i], grayImage, cv::COLOR_BGR2GRAY);
+            dlib::assign_image(m_grayImages[i], dlib::cv_image<unsigned char>(grayImage));
+            dlib::assign_image(m_colorImages[i], dlib::cv_image<dlib::bgr_pixel>(colorImages[i]));
+        }
+        for (size_t i = 0; i < 13; ++i)
+        {
+            const auto size = static_cast<long>(80 + 37 * i);
+            const auto x = static_cast<long>(53 * i) - 40;
+            const auto y = static_cast<long>(31 * i) - 20;
+            m_faces.emplace_back(x, y, x + size, y + size);
+        }
+    }
+
+    template <typename image_type>
+    void verifySameShapes(const std::vector<image_type> & images) const
+    {
+        std::vector<const image_type *> faceImages;
+        for (size_t i = 0; i < m_faces.size(); ++i)
+        {
+            faceImages.push_back(&images[i % images.size()]);
+        }
+
+        const BatchShapePredictor batchShapePredictor(m_shapePredictor);
+        EXPECT_EQ(batchShapePredictor.numParts(), m_shapePredictor.num_parts());
+        // 13 faces, so the last block is not full
+        const auto shapes = batchShapePredictor(faceImages, m_faces);
+        ASSERT_EQ(shapes.size(), m_faces.size());
+        for (size_t i = 0; i < m_faces.size(); ++i)
+        {
+            const auto expected = m_shapePredictor(*faceImages[i], m_faces[i]);
+            EXPECT_EQ(shapes[i].get_rect(), m_faces[i]);
+            ASSERT_EQ(shapes[i].num_parts(), expected.num_parts());
+            for (unsigned long j = 0; j < expected.num_parts(); ++j)
+            {
+                EXPECT_EQ(shapes[i].part(j), expected.part(j)) << "Face " << i << " part " << j;
+            }
+        }
+    }
+
+    dlib::shape_predictor m_shapePredictor;
+    std::vector<dlib::array2d<unsigned char>> m_grayImages;
+    std::vector<dlib::array2d<dlib::bgr_pixel>> m_colorImages;
+    std::vector<dlib::rectangle> m_faces;
+};
+
+TEST_F(BatchShapePredictorTests, GrayShapesAreIdenticalToDlib)
+{
+    verifySameShapes(m_grayImages);
+}
+
+TEST_F(BatchShapePredictorTests, ColorShapesAreIdenticalToDlib)
+{
+    verifySameShapes(m_colorImages);
+}
+
+TEST_F(BatchShapePredictorTests, ConvergedFacesLeaveTheCascade)
+{
+    std::vector<const dlib::array2d<unsigned char> *> faceImages(m_faces.size(), &m_grayImages.front());
+    BatchShapePredictor batchShapePredictor(m_shapePredictor);
+    std::vector<size_t> numCascades;
+    const auto shapes = batchShapePredictor(faceImages, m_faces, &numCascades);
+    EXPECT_EQ(numCascades, std::vector<size_t>(m_faces.size(), batchShapePredictor.numCascades()));
+
+    // Any update is below this threshold, so only the first level runs
+    batchShapePredictor.setConvergenceThreshold(10.0f);
+    batchShapePredictor(faceImages, m_faces, &numCascades);
+    EXPECT_EQ(numCascades, std::vector<size_t>(m_faces.size(), 1));
+
+    // Faces stop at different levels, the ones running to the end are unchanged
+    batchShapePredictor.setConvergenceThreshold(0.004f);
+    const auto earlyShapes = batchShapePredictor(faceImages, m_faces, &numCascades);
+    for (size_t i = 0; i < m_faces.size(); ++i)
+    {
+        ASSERT_GE(numCascades[i], 1);
+        ASSERT_LE(numCascades[i], batchShapePredictor.numCascades());
+        if (numCascades[i] == batchShapePredictor.numCascades())
+        {
+            EXPECT_EQ(earlyShapes[i].part(0), shapes[i].part(0));
+        }
+    }
+}
+
+TEST_F(BatchShapePredictorTests, EmptyBatch)
+{
+    const BatchShapePredictor batchShapePredictor(m_shapePredictor);
+    EXPECT_TRUE(batchShapePredictor(std::vector<const dlib::array2d<unsigned char> *>(), {}).empty());
+}
+} // namespace ppp
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "ColorLut3D.h"
+
+#include <cmath>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace ppp
+{
+class ColorLut3DTests : public testing::Test
+{
+protected:
+    ColorLut3DTests()
+    {
+        cv::randu(m_image, 0, 256);
+    }
+
+    cv::Mat m_image = cv::Mat(64, 64, CV_8UC3);
+};
+
+TEST_F(ColorLut3DTests, IdentityLeavesImageUnchanged)
+{
+    const auto lut = ColorLut3D::fromTransform([](const cv::Vec3f & bgr) { return bgr; });
+    auto image = m_image.clone();
+    lut.apply(image);
+    EXPECT_LE(cv::norm(image, m_image, cv::NORM_INF), 1);
+}
+
+TEST_F(ColorLut3DTests, InterpolatesSmoothTransforms)
+{
+    const auto lut = ColorLut3D::fromTransform([](const cv::Vec3f & bgr) {
+        // Channel swap with a contrast curve
+        return cv::Vec3f(bgr[2] * bgr[2], bgr[1] * bgr[1], bgr[0] * bgr[0]);
+    });
+    auto image = m_image.clone();
+    lut.apply(image);
+
+    cv::Mat expected;
+    cv::cvtColor(m_image, expected, cv::COLOR_BGR2RGB);
+    expected.convertTo(expected, CV_32F, 1.0 / 255.0);
+    expected = expected.mul(expected) * 255.0;
+    expected.convertTo(expected, CV_8U);
+    EXPECT_LE(cv::norm(image, expected, cv::NORM_INF), 1);
+}
+
+TEST_F(ColorLut3DTests, PerChannelTransformsMatchTheInterpolation)
+{
+    // Gains and a curve on each channel, applied with a per channel table
+    const auto lut = ColorLut3D::fromTransform([](const cv::Vec3f & bgr) {
+        return cv::Vec3f(bgr[0] * 0.8f, std::sqrt(bgr[1]), bgr[2] * bgr[2]);
+    });
+    cv::Mat canvas(80, 80, CV_8UC3, cv::Scalar(255, 255, 255));
+    auto region = canvas(cv::Rect(8, 8, m_image.cols, m_image.rows));
+    lut.apply(m_image, region);
+
+    for (auto row = 0; row < m_image.rows; ++row)
+    {
+        for (auto col = 0; col < m_image.cols; ++col)
+        {
+            const auto expected = lut.map(cv::Vec3f(m_image.at<cv::Vec3b>(row, col)) / 255.0f) * 255.0f;
+            const cv::Vec3f actual = region.at<cv::Vec3b>(row, col);
+            EXPECT_LE(cv::norm(actual - expected, cv::NORM_INF), 1.0);
+        }
+    }
+    EXPECT_EQ(canvas.at<cv::Vec3b>(0, 0), cv::Vec3b(255, 255, 255));
+}
+
+TEST_F(ColorLut3DTests, OutputDoesNotDependOnTheThreads)
+{
+    const auto lut = ColorLut3D::fromTransform([](const cv::Vec3f & bgr) { return bgr.mul(bgr); });
+    cv::Mat image(480, 640, CV_8UC3);
+    cv::randu(image, 0, 256);
+    auto singleThreadImage = image.clone();
+    auto multiThreadImage = image.clone();
+
+    const auto numThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    lut.apply(singleThreadImage);
+    cv::setNumThreads(4);
+    lut.apply(multiThreadImage);
+    cv::setNumThreads(numThreads);
+    EXPECT_EQ(cv::norm(singleThreadImage, multiThreadImage, cv::NORM_INF), 0);
+    EXPECT_GT(cv::norm(singleThreadImage, image, cv::NORM_INF), 0);
+}
+
+TEST_F(ColorLut3DTests, AutoCorrectionBrightensUnderExposedFaces)
+{
+    // Dark face over a lighter background, with some black and white pixels so that levels are not stretched
+    cv::Mat portrait(200, 160, CV_8UC3, cv::Scalar(110, 110, 110));
+    const cv::Rect faceRegion(50, 60, 60, 80);
+    portrait(faceRegion).setTo(cv::Scalar(25, 35, 50));
+    portrait(cv::Rect(0, 190, 80, 10)).setTo(cv::Scalar(0, 0, 0));
+    portrait(cv::Rect(80, 190, 80, 10)).setTo(cv::Scalar(255, 255, 255));
+
+    const auto lut = ColorLut3D::autoCorrection(portrait, faceRegion);
+    auto corrected = portrait.clone();
+    lut.apply(corrected);
+
+    cv::Mat1b faceLuma;
+    cv::cvtColor(corrected(faceRegion), faceLuma, cv::COLOR_BGR2GRAY);
+    EXPECT_GE(cv::mean(faceLuma)[0], 0.3 * 255);
+    // Skin tone hue is kept, red stays above green above blue
+    const auto faceColor = corrected.at<cv::Vec3b>(100, 80);
+    EXPECT_GT(faceColor[2], faceColor[1]);
+    EXPECT_GT(faceColor[1], faceColor[0]);
+}
+
+TEST_F(ColorLut3DTests, AutoCorrectionKeepsWellExposedFaces)
+{
+    cv::Mat portrait(200, 160, CV_8UC3, cv::Scalar(140, 140, 140));
+    const cv::Rect faceRegion(50, 60, 60, 80);
+    portrait(faceRegion).setTo(cv::Scalar(128, 128, 128));
+    portrait(cv::Rect(0, 190, 80, 10)).setTo(cv::Scalar(0, 0, 0));
+    portrait(cv::Rect(80, 190, 80, 10)).setTo(cv::Scalar(255, 255, 255));
+
+    const auto lut = ColorLut3D::autoCorrection(portrait, faceRegion);
+    auto corrected = portrait.clone();
+    lut.apply(corrected);
+    EXPECT_LE(cv::norm(corrected, portrait, cv::NORM_INF), 2);
+}
+} // namespace ppp
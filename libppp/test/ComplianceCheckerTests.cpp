@@ -54,9 +54,9 @@ TEST_F(ComplianceCheckerTests, checkInputDpi)
 
     // Now make the check fail  by specifying a resolution well above the actual value for this test
     const auto highResolDpi = 600;
-    photoStandard->overrideResolution(highResolDpi);
+    const auto highResolStandard = std::make_shared<PhotoStandard>(photoStandard->withResolution(highResolDpi));
     const auto results2
-        = m_subject->checkCompliance(imgKey, photoStandard, crownPos, chinPos, { CHECK_INPUT_RESOLUTION });
+        = m_subject->checkCompliance(imgKey, highResolStandard, crownPos, chinPos, { CHECK_INPUT_RESOLUTION });
     const auto result2 = results2.front();
     EXPECT_FALSE(result2->getPassed());
 
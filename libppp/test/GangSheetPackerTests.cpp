@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include "GangSheetPacker.h"
+
+namespace ppp
+{
+TEST(GangSheetPackerTests, PhotosAreShelvedWithoutOverlapping)
+{
+    GangSheetPacker packer(cv::Size(100, 60), 2);
+
+    // Two tall photos share the first shelf, the short ones go below
+    EXPECT_TRUE(packer.add(0, cv::Size(40, 30)));
+    EXPECT_TRUE(packer.add(0, cv::Size(40, 30)));
+    EXPECT_TRUE(packer.add(1, cv::Size(20, 20)));
+    EXPECT_TRUE(packer.add(1, cv::Size(20, 20)));
+    EXPECT_TRUE(packer.add(1, cv::Size(20, 20)));
+    EXPECT_TRUE(packer.add(1, cv::Size(20, 20)));
+
+    // No room left in the shelves nor for another shelf
+    EXPECT_FALSE(packer.add(1, cv::Size(20, 20)));
+
+    const auto sheet = packer.takeSheet();
+    ASSERT_EQ(sheet.size(), 6u);
+    EXPECT_EQ(sheet[0].rect, cv::Rect(0, 0, 40, 30));
+    EXPECT_EQ(sheet[1].rect, cv::Rect(42, 0, 40, 30));
+    EXPECT_EQ(sheet[2].rect, cv::Rect(0, 32, 20, 20));
+    EXPECT_EQ(sheet[5].rect, cv::Rect(66, 32, 20, 20));
+    EXPECT_EQ(sheet[5].jobIndex, 1u);
+    for (size_t i = 0; i < sheet.size(); ++i)
+    {
+        EXPECT_TRUE((sheet[i].rect & cv::Rect(0, 0, 100, 60)) == sheet[i].rect);
+        for (size_t j = i + 1; j < sheet.size(); ++j)
+        {
+            EXPECT_EQ((sheet[i].rect & sheet[j].rect).area(), 0);
+        }
+    }
+
+    EXPECT_TRUE(packer.empty());
+    EXPECT_TRUE(packer.add(1, cv::Size(20, 20)));
+    EXPECT_EQ(packer.takeSheet()[0].rect, cv::Rect(0, 0, 20, 20));
+}
+
+TEST(GangSheetPackerTests, OversizedPhotosAreRejected)
+{
+    GangSheetPacker packer(cv::Size(100, 60), 0);
+    EXPECT_FALSE(packer.fitsInSheet(cv::Size(101, 10)));
+    EXPECT_FALSE(packer.add(0, cv::Size(101, 10)));
+    EXPECT_TRUE(packer.fitsInSheet(cv::Size(100, 60)));
+    EXPECT_TRUE(packer.add(0, cv::Size(100, 60)));
+}
+} // namespace ppp
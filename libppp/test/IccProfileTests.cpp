@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include "ColorLut3D.h"
+#include "ColorProfileStore.h"
+#include "IccProfile.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace ppp
+{
+class IccProfileTests : public testing::Test
+{
+protected:
+    /*!@brief Minimal matrix/TRC profile with the sRGB primaries and a plain gamma curve on every channel !*/
+    static std::string makeGammaProfile(const double gamma, const bool withRedPrimary = true)
+    {
+        const std::vector<std::pair<std::string, cv::Vec3d>> primaries = {
+            { "rXYZ", { 0.4360747, 0.2225045, 0.0139322 } },
+            { "gXYZ", { 0.3850649, 0.7168786, 0.0971045 } },
+            { "bXYZ", { 0.1430804, 0.0606169, 0.7141733 } },
+        };
+        std::vector<std::pair<std::string, std::string>> tags;
+        for (const auto & primary : primaries)
+        {
+            if (primary.first == "rXYZ" && !withRedPrimary)
+            {
+                continue;
+            }
+            auto tag = std::string("XYZ ") + std::string(4, '\0');
+            for (auto i = 0; i < 3; ++i)
+            {
+                tag += bigEndian(static_cast<uint32_t>(std::lround(primary.second[i] * 65536.0)), 4);
+            }
+            tags.emplace_back(primary.first, tag);
+        }
+        const auto curve = std::string("curv") + std::string(4, '\0') + bigEndian(1, 4)
+            + bigEndian(static_cast<uint32_t>(std::lround(gamma * 256.0)), 2) + std::string(2, '\0');
+        for (const auto & name : { "rTRC", "gTRC", "bTRC" })
+        {
+            tags.emplace_back(name, curve);
+        }
+
+        std::string header(128, '\0');
+        header.replace(16, 4, "RGB ");
+        header.replace(20, 4, "XYZ ");
+        header.replace(36, 4, "acsp");
+        auto tagTable = bigEndian(static_cast<uint32_t>(tags.size()), 4);
+        std::string tagData;
+        const auto dataOffset = header.size() + 4 + 12 * tags.size();
+        for (const auto & tag : tags)
+        {
+            tagTable += tag.first + bigEndian(static_cast<uint32_t>(dataOffset + tagData.size()), 4)
+                + bigEndian(static_cast<uint32_t>(tag.second.size()), 4);
+            tagData += tag.second;
+        }
+        auto profile = header + tagTable + tagData;
+        profile.replace(0, 4, bigEndian(static_cast<uint32_t>(profile.size()), 4));
+        return profile;
+    }
+
+    static std::string bigEndian(const uint32_t value, const int numBytes)
+    {
+        std::string bytes;
+        for (auto i = numBytes - 1; i >= 0; --i)
+        {
+            bytes += static_cast<char>(value >> (8 * i) & 0xFF);
+        }
+        return bytes;
+    }
+};
+
+TEST_F(IccProfileTests, SameProfileTransformIsIdentity)
+{
+    const auto lut = IccProfile::transformLut(*IccProfile::sRgb(), *IccProfile::sRgb());
+    cv::Mat image(64, 64, CV_8UC3);
+    cv::randu(image, 0, 256);
+    auto transformed = image.clone();
+    lut.apply(transformed);
+    EXPECT_LE(cv::norm(transformed, image, cv::NORM_INF), 1);
+}
+
+TEST_F(IccProfileTests, ConvertsToGammaProfile)
+{
+    const auto destination = IccProfile::fromData(makeGammaProfile(1.8));
+    const auto lut = IccProfile::transformLut(*IccProfile::sRgb(), *destination);
+
+    // sRGB 128 is 21.6% linear, that is 0.426 with a 1.8 gamma
+    cv::Mat image(4, 4, CV_8UC3, cv::Scalar(128, 128, 128));
+    lut.apply(image);
+    const auto result = cv::mean(image);
+    for (auto c = 0; c < 3; ++c)
+    {
+        EXPECT_NEAR(result[c], 109, 1);
+    }
+}
+
+TEST_F(IccProfileTests, RejectsUnsupportedProfiles)
+{
+    EXPECT_THROW(IccProfile::fromData(makeGammaProfile(1.8, false)), std::runtime_error);
+    EXPECT_THROW(IccProfile::fromData("not a profile"), std::runtime_error);
+}
+
+TEST_F(IccProfileTests, StoreSharesTransformsOfIdenticalProfiles)
+{
+    ColorProfileStore store;
+    store.registerProfile("printerA", makeGammaProfile(1.8));
+    store.registerProfile("printerB", makeGammaProfile(1.8));
+    store.registerProfile("printerC", makeGammaProfile(2.2));
+
+    EXPECT_EQ(store.printTransform("printerA"), store.printTransform("printerB"));
+    EXPECT_NE(store.printTransform("printerA"), store.printTransform("printerC"));
+    EXPECT_THROW(store.printTransform("unknown"), std::runtime_error);
+}
+
+TEST_F(IccProfileTests, StoreKeepsTheMostRecentlyUsedTransforms)
+{
+    ColorProfileStore store;
+    store.registerProfile("first", makeGammaProfile(1.0));
+    const auto firstLut = store.printTransform("first");
+    // Each gamma gives different profile data, thus its own LUT
+    for (auto i = 1; i <= 16; ++i)
+    {
+        const auto id = "printer" + std::to_string(i);
+        store.registerProfile(id, makeGammaProfile(1.0 + i / 10.0));
+        EXPECT_NE(store.printTransform(id), firstLut);
+    }
+
+    // Evicted by the 16 more recent ones, the LUT is built again
+    const auto rebuiltLut = store.printTransform("first");
+    EXPECT_NE(rebuiltLut, firstLut);
+    EXPECT_EQ(rebuiltLut->map(cv::Vec3f(0.5f, 0.25f, 0.75f)), firstLut->map(cv::Vec3f(0.5f, 0.25f, 0.75f)));
+    EXPECT_EQ(store.printTransform("first"), rebuiltLut);
+}
+} // namespace ppp
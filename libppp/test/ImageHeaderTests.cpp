@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include "ImageHeader.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+namespace ppp
+{
+TEST(ImageHeaderTests, ReadsTheDimensionsOfEncodedImages)
+{
+    const cv::Mat image(123, 457, CV_8UC3, cv::Scalar(20, 120, 220));
+    const std::vector<std::pair<std::string, std::vector<int>>> encodings
+        = { { ".jpg", {} },
+            { ".jpg", { cv::IMWRITE_JPEG_PROGRESSIVE, 1 } },
+            { ".png", {} },
+            { ".bmp", {} },
+            { ".webp", { cv::IMWRITE_WEBP_QUALITY, 80 } },
+            { ".webp", { cv::IMWRITE_WEBP_QUALITY, 101 } } };
+    for (const auto & encoding : encodings)
+    {
+        std::vector<BYTE> data;
+        cv::imencode(encoding.first, image, data, encoding.second);
+        ImageHeader header;
+        ASSERT_TRUE(ImageHeader::read(data.data(), data.size(), header)) << encoding.first;
+        EXPECT_NE(header.format, ImageHeader::Format::UNKNOWN);
+        EXPECT_EQ(header.size, image.size()) << encoding.first;
+    }
+}
+
+TEST(ImageHeaderTests, TruncatedOrUnknownDataIsRejected)
+{
+    std::vector<BYTE> jpeg;
+    cv::imencode(".jpg", cv::Mat(16, 16, CV_8UC3, cv::Scalar::all(0)), jpeg);
+    ImageHeader header;
+    for (const auto length : { size_t(0), size_t(3), size_t(20) })
+    {
+        EXPECT_FALSE(ImageHeader::read(jpeg.data(), length, header)) << length;
+        EXPECT_EQ(header.format, ImageHeader::Format::UNKNOWN);
+    }
+
+    const std::string text = "GIF89a, or anything else";
+    EXPECT_FALSE(ImageHeader::read(reinterpret_cast<const BYTE *>(text.data()), text.size(), header));
+}
+} // namespace ppp
@@ -2,8 +2,11 @@
 
 #include "EasyExif.h"
 #include "ImageStore.h"
+#include "LandMarks.h"
 #include "TestHelpers.h"
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <thread>
 
 namespace ppp
 {
@@ -86,6 +89,28 @@ TEST_F(ImageStoreTests, ImagesArePrioritizedByAccess)
     EXPECT_FALSE(m_pImageStore->containsImage(key3));
 }
 
+TEST_F(ImageStoreTests, GettersOfEvictedImagesReturnEmptyResults)
+{
+    m_pImageStore->setStoreSize(1);
+    const auto key1 = m_pImageStore->setImage(m_data1.data(), m_data1.size());
+    m_pImageStore->setImage(m_data2.data(), m_data2.size());
+    ASSERT_FALSE(m_pImageStore->containsImage(key1));
+
+    // As after a containsImage check that raced with the eviction
+    EXPECT_TRUE(m_pImageStore->getImage(key1).empty());
+    EXPECT_TRUE(m_pImageStore->getLumaImage(key1).empty());
+    EXPECT_TRUE(m_pImageStore->getImageRegion(key1, cv::Rect(0, 0, 5, 5)).empty());
+    EXPECT_EQ(m_pImageStore->getImageSize(key1), cv::Size());
+    EXPECT_EQ(m_pImageStore->getLandMarks(key1), nullptr);
+    auto scale = 0.0;
+    EXPECT_TRUE(m_pImageStore->getProxyImage(key1, scale).empty());
+
+    // None of them brought the image back as an empty entry
+    EXPECT_FALSE(m_pImageStore->containsImage(key1));
+    cv::Size similarImageSize;
+    EXPECT_EQ(m_pImageStore->findSimilarImage(key1, similarImageSize), nullptr);
+}
+
 TEST_F(ImageStoreTests, ImageExifDataRetrieval)
 {
     m_pImageStore->setStoreSize(1);
@@ -116,4 +141,239 @@ TEST_F(ImageStoreTests, ImageExifDataRetrieval)
     EXPECT_EQ(image2.rows, 512);
     ASSERT_FALSE(imgExif2);
 }
+TEST_F(ImageStoreTests, RegionsOfEvictedImagesCanBeDecoded)
+{
+    m_pImageStore->setStoreSize(1);
+    m_pImageStore->setEncodedStoreBytes(1 << 20);
+
+    cv::Mat image(64, 48, CV_8UC3, cv::Scalar(0, 0, 0));
+    image(cv::Rect(8, 16, 24, 32)).setTo(cv::Scalar(10, 200, 30));
+    std::vector<BYTE> pictureData;
+    cv::imencode(".png", image, pictureData);
+
+    const auto key = m_pImageStore->setImage(reinterpret_cast<const char *>(pictureData.data()), pictureData.size());
+    m_pImageStore->setImage(m_data1.data(), m_data1.size());
+
+    EXPECT_FALSE(m_pImageStore->containsImage(key));
+    ASSERT_TRUE(m_pImageStore->containsEncodedImage(key));
+
+    // Region partially outside the image is padded with zeros
+    auto scale = 0.0;
+    const auto region = m_pImageStore->decodeImageRegion(key, cv::Rect(-4, 16, 36, 32), 1.0, scale);
+    EXPECT_DOUBLE_EQ(scale, 1.0);
+    ASSERT_EQ(region.size(), cv::Size(36, 32));
+    verifyEqualImages(region(cv::Rect(0, 0, 12, 32)), cv::Mat(32, 12, CV_8UC3, cv::Scalar(0, 0, 0)));
+    verifyEqualImages(region(cv::Rect(12, 0, 24, 32)), image(cv::Rect(8, 16, 24, 32)));
+}
+
+TEST_F(ImageStoreTests, JpegRegionsAreDecodedFromTheirBlocksOnly)
+{
+    m_pImageStore->setStoreSize(1);
+    m_pImageStore->setEncodedStoreBytes(1 << 20);
+
+    cv::Mat noise(30, 40, CV_8UC3), image;
+    cv::randu(noise, 0, 255);
+    cv::resize(noise, image, cv::Size(400, 300), 0, 0, cv::INTER_CUBIC);
+    std::vector<BYTE> pictureData;
+    cv::imencode(".jpg", image, pictureData);
+    const auto key = m_pImageStore->setImage(reinterpret_cast<const char *>(pictureData.data()), pictureData.size());
+    m_pImageStore->setImage(m_data1.data(), m_data1.size());
+
+    // Regions not on the block grid, the decoder works on the blocks around them
+    for (const auto downscale : { 1, 2, 4 })
+    {
+        const auto fullImage = cv::imdecode(pictureData, downscale == 1 ? cv::IMREAD_COLOR
+                                                : downscale == 2        ? cv::IMREAD_REDUCED_COLOR_2
+                                                                        : cv::IMREAD_REDUCED_COLOR_4);
+        auto scale = 0.0;
+        const cv::Rect region(100, 68, 200, 160);
+        const auto regionImage = m_pImageStore->decodeImageRegion(key, region, downscale, scale);
+        EXPECT_DOUBLE_EQ(scale, 1.0 / downscale);
+        const cv::Rect scaledRegion(region.x / downscale, region.y / downscale, 200 / downscale, 160 / downscale);
+        ASSERT_EQ(regionImage.size(), scaledRegion.size());
+        // Only the chroma upsampling at the edges of the blocks read can differ
+        const cv::Rect inner(2, 2, scaledRegion.width - 4, scaledRegion.height - 4);
+        EXPECT_EQ(cv::norm(regionImage(inner), fullImage(scaledRegion)(inner), cv::NORM_INF), 0) << downscale;
+    }
+}
+
+TEST_F(ImageStoreTests, DecodeLimitsAreEnforced)
+{
+    cv::Mat image(300, 400, CV_8UC3, cv::Scalar(40, 80, 120));
+    std::vector<BYTE> pictureData;
+    cv::imencode(".jpg", image, pictureData);
+    const auto data = reinterpret_cast<const char *>(pictureData.data());
+
+    m_pImageStore->setDecodeLimits(pictureData.size() - 1, 0, 0);
+    EXPECT_THROW(m_pImageStore->setImage(data, pictureData.size()), std::runtime_error);
+
+    m_pImageStore->setDecodeLimits(0, 400 * 300 - 1, 0);
+    EXPECT_THROW(m_pImageStore->setImage(data, pictureData.size()), std::runtime_error);
+
+    // Formats whose header is not read are checked once decoded
+    std::vector<BYTE> ppmData;
+    cv::imencode(".ppm", image, ppmData);
+    EXPECT_THROW(m_pImageStore->setImage(reinterpret_cast<const char *>(ppmData.data()), ppmData.size()),
+                 std::runtime_error);
+    m_pImageStore->setDecodeLimits(0, 400 * 300, 0);
+    const auto ppmKey = m_pImageStore->setImage(reinterpret_cast<const char *>(ppmData.data()), ppmData.size());
+    EXPECT_EQ(m_pImageStore->getImageSize(ppmKey), image.size());
+
+    m_pImageStore->setDecodeLimits(pictureData.size(), 400 * 300, 0);
+    const auto key = m_pImageStore->setImage(data, pictureData.size());
+    EXPECT_EQ(m_pImageStore->getImageSize(key), image.size());
+}
+
+TEST_F(ImageStoreTests, LargeImagesAreDecodedAtAReducedScale)
+{
+    m_pImageStore->setStoreSize(1);
+    m_pImageStore->setEncodedStoreBytes(1 << 20);
+    m_pImageStore->setDecodeLimits(0, 0, 40000);
+
+    cv::Mat image(300, 400, CV_8UC3, cv::Scalar(40, 80, 120));
+    std::vector<BYTE> pictureData;
+    cv::imencode(".jpg", image, pictureData);
+    const auto key = m_pImageStore->setImage(reinterpret_cast<const char *>(pictureData.data()), pictureData.size());
+    EXPECT_EQ(m_pImageStore->getImageSize(key), cv::Size(200, 150));
+    EXPECT_EQ(m_pImageStore->getDecodeScale(key), 2);
+
+    // Regions are in the coordinates of the stored image, downscales are relative to it
+    m_pImageStore->setImage(m_data1.data(), m_data1.size());
+    auto scale = 0.0;
+    auto region = m_pImageStore->decodeImageRegion(key, cv::Rect(20, 10, 100, 80), 1.0, scale);
+    EXPECT_DOUBLE_EQ(scale, 1.0);
+    EXPECT_EQ(region.size(), cv::Size(100, 80));
+    region = m_pImageStore->decodeImageRegion(key, cv::Rect(20, 10, 100, 80), 2.0, scale);
+    EXPECT_DOUBLE_EQ(scale, 0.5);
+    EXPECT_EQ(region.size(), cv::Size(50, 40));
+}
+
+TEST_F(ImageStoreTests, ProxyImageIsCreatedOnceAndReused)
+{
+    cv::Mat image(2000, 1500, CV_8UC3, cv::Scalar(40, 80, 120));
+    std::vector<BYTE> pictureData;
+    cv::imencode(".png", image, pictureData);
+    const auto key = m_pImageStore->setImage(reinterpret_cast<const char *>(pictureData.data()), pictureData.size());
+
+    auto scale = 0.0;
+    const auto proxy1 = m_pImageStore->getProxyImage(key, scale);
+    EXPECT_EQ(proxy1.size(), cv::Size(768, 1024));
+    EXPECT_DOUBLE_EQ(scale, 768.0 / 1500.0);
+
+    auto scale2 = 0.0;
+    const auto proxy2 = m_pImageStore->getProxyImage(key, scale2);
+    EXPECT_EQ(proxy1.data, proxy2.data);
+    EXPECT_DOUBLE_EQ(scale, scale2);
+
+    // Small images are their own proxy
+    const auto smallKey = m_pImageStore->setImage(m_data1.data(), m_data1.size());
+    verifyEqualImages(m_mat1, m_pImageStore->getProxyImage(smallKey, scale));
+    EXPECT_DOUBLE_EQ(scale, 1.0);
+}
+
+TEST_F(ImageStoreTests, PlanarStorageKeepsLumaAndSubsampledChroma)
+{
+    m_pImageStore->setPlanarStorage(true);
+
+    // Smooth colour gradients survive the chroma subsampling
+    cv::Mat image(40, 60, CV_8UC3);
+    for (auto y = 0; y < image.rows; ++y)
+    {
+        for (auto x = 0; x < image.cols; ++x)
+        {
+            image.at<cv::Vec3b>(y, x) = cv::Vec3b(static_cast<uchar>(4 * x), static_cast<uchar>(5 * y), 90);
+        }
+    }
+    std::vector<BYTE> pictureData;
+    cv::imencode(".png", image, pictureData);
+    const auto key = m_pImageStore->setImage(reinterpret_cast<const char *>(pictureData.data()), pictureData.size());
+
+    EXPECT_TRUE(m_pImageStore->isPlanarStorage());
+    EXPECT_EQ(m_pImageStore->getImageSize(key), image.size());
+
+    cv::Mat expectedLuma;
+    cv::cvtColor(image, expectedLuma, cv::COLOR_BGR2GRAY);
+    EXPECT_LE(cv::norm(expectedLuma, m_pImageStore->getLumaImage(key), cv::NORM_INF), 1.0);
+
+    EXPECT_LE(cv::norm(image, m_pImageStore->getImage(key), cv::NORM_INF), 8.0);
+
+    const cv::Rect region(-5, 10, 30, 20);
+    const auto regionImage = m_pImageStore->getImageRegion(key, region);
+    ASSERT_EQ(regionImage.size(), region.size());
+    verifyEqualImages(regionImage(cv::Rect(0, 0, 5, 20)), cv::Mat(20, 5, CV_8UC3, cv::Scalar(0, 0, 0)));
+    EXPECT_LE(cv::norm(image(cv::Rect(0, 10, 25, 20)), regionImage(cv::Rect(5, 0, 25, 20)), cv::NORM_INF), 8.0);
+}
+
+TEST_F(ImageStoreTests, LandMarksAreCopiedInAndOutOfTheStore)
+{
+    m_pImageStore->setStoreSize(1);
+    const auto key = m_pImageStore->setImage(cv::Mat(16, 16, CV_8UC3, cv::Scalar(1, 2, 3)));
+    const auto landMarks = m_pImageStore->getLandMarks(key);
+    ASSERT_NE(landMarks, nullptr);
+    EXPECT_EQ(landMarks->imageKey, key);
+    EXPECT_TRUE(landMarks->allLandmarks.empty());
+
+    landMarks->crownPoint = cv::Point(8, 1);
+    landMarks->allLandmarks = { cv::Point(4, 6), cv::Point(12, 6) };
+    landMarks->lipContour1st = { cv::Point(6, 12), cv::Point(10, 12) };
+    EXPECT_EQ(m_pImageStore->getLandMarks(key)->crownPoint, cv::Point());
+
+    m_pImageStore->setLandMarks(key, *landMarks);
+    const auto stored = m_pImageStore->getLandMarks(key);
+    EXPECT_NE(stored, landMarks);
+    EXPECT_EQ(stored->crownPoint, landMarks->crownPoint);
+    EXPECT_EQ(stored->allLandmarks, landMarks->allLandmarks);
+    EXPECT_EQ(stored->lipContour1st, landMarks->lipContour1st);
+
+    // Landmarks of an image evicted meanwhile are dropped
+    const auto otherKey = m_pImageStore->setImage(cv::Mat(16, 16, CV_8UC3, cv::Scalar(3, 2, 1)));
+    m_pImageStore->setLandMarks(key, *landMarks);
+    EXPECT_EQ(m_pImageStore->getLandMarks(key), nullptr);
+    EXPECT_TRUE(m_pImageStore->getLandMarks(otherKey)->allLandmarks.empty());
+}
+
+TEST_F(ImageStoreTests, SimilarImagesGiveACopyOfTheirLandMarks)
+{
+    m_pImageStore->setStoreSize(2);
+    cv::Mat image(64, 64, CV_8UC3, cv::Scalar(40, 60, 80));
+    cv::circle(image, cv::Point(32, 28), 16, cv::Scalar(200, 180, 160), cv::FILLED);
+    cv::Mat resizedImage;
+    cv::resize(image, resizedImage, cv::Size(), 2.0, 2.0, cv::INTER_LINEAR);
+
+    const auto key = m_pImageStore->setImage(image);
+    LandMarks landMarks;
+    landMarks.allLandmarks = { cv::Point(32, 12), cv::Point(32, 44) };
+    m_pImageStore->setLandMarks(key, landMarks);
+    const auto resizedKey = m_pImageStore->setImage(resizedImage);
+
+    cv::Size similarImageSize;
+    const auto similarLandMarks = m_pImageStore->findSimilarImage(resizedKey, similarImageSize);
+    ASSERT_NE(similarLandMarks, nullptr);
+    EXPECT_EQ(similarImageSize, image.size());
+    EXPECT_EQ(similarLandMarks->allLandmarks, m_pImageStore->getLandMarks(key)->allLandmarks);
+
+    // The copy outlives the eviction of the image it was taken from
+    m_pImageStore->setStoreSize(1);
+    EXPECT_FALSE(m_pImageStore->containsImage(key));
+    EXPECT_EQ(m_pImageStore->getLandMarks(key), nullptr);
+    EXPECT_EQ(similarLandMarks->allLandmarks.size(), 2);
+}
+
+TEST_F(ImageStoreTests, ConcurrentCopiesOfAnImageAreStoredOnce)
+{
+    m_pImageStore->setStoreSize(2);
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([this]() { m_pImageStore->setImage(m_mat1); });
+    }
+    for (auto & thread : threads)
+    {
+        thread.join();
+    }
+    // A duplicate entry would take a place in the store order and get the image evicted by the next one
+    const auto key1 = m_pImageStore->setImage(m_mat1);
+    m_pImageStore->setImage(m_mat2);
+    EXPECT_TRUE(m_pImageStore->containsImage(key1));
+}
 } // namespace ppp
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "JpegLosslessCrop.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace ppp
+{
+class JpegLosslessCropTests : public testing::Test
+{
+protected:
+    JpegLosslessCropTests()
+    {
+        cv::randu(m_image, 0, 256);
+        cv::GaussianBlur(m_image, m_image, cv::Size(), 2.0);
+    }
+
+    static std::vector<BYTE> encode(const cv::Mat & image, const std::vector<int> & params = {})
+    {
+        std::vector<BYTE> jpeg;
+        cv::imencode(".jpg", image, jpeg, params);
+        return jpeg;
+    }
+
+    cv::Mat m_image = cv::Mat(237, 311, CV_8UC3);
+};
+
+TEST_F(JpegLosslessCropTests, ReadsFrameLayout)
+{
+    JpegFrameInfo info;
+    ASSERT_TRUE(JpegLosslessCrop::readFrameInfo(encode(m_image), info));
+    EXPECT_EQ(info.size, m_image.size());
+    // Chroma is subsampled by default
+    EXPECT_EQ(info.mcuSize, cv::Size(16, 16));
+
+    cv::Mat gray;
+    cv::cvtColor(m_image, gray, cv::COLOR_BGR2GRAY);
+    ASSERT_TRUE(JpegLosslessCrop::readFrameInfo(encode(gray), info));
+    EXPECT_EQ(info.mcuSize, cv::Size(8, 8));
+}
+
+TEST_F(JpegLosslessCropTests, CropIsIdenticalToTheSource)
+{
+    cv::Mat gray;
+    cv::cvtColor(m_image, gray, cv::COLOR_BGR2GRAY);
+    const auto jpeg = encode(gray);
+    const auto source = cv::imdecode(jpeg, cv::IMREAD_GRAYSCALE);
+
+    for (const auto & region : { cv::Rect(16, 24, 101, 77), cv::Rect(0, 0, 311, 237), cv::Rect(304, 232, 7, 5) })
+    {
+        std::vector<BYTE> output;
+        ASSERT_TRUE(JpegLosslessCrop::crop(jpeg, region, output)) << region;
+        const auto cropped = cv::imdecode(output, cv::IMREAD_GRAYSCALE);
+        ASSERT_EQ(cropped.size(), region.size());
+        EXPECT_EQ(cv::norm(cropped, source(region), cv::NORM_INF), 0) << region;
+    }
+}
+
+TEST_F(JpegLosslessCropTests, ColorCropMatchesTheSource)
+{
+    const auto jpeg = encode(m_image, { cv::IMWRITE_JPEG_QUALITY, 90, cv::IMWRITE_JPEG_RST_INTERVAL, 3 });
+    const auto source = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+    const cv::Rect region(32, 48, 150, 120);
+
+    std::vector<BYTE> output;
+    ASSERT_TRUE(JpegLosslessCrop::crop(jpeg, region, output));
+    const auto cropped = cv::imdecode(output, cv::IMREAD_COLOR);
+    ASSERT_EQ(cropped.size(), region.size());
+    // Only the chroma upsampling along the borders of the crop differs, it has no neighbour blocks there anymore
+    const cv::Rect inner(2, 2, region.width - 4, region.height - 4);
+    EXPECT_EQ(cv::norm(cropped(inner), source(region)(inner), cv::NORM_INF), 0);
+    EXPECT_LE(cv::norm(cropped, source(region), cv::NORM_L1) / cropped.total(), 2.0);
+}
+
+TEST_F(JpegLosslessCropTests, UnsupportedCropsAreRejected)
+{
+    const auto jpeg = encode(m_image);
+    std::vector<BYTE> output;
+    EXPECT_FALSE(JpegLosslessCrop::crop(jpeg, cv::Rect(8, 0, 64, 64), output)) << "Not on the MCU grid";
+    EXPECT_FALSE(JpegLosslessCrop::crop(jpeg, cv::Rect(256, 0, 64, 64), output)) << "Outside of the image";
+    EXPECT_FALSE(JpegLosslessCrop::crop(encode(m_image, { cv::IMWRITE_JPEG_PROGRESSIVE, 1 }),
+                                        cv::Rect(0, 0, 64, 64),
+                                        output))
+        << "Progressive";
+
+    auto truncated = jpeg;
+    truncated.resize(jpeg.size() / 2);
+    EXPECT_FALSE(JpegLosslessCrop::crop(truncated, cv::Rect(0, 160, 64, 64), output)) << "Corrupt";
+}
+} // namespace ppp
@@ -4,9 +4,13 @@
 
 #include "FaceDetector.h"
 #include "IImageStore.h"
+#include "ImageStore.h"
 #include "LandMarks.h"
+#include "ParameterOverrides.h"
 #include "PppEngine.h"
+#include "StageMetrics.h"
 #include "TestHelpers.h"
+#include "Utilities.h"
 
 using namespace cv;
 
@@ -101,6 +105,7 @@ protected:
         const Stats crownChinStats(crownChinEstimationErrors);
         std::cout << "Scale errors" << s << std::endl;
         std::cout << "Crown-Chin estimation relative error: " << crownChinStats << std::endl;
+        std::cout << "Stage metrics: " << m_pPppEngine->getMetrics() << std::endl;
     }
 
     void runSingleImage(const std::string & imageFilePath) const
@@ -210,6 +215,60 @@ TEST_F(LandMarkDetectionTests, EndToEndDetectioWorks)
     processResults(resultsData);
 }
 
+TEST_F(LandMarkDetectionTests, EarlyTerminationAccuracyAndLatency)
+{
+    // Same configuration, except that the shape predictor stops once the shape has converged
+    std::string configString;
+    readConfigFromFile("", configString);
+    rapidjson::Document config;
+    config.Parse(configString.c_str());
+    config["shapePredictor"]["convergenceThreshold"].SetDouble(0.004);
+    const auto earlyTerminationEngine = std::make_shared<PppEngine>();
+    ASSERT_TRUE(earlyTerminationEngine->configure(Utilities::serializeJson(config, false), nullptr));
+
+    std::vector<std::string> imageFilePaths;
+    for (const auto & imageName : { "001", "013", "014", "020", "021", "078" })
+    {
+        imageFilePaths.push_back(resolvePath("research/mugshot_frontal_original_all/") + imageName + "_frontal.jpg");
+    }
+
+    // Mean error of the landmarks used to crop, relative to the annotated face width
+    const auto evaluate = [&imageFilePaths](const PppEngine & engine, double & meanError, double & meanCascades) {
+        meanError = meanCascades = 0;
+        const auto & imageStore = engine.getImageStore();
+        for (const auto & imageFilePath : imageFilePaths)
+        {
+            const auto annotations = loadLandmarks(imageFilePath);
+            const auto imgKey = imageStore->setImage(imageFilePath);
+            EXPECT_TRUE(engine.detectLandMarks(imgKey)) << imageFilePath;
+            const auto & detected = *imageStore->getLandMarks(imgKey);
+            const auto error = norm(detected.eyeLeftPupil - annotations->eyeLeftPupil)
+                + norm(detected.eyeRightPupil - annotations->eyeRightPupil)
+                + norm(detected.lipLeftCorner - annotations->lipLeftCorner)
+                + norm(detected.lipRightCorner - annotations->lipRightCorner)
+                + norm(detected.chinPoint - annotations->chinPoint);
+            meanError += error / 5 / annotations->vjFaceRect.width / imageFilePaths.size();
+            meanCascades += static_cast<double>(detected.shapeCascades) / imageFilePaths.size();
+        }
+    };
+
+    double fullError, fullCascades, earlyError, earlyCascades;
+    StageMetrics::reset();
+    evaluate(*m_pPppEngine, fullError, fullCascades);
+    const auto fullTimeMs = StageMetrics::get("shapePrediction").wallTimeMs;
+    StageMetrics::reset();
+    evaluate(*earlyTerminationEngine, earlyError, earlyCascades);
+    const auto earlyTimeMs = StageMetrics::get("shapePrediction").wallTimeMs;
+
+    std::cout << "All cascades: error " << pct(fullError) << ", " << fullCascades << " cascades, " << fullTimeMs
+              << " ms" << std::endl;
+    std::cout << "Early termination: error " << pct(earlyError) << ", " << earlyCascades << " cascades, "
+              << earlyTimeMs << " ms" << std::endl;
+
+    EXPECT_LT(earlyCascades, 0.8 * fullCascades);
+    EXPECT_LT(earlyError, fullError + 0.01);
+}
+
 TEST_F(LandMarkDetectionTests, DevelopementTestSingleCase)
 {
     runSingleImage(resolvePath("research/mugshot_frontal_original_all/012_frontal.jpg"));
@@ -219,4 +278,88 @@ TEST_F(LandMarkDetectionTests, DISABLED_babyTest)
 {
     runSingleImage(resolvePath("research/my_database/20191021_155155.jpg"));
 }
+
+TEST_F(LandMarkDetectionTests, CrownChinCoefficientsCanBeOverriddenPerCall)
+{
+    const auto & imageStore = m_pPppEngine->getImageStore();
+    const auto imgKey = imageStore->setImage(resolvePath("research/mugshot_frontal_original_all/001_frontal.jpg"));
+    ASSERT_TRUE(m_pPppEngine->detectLandMarks(imgKey));
+    const auto configured = *imageStore->getLandMarks(imgKey);
+
+    ParameterOverrides overrides;
+    overrides.chinCrownCoeff = 1.7096 * 1.2;
+    LandMarks overridden;
+    ASSERT_TRUE(m_pPppEngine->detectLandMarks(imgKey, overrides, overridden));
+    // Same chin, the crown is further away in proportion to the coefficient
+    EXPECT_EQ(overridden.chinPoint, configured.chinPoint);
+    const auto configuredDistance = norm(configured.crownPoint - configured.chinPoint);
+    EXPECT_NEAR(norm(overridden.crownPoint - overridden.chinPoint) / configuredDistance, 1.2, 0.01);
+
+    // The landmarks shared by the requests on the image keep the configured estimate
+    EXPECT_EQ(imageStore->getLandMarks(imgKey)->crownPoint, configured.crownPoint);
+    ASSERT_TRUE(m_pPppEngine->detectLandMarks(imgKey));
+    EXPECT_EQ(imageStore->getLandMarks(imgKey)->crownPoint, configured.crownPoint);
+}
+
+TEST_F(LandMarkDetectionTests, BatchDetectionMatchesSingleImageDetection)
+{
+    // Separate engines, so that neither reuses the landmarks detected by the other on the same pictures
+    const auto batchEngine = std::make_shared<PppEngine>();
+    ASSERT_TRUE(batchEngine->configure(resolvePath("libppp/share/config.json"), nullptr));
+
+    std::vector<std::string> imageKeys;
+    std::vector<LandMarks> expectedLandMarks;
+    for (const auto & imageName : { "001", "013", "014", "020" })
+    {
+        const auto imageFilePath = resolvePath("research/mugshot_frontal_original_all/") + imageName + "_frontal.jpg";
+        const auto & imageStore = m_pPppEngine->getImageStore();
+        const auto imgKey = imageStore->setImage(imageFilePath);
+        EXPECT_TRUE(m_pPppEngine->detectLandMarks(imgKey)) << imageFilePath;
+        expectedLandMarks.push_back(*imageStore->getLandMarks(imgKey));
+        imageKeys.push_back(batchEngine->getImageStore()->setImage(imageFilePath));
+    }
+
+    const auto detected = batchEngine->detectLandMarks(imageKeys);
+    ASSERT_EQ(detected.size(), imageKeys.size());
+    for (size_t i = 0; i < imageKeys.size(); ++i)
+    {
+        EXPECT_TRUE(detected[i]) << imageKeys[i];
+        const auto & actual = *batchEngine->getImageStore()->getLandMarks(imageKeys[i]);
+        const auto & expected = expectedLandMarks[i];
+        EXPECT_EQ(actual.vjFaceRect, expected.vjFaceRect);
+        EXPECT_EQ(actual.allLandmarks, expected.allLandmarks);
+        EXPECT_EQ(actual.crownPoint, expected.crownPoint);
+        EXPECT_EQ(actual.chinPoint, expected.chinPoint);
+    }
+}
+
+TEST_F(LandMarkDetectionTests, LandMarksDoNotDependOnThePlanarStorage)
+{
+    const auto planarEngine = std::make_shared<PppEngine>();
+    ASSERT_TRUE(planarEngine->configure(resolvePath("libppp/share/config.json"), nullptr));
+    const auto planarStore = std::dynamic_pointer_cast<ImageStore>(planarEngine->getImageStore());
+    ASSERT_NE(planarStore, nullptr);
+    planarStore->setPlanarStorage(true);
+
+    for (const auto & imageName : { "001", "013", "014", "020" })
+    {
+        const auto imageFilePath = resolvePath("research/mugshot_frontal_original_all/") + imageName + "_frontal.jpg";
+        const auto & imageStore = m_pPppEngine->getImageStore();
+        const auto imgKey = imageStore->setImage(imageFilePath);
+        const auto planarKey = planarStore->setImage(imageFilePath);
+        ASSERT_TRUE(m_pPppEngine->detectLandMarks(imgKey)) << imageFilePath;
+        ASSERT_TRUE(planarEngine->detectLandMarks(planarKey)) << imageFilePath;
+
+        // Both read the luma, which differs by the rounding of the colour conversions only
+        const auto & expected = *imageStore->getLandMarks(imgKey);
+        const auto & actual = *planarStore->getLandMarks(planarKey);
+        ASSERT_EQ(actual.allLandmarks.size(), expected.allLandmarks.size()) << imageFilePath;
+        for (size_t i = 0; i < expected.allLandmarks.size(); ++i)
+        {
+            EXPECT_LE(cv::norm(actual.allLandmarks[i] - expected.allLandmarks[i]), 2.0) << imageFilePath << " #" << i;
+        }
+        EXPECT_LE(cv::norm(actual.crownPoint - expected.crownPoint), 2.0) << imageFilePath;
+        EXPECT_LE(cv::norm(actual.chinPoint - expected.chinPoint), 2.0) << imageFilePath;
+    }
+}
 } // namespace ppp
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "LandMarks.h"
+#include "LandMarksRecord.h"
+
+namespace ppp
+{
+TEST(LandMarksRecordTests, RoundTripPreservesLandMarks)
+{
+    LandMarks lm;
+    lm.imageKey = "0a1b2c3d";
+    lm.imageRotation = -90;
+    lm.shapeCascades = 7;
+    lm.vjFaceRect = cv::Rect(100, 120, 400, 410);
+    lm.eyeLeftPupil = cv::Point(210, 300);
+    lm.eyeRightPupil = cv::Point(380, 302);
+    lm.crownPoint = cv::Point(295, 90);
+    lm.chinPoint = cv::Point(297, 560);
+    lm.lipContour1st = { cv::Point(1, 2), cv::Point(3, 4) };
+    for (auto i = 0; i < 50; ++i)
+    {
+        lm.allLandmarks.emplace_back(i * 3, 1000 + i);
+    }
+
+    const auto record = LandMarksRecord::fromLandMarks(lm);
+    EXPECT_EQ(record.numShapePoints, 50);
+
+    // The record is copied as raw bytes
+    LandMarksRecord copy;
+    std::memcpy(&copy, &record, sizeof(record));
+
+    LandMarks actual;
+    copy.toLandMarks(actual);
+
+    // The key is the one of the store entry
+    EXPECT_TRUE(actual.imageKey.empty());
+    EXPECT_EQ(actual.imageRotation, lm.imageRotation);
+    EXPECT_EQ(actual.shapeCascades, lm.shapeCascades);
+    EXPECT_EQ(actual.vjFaceRect, lm.vjFaceRect);
+    EXPECT_EQ(actual.eyeLeftPupil, lm.eyeLeftPupil);
+    EXPECT_EQ(actual.eyeRightPupil, lm.eyeRightPupil);
+    EXPECT_EQ(actual.crownPoint, lm.crownPoint);
+    EXPECT_EQ(actual.chinPoint, lm.chinPoint);
+    EXPECT_EQ(actual.allLandmarks, lm.allLandmarks);
+    EXPECT_TRUE(actual.lipContour1st.empty());
+
+    const auto contours = LandMarksContours::fromLandMarks(lm);
+    ASSERT_TRUE(contours != nullptr);
+    contours->toLandMarks(actual);
+    EXPECT_EQ(actual.lipContour1st, lm.lipContour1st);
+}
+
+TEST(LandMarksRecordTests, OutOfRangeValuesAreSaturated)
+{
+    LandMarks lm;
+    lm.crownPoint = cv::Point(-50000, 40000);
+    for (size_t i = 0; i < LandMarksRecord::MAX_SHAPE_POINTS + 10; ++i)
+    {
+        lm.allLandmarks.emplace_back(1, 1);
+    }
+
+    const auto record = LandMarksRecord::fromLandMarks(lm);
+    EXPECT_EQ(record.crownPoint.x, INT16_MIN);
+    EXPECT_EQ(record.crownPoint.y, INT16_MAX);
+    EXPECT_EQ(record.numShapePoints, LandMarksRecord::MAX_SHAPE_POINTS);
+    EXPECT_EQ(LandMarksContours::fromLandMarks(lm), nullptr);
+}
+} // namespace ppp
@@ -10,6 +10,6 @@ class MockCrownChinEstimator : public ICrownChinEstimator
 {
 public:
     MOCK_METHOD1(configure, void(const ConfigLoaderSPtr &));
-    MOCK_METHOD1(estimateCrownChin, bool(LandMarks &));
+    MOCK_METHOD2(estimateCrownChin, bool(LandMarks &, const ParameterOverrides *));
 };
 } // namespace ppp
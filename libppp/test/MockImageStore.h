@@ -10,15 +10,27 @@ class MockImageStore final : public IImageStore
 {
 public:
     MOCK_METHOD1(getImage, cv::Mat(const std::string &));
+    MOCK_METHOD1(getLumaImage, cv::Mat(const std::string &));
+    MOCK_METHOD2(getImageRegion, cv::Mat(const std::string &, const cv::Rect &));
+    MOCK_METHOD1(getImageSize, cv::Size(const std::string &));
+    MOCK_METHOD0(isPlanarStorage, bool());
+    MOCK_METHOD2(getProxyImage, cv::Mat(const std::string &, double &));
+    MOCK_METHOD4(decodeImageRegion, cv::Mat(const std::string &, const cv::Rect &, double, double &));
+    MOCK_METHOD1(containsEncodedImage, bool(const std::string &));
+    MOCK_METHOD1(getEncodedImage, EncodedImageSPtr(const std::string &));
+    MOCK_METHOD1(getDecodeScale, int(const std::string &));
     MOCK_METHOD1(getExifInfo, easyexif::EXIFInfoSPtr(const std::string &));
     MOCK_METHOD1(getLandMarks, LandMarksSPtr(const std::string &));
+    MOCK_METHOD2(setLandMarks, void(const std::string &, const LandMarks &));
 
     MOCK_METHOD1(unlockImage, void(const std::string &));
+    MOCK_METHOD2(findSimilarImage, LandMarksSPtr(const std::string &, cv::Size &));
     MOCK_METHOD1(containsImage, bool(const std::string &));
     MOCK_METHOD1(setStoreSize, void(size_t));
 
     MOCK_METHOD1(setImage, std::string(const std::string &));
     MOCK_METHOD2(setImage, std::string(const char *, size_t));
+    MOCK_METHOD1(setImage, std::string(const cv::Mat &));
 
     MOCK_METHOD1(configureInternal, void(const ConfigLoaderSPtr &));
 };
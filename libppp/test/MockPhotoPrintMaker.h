@@ -8,8 +8,30 @@ namespace ppp
 class MockPhotoPrintMaker : public IPhotoPrintMaker
 {
 public:
-    MOCK_METHOD4(cropPicture, cv::Mat(const cv::Mat &, const cv::Point &, const cv::Point &, const PhotoStandard &));
-    MOCK_METHOD3(tileCroppedPhoto, cv::Mat(const PrintDefinition &, const PhotoStandard &, const cv::Mat &));
+    MOCK_METHOD5(cropPicture,
+                 cv::Mat(const cv::Mat &,
+                         const cv::Point &,
+                         const cv::Point &,
+                         const PhotoStandard &,
+                         const ParameterOverrides *));
+    MOCK_METHOD3(cropBoundingBox, cv::Rect(const cv::Point &, const cv::Point &, const PhotoStandard &));
+    MOCK_METHOD4(renderGangSheet,
+                 cv::Mat(const PrintDefinition &,
+                         const GangSheet &,
+                         const std::vector<cv::Mat> &,
+                         const ParameterOverrides *));
+    MOCK_METHOD5(tileCroppedPhoto,
+                 cv::Mat(const PrintDefinition &,
+                         const PhotoStandard &,
+                         const cv::Mat &,
+                         const ColorLut3D *,
+                         const ParameterOverrides *));
+    MOCK_METHOD5(cropJpegLossless,
+                 bool(const std::vector<BYTE> &,
+                      const cv::Point &,
+                      const cv::Point &,
+                      const PhotoStandard &,
+                      std::vector<BYTE> &));
 
 protected:
     MOCK_METHOD1(configureInternal, void(const ConfigLoaderSPtr &));
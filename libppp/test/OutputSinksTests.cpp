@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include "OutputSinks.h"
+#include "Utilities.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace ppp
+{
+namespace
+{
+std::vector<BYTE> testBytes(const size_t size)
+{
+    std::vector<BYTE> bytes(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        bytes[i] = static_cast<BYTE>(i * 7919 >> 3);
+    }
+    return bytes;
+}
+} // namespace
+
+TEST(OutputSinksTests, Base64IsTheSameAsBase64Encode)
+{
+    for (const auto size : { 0, 1, 2, 3, 4, 5, 3071, 3072, 3073, 100000 })
+    {
+        const auto bytes = testBytes(size);
+        std::string output;
+        StringOutputSink stringSink(output);
+        Base64OutputSink sink(stringSink);
+        // Uneven writes, so that groups of three bytes span several of them
+        for (size_t offset = 0, step = 1; offset < bytes.size(); offset += step, step = step % 5 + 1)
+        {
+            sink.write(reinterpret_cast<const char *>(bytes.data()) + offset, std::min(step, bytes.size() - offset));
+        }
+        sink.finish();
+        EXPECT_EQ(output, Utilities::base64Encode(bytes)) << size;
+    }
+}
+
+TEST(OutputSinksTests, CallbackReceivesFullChunks)
+{
+    const auto bytes = testBytes(1000);
+    std::vector<size_t> chunkSizes;
+    std::string output;
+    CallbackOutputSink sink(
+        [&](const char * data, const size_t size) {
+            chunkSizes.push_back(size);
+            output.append(data, size);
+        },
+        256);
+    sink.write(reinterpret_cast<const char *>(bytes.data()), 100);
+    sink.write(reinterpret_cast<const char *>(bytes.data()) + 100, 600);
+    sink.write(reinterpret_cast<const char *>(bytes.data()) + 700, 300);
+    EXPECT_EQ(chunkSizes, std::vector<size_t>({ 256, 256, 256 }));
+    sink.finish();
+    EXPECT_EQ(chunkSizes, std::vector<size_t>({ 256, 256, 256, 232 }));
+    EXPECT_EQ(output, std::string(bytes.begin(), bytes.end()));
+}
+
+TEST(OutputSinksTests, BufferDoesNotOverflow)
+{
+    char buffer[8];
+    BufferOutputSink sink(buffer, sizeof(buffer));
+    sink.write("12345", 5);
+    EXPECT_THROW(sink.write("6789", 4), std::runtime_error);
+    sink.write("678", 3);
+    EXPECT_EQ(sink.size(), 8u);
+    EXPECT_EQ(std::string(buffer, sizeof(buffer)), "12345678");
+}
+
+TEST(OutputSinksTests, FileDescriptorReceivesTheOutput)
+{
+    const auto file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    const auto bytes = testBytes(100000);
+    FileDescriptorOutputSink sink(fileno(file));
+    sink.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    sink.finish();
+    EXPECT_EQ(sink.size(), bytes.size());
+
+    std::rewind(file);
+    std::vector<BYTE> readBytes(bytes.size() + 1);
+    EXPECT_EQ(std::fread(readBytes.data(), 1, readBytes.size(), file), bytes.size());
+    readBytes.pop_back();
+    EXPECT_EQ(readBytes, bytes);
+    std::fclose(file);
+}
+
+TEST(OutputSinksTests, WrittenPngHasThePixelsAndTheResolutionOfTheImage)
+{
+    cv::Mat image(64, 48, CV_8UC3);
+    cv::randu(image, 0, 255);
+
+    std::string output;
+    StringOutputSink sink(output);
+    Utilities::writeImageAsPng(image, sink, false, 300);
+    const std::vector<BYTE> png(output.begin(), output.end());
+    EXPECT_EQ(cv::norm(cv::imdecode(png, cv::IMREAD_UNCHANGED), image, cv::NORM_INF), 0);
+
+    // Same resolution chunk as the one set into the file encoded by OpenCV
+    std::vector<BYTE> expectedPng;
+    cv::imencode(".png", image, expectedPng);
+    Utilities::setPngResolutionDpi(expectedPng, 300);
+    const auto chunkOf = [](const std::vector<BYTE> & bytes) {
+        const std::string type = "pHYs";
+        const auto it = std::search(bytes.begin(), bytes.end(), type.begin(), type.end());
+        return it == bytes.end() ? std::vector<BYTE>() : std::vector<BYTE>(it - 4, it + 17);
+    };
+    EXPECT_FALSE(chunkOf(png).empty());
+    EXPECT_EQ(chunkOf(png), chunkOf(expectedPng));
+
+    // Streamed through the base64 sink, the same bytes as encoded at once
+    std::string base64Output;
+    StringOutputSink base64Sink(base64Output);
+    Utilities::writeImageAsPng(image, base64Sink, true, 300);
+    EXPECT_EQ(base64Output, Utilities::base64Encode(png));
+}
+} // namespace ppp
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include "OutputSinks.h"
+#include "ParallelPngEncoder.h"
+#include "Utilities.h"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+
+namespace ppp
+{
+namespace
+{
+// Built without zlib, PNG files are encoded by OpenCV
+bool isAvailable()
+{
+    return ParallelPngEncoder::supports(cv::Mat(1, 1, CV_8UC3));
+}
+
+std::vector<BYTE> encode(const cv::Mat & image, const double resolutionDpi = 0)
+{
+    std::string output;
+    StringOutputSink sink(output);
+    ParallelPngEncoder::write(image, sink, resolutionDpi);
+    return std::vector<BYTE>(output.begin(), output.end());
+}
+
+/*!@brief Smooth gradient with a noisy patch, spanning several blocks of the encoder !*/
+cv::Mat testImage(const int type)
+{
+    cv::Mat image(1500, 900, type);
+    for (auto row = 0; row < image.rows; ++row)
+    {
+        image.row(row).setTo(cv::Scalar::all(row * 255 / image.rows));
+    }
+    cv::randu(image(cv::Rect(100, 600, 400, 300)), 0, 255);
+    return image;
+}
+
+std::vector<BYTE> chunkOf(const std::vector<BYTE> & png, const std::string & type)
+{
+    const auto it = std::search(png.begin(), png.end(), type.begin(), type.end());
+    return it == png.end() ? std::vector<BYTE>() : std::vector<BYTE>(it - 4, it + 17);
+}
+} // namespace
+
+TEST(ParallelPngEncoderTests, DecodesToTheImage)
+{
+    if (!isAvailable())
+    {
+        GTEST_SKIP() << "Built without zlib";
+    }
+    for (const auto type : { CV_8UC1, CV_8UC3, CV_8UC4 })
+    {
+        const auto image = testImage(type);
+        EXPECT_EQ(cv::norm(cv::imdecode(encode(image), cv::IMREAD_UNCHANGED), image, cv::NORM_INF), 0) << type;
+    }
+    // Smaller than a block, and not continuous
+    const auto image = testImage(CV_8UC3)(cv::Rect(3, 5, 7, 2));
+    EXPECT_EQ(cv::norm(cv::imdecode(encode(image), cv::IMREAD_UNCHANGED), image, cv::NORM_INF), 0);
+}
+
+TEST(ParallelPngEncoderTests, OutputDoesNotDependOnTheThreads)
+{
+    if (!isAvailable())
+    {
+        GTEST_SKIP() << "Built without zlib";
+    }
+    const auto image = testImage(CV_8UC3);
+    const auto numThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    const auto singleThreadPng = encode(image);
+    cv::setNumThreads(4);
+    const auto multiThreadPng = encode(image);
+    cv::setNumThreads(numThreads);
+    EXPECT_EQ(singleThreadPng, multiThreadPng);
+}
+
+TEST(ParallelPngEncoderTests, WritesTheResolutionChunk)
+{
+    if (!isAvailable())
+    {
+        GTEST_SKIP() << "Built without zlib";
+    }
+    const cv::Mat image(16, 16, CV_8UC3, cv::Scalar(10, 20, 30));
+    std::vector<BYTE> expectedPng;
+    cv::imencode(".png", image, expectedPng);
+    Utilities::setPngResolutionDpi(expectedPng, 300);
+
+    const auto png = encode(image, 300);
+    EXPECT_FALSE(chunkOf(png, "pHYs").empty());
+    EXPECT_EQ(chunkOf(png, "pHYs"), chunkOf(expectedPng, "pHYs"));
+    EXPECT_TRUE(chunkOf(encode(image), "pHYs").empty());
+}
+} // namespace ppp
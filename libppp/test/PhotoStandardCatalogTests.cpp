@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include "ConfigLoader.h"
+#include "PhotoStandard.h"
+#include "PhotoStandardCatalog.h"
+#include "PrintDefinition.h"
+
+namespace ppp
+{
+TEST(PhotoStandardCatalogTests, EntriesAreLoadedFromConfigAndSharedAcrossRequests)
+{
+    const auto config = std::make_shared<ConfigLoader>(R"({
+        "catalog": {
+            "photoStandards": [
+                { "id": "ps600", "dimensions": { "pictureWidth": 35, "pictureHeight": 45, "faceHeight": 34,
+                                                 "dpi": 600 } },
+                { "id": "ps300", "dimensions": { "pictureWidth": 2, "pictureHeight": 2, "faceHeight": 1.29,
+                                                 "dpi": 300, "units": "inch" } }
+            ],
+            "printDefinitions": [
+                { "id": "6x4in", "width": 6, "height": 4, "resolution": 300, "units": "inch" },
+                { "id": "10x15cm", "width": 15, "height": 10, "resolution": 400, "units": "cm" }
+            ]
+        }
+    })");
+
+    PhotoStandardCatalog catalog;
+    catalog.configure(config);
+
+    const auto ps600 = catalog.photoStandard("ps600");
+    EXPECT_EQ(ps600, catalog.photoStandard("ps600"));
+    EXPECT_DOUBLE_EQ(ps600->photoHeight(), 45 * 600 / 25.4);
+    EXPECT_DOUBLE_EQ(catalog.printDefinition("6x4in")->width(), 1800);
+    EXPECT_THROW(catalog.photoStandard("unknown"), std::runtime_error);
+    EXPECT_THROW(catalog.printDefinition("unknown"), std::runtime_error);
+
+    // Rescaled versions for the resolution of the print definitions are created once
+    const auto ps300At400 = catalog.photoStandard("ps300", 400);
+    EXPECT_EQ(ps300At400, catalog.photoStandard("ps300", 400));
+    EXPECT_DOUBLE_EQ(ps300At400->photoWidth(), 800);
+    EXPECT_DOUBLE_EQ(ps300At400->faceHeight("inch"), 1.29);
+    EXPECT_EQ(catalog.photoStandard("ps300", 300), catalog.photoStandard("ps300"));
+
+    // Resolutions not used by any print definition are still supported
+    EXPECT_DOUBLE_EQ(catalog.photoStandard("ps300", 1200)->photoHeight(), 2400);
+}
+
+TEST(PhotoStandardCatalogTests, RegisteringEntriesDoesNotChangeEarlierSnapshots)
+{
+    PhotoStandardCatalog catalog;
+    const auto before = catalog.snapshot();
+
+    catalog.registerPhotoStandard("square", std::make_shared<PhotoStandard>(50, 50, 30, 0, 0, 300));
+    catalog.registerPrintDefinition("5x7in", std::make_shared<PrintDefinition>(7, 5, 600, "inch"));
+
+    EXPECT_TRUE(before->photoStandards.empty());
+    EXPECT_TRUE(before->printDefinitions.empty());
+
+    const auto after = catalog.snapshot();
+    EXPECT_EQ(after->photoStandards.size(), 1u);
+    EXPECT_EQ(after->printDefinitions.size(), 1u);
+    ASSERT_EQ(after->printResolutionStandards.at("square").size(), 1u);
+    EXPECT_DOUBLE_EQ(after->printResolutionStandards.at("square").front()->resolutionDpi(), 600);
+}
+} // namespace ppp
@@ -27,4 +27,16 @@ TEST(PhotoStandardTests, canLoadAllPredefinedPhotoStandardsFromJson)
         }
     }
 }
+
+TEST(PhotoStandardTests, withResolutionReturnsRescaledCopy)
+{
+    const PhotoStandard ps(35, 45, 34, 0, 20, 300, "mm");
+    const auto ps600 = ps.withResolution(600);
+
+    EXPECT_DOUBLE_EQ(ps.resolutionDpi(), 300);
+    EXPECT_DOUBLE_EQ(ps600.resolutionDpi(), 600);
+    EXPECT_DOUBLE_EQ(ps600.photoHeight(), 2 * ps.photoHeight());
+    EXPECT_DOUBLE_EQ(ps600.faceHeight(), 2 * ps.faceHeight());
+    EXPECT_DOUBLE_EQ(ps600.crownTop("mm"), ps.crownTop("mm"));
+}
 } // namespace ppp
@@ -4,6 +4,7 @@
 #include "LandMarks.h"
 #include "PhotoStandard.h"
 #include "PrintDefinition.h"
+#include "StageMetrics.h"
 
 #include "MockCrownChinEstimator.h"
 #include "MockDetector.h"
@@ -73,9 +74,91 @@ TEST_F(PppEngineTests, DISABLED_LandMarkDetectionWorkflowHappyPath)
 
     EXPECT_CALL(*m_pFaceDetector, detectLandMarks(_, Ref(*landmarks))).WillOnce(Return(true));
 
-    EXPECT_CALL(*m_pCrownChinEstimator, estimateCrownChin(Ref(*landmarks))).WillOnce(Return(true));
+    EXPECT_CALL(*m_pCrownChinEstimator, estimateCrownChin(Ref(*landmarks), _)).WillOnce(Return(true));
+
+    EXPECT_CALL(*m_pImageStore, setLandMarks(Ref(imgKey), Ref(*landmarks)));
 
     // Act
     EXPECT_EQ(true, m_pppEngine->detectLandMarks(imgKey));
 }
+
+TEST_F(PppEngineTests, GangSheetsCropEvictedImagesFromTheirFile)
+{
+    // More jobs than the store keeps decoded images, only the last one is still decoded
+    const auto photoStandard = std::make_shared<PhotoStandard>(2, 2, 1.1875, 0.0, 0.0, 300, "inch");
+    const PrintDefinition printDefinition(6, 4, 300, "inch");
+    std::vector<GangSheetJob> jobs;
+    for (const auto & imageKey : { "a", "b", "c" })
+    {
+        jobs.push_back({ imageKey, photoStandard, cv::Point(50, 20), cv::Point(50, 80) });
+    }
+    EXPECT_CALL(*m_pImageStore, containsImage(_)).WillRepeatedly(Return(false));
+    EXPECT_CALL(*m_pImageStore, containsImage("c")).WillRepeatedly(Return(true));
+    EXPECT_CALL(*m_pImageStore, containsEncodedImage(_)).WillRepeatedly(Return(true));
+
+    const cv::Rect cropRegion(0, 0, 100, 100);
+    const cv::Mat regionImage(100, 100, CV_8UC3, cv::Scalar(10, 20, 30));
+    EXPECT_CALL(*m_pPhotoPrintMaker, cropBoundingBox(_, _, _)).WillRepeatedly(Return(cropRegion));
+    EXPECT_CALL(*m_pImageStore, getImageRegion("c", cropRegion)).WillOnce(Return(regionImage));
+    EXPECT_CALL(*m_pImageStore, decodeImageRegion("a", cropRegion, _, _))
+        .WillOnce(DoAll(SetArgReferee<3>(1.0), Return(regionImage)));
+    EXPECT_CALL(*m_pImageStore, decodeImageRegion("b", cropRegion, _, _))
+        .WillOnce(DoAll(SetArgReferee<3>(1.0), Return(regionImage)));
+    EXPECT_CALL(*m_pPhotoPrintMaker, cropPicture(_, _, _, _, _)).Times(3).WillRepeatedly(Return(regionImage));
+    EXPECT_CALL(*m_pPhotoPrintMaker, renderGangSheet(_, _, SizeIs(3), _))
+        .WillOnce(Return(cv::Mat(1200, 1800, CV_8UC3)));
+
+    auto numDeliveredSheets = 0;
+    const auto numSheets
+        = m_pppEngine->createGangSheets(jobs, printDefinition, [&](const cv::Mat &) { ++numDeliveredSheets; });
+    EXPECT_EQ(numSheets, 1);
+    EXPECT_EQ(numDeliveredSheets, 1);
+}
+
+TEST_F(PppEngineTests, GangSheetsRejectImagesNoLongerStored)
+{
+    const auto photoStandard = std::make_shared<PhotoStandard>(2, 2, 1.1875, 0.0, 0.0, 300, "inch");
+    const PrintDefinition printDefinition(6, 4, 300, "inch");
+    const std::vector<GangSheetJob> jobs { { "a", photoStandard, cv::Point(50, 20), cv::Point(50, 80) } };
+    EXPECT_CALL(*m_pImageStore, containsImage("a")).WillRepeatedly(Return(false));
+    EXPECT_CALL(*m_pImageStore, containsEncodedImage("a")).WillRepeatedly(Return(false));
+
+    EXPECT_THROW(m_pppEngine->createGangSheets(jobs, printDefinition, [](const cv::Mat &) {}), std::runtime_error);
+}
+
+TEST_F(PppEngineTests, AllocationsOfTheSheetRenderingThreadsAreCountedInTheRequest)
+{
+    const auto photoStandard = std::make_shared<PhotoStandard>(2, 2, 1.1875, 0.0, 0.0, 300, "inch");
+    const PrintDefinition printDefinition(6, 4, 300, "inch");
+    const std::vector<GangSheetJob> jobs { { "a", photoStandard, cv::Point(50, 20), cv::Point(50, 80) } };
+    const cv::Mat regionImage(100, 100, CV_8UC3, cv::Scalar(10, 20, 30));
+    EXPECT_CALL(*m_pImageStore, containsImage("a")).WillRepeatedly(Return(true));
+    EXPECT_CALL(*m_pPhotoPrintMaker, cropBoundingBox(_, _, _)).WillRepeatedly(Return(cv::Rect(0, 0, 100, 100)));
+    EXPECT_CALL(*m_pImageStore, getImageRegion("a", _)).WillOnce(Return(regionImage));
+    EXPECT_CALL(*m_pPhotoPrintMaker, cropPicture(_, _, _, _, _)).WillOnce(Return(regionImage));
+    // The sheet is allocated by the thread rendering it
+    const cv::Size sheetSize(1800, 1200);
+    EXPECT_CALL(*m_pPhotoPrintMaker, renderGangSheet(_, _, _, _)).WillOnce(InvokeWithoutArgs([sheetSize]() {
+        return cv::Mat(sheetSize, CV_8UC3, cv::Scalar::all(255));
+    }));
+
+    StageMetrics::reset();
+    {
+        PPP_REQUEST_SCOPE("testGangSheets");
+        EXPECT_EQ(m_pppEngine->createGangSheets(jobs, printDefinition, [](const cv::Mat &) {}), 1);
+    }
+
+    const auto request = StageMetrics::get("testGangSheets", ScopeKind::REQUEST);
+    EXPECT_EQ(request.calls, 1u);
+    if (AllocationTracker::isEnabled())
+    {
+        EXPECT_GE(request.allocations.count, 1u);
+        EXPECT_GE(request.allocations.bytes, static_cast<uint64_t>(sheetSize.area() * 3));
+    }
+    else
+    {
+        EXPECT_EQ(request.allocations.count, 0u);
+    }
+    StageMetrics::reset();
+}
 } // namespace ppp
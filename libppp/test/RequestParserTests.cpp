@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include "AllocationTracker.h"
+#include "RequestParser.h"
+
+namespace ppp
+{
+TEST(RequestParserTests, ParsesAllFields)
+{
+    RequestParser parser;
+    ApiRequest request;
+    parser.parse(R"({
+        "imgKey": "abc123",
+        "standard": { "pictureWidth": 35, "pictureHeight": 45, "faceHeight": 34, "units": "mm" },
+        "canvas": "6x4in",
+        "crownPoint": { "x": 500, "y": 10.6 },
+        "chinPoint": { "x": 510, "y": 700 },
+        "asBase64": true,
+        "printProfile": "printer",
+        "format": "jpeg",
+        "maxHeight": 480,
+        "complianceChecks": [ "face", "eyes" ]
+    })",
+                 request);
+
+    EXPECT_EQ(request.imageId, "abc123");
+    ASSERT_TRUE(request.standard.has_value());
+    EXPECT_TRUE(request.standardId.empty());
+    EXPECT_DOUBLE_EQ(request.standard->photoWidth("mm"), 35);
+    EXPECT_DOUBLE_EQ(request.standard->faceHeight("mm"), 34);
+    EXPECT_DOUBLE_EQ(request.standard->resolutionDpi(), 300);
+    EXPECT_EQ(request.canvasId, "6x4in");
+    EXPECT_FALSE(request.canvas.has_value());
+    EXPECT_EQ(request.crownPoint, cv::Point(500, 11));
+    EXPECT_EQ(request.chinPoint, cv::Point(510, 700));
+    EXPECT_TRUE(request.asBase64);
+    EXPECT_FALSE(request.autoCorrect);
+    EXPECT_EQ(request.printProfile, "printer");
+    EXPECT_EQ(request.format, "jpeg");
+    EXPECT_EQ(request.maxHeight, 480);
+    EXPECT_EQ(request.complianceChecks, std::vector<std::string>({ "face", "eyes" }));
+}
+
+TEST(RequestParserTests, ReusedRequestIsCleared)
+{
+    RequestParser parser;
+    ApiRequest request;
+    parser.parse(R"({ "imgKey": "abc", "standard": "us", "crownPoint": { "x": 1, "y": 2 }, "asBase64": true })",
+                 request);
+    parser.parse(R"({ "canvas": { "width": 6, "height": 4, "resolution": 300, "units": "inch" } })", request);
+
+    EXPECT_TRUE(request.imageId.empty());
+    EXPECT_TRUE(request.standardId.empty());
+    EXPECT_FALSE(request.crownPoint.has_value());
+    EXPECT_FALSE(request.asBase64);
+    ASSERT_TRUE(request.canvas.has_value());
+    EXPECT_DOUBLE_EQ(request.canvas->width("inch"), 6);
+    EXPECT_DOUBLE_EQ(request.canvas->resolutionDpi(), 300);
+}
+
+TEST(RequestParserTests, UnknownKeysAreSkipped)
+{
+    RequestParser parser;
+    ApiRequest request;
+    parser.parse(R"({ "preprocessing": { "a": [ 1, { "b": null } ] }, "imgKey": "abc", "other": [ "x" ] })", request);
+    EXPECT_EQ(request.imageId, "abc");
+}
+
+TEST(RequestParserTests, ParsesOverrides)
+{
+    RequestParser parser;
+    ApiRequest request;
+    parser.parse(R"({
+        "overrides": {
+            "photoPrintMaker": { "background": [ 255, 250, 240 ], "backgroundReplacement": { "enabled": true } },
+            "crownChinEstimator": { "chinCrownCoeff": 1.8 }
+        }
+    })",
+                 request);
+
+    EXPECT_EQ(request.overrides.backgroundColor, cv::Scalar(255, 250, 240));
+    EXPECT_EQ(request.overrides.chinCrownCoeff, 1.8);
+    EXPECT_FALSE(request.overrides.chinFrownCoeff.has_value());
+
+    parser.parse(R"({ "imgKey": "abc" })", request);
+    EXPECT_TRUE(request.overrides.empty());
+}
+
+TEST(RequestParserTests, ParsesGangSheetJobs)
+{
+    RequestParser parser;
+    ApiRequest request;
+    parser.parse(R"({
+        "canvas": "6x4in",
+        "jobs": [
+            { "imgKey": "abc", "standard": "passport_us", "crownPoint": { "x": 5, "y": 1 },
+              "chinPoint": { "x": 6, "y": 70 }, "copies": 4 },
+            { "imgKey": "def", "crownPoint": { "x": 50, "y": 10 }, "chinPoint": { "x": 51, "y": 700 },
+              "standard": { "pictureWidth": 35, "pictureHeight": 45, "faceHeight": 34 }, "notes": [ 1 ] }
+        ],
+        "crownPoint": { "x": 1, "y": 2 }
+    })",
+                 request);
+
+    EXPECT_EQ(request.canvasId, "6x4in");
+    EXPECT_EQ(request.crownPoint, cv::Point(1, 2));
+    EXPECT_FALSE(request.standard.has_value());
+    ASSERT_EQ(request.jobs.size(), 2u);
+    EXPECT_EQ(request.jobs[0].imageId, "abc");
+    EXPECT_EQ(request.jobs[0].standardId, "passport_us");
+    EXPECT_EQ(request.jobs[0].crownPoint, cv::Point(5, 1));
+    EXPECT_EQ(request.jobs[0].chinPoint, cv::Point(6, 70));
+    EXPECT_EQ(request.jobs[0].copies, 4);
+    EXPECT_EQ(request.jobs[1].imageId, "def");
+    EXPECT_TRUE(request.jobs[1].standardId.empty());
+    ASSERT_TRUE(request.jobs[1].standard.has_value());
+    EXPECT_EQ(request.jobs[1].standard->photoWidth("mm"), 35);
+    EXPECT_EQ(request.jobs[1].chinPoint, cv::Point(51, 700));
+    EXPECT_EQ(request.jobs[1].copies, 1);
+
+    parser.parse(R"({ "imgKey": "abc" })", request);
+    EXPECT_TRUE(request.jobs.empty());
+}
+
+TEST(RequestParserTests, InvalidRequestsThrow)
+{
+    RequestParser parser;
+    ApiRequest request;
+    for (const auto json : { R"({ "asBase64": "yes" })",
+                             R"({ "imgKey": 1 })",
+                             R"({ "printProfile": null })",
+                             R"({ "crownPoint": { "x": 1 } })",
+                             R"({ "standard": { "pictureWidth": 35 } })",
+                             R"({ "standard": { "pictureWidth": -1, "pictureHeight": 45, "faceHeight": 34 } })",
+                             R"({ "complianceChecks": [ 1 ] })",
+                             R"({ "overrides": { "photoPrintMaker": { "background": [ 255, 255 ] } } })",
+                             R"({ "overrides": { "photoPrintMaker": { "background": [ 0, 0, 0, 0 ] } } })",
+                             R"({ "overrides": { "photoPrintMaker": { "background": [ 0, 256, 0 ] } } })",
+                             R"({ "overrides": { "crownChinEstimator": { "chinFrownCoeff": 0 } } })",
+                             R"({ "jobs": [ "abc" ] })",
+                             R"({ "jobs": [ { "imgKey": "abc", "standard": "passport_us" } ] })",
+                             R"({ "jobs": [ { "imgKey": "abc", "standard": "passport_us", "copies": -1,
+                                 "crownPoint": { "x": 1, "y": 2 }, "chinPoint": { "x": 1, "y": 9 } } ] })",
+                             R"({ "jobs": { "imgKey": "abc" } })",
+                             R"({ "imgKey": "abc")",
+                             R"([ 1, 2 ])" })
+    {
+        EXPECT_THROW(parser.parse(json, request), std::runtime_error) << json;
+    }
+}
+
+TEST(RequestParserTests, ParsingAgainIntoAReusedRequestDoesNotAllocate)
+{
+    if (!AllocationTracker::isEnabled())
+    {
+        GTEST_SKIP() << "Allocations are only counted when built with PPP_TRACK_ALLOCATIONS";
+    }
+    const std::string json = R"({
+        "imgKey": "0a1b2c3d4e5f60718293a4b5c6d7e8f9",
+        "standard": "passport_us",
+        "canvas": "6x4in",
+        "crownPoint": { "x": 500, "y": 10 },
+        "chinPoint": { "x": 510, "y": 700 },
+        "asBase64": true,
+        "format": "jpeg",
+        "complianceChecks": [ "face", "eyes" ],
+        "overrides": { "crownChinEstimator": { "chinCrownCoeff": 1.7 } }
+    })";
+    RequestParser parser;
+    ApiRequest request;
+    // The first parse sizes the strings of the request and the stack of the reader
+    parser.parse(json, request);
+
+    const auto startAllocations = AllocationTracker::currentThreadCounts();
+    for (auto i = 0; i < 10; ++i)
+    {
+        parser.parse(json, request);
+    }
+    const auto allocations = AllocationTracker::currentThreadCounts() - startAllocations;
+
+    EXPECT_EQ(request.imageId, "0a1b2c3d4e5f60718293a4b5c6d7e8f9");
+    EXPECT_EQ(request.complianceChecks.size(), 2u);
+    EXPECT_EQ(allocations.count, 0u);
+    EXPECT_EQ(allocations.bytes, 0u);
+}
+} // namespace ppp
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "RequestRecorder.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace ppp
+{
+TEST(RequestRecorderTests, RecordedRequestsCanBeReadBack)
+{
+    const auto archiveFile = testing::TempDir() + "RequestRecorderTests.pppr";
+    const auto config = std::string(R"({"imageStore": {"size": 4}})");
+    const std::string imageBytes("\xff\xd8\x00\x01\xff\xd9", 6);
+
+    RequestRecorder recorder;
+    recorder.setConfiguration(config);
+    {
+        // Calls made before recording starts are not captured
+        RecordedCall(recorder, "getImage").arg("ignored");
+    }
+
+    recorder.start(archiveFile);
+    {
+        RecordedCall recordedCall(recorder, "setImage");
+        recordedCall.arg(imageBytes.data(), imageBytes.size()).arg("6");
+    }
+    {
+        RecordedCall recordedCall(recorder, "createTiledPrint");
+        recordedCall.arg("0a1b2c3d").arg(R"({"asBase64": false})");
+    }
+    recorder.stop();
+    {
+        RecordedCall(recorder, "getImage").arg("ignored");
+    }
+
+    const auto archive = RequestRecorder::readArchive(archiveFile);
+    std::remove(archiveFile.c_str());
+
+    EXPECT_EQ(archive.configHash, RequestRecorder::configurationHash(config));
+    ASSERT_EQ(archive.requests.size(), 2u);
+
+    const auto & setImage = archive.requests[0];
+    EXPECT_EQ(setImage.name, "setImage");
+    ASSERT_EQ(setImage.args.size(), 2u);
+    EXPECT_EQ(setImage.args[0], imageBytes);
+    EXPECT_EQ(setImage.args[1], "6");
+    EXPECT_GE(setImage.durationMs, 0.0);
+
+    const auto & createTiledPrint = archive.requests[1];
+    EXPECT_EQ(createTiledPrint.name, "createTiledPrint");
+    EXPECT_EQ(createTiledPrint.args, std::vector<std::string>({ "0a1b2c3d", R"({"asBase64": false})" }));
+    EXPECT_GE(createTiledPrint.startTimeUs, setImage.startTimeUs);
+}
+
+TEST(RequestRecorderTests, ReadingInvalidArchiveThrows)
+{
+    const auto archiveFile = testing::TempDir() + "RequestRecorderTests.invalid";
+    {
+        std::ofstream os(archiveFile, std::ios::binary);
+        os << "not an archive";
+    }
+    EXPECT_THROW(RequestRecorder::readArchive(archiveFile), std::runtime_error);
+    std::remove(archiveFile.c_str());
+}
+
+TEST(RequestRecorderTests, ArchivesAreLittleEndian)
+{
+    const auto archiveFile = testing::TempDir() + "RequestRecorderTests.endianness";
+    RequestRecorder recorder;
+    recorder.start(archiveFile);
+    {
+        RecordedCall(recorder, "getImage").arg("key");
+    }
+    recorder.stop();
+
+    std::ifstream is(archiveFile, std::ios::binary);
+    const std::string bytes((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    std::remove(archiveFile.c_str());
+    // Version 1 after the magic, then the name length of the entry after the configuration hash
+    ASSERT_GT(bytes.size(), 16u);
+    EXPECT_EQ(bytes.substr(6, 2), std::string("\x01\x00", 2));
+    EXPECT_EQ(bytes.substr(12, 4), std::string("\x08\x00\x00\x00", 4));
+    EXPECT_EQ(bytes.substr(16, 8), "getImage");
+}
+
+TEST(RequestRecorderTests, CorruptedLengthsThrowBeforeAllocating)
+{
+    const auto archiveFile = testing::TempDir() + "RequestRecorderTests.corrupted";
+    RequestRecorder recorder;
+    recorder.start(archiveFile);
+    {
+        RecordedCall(recorder, "getImage").arg("key");
+    }
+    recorder.stop();
+    {
+        // Length of the only argument, past the name, start time, duration and number of arguments
+        std::fstream os(archiveFile, std::ios::binary | std::ios::in | std::ios::out);
+        os.seekp(6 + 2 + 4 + 4 + 8 + 8 + 8 + 4);
+        const std::string hugeLength(8, '\x7f');
+        os.write(hugeLength.data(), hugeLength.size());
+    }
+    EXPECT_THROW(RequestRecorder::readArchive(archiveFile), std::runtime_error);
+    std::remove(archiveFile.c_str());
+}
+} // namespace ppp
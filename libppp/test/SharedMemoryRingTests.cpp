@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include "ImageStore.h"
+#include "SharedMemoryRing.h"
+#include "SharedMemoryServer.h"
+
+#include <cstring>
+
+#include <opencv2/core/core.hpp>
+
+namespace ppp
+{
+class SharedMemoryRingTests : public testing::Test
+{
+protected:
+    // The client side creates both rings, the engine side maps them a second time like another process would
+    SharedMemoryRingSPtr m_clientRequests = SharedMemoryRing::create("ppp_test_requests", 3, 64 * 64 * 3);
+    SharedMemoryRingSPtr m_clientResponses = SharedMemoryRing::create("ppp_test_responses", 3, 1024);
+    SharedMemoryRingSPtr m_serverRequests = SharedMemoryRing::open("ppp_test_requests");
+    SharedMemoryRingSPtr m_serverResponses = SharedMemoryRing::open("ppp_test_responses");
+    ImageStoreSPtr m_pImageStore = std::make_shared<ImageStore>();
+
+    SharedMemoryServer createServer()
+    {
+        const auto noRenderer = [](const std::string &, double &) -> cv::Mat {
+            throw std::runtime_error("Not expected");
+        };
+        return SharedMemoryServer(m_pImageStore, noRenderer, m_serverRequests, m_serverResponses);
+    }
+
+    RingSlotHeader * postRawImage(const cv::Mat & image, const uint64_t requestId)
+    {
+        const auto slot = m_clientRequests->beginWrite();
+        slot->kind = static_cast<uint32_t>(ShmRequestKind::SET_IMAGE_RAW);
+        slot->requestId = requestId;
+        slot->rows = image.rows;
+        slot->cols = image.cols;
+        slot->type = image.type();
+        slot->length = image.total() * image.elemSize();
+        std::memcpy(SharedMemoryRing::payload(slot), image.data, slot->length);
+        m_clientRequests->commitWrite(slot);
+        return slot;
+    }
+
+    std::string readResponse(const uint64_t requestId, const ShmResponseKind expectedKind)
+    {
+        const auto slot = m_clientResponses->beginRead();
+        EXPECT_NE(slot, nullptr);
+        EXPECT_EQ(slot->requestId, requestId);
+        EXPECT_EQ(slot->kind, static_cast<uint32_t>(expectedKind));
+        const std::string content(reinterpret_cast<const char *>(SharedMemoryRing::payload(slot)), slot->length);
+        SharedMemoryRing::release(slot);
+        return content;
+    }
+};
+
+TEST_F(SharedMemoryRingTests, SlotsWrittenByOneMappingAreReadByTheOther)
+{
+    EXPECT_EQ(m_serverRequests->numSlots(), 3);
+    EXPECT_EQ(m_serverRequests->slotCapacity(), 64 * 64 * 3);
+    EXPECT_EQ(m_serverRequests->beginRead(), nullptr);
+
+    const auto written = m_clientRequests->beginWrite();
+    std::memcpy(SharedMemoryRing::payload(written), "hello", 5);
+    written->length = 5;
+    written->requestId = 7;
+    m_clientRequests->commitWrite(written);
+
+    const auto read = m_serverRequests->beginRead();
+    ASSERT_NE(read, nullptr);
+    EXPECT_EQ(read->requestId, 7);
+    EXPECT_EQ(std::string(reinterpret_cast<const char *>(SharedMemoryRing::payload(read)), read->length), "hello");
+    EXPECT_EQ(m_serverRequests->beginRead(), nullptr);
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 1);
+
+    SharedMemoryRing::release(read);
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 0);
+}
+
+TEST_F(SharedMemoryRingTests, SlotsCanBeReleasedOutOfOrder)
+{
+    RingSlotHeader * slots[3];
+    for (uint64_t requestId = 0; requestId < 3; ++requestId)
+    {
+        // Each process maps the ring at its own address, slots are compared through their content
+        const auto slot = slots[requestId] = m_clientRequests->beginWrite();
+        ASSERT_NE(slot, nullptr);
+        slot->requestId = requestId + 1;
+        m_clientRequests->commitWrite(slot);
+        EXPECT_EQ(m_serverRequests->beginRead()->requestId, requestId + 1);
+    }
+    EXPECT_EQ(m_clientRequests->beginWrite(), nullptr);
+
+    // A slot released early is reused right away, the slots before it may be held for long
+    SharedMemoryRing::release(slots[1]);
+    EXPECT_EQ(m_clientRequests->beginWrite(), slots[1]);
+    slots[1]->requestId = 4;
+    m_clientRequests->commitWrite(slots[1]);
+    EXPECT_EQ(m_clientRequests->beginWrite(), nullptr);
+
+    // Requests are still read in the order they were written
+    SharedMemoryRing::release(slots[0]);
+    EXPECT_EQ(m_clientRequests->beginWrite(), slots[0]);
+    slots[0]->requestId = 5;
+    m_clientRequests->commitWrite(slots[0]);
+    EXPECT_EQ(m_serverRequests->beginRead()->requestId, 4);
+    EXPECT_EQ(m_serverRequests->beginRead()->requestId, 5);
+}
+
+TEST_F(SharedMemoryRingTests, ReplacementConsumerCarriesOnWhereTheDeadOneStopped)
+{
+    for (auto i = 0; i < 2; ++i)
+    {
+        const auto slot = m_clientRequests->beginWrite();
+        slot->requestId = i;
+        m_clientRequests->commitWrite(slot);
+    }
+    // The first consumer dies while holding the first request
+    EXPECT_EQ(m_serverRequests->beginRead()->requestId, 0);
+    m_serverRequests.reset();
+
+    const auto replacement = SharedMemoryRing::open("ppp_test_requests");
+    EXPECT_EQ(replacement->numSlotsInUse(), 1);
+    replacement->reclaimConsumerSlots();
+    EXPECT_EQ(replacement->numSlotsInUse(), 0);
+    EXPECT_EQ(replacement->beginRead()->requestId, 1);
+}
+
+TEST_F(SharedMemoryRingTests, RawImagesAreStoredInPlaceUntilEvicted)
+{
+    auto server = createServer();
+    cv::Mat image1(32, 48, CV_8UC3), image2(32, 48, CV_8UC3);
+    cv::randu(image1, 0, 255);
+    cv::randu(image2, 0, 255);
+
+    const auto slot1 = postRawImage(image1, 1);
+    EXPECT_TRUE(server.serveOne());
+    const auto imageKey1 = readResponse(1, ShmResponseKind::IMAGE_KEY);
+
+    // The pixels in the store are the ones in the slot, which stays in use
+    {
+        const auto storedImage = m_pImageStore->getImage(imageKey1);
+        EXPECT_EQ(cv::norm(storedImage, image1, cv::NORM_INF), 0);
+        EXPECT_EQ(storedImage.data, SharedMemoryRing::payload(slot1));
+        EXPECT_EQ(m_clientRequests->numSlotsInUse(), 1);
+    }
+
+    // The default store keeps a single image, storing a second one evicts the first and frees its slot
+    postRawImage(image2, 2);
+    EXPECT_TRUE(server.serveOne());
+    readResponse(2, ShmResponseKind::IMAGE_KEY);
+    EXPECT_FALSE(m_pImageStore->containsImage(imageKey1));
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 1);
+}
+
+TEST_F(SharedMemoryRingTests, RawImagesInARowNeverBlockTheProducer)
+{
+    // The store keeps more images than there are request slots, so no slot is freed by an eviction
+    m_pImageStore->setStoreSize(32);
+    auto server = createServer();
+    cv::Mat image(32, 48, CV_8UC3);
+    for (uint64_t requestId = 1; requestId <= 10; ++requestId)
+    {
+        cv::randu(image, 0, 255);
+        ASSERT_NE(m_clientRequests->beginWrite(), nullptr) << "Producer blocked at request " << requestId;
+        postRawImage(image, requestId);
+        EXPECT_TRUE(server.serveOne());
+        const auto imageKey = readResponse(requestId, ShmResponseKind::IMAGE_KEY);
+        EXPECT_EQ(cv::norm(m_pImageStore->getImage(imageKey), image, cv::NORM_INF), 0);
+    }
+    // Two images were kept in place, the following ones were copied to leave the last slot to the producer
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 2);
+}
+
+TEST_F(SharedMemoryRingTests, RequestsWaitWhileTheResponsesAreNotRead)
+{
+    auto server = createServer();
+    cv::Mat image(32, 48, CV_8UC3, cv::Scalar(1, 2, 3));
+    for (uint64_t requestId = 1; requestId <= 3; ++requestId)
+    {
+        postRawImage(image, requestId);
+        EXPECT_TRUE(server.serveOne());
+    }
+    // The response ring is full, the next request is left for when the gateway catches up
+    postRawImage(image, 4);
+    EXPECT_FALSE(server.serveOne());
+    readResponse(1, ShmResponseKind::IMAGE_KEY);
+    EXPECT_TRUE(server.serveOne());
+    readResponse(2, ShmResponseKind::IMAGE_KEY);
+    readResponse(3, ShmResponseKind::IMAGE_KEY);
+    readResponse(4, ShmResponseKind::IMAGE_KEY);
+}
+
+TEST_F(SharedMemoryRingTests, RequestsOfADeadConsumerAreAnswered)
+{
+    auto server = createServer();
+    cv::Mat image(32, 48, CV_8UC3, cv::Scalar(1, 2, 3));
+    postRawImage(image, 1);
+    EXPECT_TRUE(server.serveOne());
+    readResponse(1, ShmResponseKind::IMAGE_KEY);
+
+    // The consumer dies while processing the second request, with the first image still in its slot
+    postRawImage(image, 2);
+    postRawImage(image, 3);
+    EXPECT_EQ(m_serverRequests->beginRead()->requestId, 2);
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 2);
+
+    SharedMemoryServer::answerAbandonedRequests(*m_clientRequests, *m_clientResponses, "Worker died");
+    EXPECT_EQ(readResponse(2, ShmResponseKind::ERROR_MESSAGE), "Worker died");
+    EXPECT_EQ(m_clientResponses->beginRead(), nullptr);
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 0);
+
+    // The request nobody took yet is served by the replacement consumer
+    EXPECT_TRUE(server.serveOne());
+    readResponse(3, ShmResponseKind::IMAGE_KEY);
+}
+
+TEST_F(SharedMemoryRingTests, ErrorsAreReportedInTheResponse)
+{
+    auto server = createServer();
+    const auto slot = m_clientRequests->beginWrite();
+    slot->kind = 42;
+    slot->requestId = 3;
+    slot->length = 0;
+    m_clientRequests->commitWrite(slot);
+
+    EXPECT_TRUE(server.serveOne());
+    EXPECT_FALSE(server.serveOne());
+    EXPECT_EQ(readResponse(3, ShmResponseKind::ERROR_MESSAGE), "Unknown shared memory request kind 42");
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 0);
+}
+
+TEST_F(SharedMemoryRingTests, RequestsLongerThanTheSlotAreRejected)
+{
+    auto server = createServer();
+    const auto slot = m_clientRequests->beginWrite();
+    slot->kind = static_cast<uint32_t>(ShmRequestKind::CREATE_TILED_PRINT);
+    slot->requestId = 4;
+    const auto capacity = m_clientRequests->slotCapacity();
+    slot->length = capacity + 1;
+    m_clientRequests->commitWrite(slot);
+
+    EXPECT_TRUE(server.serveOne());
+    EXPECT_EQ(readResponse(4, ShmResponseKind::ERROR_MESSAGE),
+              "Request length " + std::to_string(capacity + 1) + " exceeds the slot capacity "
+                  + std::to_string(capacity));
+    EXPECT_EQ(m_clientRequests->numSlotsInUse(), 0);
+}
+} // namespace ppp
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "StageMetrics.h"
+
+#include <future>
+#include <thread>
+#include <rapidjson/document.h>
+#include <vector>
+
+namespace ppp
+{
+TEST(StageMetricsTests, ScopesAreAccumulatedPerStage)
+{
+    StageMetrics::reset();
+    StageMetrics::setHardwareCountersEnabled(true);
+
+    volatile auto sum = 0.0;
+    for (auto i = 0; i < 3; ++i)
+    {
+        PPP_STAGE_SCOPE("testStage");
+        for (auto j = 0; j < 100000; ++j)
+        {
+            sum = sum + j;
+        }
+    }
+
+    const auto stats = StageMetrics::get("testStage");
+    EXPECT_EQ(stats.calls, 3u);
+    EXPECT_GT(stats.wallTimeMs, 0.0);
+    if (PerfCounters::forCurrentThread().isAvailable())
+    {
+        EXPECT_GT(stats.counters.instructions, 300000u);
+        EXPECT_GT(stats.counters.cycles, 0u);
+    }
+
+    rapidjson::Document d;
+    d.Parse(StageMetrics::toJson().c_str());
+    const auto & stages = d["stages"];
+    ASSERT_TRUE(stages.HasMember("testStage"));
+    EXPECT_EQ(stages["testStage"]["calls"].GetUint64(), 3u);
+    EXPECT_TRUE(stages["testStage"].HasMember("cycles"));
+
+    StageMetrics::setHardwareCountersEnabled(false);
+    StageMetrics::reset();
+}
+
+TEST(StageMetricsTests, AllocationsAreAttributedToRequestsAndStages)
+{
+    StageMetrics::reset();
+    {
+        PPP_REQUEST_SCOPE("testRequest");
+        {
+            PPP_STAGE_SCOPE("testAllocatingStage");
+            std::vector<int> values(1000, 1);
+            EXPECT_EQ(values.size(), 1000u);
+        }
+    }
+
+    const auto stage = StageMetrics::get("testAllocatingStage");
+    const auto request = StageMetrics::get("testRequest", ScopeKind::REQUEST);
+    EXPECT_EQ(stage.calls, 1u);
+    EXPECT_EQ(request.calls, 1u);
+    if (AllocationTracker::isEnabled())
+    {
+        EXPECT_GE(stage.allocations.count, 1u);
+        EXPECT_GE(stage.allocations.bytes, 1000 * sizeof(int));
+        // Requests include the allocations of their stages
+        EXPECT_GE(request.allocations.bytes, stage.allocations.bytes);
+    }
+    else
+    {
+        EXPECT_EQ(stage.allocations.count, 0u);
+    }
+    StageMetrics::reset();
+}
+
+TEST(StageMetricsTests, AllocationsOfOtherThreadsCanBeAttributedToTheWaitingOne)
+{
+    StageMetrics::reset();
+    {
+        PPP_REQUEST_SCOPE("testRequest");
+        const auto workerAllocations = std::async(std::launch::async, []() {
+                                           const auto start = AllocationTracker::currentThreadCounts();
+                                           std::vector<int> values(1000, 1);
+                                           EXPECT_EQ(values.size(), 1000u);
+                                           return AllocationTracker::currentThreadCounts() - start;
+                                       }).get();
+        AllocationTracker::attributeToCurrentThread(workerAllocations);
+    }
+
+    const auto request = StageMetrics::get("testRequest", ScopeKind::REQUEST);
+    if (AllocationTracker::isEnabled())
+    {
+        EXPECT_GE(request.allocations.bytes, 1000 * sizeof(int));
+    }
+    else
+    {
+        EXPECT_EQ(request.allocations.count, 0u);
+    }
+    StageMetrics::reset();
+}
+
+TEST(StageMetricsTests, ScopesOfAllThreadsAreMerged)
+{
+    StageMetrics::reset();
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([]() {
+            for (auto j = 0; j < 100; ++j)
+            {
+                PPP_STAGE_SCOPE("testStage");
+            }
+        });
+    }
+    {
+        PPP_STAGE_SCOPE("testStage");
+    }
+    for (auto & thread : threads)
+    {
+        thread.join();
+    }
+
+    // Including the threads that have exited
+    EXPECT_EQ(StageMetrics::get("testStage").calls, 401u);
+    rapidjson::Document d;
+    d.Parse(StageMetrics::toJson().c_str());
+    EXPECT_EQ(d["stages"]["testStage"]["calls"].GetUint64(), 401u);
+
+    StageMetrics::reset();
+    EXPECT_EQ(StageMetrics::get("testStage").calls, 0u);
+}
+} // namespace ppp
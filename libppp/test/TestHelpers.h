@@ -46,6 +46,8 @@ void verifyEqualImages(const cv::Mat & expected, const cv::Mat & actual);
 
 ConfigLoaderSPtr getConfigLoader(const std::string & configFile = "");
 
+void readConfigFromFile(const std::string & configFile, std::string & configString);
+
 void processDatabase(const DetectionCallback & callback,
                      const std::vector<std::string> & ignoredImages,
                      const std::string & landmarksPath,
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <opencv2/imgcodecs.hpp>
 
+#include "ParameterOverrides.h"
 #include "PhotoPrintMaker.h"
 #include "PhotoStandard.h"
 #include "PrintDefinition.h"
@@ -45,6 +46,24 @@ TEST_F(PhotoPrintMakerTests, TestCroppingWorks)
     benchmarkValidate(tiledPhoto, "_tiledPhoto");
 }
 
+TEST_F(PhotoPrintMakerTests, CropOfTheBoundingBoxMatchesTheCropOfThePicture)
+{
+    const PhotoStandard passportStandard(35.0, 45.0, 34.0, 0.0, 0.0, 300, "mm");
+    const cv::Point crownPos(941, 999);
+    const cv::Point chinPos(927, 1675);
+    const auto image = cv::imread(resolvePath("research/sample_test_images/000.jpg"));
+
+    // What the engine does to only process the pixels of the crop
+    const auto boundingBox = m_pPhotoPrintMaker->cropBoundingBox(crownPos, chinPos, passportStandard);
+    ASSERT_EQ(boundingBox & cv::Rect(cv::Point(), image.size()), boundingBox);
+    const auto regionCrop = m_pPhotoPrintMaker->cropPicture(
+        image(boundingBox), crownPos - boundingBox.tl(), chinPos - boundingBox.tl(), passportStandard);
+
+    const auto croppedImage = m_pPhotoPrintMaker->cropPicture(image, crownPos, chinPos, passportStandard);
+    ASSERT_EQ(regionCrop.size(), croppedImage.size());
+    EXPECT_LE(cv::norm(regionCrop, croppedImage, cv::NORM_INF), 1.0);
+}
+
 TEST_F(PhotoPrintMakerTests, TestCroppingWorksWithPadding)
 {
     const PhotoStandard passportStandard(2, 2, 1.1875, 0.0, 0.0, 300, "inch");
@@ -77,4 +96,21 @@ TEST_F(PhotoPrintMakerTests, DigitalSize)
     benchmarkValidate(printPhoto);
 }
 
+TEST_F(PhotoPrintMakerTests, BackgroundCanBeOverriddenPerRequest)
+{
+    const PhotoStandard passportStandard(35.0, 45.0, 34.0, 0.0, 0.0, 300, "mm");
+    const PrintDefinition printDefinition(6, 4, 300, "inch", 0, 1.5 / 25.4);
+    const cv::Mat croppedImage(531, 413, CV_8UC3, cv::Scalar(0, 0, 255));
+
+    ParameterOverrides overrides;
+    overrides.backgroundColor = cv::Scalar(255, 255, 255);
+    const auto overriddenPrint
+        = m_pPhotoPrintMaker->tileCroppedPhoto(printDefinition, passportStandard, croppedImage, nullptr, &overrides);
+    EXPECT_EQ(overriddenPrint.at<cv::Vec3b>(0, 0), cv::Vec3b(255, 255, 255));
+
+    // The configured background is left as it was for the other requests
+    const auto printPhoto = m_pPhotoPrintMaker->tileCroppedPhoto(printDefinition, passportStandard, croppedImage);
+    EXPECT_EQ(printPhoto.at<cv::Vec3b>(0, 0), cv::Vec3b(128, 128, 128));
+    EXPECT_EQ(cv::norm(printPhoto, overriddenPrint, cv::NORM_INF), 127);
+}
 } // namespace ppp
@@ -4,6 +4,7 @@
 #include "TestHelpers.h"
 #include <gtest/gtest.h>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include <utility>
 
 using namespace std;
@@ -56,6 +57,23 @@ TEST(UtilitiesTests, TestBase64EncodeDecode)
     }
 }
 
+TEST(UtilitiesTests, PerceptualHashMatchesRecompressedAndResizedCopies)
+{
+    const auto image = imread(resolvePath("research/sample_test_images/000.jpg"));
+    const auto otherImage = imread(resolvePath("research/sample_test_images/001.jpg"));
+
+    // Re-compress and resize the image as a messaging app would do
+    vector<uchar> jpegBytes;
+    imencode(".jpg", image, jpegBytes, { IMWRITE_JPEG_QUALITY, 60 });
+    Mat recompressedImage = imdecode(jpegBytes, IMREAD_COLOR), resizedImage;
+    resize(recompressedImage, resizedImage, Size(), 0.5, 0.5, INTER_AREA);
+
+    const auto hash = Utilities::perceptualHash(image);
+    EXPECT_LE(Utilities::hammingDistance(hash, Utilities::perceptualHash(recompressedImage)), 4);
+    EXPECT_LE(Utilities::hammingDistance(hash, Utilities::perceptualHash(resizedImage)), 4);
+    EXPECT_GT(Utilities::hammingDistance(hash, Utilities::perceptualHash(otherImage)), 10);
+}
+
 // TEST(UtilitiesTests, ResourceRetrievalWorks)
 //{
 //    string fileName = "shape_predictor_68_face_landmarks.dat";
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include "WorkerSupervisor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+namespace ppp
+{
+TEST(WorkerSupervisorTests, CrashedWorkersAreRespawned)
+{
+    std::vector<size_t> exitedWorkers;
+    WorkerSupervisor supervisor(
+        2,
+        [](const size_t workerIndex, const std::function<bool()> & keepRunning) {
+            if (workerIndex == 1)
+            {
+                std::abort();
+            }
+            while (keepRunning())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        },
+        [&exitedWorkers](const size_t workerIndex) { exitedWorkers.push_back(workerIndex); });
+
+    supervisor.start();
+    const auto initialPids = supervisor.workerPids();
+    EXPECT_GT(initialPids[0], 0);
+    EXPECT_GT(initialPids[1], 0);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (supervisor.numRespawns() == 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        supervisor.superviseOnce();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_GE(supervisor.numRespawns(), 1);
+    ASSERT_FALSE(exitedWorkers.empty());
+    EXPECT_EQ(exitedWorkers.front(), 1);
+    // The healthy worker keeps running untouched
+    EXPECT_EQ(supervisor.workerPids()[0], initialPids[0]);
+
+    supervisor.stop();
+    EXPECT_EQ(supervisor.workerPids(), std::vector<int>({ -1, -1 }));
+}
+} // namespace ppp